@@ -2,35 +2,186 @@
  * File:    components/app_logic/app_logic.c
  * Description: Main application logic task. Reads sensor data and prepares it for publishing.
  * Created on: 2025-06-11
- * Edited on:  2025-07-08
- * Version: v8.3.3
+ * Edited on:  2026-10-19
+ * Version: v8.3.10
  * Author:  R. Andrew Ballard (c) 2025
  */
 
 #include "app_logic.h"
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "cJSON.h"
 
 // Project Components
 #include "wifi_manager.h"
+#include "http_app.h"
 #include "mqtt_manager.h"
+#include "mqtt_rpc.h"
 #include "board_manager.h"
+#include "boot_manager.h"
 
 static const char *TAG = "APP_LOGIC";
 
+#define SAMPLE_PERIOD_MS 5000
+
+// Sensor lines as the dashboard and the MQTT payload report them: a set bit means "ok".
+#define LINE_POWER 0x01
+#define LINE_WATER 0x02
+#define LINE_PADS  0x04
+#define LINE_COUNT 3
+
+static const char *const line_names[LINE_COUNT] = { "power", "water", "pads" };
+
+// Transition history for the local dashboard: one entry per change of any
+// line, at the sampling granularity. Oldest entries are overwritten.
+#define HISTORY_LEN   256
+#define HISTORY_BATCH 16
+
+typedef struct {
+    uint32_t t_s;       // uptime
+    uint8_t lines;
+} history_entry_t;
+
+typedef struct {
+    uint32_t transitions;
+    uint32_t last_change_s;
+} line_stats_t;
+
+static portMUX_TYPE history_mux = portMUX_INITIALIZER_UNLOCKED;
+static history_entry_t history[HISTORY_LEN];
+static uint32_t history_seq;            // entries ever recorded
+static line_stats_t line_stats[LINE_COUNT];
+static uint8_t current_lines;
+static uint32_t samples;
+
+static uint32_t uptime_s(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+static uint8_t status_lines(const dcm_status_t *status)
+{
+    return (status->power_ok ? LINE_POWER : 0) |
+           (!status->water_low ? LINE_WATER : 0) |
+           (!status->pads_worn ? LINE_PADS : 0);
+}
+
+static void history_record(const dcm_status_t *status)
+{
+    uint8_t lines = status_lines(status);
+    uint32_t now = uptime_s();
+
+    taskENTER_CRITICAL(&history_mux);
+    uint8_t changed = lines ^ current_lines;
+    if (history_seq == 0 || changed) {
+        history[history_seq % HISTORY_LEN] = (history_entry_t){ now, lines };
+        for (int i = 0; i < LINE_COUNT && history_seq; i++) {
+            if (changed & (1 << i)) {
+                line_stats[i].transitions++;
+                line_stats[i].last_change_s = now;
+            }
+        }
+        history_seq++;
+        current_lines = lines;
+    }
+    samples++;
+    taskEXIT_CRITICAL(&history_mux);
+}
+
+// /dash/status.json: current lines, per-line transition counts and last change.
+static esp_err_t dash_status(wifi_manager_dash_write_t write, void *sink, void *ctx)
+{
+    line_stats_t stats[LINE_COUNT];
+    uint8_t lines;
+    uint32_t n;
+    char buf[96];
+
+    taskENTER_CRITICAL(&history_mux);
+    memcpy(stats, line_stats, sizeof(stats));
+    lines = current_lines;
+    n = samples;
+    taskEXIT_CRITICAL(&history_mux);
+
+    int len = snprintf(buf, sizeof(buf), "{\"uptime_s\":%" PRIu32 ",\"samples\":%" PRIu32 ",\"period_ms\":%d,\"lines\":{",
+                       uptime_s(), n, SAMPLE_PERIOD_MS);
+    esp_err_t err = write(sink, buf, len);
+    for (int i = 0; i < LINE_COUNT && err == ESP_OK; i++) {
+        len = snprintf(buf, sizeof(buf),
+                       "%s\"%s\":{\"ok\":%s,\"transitions\":%" PRIu32 ",\"last_change_s\":%" PRIu32 "}",
+                       i ? "," : "", line_names[i], (lines & (1 << i)) ? "true" : "false",
+                       stats[i].transitions, stats[i].last_change_s);
+        err = write(sink, buf, len);
+    }
+    if (err == ESP_OK) {
+        err = write(sink, "}}", 2);
+    }
+    return err;
+}
+
+// /dash/history.json: the ring, oldest first, as [uptime_s, line bits] pairs.
+// Copied out a batch at a time so the lock is never held across a send.
+static esp_err_t dash_history(wifi_manager_dash_write_t write, void *sink, void *ctx)
+{
+    history_entry_t batch[HISTORY_BATCH];
+    char buf[HISTORY_BATCH * 16 + 2];
+    uint32_t seq, end;
+    bool first = true;
+
+    taskENTER_CRITICAL(&history_mux);
+    end = history_seq;
+    taskEXIT_CRITICAL(&history_mux);
+    seq = end > HISTORY_LEN ? end - HISTORY_LEN : 0;
+
+    int len = snprintf(buf, sizeof(buf), "{\"now_s\":%" PRIu32 ",\"events\":[", uptime_s());
+    esp_err_t err = write(sink, buf, len);
+    while (seq < end && err == ESP_OK) {
+        size_t n = 0;
+        taskENTER_CRITICAL(&history_mux);
+        // Entries overwritten while the previous batch was on the wire are skipped.
+        if (history_seq > seq + HISTORY_LEN) {
+            seq = history_seq - HISTORY_LEN;
+        }
+        while (n < HISTORY_BATCH && seq + n < end) {
+            batch[n] = history[(seq + n) % HISTORY_LEN];
+            n++;
+        }
+        taskEXIT_CRITICAL(&history_mux);
+
+        len = 0;
+        for (size_t i = 0; i < n; i++) {
+            len += snprintf(buf + len, sizeof(buf) - len, "%s[%" PRIu32 ",%u]",
+                            first ? "" : ",", batch[i].t_s, batch[i].lines);
+            first = false;
+        }
+        seq += n;
+        err = write(sink, buf, len);
+    }
+    if (err == ESP_OK) {
+        err = write(sink, "]}", 2);
+    }
+    return err;
+}
+
+static const wifi_manager_dashboard_t dashboard = {
+    .status = dash_status,
+    .history = dash_history,
+};
+
 // internal worker function: blocks until Wi-Fi connected, then runs the main loop
 static void app_logic_task(void *pvParameter)
 {
     ESP_LOGI(TAG, "Application task started. Waiting for Wi-Fi connection...");
 
-    // 1) wait for station bit to be set
+    // 1) wait until the station has an IP
     EventGroupHandle_t wifi_events = wifi_manager_get_event_group();
     xEventGroupWaitBits(wifi_events,
-                        WIFI_MANAGER_STA_CONNECTED_BIT,
+                        WIFI_MANAGER_GOT_IP_BIT,
                         pdFALSE,
                         pdFALSE,
                         portMAX_DELAY);
@@ -39,9 +190,17 @@ static void app_logic_task(void *pvParameter)
 
     dcm_status_t current_status;
     char json_payload[200];
+    char topic[64];
+    bool published = false;
+
+    snprintf(topic, sizeof(topic), "%s/%s/status", CONFIG_MQTT_RPC_TOPIC_PREFIX, mqtt_manager_device_id());
 
+    // 2) sample from here on, so the dashboard has history even without a broker;
+    //    until the first publish, waiting for the session replaces the sleep so
+    //    the boot timeline measures the real boot-to-first-publish time
     while (1) {
         if (board_manager_get_status(&current_status) == ESP_OK) {
+            history_record(&current_status);
             cJSON *root = cJSON_CreateObject();
             if (root) {
                 cJSON_AddBoolToObject(root,  "power", current_status.power_ok);
@@ -50,15 +209,137 @@ static void app_logic_task(void *pvParameter)
 
                 if (cJSON_PrintPreallocated(root, json_payload, sizeof(json_payload), false)) {
                     ESP_LOGI(TAG, "Status Payload: %s", json_payload);
-                    // mqtt_manager_publish("dcm/status/DEVICE_ID", json_payload);
+                    if (mqtt_manager_is_connected() &&
+                        mqtt_manager_publish(topic, json_payload, 0, 1) >= 0 && !published) {
+                        published = true;
+                        boot_manager_mark("first_publish");
+                    }
                 }
                 cJSON_Delete(root);
             }
         } else {
             ESP_LOGE(TAG, "Failed to read board status");
         }
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        if (published || mqtt_manager_is_connected() ||
+            mqtt_manager_wait_connected(SAMPLE_PERIOD_MS) == ESP_ERR_INVALID_STATE) {
+            vTaskDelay(pdMS_TO_TICKS(SAMPLE_PERIOD_MS));
+        }
+    }
+}
+
+// RPC "board.status": current sensor state, same fields as the periodic payload.
+static esp_err_t rpc_board_status(const char *params, mqtt_rpc_reply_t *reply, void *ctx)
+{
+    dcm_status_t status;
+    esp_err_t err = board_manager_get_status(&status);
+    if (err != ESP_OK) {
+        return err;
     }
+    return mqtt_rpc_reply_printf(reply, "{\"power\":%s,\"water\":%s,\"pads\":%s}",
+                                 status.power_ok ? "true" : "false",
+                                 !status.water_low ? "true" : "false",
+                                 !status.pads_worn ? "true" : "false");
+}
+
+static const char *const ps_names[WIFI_MANAGER_PS_PROFILES] = { "none", "min", "max" };
+
+// MQTT keepalive per power profile; 0 keeps the esp-mqtt default (120 s). In
+// max-modem every PINGREQ is a radio wakeup, so it is stretched as far as
+// typical broker and NAT idle timeouts allow.
+static const int ps_keepalive_s[WIFI_MANAGER_PS_PROFILES] = { 0, 0, 300 };
+
+static void on_power_profile(wifi_manager_ps_profile_t profile, void *ctx)
+{
+    mqtt_manager_set_keepalive(ps_keepalive_s[profile]);
+}
+
+// RPC "wifi.power": optional {"profile":"none|min|max"} to switch, then the
+// profile (the requested one after a switch: the manager task applies it
+// asynchronously) and the airtime counters of every profile.
+static esp_err_t rpc_wifi_power(const char *params, mqtt_rpc_reply_t *reply, void *ctx)
+{
+    wifi_manager_ps_profile_t selected = wifi_manager_get_power_profile();
+
+    if (params) {
+        cJSON *root = cJSON_Parse(params);
+        const cJSON *profile = cJSON_GetObjectItemCaseSensitive(root, "profile");
+        esp_err_t err = ESP_OK;
+        if (cJSON_IsString(profile)) {
+            err = ESP_ERR_INVALID_ARG;
+            for (int i = 0; i < WIFI_MANAGER_PS_PROFILES; i++) {
+                if (strcmp(profile->valuestring, ps_names[i]) == 0) {
+                    err = wifi_manager_set_power_profile((wifi_manager_ps_profile_t)i);
+                    selected = (wifi_manager_ps_profile_t)i;
+                    break;
+                }
+            }
+        }
+        cJSON_Delete(root);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    esp_err_t err = mqtt_rpc_reply_printf(reply, "{\"profile\":\"%s\",\"profiles\":{", ps_names[selected]);
+    for (int i = 0; i < WIFI_MANAGER_PS_PROFILES && err == ESP_OK; i++) {
+        wifi_manager_power_stats_t st;
+        wifi_manager_get_power_stats((wifi_manager_ps_profile_t)i, &st);
+        err = mqtt_rpc_reply_printf(reply,
+                "%s\"%s\":{\"active_ms\":%" PRIu32 ",\"radio_on_ms\":%" PRIu32 ",\"tx_bytes\":%" PRIu64
+                ",\"tx_packets\":%" PRIu32 ",\"wakeups\":%" PRIu32 ",\"tx_wakeups\":%" PRIu32 "}",
+                i ? "," : "", ps_names[i], st.active_ms, st.radio_on_ms, st.tx_bytes,
+                st.tx_packets, st.wakeups, st.tx_wakeups);
+    }
+    if (err == ESP_OK) {
+        err = mqtt_rpc_reply_write(reply, "}}", 2);
+    }
+    return err;
+}
+
+// RPC "boot.timeline": the stages and milestones of this boot, in ms since reset release.
+static esp_err_t rpc_boot_timeline(const char *params, mqtt_rpc_reply_t *reply, void *ctx)
+{
+    boot_timeline_entry_t entries[BOOT_MANAGER_MAX_ENTRIES];
+    size_t n = boot_manager_get_timeline(entries, BOOT_MANAGER_MAX_ENTRIES);
+
+    esp_err_t err = mqtt_rpc_reply_write(reply, "[", 1);
+    for (size_t i = 0; i < n && err == ESP_OK; i++) {
+        if (entries[i].is_mark) {
+            err = mqtt_rpc_reply_printf(reply, "%s{\"mark\":\"%s\",\"at_ms\":%" PRIi64 "}",
+                                        i ? "," : "", entries[i].name, entries[i].start_us / 1000);
+        } else {
+            err = mqtt_rpc_reply_printf(reply,
+                    "%s{\"stage\":\"%s\",\"start_ms\":%" PRIi64 ",\"end_ms\":%" PRIi64 ",\"err\":\"%s\"}",
+                    i ? "," : "", entries[i].name, entries[i].start_us / 1000,
+                    entries[i].end_us ? entries[i].end_us / 1000 : -1,
+                    esp_err_to_name(entries[i].err));
+        }
+    }
+    if (err == ESP_OK) {
+        err = mqtt_rpc_reply_write(reply, "]", 1);
+    }
+    return err;
+}
+
+static bool rpc_flush(void *ctx, const char *data, size_t len)
+{
+    return mqtt_rpc_reply_write(ctx, data, len) == ESP_OK;
+}
+
+// RPC "http.stats": the /stats.json document (routes, sockets, DNS, settings, NVS
+// locks, portal clients), which over HTTP needs the dashboard password.
+static esp_err_t rpc_http_stats(const char *params, mqtt_rpc_reply_t *reply, void *ctx)
+{
+    char buf[256];
+    json_writer_t w;
+
+    json_writer_init(&w, buf, sizeof(buf), rpc_flush, reply);
+    http_app_write_stats(&w);
+    if (json_writer_finish(&w)) {
+        return ESP_OK;
+    }
+    // A failed write is usually the deadline; report that rather than a bare failure.
+    return mqtt_rpc_reply_remaining_ms(reply) ? ESP_FAIL : ESP_ERR_TIMEOUT;
 }
 
 /**
@@ -66,6 +347,13 @@ static void app_logic_task(void *pvParameter)
  */
 void app_logic_init(void)
 {
+    mqtt_rpc_register("board.status", rpc_board_status, NULL);
+    mqtt_rpc_register("wifi.power", rpc_wifi_power, NULL);
+    mqtt_rpc_register("boot.timeline", rpc_boot_timeline, NULL);
+    mqtt_rpc_register("http.stats", rpc_http_stats, NULL);
+    wifi_manager_set_power_cb(on_power_profile, NULL);
+    wifi_manager_set_dashboard(&dashboard);
+
     xTaskCreate(app_logic_task,
                 "app_logic_task",
                 4096,
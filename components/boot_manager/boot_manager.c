@@ -0,0 +1,205 @@
+/*
+ * File: components/boot_manager/boot_manager.c
+ * Description: Runs the start-up stages on their own tasks, gated by an event
+ *              group of "finished" bits, and records when each one ran.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.9.0
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "boot_manager.h"
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "BOOT_MANAGER";
+
+#define BOOT_STAGE_STACK_DEFAULT 4096
+#define BOOT_STAGE_PRIORITY      5
+
+static const boot_stage_t *stage_table = NULL;
+static size_t stage_count = 0;
+static EventGroupHandle_t done_bits = NULL;
+static uint32_t all_bits = 0;
+static volatile uint32_t failed_bits = 0;
+static esp_err_t first_err = ESP_OK;
+
+static portMUX_TYPE timeline_mux = portMUX_INITIALIZER_UNLOCKED;
+static boot_timeline_entry_t timeline[BOOT_MANAGER_MAX_ENTRIES];
+static size_t timeline_len = 0;
+
+// Returns the slot index, or -1 when the timeline is full.
+static int timeline_add(const char *name, int64_t t_us, bool is_mark) {
+    int idx = -1;
+
+    taskENTER_CRITICAL(&timeline_mux);
+    if (is_mark) {
+        for (size_t i = 0; i < timeline_len; i++) {
+            if (timeline[i].is_mark && strcmp(timeline[i].name, name) == 0) {
+                taskEXIT_CRITICAL(&timeline_mux);
+                return -1;
+            }
+        }
+    }
+    if (timeline_len < BOOT_MANAGER_MAX_ENTRIES) {
+        idx = timeline_len++;
+        timeline[idx] = (boot_timeline_entry_t) {
+            .name = name,
+            .start_us = t_us,
+            .end_us = is_mark ? t_us : 0,
+            .err = ESP_OK,
+            .is_mark = is_mark,
+        };
+    }
+    taskEXIT_CRITICAL(&timeline_mux);
+    return idx;
+}
+
+static void stage_task(void *arg) {
+    size_t i = (size_t)arg;
+    const boot_stage_t *stage = &stage_table[i];
+    esp_err_t err = ESP_OK;
+
+    if (stage->deps) {
+        xEventGroupWaitBits(done_bits, stage->deps, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+
+    int slot = timeline_add(stage->name, esp_timer_get_time(), false);
+    if (failed_bits & stage->deps) {
+        ESP_LOGW(TAG, "Skipping %s: a dependency failed", stage->name);
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        err = stage->fn();
+    }
+    int64_t end_us = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&timeline_mux);
+    if (slot >= 0) {
+        timeline[slot].end_us = end_us;
+        timeline[slot].err = err;
+    }
+    if (err != ESP_OK) {
+        failed_bits |= BOOT_DEP(i);
+        if (first_err == ESP_OK) {
+            first_err = err;
+        }
+    }
+    taskEXIT_CRITICAL(&timeline_mux);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Stage %s failed: %s", stage->name, esp_err_to_name(err));
+    }
+
+    EventBits_t bits = xEventGroupSetBits(done_bits, BOOT_DEP(i));
+    // Setters are serialised, so only the last stage to finish sees the full set.
+    if ((bits & all_bits) == all_bits) {
+        boot_manager_log_timeline();
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t boot_manager_run(const boot_stage_t *stages, size_t count) {
+    if (stage_table || stages == NULL || count == 0 || count > BOOT_MANAGER_MAX_STAGES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (size_t i = 0; i < count; i++) {
+        // Dependencies must point backwards, which also rules out cycles.
+        if (stages[i].fn == NULL || (stages[i].deps & ~(BOOT_DEP(i) - 1))) {
+            ESP_LOGE(TAG, "Bad stage %u (%s)", (unsigned)i, stages[i].name ? stages[i].name : "?");
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    done_bits = xEventGroupCreate();
+    if (!done_bits) {
+        return ESP_ERR_NO_MEM;
+    }
+    stage_table = stages;
+    stage_count = count;
+    all_bits = BOOT_DEP(count) - 1;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t stack = stages[i].stack ? stages[i].stack : BOOT_STAGE_STACK_DEFAULT;
+        if (xTaskCreate(stage_task, stages[i].name, stack, (void *)i, BOOT_STAGE_PRIORITY, NULL) != pdPASS) {
+            // Already running stages may depend on this one; mark it failed rather than hang them.
+            ESP_LOGE(TAG, "Failed to start stage %s", stages[i].name);
+            taskENTER_CRITICAL(&timeline_mux);
+            failed_bits |= BOOT_DEP(i);
+            if (first_err == ESP_OK) {
+                first_err = ESP_ERR_NO_MEM;
+            }
+            taskEXIT_CRITICAL(&timeline_mux);
+            xEventGroupSetBits(done_bits, BOOT_DEP(i));
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t boot_manager_wait(uint32_t timeout_ms) {
+    if (!done_bits) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    TickType_t ticks = timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    EventBits_t bits = xEventGroupWaitBits(done_bits, all_bits, pdFALSE, pdTRUE, ticks);
+    if ((bits & all_bits) != all_bits) {
+        return ESP_ERR_TIMEOUT;
+    }
+    return first_err;
+}
+
+void boot_manager_mark(const char *name) {
+    if (timeline_add(name, esp_timer_get_time(), true) >= 0) {
+        ESP_LOGI(TAG, "%s at %" PRIi32 " ms", name, boot_manager_elapsed_ms(name));
+    }
+}
+
+int32_t boot_manager_elapsed_ms(const char *name) {
+    int32_t ms = -1;
+
+    taskENTER_CRITICAL(&timeline_mux);
+    for (size_t i = 0; i < timeline_len; i++) {
+        if (strcmp(timeline[i].name, name) == 0) {
+            if (timeline[i].end_us) {
+                ms = (int32_t)(timeline[i].end_us / 1000);
+            }
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&timeline_mux);
+    return ms;
+}
+
+size_t boot_manager_get_timeline(boot_timeline_entry_t *entries, size_t max) {
+    taskENTER_CRITICAL(&timeline_mux);
+    size_t n = timeline_len < max ? timeline_len : max;
+    memcpy(entries, timeline, n * sizeof(*entries));
+    taskEXIT_CRITICAL(&timeline_mux);
+    return n;
+}
+
+void boot_manager_log_timeline(void) {
+    boot_timeline_entry_t copy[BOOT_MANAGER_MAX_ENTRIES];
+    size_t n = boot_manager_get_timeline(copy, BOOT_MANAGER_MAX_ENTRIES);
+
+    ESP_LOGI(TAG, "Boot timeline (ms since reset release):");
+    for (size_t i = 0; i < n; i++) {
+        if (copy[i].is_mark) {
+            ESP_LOGI(TAG, "  %-14s         @ %6" PRIi64, copy[i].name, copy[i].start_us / 1000);
+        } else if (copy[i].end_us == 0) {
+            ESP_LOGI(TAG, "  %-14s %6" PRIi64 " .. running", copy[i].name, copy[i].start_us / 1000);
+        } else {
+            ESP_LOGI(TAG, "  %-14s %6" PRIi64 " .. %6" PRIi64 " (%5" PRIi64 ") %s",
+                     copy[i].name, copy[i].start_us / 1000, copy[i].end_us / 1000,
+                     (copy[i].end_us - copy[i].start_us) / 1000,
+                     copy[i].err == ESP_OK ? "" : esp_err_to_name(copy[i].err));
+        }
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * File: components/boot_manager/include/boot_manager.h
+ * Description: Dependency-ordered, concurrent start-up of the firmware components
+ *              with a per-stage boot timeline.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.9.0
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+#ifndef BOOT_MANAGER_H
+#define BOOT_MANAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Stages and marks share one timeline; stages are limited by the event group width. */
+#define BOOT_MANAGER_MAX_STAGES   16
+#define BOOT_MANAGER_MAX_ENTRIES  24
+
+/** Dependency bit for the stage at index i of the table passed to boot_manager_run(). */
+#define BOOT_DEP(i) (1UL << (i))
+
+/**
+ * @brief One start-up step. Every stage runs on its own task as soon as all the
+ *        stages named in deps have finished, so independent stages overlap.
+ *
+ * A stage that fails (or whose dependency failed) still counts as finished;
+ * its dependants are skipped and recorded with ESP_ERR_INVALID_STATE.
+ */
+typedef struct {
+    const char *name;
+    esp_err_t (*fn)(void);
+    uint32_t deps;          // BOOT_DEP() mask of stages that must finish first
+    uint32_t stack;         // task stack in bytes, 0 for the default (4096)
+} boot_stage_t;
+
+typedef struct {
+    const char *name;
+    int64_t start_us;       // esp_timer time; start_us == end_us for marks
+    int64_t end_us;         // 0 while the stage is still running
+    esp_err_t err;
+    bool is_mark;
+} boot_timeline_entry_t;
+
+/**
+ * @brief Launch the stage table. Returns once every stage task is created.
+ * @param stages Must stay valid until the boot is complete (use a static table).
+ * @return ESP_OK, ESP_ERR_INVALID_ARG for a bad table, ESP_ERR_NO_MEM.
+ * @note The timeline is logged when the last stage finishes.
+ */
+esp_err_t boot_manager_run(const boot_stage_t *stages, size_t count);
+
+/**
+ * @brief Block until all stages have finished.
+ * @return ESP_OK, ESP_ERR_TIMEOUT, or the first stage error.
+ */
+esp_err_t boot_manager_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Record a point-in-time milestone (e.g. "first_publish"). Only the first
+ *        mark of a given name is kept, so callers need not track it themselves.
+ * @param name Must be a string literal or otherwise outlive the timeline.
+ */
+void boot_manager_mark(const char *name);
+
+/**
+ * @brief Milliseconds from the start of the boot (reset release) to the named
+ *        mark or the end of the named stage, or -1 if it has not happened yet.
+ */
+int32_t boot_manager_elapsed_ms(const char *name);
+
+/**
+ * @brief Copy up to max timeline entries in recording order.
+ * @return Number of entries copied.
+ */
+size_t boot_manager_get_timeline(boot_timeline_entry_t *entries, size_t max);
+
+/**
+ * @brief Log the timeline as a table, times relative to reset release.
+ */
+void boot_manager_log_timeline(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_MANAGER_H
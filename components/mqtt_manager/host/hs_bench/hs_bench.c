@@ -0,0 +1,178 @@
+/**
+ * File: hs_bench.c
+ * Description: Runs hs_encoder.c, the encoder compressed MQTT streams use, over
+ *              payloads like the ones the firmware sends and over any files given,
+ *              fed in small slices as mqtt_stream.c does. Prints the ratio and the
+ *              encoder time per byte, and decodes every result to check it.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.5
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include "hs_encoder.h"
+
+#define SAMPLE_SIZE (64 * 1024)
+#define MAX_SLICE   256
+#define MIN_SECONDS 0.2
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "hs_bench: %s (line %d)\n", #cond, __LINE__); exit(1); } } while (0)
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} buf_t;
+
+static int sink(void *ctx, const uint8_t *data, size_t len) {
+    buf_t *b = ctx;
+    if (b->len + len > b->cap) {
+        return 1;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+    return 0;
+}
+
+// A stock heatshrink decoder with the same window and lookahead.
+static size_t decode(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_cap) {
+    size_t pos = 0, out_len = 0;
+    uint32_t acc = 0;
+    int nbits = 0;
+#define TAKE(var, count) do { \
+        while (nbits < (count)) { if (pos == in_len) return out_len; acc = acc << 8 | in[pos++]; nbits += 8; } \
+        nbits -= (count); (var) = (acc >> nbits) & ((1u << (count)) - 1); acc &= (1u << nbits) - 1; \
+    } while (0)
+    for (;;) {
+        uint32_t tag, v, index, count;
+        TAKE(tag, 1);
+        if (tag) {
+            TAKE(v, 8);
+            CHECK(out_len < out_cap);
+            out[out_len++] = (uint8_t)v;
+            continue;
+        }
+        TAKE(index, HS_WINDOW_BITS);
+        TAKE(count, HS_LOOKAHEAD_BITS);
+        CHECK(index < out_len && out_len + count + 1 <= out_cap);
+        for (uint32_t i = 0; i <= count; i++, out_len++) {
+            out[out_len] = out[out_len - index - 1];
+        }
+    }
+#undef TAKE
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t compress(hs_encoder_t *enc, const uint8_t *data, size_t len, buf_t *out) {
+    out->len = 0;
+    hs_encoder_init(enc, sink, out);
+    for (size_t pos = 0; pos < len;) {
+        size_t n = 1 + (size_t)rand() % MAX_SLICE;
+        if (n > len - pos) {
+            n = len - pos;
+        }
+        CHECK(hs_encoder_write(enc, data + pos, n) == 0);
+        pos += n;
+    }
+    CHECK(hs_encoder_finish(enc) == 0);
+    return out->len;
+}
+
+static void run(const char *name, const uint8_t *data, size_t len) {
+    static hs_encoder_t enc;
+    buf_t out = { malloc(len + len / 8 + 16), 0, len + len / 8 + 16 };
+    uint8_t *back = malloc(len + 1);
+    CHECK(out.data && back);
+
+    // Repeat until the time is worth measuring.
+    int rounds = 0;
+    double t = now_s(), elapsed;
+    do {
+        compress(&enc, data, len, &out);
+        rounds++;
+        elapsed = now_s() - t;
+    } while (elapsed < MIN_SECONDS);
+
+    CHECK(decode(out.data, out.len, back, len + 1) == len && memcmp(back, data, len) == 0);
+    double ns = len ? elapsed * 1e9 / ((double)len * rounds) : 0.0;
+    printf("%-14s %8zu -> %8zu bytes  %5.1f%%  %6.1f ns/byte  %6.1f MB/s\n",
+           name, len, out.len, len ? 100.0 * out.len / len : 0.0, ns, ns ? 1e3 / ns : 0.0);
+    free(out.data);
+    free(back);
+}
+
+// The synthetic log text of mqtt_manager_bench.c's stream run.
+static size_t make_log(uint8_t *buf, size_t cap) {
+    size_t len = 0;
+    for (uint32_t i = 0; len + 96 < cap; i++) {
+        len += (size_t)snprintf((char *)buf + len, cap - len,
+                                "I (%" PRIu32 ") APP_LOGIC: Status Payload: {\"power\":%s,\"water\":true,\"pads\":%s}\n",
+                                i * 5000, (i % 7) ? "true" : "false", (i % 13) ? "true" : "false");
+    }
+    return len;
+}
+
+// Counters as an RPC reply carries them: mostly keys and changing digits.
+static size_t make_stats(uint8_t *buf, size_t cap) {
+    static const char *const keys[] = { "enqueued", "acked", "latency_p50_ms", "latency_p99_ms",
+                                        "reconnect_last_ms", "heap_min_free", "outbox_bytes", "rssi" };
+    size_t len = 0;
+    for (uint32_t i = 0; len + 64 < cap; i++) {
+        len += (size_t)snprintf((char *)buf + len, cap - len, "%s\"%s\":%" PRIu32,
+                                i % 8 ? "," : "}\n{", keys[i % 8], (uint32_t)rand() % 100000);
+    }
+    return len;
+}
+
+static void run_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    size_t len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(len ? len : 1);
+    CHECK(data && fread(data, 1, len, f) == len);
+    fclose(f);
+    const char *name = strrchr(path, '/');
+    run(name ? name + 1 : path, data, len);
+    free(data);
+}
+
+int main(int argc, char **argv) {
+    static uint8_t sample[SAMPLE_SIZE];
+    srand(1);
+
+    printf("hs_encoder: window %d, lookahead %d, %zu bytes of state per stream here "
+           "(%zu in ring, prev and head)\n", HS_WINDOW_BITS, HS_LOOKAHEAD_BITS, sizeof(hs_encoder_t),
+           sizeof(((hs_encoder_t *)0)->ring) + sizeof(((hs_encoder_t *)0)->prev) +
+           sizeof(((hs_encoder_t *)0)->head));
+
+    run("log text", sample, make_log(sample, sizeof(sample)));
+    run("stats json", sample, make_stats(sample, sizeof(sample)));
+    memset(sample, 0, sizeof(sample));
+    run("zeros", sample, sizeof(sample));
+    for (size_t i = 0; i < sizeof(sample); i++) {
+        sample[i] = (uint8_t)rand();
+    }
+    run("random", sample, sizeof(sample));
+    run("empty", sample, 0);
+
+    for (int i = 1; i < argc; i++) {
+        run_file(argv[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * File: mqtt_bench_main.c
+ * Description: Runs mqtt_manager under the ESP-IDF Linux target with the benchmark
+ *              task of mqtt_manager_bench.c: QoS1 throughput, enqueue-to-ack
+ *              latency, injected drops and the reconnects after them, then the
+ *              compressed stream run. The bench task ends the process.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.8
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "mqtt_manager.h"
+
+static const char *TAG = "mqtt_bench_main";
+
+// Whole PEM file plus the NUL esp-tls expects to be counted in the length.
+static unsigned char *load_pem(const char *var, size_t *len) {
+    const char *path = getenv(var);
+    if (!path) {
+        ESP_LOGE(TAG, "%s is not set", var);
+        return NULL;
+    }
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGE(TAG, "Cannot open %s=%s", var, path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char *buf = size > 0 ? malloc(size + 1) : NULL;
+    if (buf && fread(buf, 1, size, f) == (size_t)size) {
+        buf[size] = '\0';
+        *len = size + 1;
+    } else {
+        ESP_LOGE(TAG, "Cannot read %s=%s", var, path);
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    return buf;
+}
+
+void app_main(void)
+{
+    // The embedded credentials are the production ones; a loopback TLS run brings its own.
+    if (strncmp(CONFIG_MQTT_MANAGER_BROKER_URI, "mqtts://", 8) == 0) {
+        size_t ca_len = 0, crt_len = 0, key_len = 0;
+        unsigned char *ca = load_pem("MQTT_BENCH_CA", &ca_len);
+        unsigned char *crt = load_pem("MQTT_BENCH_CERT", &crt_len);
+        unsigned char *key = load_pem("MQTT_BENCH_KEY", &key_len);
+        if (!ca || !crt || !key ||
+            mqtt_manager_set_tls_credentials(ca, ca_len, crt, crt_len, key, key_len) != ESP_OK) {
+            exit(2);
+        }
+    }
+    mqtt_manager_init();
+}
@@ -0,0 +1,121 @@
+/**
+ * File: hs_encoder.c
+ * Description: Streaming LZSS encoder producing heatshrink-compatible output.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.1
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "hs_encoder.h"
+#include <string.h>
+
+#define RING_MASK   (HS_RING_SIZE - 1)
+/* A backref costs 1 + W + L bits; two literals cost 18, so any match >= 2 wins. */
+#define MIN_MATCH   2
+
+static void flush_out(hs_encoder_t *enc) {
+    if (enc->out_len && !enc->error) {
+        enc->error = enc->sink(enc->sink_ctx, enc->out, enc->out_len);
+    }
+    enc->out_len = 0;
+}
+
+static void put_bits(hs_encoder_t *enc, uint32_t value, uint8_t count) {
+    enc->bits = (enc->bits << count) | value;
+    enc->nbits += count;
+    while (enc->nbits >= 8) {
+        enc->nbits -= 8;
+        enc->out[enc->out_len++] = (uint8_t)(enc->bits >> enc->nbits);
+        if (enc->out_len == sizeof(enc->out)) {
+            flush_out(enc);
+        }
+    }
+    enc->bits &= (1u << enc->nbits) - 1;
+}
+
+static void index_pos(hs_encoder_t *enc, uint32_t pos) {
+    uint8_t c = enc->ring[pos & RING_MASK];
+    uint32_t last = enc->head[c];
+    uint32_t dist = last ? pos - (last - 1) : 0;
+    enc->prev[pos & RING_MASK] = (dist <= HS_WINDOW_SIZE) ? (uint16_t)dist : 0;
+    enc->head[c] = pos + 1;
+}
+
+static uint32_t find_match(const hs_encoder_t *enc, uint32_t avail, uint32_t *offset) {
+    const uint32_t pos = enc->pos;
+    const uint8_t *ring = enc->ring;
+    uint32_t last = enc->head[ring[pos & RING_MASK]];
+    uint32_t best = 0;
+
+    if (!last) {
+        return 0;
+    }
+
+    uint32_t cand = last - 1;
+    while (pos - cand <= HS_WINDOW_SIZE) {
+        uint32_t len = 1;
+        while (len < avail && ring[(cand + len) & RING_MASK] == ring[(pos + len) & RING_MASK]) {
+            len++;
+        }
+        if (len > best) {
+            best = len;
+            *offset = pos - cand;
+            if (best == avail) {
+                break;
+            }
+        }
+        uint16_t d = enc->prev[cand & RING_MASK];
+        if (!d) {
+            break;
+        }
+        cand -= d;
+    }
+    return best;
+}
+
+static void encode_step(hs_encoder_t *enc, uint32_t avail) {
+    uint32_t offset = 0;
+    uint32_t len = find_match(enc, avail, &offset);
+
+    if (len >= MIN_MATCH) {
+        put_bits(enc, 0, 1);
+        put_bits(enc, offset - 1, HS_WINDOW_BITS);
+        put_bits(enc, len - 1, HS_LOOKAHEAD_BITS);
+    } else {
+        len = 1;
+        put_bits(enc, 0x100 | enc->ring[enc->pos & RING_MASK], 9);
+    }
+
+    for (uint32_t i = 0; i < len; i++) {
+        index_pos(enc, enc->pos++);
+    }
+}
+
+void hs_encoder_init(hs_encoder_t *enc, hs_sink_t sink, void *sink_ctx) {
+    memset(enc, 0, sizeof(*enc));
+    enc->sink = sink;
+    enc->sink_ctx = sink_ctx;
+}
+
+int hs_encoder_write(hs_encoder_t *enc, const void *data, size_t len) {
+    const uint8_t *in = data;
+    for (size_t i = 0; i < len && !enc->error; i++) {
+        enc->ring[enc->end++ & RING_MASK] = in[i];
+        if (enc->end - enc->pos == HS_LOOKAHEAD_SIZE) {
+            encode_step(enc, HS_LOOKAHEAD_SIZE);
+        }
+    }
+    return enc->error;
+}
+
+int hs_encoder_finish(hs_encoder_t *enc) {
+    while (enc->pos != enc->end && !enc->error) {
+        encode_step(enc, enc->end - enc->pos);
+    }
+    if (enc->nbits) {
+        put_bits(enc, 0, 8 - enc->nbits);
+    }
+    flush_out(enc);
+    return enc->error;
+}
@@ -0,0 +1,70 @@
+/**
+ * File: hs_encoder.h
+ * Description: Streaming LZSS encoder producing heatshrink-compatible output.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.1
+ * Author: R. Andrew Ballard (c) 2025
+ *
+ * The bitstream matches heatshrink with window_sz2 = HS_WINDOW_BITS and
+ * lookahead_sz2 = HS_LOOKAHEAD_BITS, so the backend can decode with any stock
+ * heatshrink decoder (e.g. `heatshrink -d -w 8 -l 4`). Only the encoder side
+ * lives on the device.
+ */
+
+#ifndef HS_ENCODER_H_INCLUDED
+#define HS_ENCODER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HS_WINDOW_BITS    8
+#define HS_LOOKAHEAD_BITS 4
+#define HS_WINDOW_SIZE    (1 << HS_WINDOW_BITS)
+#define HS_LOOKAHEAD_SIZE (1 << HS_LOOKAHEAD_BITS)
+/* Ring must hold a full window behind the cursor plus the lookahead ahead of it. */
+#define HS_RING_SIZE      (2 * HS_WINDOW_SIZE)
+
+/**
+ * @brief Called whenever the encoder has a full output byte run to hand off.
+ * @return 0 to continue, non-zero to abort encoding.
+ */
+typedef int (*hs_sink_t)(void *ctx, const uint8_t *data, size_t len);
+
+typedef struct {
+    uint8_t ring[HS_RING_SIZE];
+    uint16_t prev[HS_RING_SIZE];      /* previous position with the same byte */
+    uint32_t head[256];               /* last position + 1 per byte value, 0 = none */
+    uint32_t pos;                     /* next position to encode */
+    uint32_t end;                     /* one past the last buffered byte */
+    uint32_t bits;                    /* pending output bits, MSB first */
+    uint8_t nbits;
+    uint8_t out[32];
+    size_t out_len;
+    hs_sink_t sink;
+    void *sink_ctx;
+    int error;
+} hs_encoder_t;
+
+void hs_encoder_init(hs_encoder_t *enc, hs_sink_t sink, void *sink_ctx);
+
+/**
+ * @brief Feed input. Output is produced as soon as a full lookahead is buffered.
+ * @return 0 on success, the sink's non-zero return value otherwise.
+ */
+int hs_encoder_write(hs_encoder_t *enc, const void *data, size_t len);
+
+/**
+ * @brief Encode buffered input, pad the last byte and flush everything to the sink.
+ */
+int hs_encoder_finish(hs_encoder_t *enc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HS_ENCODER_H_INCLUDED */
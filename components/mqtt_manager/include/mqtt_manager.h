@@ -2,20 +2,208 @@
  * File: mqtt_manager.h
  * Description: MQTT manager header for PianoGuard DCM-1
  * Created on: 2025-06-20
- * Edited on:  2025-07-01
- * Version: v8.6.8
+ * Edited on:  2026-10-19
+ * Version: v8.7.6
  * Author: R. Andrew Ballard (c) 2025
  */
 
 #ifndef MQTT_MANAGER_H_INCLUDED
 #define MQTT_MANAGER_H_INCLUDED
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Number of log2 millisecond buckets in the enqueue-to-ack latency histogram. */
+#define MQTT_MANAGER_LATENCY_BUCKETS 16
+
+/**
+ * @brief Snapshot of the publish path and connection counters.
+ *
+ * Latency is measured from mqtt_manager_publish() handing a QoS>0 message to the
+ * esp-mqtt outbox until the matching PUBACK/PUBCOMP arrives. Bucket i of
+ * latency_hist counts acks that took [2^i - 1, 2^(i+1) - 1) ms.
+ */
+typedef struct {
+    uint32_t enqueued;          // messages accepted into the outbox
+    uint32_t enqueue_failed;    // messages rejected by esp-mqtt
+    uint32_t acked;             // PUBACK/PUBCOMP received for tracked messages
+    uint32_t untracked_acks;    // acks that arrived after their slot was evicted
+    uint64_t bytes_enqueued;    // payload bytes accepted into the outbox
+    uint32_t latency_hist[MQTT_MANAGER_LATENCY_BUCKETS];
+    uint32_t latency_p50_ms;
+    uint32_t latency_p90_ms;
+    uint32_t latency_p99_ms;
+    uint32_t latency_max_ms;
+    uint32_t connects;          // MQTT_EVENT_CONNECTED count
+    uint32_t disconnects;       // MQTT_EVENT_DISCONNECTED count
+    uint32_t errors;            // MQTT_EVENT_ERROR count
+    uint32_t reconnect_last_ms; // disconnect-to-connected time of the last reconnect
+    uint32_t reconnect_max_ms;
+    uint32_t heap_min_free;     // lowest free heap seen from the MQTT task (not tracked on linux)
+    int outbox_bytes;           // bytes currently held in the esp-mqtt outbox
+    uint64_t compress_in_bytes; // raw bytes fed to compressed streams
+    uint64_t compress_out_bytes;// compressed bytes produced
+    uint64_t compress_us;       // CPU time spent inside the compressor
+} mqtt_manager_stats_t;
+
+/*
+ * Streams split a payload of unknown length into chunk messages on one topic.
+ * Every chunk starts with a 4 byte header:
+ *   [0] MQTT_STREAM_MAGIC
+ *   [1] flags (MQTT_STREAM_FLAG_*)
+ *   [2..3] sequence number, big endian, starting at 0
+ * Compressed streams carry one heatshrink (window 8, lookahead 4) bitstream split
+ * across the chunks; concatenate the payloads after the header before decoding.
+ * With MQTT 5 the chunks are also tagged with MQTT_STREAM_CONTENT_TYPE(_HS).
+ */
+#define MQTT_STREAM_MAGIC            0xD1
+#define MQTT_STREAM_HEADER_LEN       4
+#define MQTT_STREAM_FLAG_FINAL       0x01
+#define MQTT_STREAM_FLAG_COMPRESSED  0x02
+#define MQTT_STREAM_FLAG_ERROR       0x04  // final chunk is a plain-text error, not payload
+#define MQTT_STREAM_CONTENT_TYPE     "application/vnd.pianoguard.stream"
+#define MQTT_STREAM_CONTENT_TYPE_HS  "application/vnd.pianoguard.stream+heatshrink"
+
+typedef struct mqtt_stream *mqtt_stream_handle_t;
+
+/**
+ * @brief Called from the MQTT task for each complete message on a subscribed topic.
+ * @note Must not block; data is only valid for the duration of the call.
+ */
+typedef void (*mqtt_manager_data_cb_t)(const char *topic, const char *data, int len, void *ctx);
+
+/**
+ * @brief Convert the embedded PEM credentials to DER so esp-tls skips the
+ *        base64 pass on every connect. Optional; meant to run while DHCP is
+ *        still in progress. Blocks that cannot be converted (chains, encrypted
+ *        keys) stay PEM.
+ * @note Call before mqtt_manager_init(); a no-op for mqtt:// brokers.
+ */
+esp_err_t mqtt_manager_prepare_tls(void);
+
+/**
+ * @brief Use these credentials for mqtts:// instead of the embedded ones, e.g.
+ *        test certificates for a loopback broker. PEM must include its
+ *        terminating NUL in the length; DER is passed as is. The buffers are
+ *        not copied and must stay valid for the life of the client.
+ * @note Call before mqtt_manager_init(), and instead of mqtt_manager_prepare_tls().
+ * @return ESP_ERR_INVALID_STATE after either of them, ESP_ERR_INVALID_ARG for an empty blob.
+ */
+esp_err_t mqtt_manager_set_tls_credentials(const void *ca, size_t ca_len,
+                                           const void *crt, size_t crt_len,
+                                           const void *key, size_t key_len);
+
 void mqtt_manager_init(void);
 
+/**
+ * @brief Block until the client holds a broker session.
+ * @param timeout_ms UINT32_MAX waits forever.
+ * @return ESP_OK, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_STATE before init.
+ */
+esp_err_t mqtt_manager_wait_connected(uint32_t timeout_ms);
+
+/**
+ * @brief Set the MQTT keepalive; 0 restores the esp-mqtt default (120 s).
+ * @note The broker learns the value from CONNECT, so a change while connected
+ *       reconnects at once (skipping the back-off) to start a session with it.
+ *       May be called before mqtt_manager_init().
+ */
+esp_err_t mqtt_manager_set_keepalive(int seconds);
+
+/**
+ * @brief Whether the client currently holds a broker session.
+ */
+bool mqtt_manager_is_connected(void);
+
+/**
+ * @brief Queue a message for publishing without blocking on the network.
+ * @param topic Topic to publish to.
+ * @param data Payload; copied into the outbox before returning.
+ * @param len Payload length, or 0 to use strlen(data).
+ * @param qos 0, 1 or 2. Only QoS>0 messages contribute to latency stats.
+ * @return msg_id on success (0 for QoS0), -1 on failure.
+ */
+int mqtt_manager_publish(const char *topic, const char *data, int len, int qos);
+
+/**
+ * @brief Same as mqtt_manager_publish() but tags the message with a content type.
+ * @note content_type is only transmitted with CONFIG_MQTT_PROTOCOL_5; it is ignored on 3.1.1.
+ */
+int mqtt_manager_publish_typed(const char *topic, const char *data, int len, int qos,
+                               const char *content_type);
+
+/**
+ * @brief Open a chunked stream on topic.
+ * @param compress Run the payload through the streaming compressor. Requires
+ *        CONFIG_MQTT_MANAGER_COMPRESS; silently falls back to raw otherwise.
+ * @return Handle, or NULL if the client is not running or memory is short.
+ */
+mqtt_stream_handle_t mqtt_manager_stream_begin(const char *topic, int qos, bool compress);
+
+/**
+ * @brief Append payload data. Full chunks are published as they fill up; the call
+ *        blocks while the outbox is above CONFIG_MQTT_MANAGER_STREAM_OUTBOX_MAX.
+ * @return ESP_OK, ESP_ERR_TIMEOUT if the outbox did not drain, ESP_FAIL on enqueue error.
+ *         After an error the stream only accepts mqtt_manager_stream_end().
+ */
+esp_err_t mqtt_manager_stream_write(mqtt_stream_handle_t stream, const void *data, size_t len);
+
+/**
+ * @brief Flush remaining data as the final chunk and release the stream.
+ * @return The first error seen on this stream, or ESP_OK.
+ */
+esp_err_t mqtt_manager_stream_end(mqtt_stream_handle_t stream);
+
+/**
+ * @brief Finish a stream with an error marker instead of the remaining payload.
+ *
+ * Data already written is flushed (and the compressor finished) so the receiver
+ * can still decode it; the final chunk carries MQTT_STREAM_FLAG_ERROR and reason.
+ * @return ESP_OK if the error marker was published.
+ */
+esp_err_t mqtt_manager_stream_fail(mqtt_stream_handle_t stream, const char *reason);
+
+/**
+ * @brief Subscribe to an exact topic (no wildcards) and deliver messages to cb.
+ *
+ * Subscriptions are kept for the life of the client and re-sent on every
+ * reconnect. May be called before the broker connection is up.
+ * @return ESP_OK, ESP_ERR_NO_MEM when the table is full, ESP_ERR_INVALID_STATE before init.
+ */
+esp_err_t mqtt_manager_subscribe(const char *topic, int qos, mqtt_manager_data_cb_t cb, void *ctx);
+
+/**
+ * @brief Per-device identifier used in topics: the STA MAC as 12 hex digits.
+ */
+const char *mqtt_manager_device_id(void);
+
+/**
+ * @brief Copy the current counters and computed percentiles into stats.
+ */
+void mqtt_manager_get_stats(mqtt_manager_stats_t *stats);
+
+/**
+ * @brief Zero all counters. In-flight messages are forgotten.
+ */
+void mqtt_manager_reset_stats(void);
+
+/**
+ * @brief Drop the broker connection and reconnect immediately.
+ *
+ * Used to measure reconnect behaviour; the resulting outage is reported
+ * through reconnect_last_ms / reconnect_max_ms. Returns before the drop has
+ * happened: wait for the connects counter to move to see the reconnect.
+ * @return ESP_OK if the drop was issued, ESP_ERR_INVALID_STATE if not running
+ *         or not connected, or the esp-mqtt error.
+ */
+esp_err_t mqtt_manager_inject_disconnect(void);
+
 #ifdef __cplusplus
 }
 #endif
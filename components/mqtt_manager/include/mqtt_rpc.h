@@ -0,0 +1,86 @@
+/**
+ * File: mqtt_rpc.h
+ * Description: Request/response RPC over MQTT for PianoGuard DCM-1
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.7
+ * Author: R. Andrew Ballard (c) 2025
+ *
+ * Requests are JSON published to  <prefix>/<device_id>/rpc/req :
+ *   {"id":"a1b2","method":"status","params":{...},"timeout_ms":5000,"compress":false}
+ * timeout_ms is capped at 10 minutes; without it CONFIG_MQTT_RPC_DEFAULT_TIMEOUT_MS applies.
+ * The reply is an mqtt_manager stream on  <prefix>/<device_id>/rpc/resp/<id> ,
+ * so large replies arrive as flow-controlled chunks. Failures end the stream
+ * with MQTT_STREAM_FLAG_ERROR and a short reason (e.g. "ESP_ERR_TIMEOUT").
+ */
+
+#ifndef MQTT_RPC_H_INCLUDED
+#define MQTT_RPC_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mqtt_rpc_reply mqtt_rpc_reply_t;
+
+/**
+ * @brief Command handler, run on an RPC worker task.
+ * @param params The request's "params" value as JSON text, or NULL if absent.
+ * @param reply Stream the result with mqtt_rpc_reply_write()/printf().
+ * @return ESP_OK on success; anything else ends the reply with an error marker.
+ */
+typedef esp_err_t (*mqtt_rpc_handler_t)(const char *params, mqtt_rpc_reply_t *reply, void *ctx);
+
+typedef struct {
+    uint32_t received;
+    uint32_t completed;
+    uint32_t failed;            // handler errors and unknown methods
+    uint32_t timed_out;         // expired in the queue or while replying
+    uint32_t rejected;          // malformed requests and queue-full drops
+    uint32_t in_flight;
+    uint32_t in_flight_max;
+} mqtt_rpc_stats_t;
+
+/**
+ * @brief Start the worker tasks and subscribe to this device's request topic.
+ * @note Call after mqtt_manager_init(). Handlers may be registered before or after.
+ */
+esp_err_t mqtt_rpc_init(void);
+
+/**
+ * @brief Expose a command. method must be a string literal or otherwise outlive the registry.
+ * @note Safe from any task, also while mqtt_rpc_init() runs.
+ * @return ESP_ERR_NO_MEM when CONFIG_MQTT_RPC_MAX_HANDLERS is reached, ESP_ERR_INVALID_STATE if already registered.
+ */
+esp_err_t mqtt_rpc_register(const char *method, mqtt_rpc_handler_t handler, void *ctx);
+
+/**
+ * @brief Append reply bytes; chunks are published as they fill.
+ * @return ESP_ERR_TIMEOUT once the request deadline has passed; handlers should stop and return it.
+ */
+esp_err_t mqtt_rpc_reply_write(mqtt_rpc_reply_t *reply, const void *data, size_t len);
+
+/**
+ * @brief printf-style mqtt_rpc_reply_write(); each call is limited to 256 bytes of output.
+ * @return ESP_ERR_INVALID_SIZE, with nothing sent, for output over the limit:
+ *         split longer replies into several calls.
+ */
+esp_err_t mqtt_rpc_reply_printf(mqtt_rpc_reply_t *reply, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Milliseconds left before the request deadline (0 once expired).
+ */
+uint32_t mqtt_rpc_reply_remaining_ms(const mqtt_rpc_reply_t *reply);
+
+void mqtt_rpc_get_stats(mqtt_rpc_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MQTT_RPC_H_INCLUDED */
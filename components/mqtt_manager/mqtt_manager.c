@@ -2,36 +2,248 @@
  * File: mqtt_manager.c
  * Description: MQTT client manager for PianoGuard DCM-1
  * Created on: 2025-06-20
- * Edited on:  2025-07-02
- * Version: v8.6.12
+ * Edited on:  2026-10-19
+ * Version: v8.7.8
  * Author: R. Andrew Ballard (c) 2025
+ * Feat: PEM to DER conversion ahead of the first connect; wait for the broker session.
  */
 
 #include "mqtt_manager.h"
+#include "mqtt_manager_priv.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "mqtt_client.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include <string.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <stdio.h>
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_system.h"
+#include "esp_mac.h"
+#include "mbedtls/pem.h"
+#endif
 
 // Embedded certificate data (generated via xxd -i)
 #include "root_ca.h"    // defines unsigned char root_ca_pem[] and unsigned int root_ca_pem_len
 #include "client_crt.h" // defines unsigned char client_crt[] and unsigned int client_crt_len
 #include "client_key.h" // defines unsigned char client_key[] and unsigned int client_key_len
 
+#if CONFIG_MQTT_MANAGER_BENCH
+void mqtt_manager_bench_start(void);
+#endif
+
+// Messages awaiting a PUBACK. Oldest entry is evicted when full.
+#define INFLIGHT_SLOTS  32
+// Acks that beat the publisher back to the table (see track_enqueued()).
+#define EARLY_ACK_SLOTS 4
+
+// Subscriptions survive reconnects; entries are only ever appended.
+#define MAX_SUBSCRIPTIONS 8
+
+typedef struct {
+    int msg_id;
+    int64_t t_us;
+} inflight_t;
+
+typedef struct {
+    char *topic;
+    int qos;
+    mqtt_manager_data_cb_t cb;
+    void *ctx;
+} subscription_t;
+
 static const char *TAG = "MQTT_MANAGER";
 static esp_mqtt_client_handle_t client = NULL;
+// Kept so esp_mqtt_set_config() can be handed the full configuration again.
+static esp_mqtt_client_config_t mqtt_cfg;
+static int keepalive_s = 0;
+static volatile bool connected = false;
+// Set by mqtt_manager_inject_disconnect(): reconnect as soon as the drop is through.
+static volatile bool reconnect_now = false;
+
+// Mirrors `connected` for mqtt_manager_wait_connected().
+static EventGroupHandle_t conn_events = NULL;
+#define CONNECTED_BIT BIT0
+
+// Credentials handed to esp-tls: the embedded PEM, DER copies once mqtt_manager_prepare_tls()
+// has run, or the caller's from mqtt_manager_set_tls_credentials().
+typedef struct {
+    const unsigned char *data;
+    size_t len;
+} tls_blob_t;
+static tls_blob_t tls_ca = { root_ca_pem, 0 };
+static tls_blob_t tls_crt = { client_crt, 0 };
+static tls_blob_t tls_key = { client_key, 0 };
+static bool tls_prepared = false;
+
+static SemaphoreHandle_t stats_lock = NULL;
+#if CONFIG_MQTT_PROTOCOL_5
+// Publish properties are client-wide, so setting and using them must be atomic.
+static SemaphoreHandle_t publish_lock = NULL;
+#endif
+static mqtt_manager_stats_t stats;
+static inflight_t inflight[INFLIGHT_SLOTS];
+static inflight_t early_acks[EARLY_ACK_SLOTS];
+static int early_ack_next = 0;
+static int64_t disconnected_at_us = 0;
+static subscription_t subs[MAX_SUBSCRIPTIONS];
+static volatile int sub_count = 0;
+static char device_id[13] = {0};
+
+static void update_heap_watermark(void) {
+#if !CONFIG_IDF_TARGET_LINUX
+    uint32_t free_min = esp_get_minimum_free_heap_size();
+    if (stats.heap_min_free == 0 || free_min < stats.heap_min_free) {
+        stats.heap_min_free = free_min;
+    }
+#endif
+}
+
+// Must be called with stats_lock held.
+static void record_latency(int64_t latency_us) {
+    uint32_t ms = (uint32_t)(latency_us / 1000);
+    int bucket = 0;
+    while (bucket < MQTT_MANAGER_LATENCY_BUCKETS - 1 && (ms + 1) >> (bucket + 1)) {
+        bucket++;
+    }
+    stats.latency_hist[bucket]++;
+    stats.acked++;
+    if (ms > stats.latency_max_ms) {
+        stats.latency_max_ms = ms;
+    }
+}
+
+/*
+ * The ack handler runs on the MQTT task while holding the client API lock, so
+ * we never keep stats_lock across an esp-mqtt call. The publisher records the
+ * msg_id after esp_mqtt_client_enqueue() returns; if the ack already landed it
+ * will be waiting in early_acks.
+ */
+static void track_enqueued(int msg_id, int64_t t_us) {
+    for (int i = 0; i < EARLY_ACK_SLOTS; i++) {
+        if (early_acks[i].msg_id == msg_id) {
+            record_latency(early_acks[i].t_us - t_us);
+            early_acks[i].msg_id = 0;
+            return;
+        }
+    }
+
+    int slot = 0;
+    for (int i = 0; i < INFLIGHT_SLOTS; i++) {
+        if (inflight[i].msg_id == 0) {
+            slot = i;
+            break;
+        }
+        if (inflight[i].t_us < inflight[slot].t_us) {
+            slot = i;
+        }
+    }
+    inflight[slot].msg_id = msg_id;
+    inflight[slot].t_us = t_us;
+}
+
+static void track_acked(int msg_id, int64_t now_us) {
+    for (int i = 0; i < INFLIGHT_SLOTS; i++) {
+        if (inflight[i].msg_id == msg_id) {
+            record_latency(now_us - inflight[i].t_us);
+            inflight[i].msg_id = 0;
+            return;
+        }
+    }
+    if (early_acks[early_ack_next].msg_id != 0) {
+        stats.untracked_acks++;
+    }
+    early_acks[early_ack_next].msg_id = msg_id;
+    early_acks[early_ack_next].t_us = now_us;
+    early_ack_next = (early_ack_next + 1) % EARLY_ACK_SLOTS;
+}
+
+static void dispatch_data(esp_mqtt_event_handle_t event) {
+    // Fragmented messages (larger than CONFIG_MQTT_BUFFER_SIZE) are not reassembled.
+    if (event->current_data_offset != 0 || event->data_len != event->total_data_len) {
+        if (event->current_data_offset == 0) {
+            ESP_LOGW(TAG, "Dropping %d byte message on %.*s: exceeds buffer",
+                     event->total_data_len, event->topic_len, event->topic);
+        }
+        return;
+    }
+    for (int i = 0; i < sub_count; i++) {
+        if (strlen(subs[i].topic) == (size_t)event->topic_len &&
+            memcmp(subs[i].topic, event->topic, event->topic_len) == 0) {
+            subs[i].cb(subs[i].topic, event->data, event->data_len, subs[i].ctx);
+            return;
+        }
+    }
+}
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     ESP_LOGD(TAG, "MQTT event id: %" PRIi32, event_id);
     esp_mqtt_event_handle_t event = event_data;
+    int64_t now_us = esp_timer_get_time();
+
+    xSemaphoreTake(stats_lock, portMAX_DELAY);
+    update_heap_watermark();
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            connected = true;
+            stats.connects++;
+            if (disconnected_at_us) {
+                uint32_t ms = (uint32_t)((now_us - disconnected_at_us) / 1000);
+                stats.reconnect_last_ms = ms;
+                if (ms > stats.reconnect_max_ms) {
+                    stats.reconnect_max_ms = ms;
+                }
+                disconnected_at_us = 0;
+            }
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            connected = false;
+            stats.disconnects++;
+            if (!disconnected_at_us) {
+                disconnected_at_us = now_us;
+            }
+            break;
+        case MQTT_EVENT_PUBLISHED:
+            track_acked(event->msg_id, now_us);
+            break;
+        case MQTT_EVENT_ERROR:
+            stats.errors++;
+            break;
+        default:
+            break;
+    }
+    xSemaphoreGive(stats_lock);
+
+    if (event_id == MQTT_EVENT_CONNECTED) {
+        xEventGroupSetBits(conn_events, CONNECTED_BIT);
+    } else if (event_id == MQTT_EVENT_DISCONNECTED) {
+        xEventGroupClearBits(conn_events, CONNECTED_BIT);
+    }
 
     switch ((esp_mqtt_event_id_t)event_id) {
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+            for (int i = 0; i < sub_count; i++) {
+                esp_mqtt_client_subscribe(client, subs[i].topic, subs[i].qos);
+            }
+            break;
+        case MQTT_EVENT_DATA:
+            dispatch_data(event);
             break;
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "MQTT_EVENT_DISCONNECTED");
+            if (reconnect_now) {
+                // The client is in its reconnect wait now; skip the back-off so the
+                // measured outage is the handshake itself.
+                reconnect_now = false;
+                if (esp_mqtt_client_reconnect(client) != ESP_OK) {
+                    ESP_LOGW(TAG, "Immediate reconnect refused; waiting for the back-off");
+                }
+            }
             break;
         case MQTT_EVENT_ERROR:
             ESP_LOGE(TAG, "MQTT_EVENT_ERROR");
@@ -47,19 +259,155 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     }
 }
 
+#if !CONFIG_IDF_TARGET_LINUX
+// Decode one PEM block to DER. Chains are left as PEM: a DER buffer holds one object.
+static esp_err_t pem_to_der(tls_blob_t *blob, unsigned int pem_len, const char *begin, const char *end) {
+    // mbedtls wants a terminated string; the xxd arrays are not.
+    char *pem = malloc(pem_len + 1);
+    if (!pem) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(pem, blob->data, pem_len);
+    pem[pem_len] = '\0';
+
+    mbedtls_pem_context ctx;
+    size_t used = 0;
+    esp_err_t err = ESP_FAIL;
+    mbedtls_pem_init(&ctx);
+    if (mbedtls_pem_read_buffer(&ctx, begin, end, (const unsigned char *)pem, NULL, 0, &used) == 0) {
+        size_t der_len = 0;
+        const unsigned char *der = mbedtls_pem_get_buffer(&ctx, &der_len);
+        if (strstr(pem + used, "-----BEGIN") != NULL) {
+            err = ESP_ERR_NOT_SUPPORTED;
+        } else {
+            unsigned char *copy = malloc(der_len);
+            if (copy) {
+                memcpy(copy, der, der_len);
+                blob->data = copy;
+                blob->len = der_len;
+                err = ESP_OK;
+            } else {
+                err = ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    mbedtls_pem_free(&ctx);
+    free(pem);
+    return err;
+}
+#endif
+
+esp_err_t mqtt_manager_prepare_tls(void) {
+    if (tls_prepared || strncmp(CONFIG_MQTT_MANAGER_BROKER_URI, "mqtts://", 8) != 0) {
+        return ESP_OK;
+    }
+#if !CONFIG_IDF_TARGET_LINUX
+    int64_t t0 = esp_timer_get_time();
+    static const char *const key_types[] = { "", "RSA ", "EC " };
+    char begin[40], end[40];
+    esp_err_t err = pem_to_der(&tls_ca, root_ca_pem_len,
+                               "-----BEGIN CERTIFICATE-----", "-----END CERTIFICATE-----");
+    if (err != ESP_ERR_NO_MEM) {
+        err = pem_to_der(&tls_crt, client_crt_len,
+                         "-----BEGIN CERTIFICATE-----", "-----END CERTIFICATE-----");
+    }
+    for (size_t i = 0; i < sizeof(key_types) / sizeof(key_types[0]) && err != ESP_ERR_NO_MEM; i++) {
+        snprintf(begin, sizeof(begin), "-----BEGIN %sPRIVATE KEY-----", key_types[i]);
+        snprintf(end, sizeof(end), "-----END %sPRIVATE KEY-----", key_types[i]);
+        err = pem_to_der(&tls_key, client_key_len, begin, end);
+        if (err != ESP_FAIL) {
+            break;      // converted, or the right type but not convertible
+        }
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        return err;
+    }
+    // Anything that could not be converted is simply passed on as PEM.
+    ESP_LOGI(TAG, "TLS credentials prepared in %" PRIi64 " us (CA %s, cert %s, key %s)",
+             esp_timer_get_time() - t0, tls_ca.len ? "DER" : "PEM",
+             tls_crt.len ? "DER" : "PEM", tls_key.len ? "DER" : "PEM");
+#endif
+    tls_prepared = true;
+    return ESP_OK;
+}
+
+esp_err_t mqtt_manager_set_tls_credentials(const void *ca, size_t ca_len,
+                                           const void *crt, size_t crt_len,
+                                           const void *key, size_t key_len) {
+    if (client || tls_prepared) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!ca || !ca_len || !crt || !crt_len || !key || !key_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    tls_ca = (tls_blob_t) { ca, ca_len };
+    tls_crt = (tls_blob_t) { crt, crt_len };
+    tls_key = (tls_blob_t) { key, key_len };
+    // Used as given; there is nothing embedded left to convert.
+    tls_prepared = true;
+    return ESP_OK;
+}
+
+esp_err_t mqtt_manager_wait_connected(uint32_t timeout_ms) {
+    if (!conn_events) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    TickType_t ticks = timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    EventBits_t bits = xEventGroupWaitBits(conn_events, CONNECTED_BIT, pdFALSE, pdTRUE, ticks);
+    return (bits & CONNECTED_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
 void mqtt_manager_init(void) {
     ESP_LOGI(TAG, "Initializing MQTT with embedded certificates...");
 
-    esp_mqtt_client_config_t mqtt_cfg = {
-        .broker.address.uri                         = "mqtts://dev1.pgapi.net:8883",
-        .broker.verification.certificate            = (const char *)root_ca_pem,
-        .broker.verification.certificate_len        = root_ca_pem_len,
-        .credentials.authentication.certificate     = (const char *)client_crt,
-        .credentials.authentication.certificate_len = client_crt_len,
-        .credentials.authentication.key             = (const char *)client_key,
-        .credentials.authentication.key_len         = client_key_len,
+    if (conn_events == NULL) {
+        conn_events = xEventGroupCreate();
+        if (!conn_events) {
+            ESP_LOGE(TAG, "Failed to create connection event group");
+            return;
+        }
+    }
+
+    if (stats_lock == NULL) {
+        stats_lock = xSemaphoreCreateMutex();
+        if (!stats_lock) {
+            ESP_LOGE(TAG, "Failed to create stats lock");
+            return;
+        }
+    }
+#if CONFIG_MQTT_PROTOCOL_5
+    if (publish_lock == NULL) {
+        publish_lock = xSemaphoreCreateMutex();
+        if (!publish_lock) {
+            ESP_LOGE(TAG, "Failed to create publish lock");
+            return;
+        }
+    }
+#endif
+
+    mqtt_cfg = (esp_mqtt_client_config_t) {
+        .broker.address.uri = CONFIG_MQTT_MANAGER_BROKER_URI,
+        .session.keepalive = keepalive_s,
+#if CONFIG_MQTT_PROTOCOL_5
+        .session.protocol_ver = MQTT_PROTOCOL_V_5,
+#endif
     };
 
+    // Plain mqtt:// is only used against a local broker stand-in; skip TLS material there.
+    if (strncmp(CONFIG_MQTT_MANAGER_BROKER_URI, "mqtts://", 8) == 0) {
+        // A zero length means the embedded PEM is still in place.
+        mqtt_cfg.broker.verification.certificate            = (const char *)tls_ca.data;
+        mqtt_cfg.broker.verification.certificate_len        = tls_ca.len ? tls_ca.len : root_ca_pem_len;
+        mqtt_cfg.credentials.authentication.certificate     = (const char *)tls_crt.data;
+        mqtt_cfg.credentials.authentication.certificate_len = tls_crt.len ? tls_crt.len : client_crt_len;
+        mqtt_cfg.credentials.authentication.key             = (const char *)tls_key.data;
+        mqtt_cfg.credentials.authentication.key_len         = tls_key.len ? tls_key.len : client_key_len;
+#if CONFIG_MQTT_MANAGER_SKIP_CN_CHECK
+        // Loopback test certs are not issued for the broker's hostname.
+        mqtt_cfg.broker.verification.skip_cert_common_name_check = true;
+#endif
+    }
+
     client = esp_mqtt_client_init(&mqtt_cfg);
     if (!client) {
         ESP_LOGE(TAG, "Failed to initialize MQTT client");
@@ -69,5 +417,201 @@ void mqtt_manager_init(void) {
     esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     esp_mqtt_client_start(client);
 
-    ESP_LOGI(TAG, "MQTT client started");
+    ESP_LOGI(TAG, "MQTT client started (%s)", CONFIG_MQTT_MANAGER_BROKER_URI);
+
+#if CONFIG_MQTT_MANAGER_BENCH
+    mqtt_manager_bench_start();
+#endif
+}
+
+// Reconnect without the back-off; the MQTT_EVENT_DISCONNECTED handler does the reconnect.
+static esp_err_t drop_and_reconnect(void) {
+    // The drop happens on the MQTT task; esp_mqtt_client_reconnect() is only
+    // accepted once it has, so the event handler issues it.
+    reconnect_now = true;
+    esp_err_t err = esp_mqtt_client_disconnect(client);
+    if (err != ESP_OK) {
+        reconnect_now = false;
+    }
+    return err;
+}
+
+esp_err_t mqtt_manager_set_keepalive(int seconds) {
+    if (seconds < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (seconds == keepalive_s) {
+        return ESP_OK;
+    }
+    keepalive_s = seconds;
+    if (!client) {
+        return ESP_OK;
+    }
+    mqtt_cfg.session.keepalive = seconds;
+    esp_err_t err = esp_mqtt_set_config(client, &mqtt_cfg);
+    if (err != ESP_OK || !connected) {
+        return err;
+    }
+    // The client pings on the new period at once, but the broker holds the one from
+    // CONNECT: a longer one would get the session dropped. Start a session with it.
+    ESP_LOGI(TAG, "Keepalive %d s, reconnecting", seconds);
+    return drop_and_reconnect();
+}
+
+bool mqtt_manager_is_connected(void) {
+    return connected;
+}
+
+int mqtt_manager_publish(const char *topic, const char *data, int len, int qos) {
+    return mqtt_manager_publish_typed(topic, data, len, qos, NULL);
+}
+
+int mqtt_manager_publish_typed(const char *topic, const char *data, int len, int qos,
+                               const char *content_type) {
+    if (!client || !topic || !data) {
+        return -1;
+    }
+    if (len == 0) {
+        len = strlen(data);
+    }
+
+    int64_t t_us = esp_timer_get_time();
+#if CONFIG_MQTT_PROTOCOL_5
+    xSemaphoreTake(publish_lock, portMAX_DELAY);
+    esp_mqtt5_publish_property_config_t props = { .content_type = content_type };
+    esp_mqtt5_client_set_publish_property(client, &props);
+    int msg_id = esp_mqtt_client_enqueue(client, topic, data, len, qos, 0, true);
+    if (content_type) {
+        props.content_type = NULL;
+        esp_mqtt5_client_set_publish_property(client, &props);
+    }
+    xSemaphoreGive(publish_lock);
+#else
+    (void)content_type;
+    int msg_id = esp_mqtt_client_enqueue(client, topic, data, len, qos, 0, true);
+#endif
+
+    xSemaphoreTake(stats_lock, portMAX_DELAY);
+    if (msg_id < 0) {
+        stats.enqueue_failed++;
+    } else {
+        stats.enqueued++;
+        stats.bytes_enqueued += len;
+        if (qos > 0) {
+            track_enqueued(msg_id, t_us);
+        }
+    }
+    xSemaphoreGive(stats_lock);
+
+    return msg_id;
+}
+
+int mqtt_manager_outbox_size(void) {
+    return client ? esp_mqtt_client_get_outbox_size(client) : -1;
+}
+
+void mqtt_manager_note_compression(size_t in_bytes, size_t out_bytes, int64_t cpu_us) {
+    xSemaphoreTake(stats_lock, portMAX_DELAY);
+    stats.compress_in_bytes += in_bytes;
+    stats.compress_out_bytes += out_bytes;
+    stats.compress_us += cpu_us;
+    xSemaphoreGive(stats_lock);
+}
+
+// Upper bound (ms) of the histogram bucket holding the given percentile.
+static uint32_t hist_percentile(const uint32_t *hist, uint32_t total, uint32_t pct) {
+    if (total == 0) {
+        return 0;
+    }
+    uint32_t target = (total * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < MQTT_MANAGER_LATENCY_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= target) {
+            return (1u << (i + 1)) - 1;
+        }
+    }
+    return UINT32_MAX;
+}
+
+esp_err_t mqtt_manager_subscribe(const char *topic, int qos, mqtt_manager_data_cb_t cb, void *ctx) {
+    if (!topic || !cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!stats_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(stats_lock, portMAX_DELAY);
+    if (sub_count == MAX_SUBSCRIPTIONS) {
+        xSemaphoreGive(stats_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    subscription_t *sub = &subs[sub_count];
+    sub->topic = strdup(topic);
+    if (!sub->topic) {
+        xSemaphoreGive(stats_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    sub->qos = qos;
+    sub->cb = cb;
+    sub->ctx = ctx;
+    sub_count++;
+    xSemaphoreGive(stats_lock);
+
+    // Otherwise the next MQTT_EVENT_CONNECTED picks it up.
+    if (connected) {
+        esp_mqtt_client_subscribe(client, sub->topic, qos);
+    }
+    return ESP_OK;
+}
+
+const char *mqtt_manager_device_id(void) {
+    if (device_id[0] == '\0') {
+#if CONFIG_IDF_TARGET_LINUX
+        snprintf(device_id, sizeof(device_id), "linux");
+#else
+        uint8_t mac[6];
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(device_id, sizeof(device_id), "%02X%02X%02X%02X%02X%02X",
+                 mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+#endif
+    }
+    return device_id;
+}
+
+void mqtt_manager_get_stats(mqtt_manager_stats_t *out) {
+    if (!out || !stats_lock) {
+        return;
+    }
+    xSemaphoreTake(stats_lock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(stats_lock);
+
+    uint32_t total = 0;
+    for (int i = 0; i < MQTT_MANAGER_LATENCY_BUCKETS; i++) {
+        total += out->latency_hist[i];
+    }
+    out->latency_p50_ms = hist_percentile(out->latency_hist, total, 50);
+    out->latency_p90_ms = hist_percentile(out->latency_hist, total, 90);
+    out->latency_p99_ms = hist_percentile(out->latency_hist, total, 99);
+    out->outbox_bytes = client ? esp_mqtt_client_get_outbox_size(client) : 0;
+}
+
+void mqtt_manager_reset_stats(void) {
+    if (!stats_lock) {
+        return;
+    }
+    xSemaphoreTake(stats_lock, portMAX_DELAY);
+    memset(&stats, 0, sizeof(stats));
+    memset(inflight, 0, sizeof(inflight));
+    memset(early_acks, 0, sizeof(early_acks));
+    xSemaphoreGive(stats_lock);
+}
+
+esp_err_t mqtt_manager_inject_disconnect(void) {
+    if (!client || !connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return drop_and_reconnect();
 }
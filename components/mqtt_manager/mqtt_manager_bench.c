@@ -0,0 +1,150 @@
+/**
+ * File: mqtt_manager_bench.c
+ * Description: Publish throughput / reconnect benchmark for mqtt_manager.
+ *              Built only with CONFIG_MQTT_MANAGER_BENCH, normally on the linux
+ *              target against a broker on loopback: host/mqtt_bench with
+ *              tools/mqtt_loopback.py (plain or TLS), or mosquitto -p 1883.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.8
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "mqtt_manager.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "MQTT_BENCH";
+
+static void log_stats(const char *label, int64_t elapsed_us) {
+    mqtt_manager_stats_t s;
+    mqtt_manager_get_stats(&s);
+
+    uint32_t ms = (uint32_t)(elapsed_us / 1000);
+    ESP_LOGI(TAG, "[%s] %" PRIu32 " enqueued, %" PRIu32 " acked, %" PRIu32 " failed in %" PRIu32 " ms (%" PRIu32 " msg/s)",
+             label, s.enqueued, s.acked, s.enqueue_failed, ms,
+             ms ? (uint32_t)((uint64_t)s.acked * 1000 / ms) : 0);
+    ESP_LOGI(TAG, "[%s] latency p50<%" PRIu32 " p90<%" PRIu32 " p99<%" PRIu32 " max=%" PRIu32 " ms",
+             label, s.latency_p50_ms, s.latency_p90_ms, s.latency_p99_ms, s.latency_max_ms);
+#if CONFIG_IDF_TARGET_LINUX
+    // No heap watermark on the host; the process heap says nothing about the device's.
+    ESP_LOGI(TAG, "[%s] reconnects=%" PRIu32 " last=%" PRIu32 " max=%" PRIu32 " ms, outbox=%d",
+             label, s.disconnects, s.reconnect_last_ms, s.reconnect_max_ms, s.outbox_bytes);
+#else
+    ESP_LOGI(TAG, "[%s] reconnects=%" PRIu32 " last=%" PRIu32 " max=%" PRIu32 " ms, heap_min_free=%" PRIu32 ", outbox=%d",
+             label, s.disconnects, s.reconnect_last_ms, s.reconnect_max_ms, s.heap_min_free, s.outbox_bytes);
+#endif
+}
+
+#if CONFIG_MQTT_MANAGER_COMPRESS && CONFIG_MQTT_MANAGER_BENCH_STREAM_KB > 0
+// Log-like text is the typical diagnostic dump; it compresses far better than random data.
+static void bench_stream(void) {
+    char line[96];
+    size_t total = 0;
+    mqtt_manager_stats_t before, after;
+
+    mqtt_manager_get_stats(&before);
+    int64_t start = esp_timer_get_time();
+
+    mqtt_stream_handle_t s = mqtt_manager_stream_begin(CONFIG_MQTT_MANAGER_BENCH_TOPIC "/z", 1, true);
+    if (!s) {
+        ESP_LOGE(TAG, "stream_begin failed");
+        return;
+    }
+    for (uint32_t i = 0; total < CONFIG_MQTT_MANAGER_BENCH_STREAM_KB * 1024; i++) {
+        int n = snprintf(line, sizeof(line), "I (%" PRIu32 ") APP_LOGIC: Status Payload: {\"power\":%s,\"water\":true,\"pads\":%s}\n",
+                         i * 5000, (i % 7) ? "true" : "false", (i % 13) ? "true" : "false");
+        if (mqtt_manager_stream_write(s, line, n) != ESP_OK) {
+            break;
+        }
+        total += n;
+    }
+    esp_err_t err = mqtt_manager_stream_end(s);
+
+    mqtt_manager_get_stats(&after);
+    uint64_t in = after.compress_in_bytes - before.compress_in_bytes;
+    uint64_t out = after.compress_out_bytes - before.compress_out_bytes;
+    uint64_t us = after.compress_us - before.compress_us;
+    ESP_LOGI(TAG, "[stream] %s: %" PRIu64 " -> %" PRIu64 " bytes (%" PRIu64 "%%), encoder %" PRIu64 " us (%" PRIu64 " KB/s), wall %" PRIu32 " ms",
+             esp_err_to_name(err), in, out, in ? out * 100 / in : 0, us,
+             us ? in * 1000000 / us / 1024 : 0, (uint32_t)((esp_timer_get_time() - start) / 1000));
+}
+#endif
+
+static void wait_connected(void) {
+    while (!mqtt_manager_is_connected()) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+// Until the client is back with a new session; the connected flag alone is still set before the drop.
+static bool wait_reconnected(uint32_t connects_before) {
+    mqtt_manager_stats_t s;
+    int64_t deadline = esp_timer_get_time() + 30LL * 1000 * 1000;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        mqtt_manager_get_stats(&s);
+    } while ((s.connects == connects_before || !mqtt_manager_is_connected()) && esp_timer_get_time() < deadline);
+    return s.connects != connects_before;
+}
+
+static void mqtt_bench_task(void *arg) {
+    static char payload[CONFIG_MQTT_MANAGER_BENCH_PAYLOAD];
+    memset(payload, 'x', sizeof(payload));
+    int drop_failures = 0;
+
+    wait_connected();
+    mqtt_manager_reset_stats();
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 1; i <= CONFIG_MQTT_MANAGER_BENCH_COUNT; i++) {
+        // Back off while the outbox is full rather than measuring allocation failures.
+        while (mqtt_manager_publish(CONFIG_MQTT_MANAGER_BENCH_TOPIC, payload, sizeof(payload), 1) < 0) {
+            vTaskDelay(1);
+        }
+        if (CONFIG_MQTT_MANAGER_BENCH_DROP_EVERY && i % CONFIG_MQTT_MANAGER_BENCH_DROP_EVERY == 0) {
+            mqtt_manager_stats_t s;
+            mqtt_manager_get_stats(&s);
+            esp_err_t err = mqtt_manager_inject_disconnect();
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Drop at message %d not issued: %s", i, esp_err_to_name(err));
+                drop_failures++;
+            } else if (!wait_reconnected(s.connects)) {
+                ESP_LOGE(TAG, "No reconnect within 30 s of the drop at message %d", i);
+                drop_failures++;
+                wait_connected();
+            }
+        }
+    }
+
+    // Let the tail drain before the final snapshot.
+    mqtt_manager_stats_t s;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        mqtt_manager_get_stats(&s);
+    } while (s.outbox_bytes > 0 && esp_timer_get_time() - start < 60LL * 1000 * 1000);
+
+    log_stats("done", esp_timer_get_time() - start);
+    if (drop_failures) {
+        ESP_LOGE(TAG, "[done] %d injected drops failed; reconnect times cover the others only", drop_failures);
+    }
+
+#if CONFIG_MQTT_MANAGER_COMPRESS && CONFIG_MQTT_MANAGER_BENCH_STREAM_KB > 0
+    bench_stream();
+#endif
+#if CONFIG_IDF_TARGET_LINUX
+    // host/mqtt_bench: the run is the whole program.
+    exit(drop_failures ? 1 : 0);
+#endif
+    vTaskDelete(NULL);
+}
+
+void mqtt_manager_bench_start(void) {
+    xTaskCreate(mqtt_bench_task, "mqtt_bench", 4096, NULL, 4, NULL);
+}
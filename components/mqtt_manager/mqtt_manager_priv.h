@@ -0,0 +1,22 @@
+/**
+ * File: mqtt_manager_priv.h
+ * Description: Internal hooks shared between mqtt_manager source files.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.1
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#ifndef MQTT_MANAGER_PRIV_H_INCLUDED
+#define MQTT_MANAGER_PRIV_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Bytes held in the esp-mqtt outbox, or -1 before init. */
+int mqtt_manager_outbox_size(void);
+
+/** Add one compressed stream's totals to mqtt_manager_stats_t. */
+void mqtt_manager_note_compression(size_t in_bytes, size_t out_bytes, int64_t cpu_us);
+
+#endif /* MQTT_MANAGER_PRIV_H_INCLUDED */
@@ -0,0 +1,392 @@
+/**
+ * File: mqtt_rpc.c
+ * Description: Request/response RPC over MQTT with a handler registry and
+ *              chunked streaming replies.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.8
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "mqtt_rpc.h"
+#include "mqtt_manager.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "cJSON.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define RPC_ID_MAX      32
+#define RPC_METHOD_MAX  31
+#define RPC_TOPIC_MAX   96
+#define RPC_PRINTF_MAX  256
+// Longest timeout_ms taken from a request; anything larger (or not a number) is clamped.
+#define RPC_TIMEOUT_MAX_MS (10 * 60 * 1000)
+
+typedef struct {
+    char id[RPC_ID_MAX + 1];
+    char method[RPC_METHOD_MAX + 1];
+    char *params;               // owned, NULL if the request had none
+    int64_t deadline_us;
+    bool compress;
+} rpc_request_t;
+
+typedef struct {
+    const char *method;
+    mqtt_rpc_handler_t handler;
+    void *ctx;
+} rpc_entry_t;
+
+struct mqtt_rpc_reply {
+    char topic[RPC_TOPIC_MAX];
+    int64_t deadline_us;
+    bool compress;
+    mqtt_stream_handle_t stream; // opened on first write
+    esp_err_t err;
+};
+
+static const char *TAG = "MQTT_RPC";
+
+// Initialized statically: components register commands from their own boot
+// stages, before or while mqtt_rpc_init() runs.
+static portMUX_TYPE rpc_mux = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t rpc_queue = NULL;
+// Append-only; an entry is complete before handler_count covers it.
+static rpc_entry_t handlers[CONFIG_MQTT_RPC_MAX_HANDLERS];
+static int handler_count = 0;
+static mqtt_rpc_stats_t stats;
+static char req_topic[RPC_TOPIC_MAX];
+
+static void resp_topic(char *out, size_t size, const char *id) {
+    snprintf(out, size, "%s/%s/rpc/resp/%s", CONFIG_MQTT_RPC_TOPIC_PREFIX, mqtt_manager_device_id(), id);
+}
+
+// Ids end up in a topic name, so wildcards and separators are not allowed.
+static bool valid_id(const char *id) {
+    size_t len = strlen(id);
+    if (len == 0 || len > RPC_ID_MAX) {
+        return false;
+    }
+    for (const char *c = id; *c; c++) {
+        bool ok = (*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'z') ||
+                  (*c >= 'A' && *c <= 'Z') || *c == '-' || *c == '_' || *c == '.';
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Single-chunk error reply; safe to call from the MQTT task since it never waits on the outbox.
+static void publish_error(const char *id, const char *reason) {
+    char topic[RPC_TOPIC_MAX];
+    char msg[MQTT_STREAM_HEADER_LEN + 48];
+    size_t len = strlen(reason);
+
+    if (len > sizeof(msg) - MQTT_STREAM_HEADER_LEN) {
+        len = sizeof(msg) - MQTT_STREAM_HEADER_LEN;
+    }
+    msg[0] = MQTT_STREAM_MAGIC;
+    msg[1] = MQTT_STREAM_FLAG_FINAL | MQTT_STREAM_FLAG_ERROR;
+    msg[2] = 0;
+    msg[3] = 0;
+    memcpy(msg + MQTT_STREAM_HEADER_LEN, reason, len);
+
+    resp_topic(topic, sizeof(topic), id);
+    mqtt_manager_publish_typed(topic, msg, MQTT_STREAM_HEADER_LEN + len, 1, MQTT_STREAM_CONTENT_TYPE);
+}
+
+static void count(uint32_t *counter) {
+    taskENTER_CRITICAL(&rpc_mux);
+    (*counter)++;
+    taskEXIT_CRITICAL(&rpc_mux);
+}
+
+static void on_request(const char *topic, const char *data, int len, void *ctx) {
+    rpc_request_t req = {0};
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    const cJSON *id = cJSON_GetObjectItemCaseSensitive(root, "id");
+    const cJSON *method = cJSON_GetObjectItemCaseSensitive(root, "method");
+
+    count(&stats.received);
+
+    if (!cJSON_IsString(id) || !valid_id(id->valuestring)) {
+        ESP_LOGW(TAG, "Dropping request without a usable id");
+        count(&stats.rejected);
+        cJSON_Delete(root);
+        return;
+    }
+    strcpy(req.id, id->valuestring);
+
+    if (!cJSON_IsString(method) || strlen(method->valuestring) > RPC_METHOD_MAX) {
+        count(&stats.rejected);
+        publish_error(req.id, "bad request");
+        cJSON_Delete(root);
+        return;
+    }
+    strcpy(req.method, method->valuestring);
+
+    const cJSON *params = cJSON_GetObjectItemCaseSensitive(root, "params");
+    if (params) {
+        req.params = cJSON_PrintUnformatted(params);
+    }
+    const cJSON *timeout = cJSON_GetObjectItemCaseSensitive(root, "timeout_ms");
+    int64_t timeout_ms = CONFIG_MQTT_RPC_DEFAULT_TIMEOUT_MS;
+    if (cJSON_IsNumber(timeout) && timeout->valuedouble > 0) {
+        // Compared before the cast: NaN fails the test above, huge values and inf stop here.
+        timeout_ms = timeout->valuedouble < RPC_TIMEOUT_MAX_MS ? (int64_t)timeout->valuedouble : RPC_TIMEOUT_MAX_MS;
+    }
+    req.deadline_us = esp_timer_get_time() + timeout_ms * 1000;
+    req.compress = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(root, "compress"));
+    cJSON_Delete(root);
+
+    if (xQueueSend(rpc_queue, &req, 0) != pdTRUE) {
+        count(&stats.rejected);
+        publish_error(req.id, "busy");
+        free(req.params);
+    }
+}
+
+// Must be called with rpc_mux held.
+static const rpc_entry_t *find_handler_locked(const char *method) {
+    for (int i = 0; i < handler_count; i++) {
+        if (strcmp(handlers[i].method, method) == 0) {
+            return &handlers[i];
+        }
+    }
+    return NULL;
+}
+
+static void run_request(rpc_request_t *req) {
+    mqtt_rpc_reply_t reply = {
+        .deadline_us = req->deadline_us,
+        .compress = req->compress,
+    };
+    resp_topic(reply.topic, sizeof(reply.topic), req->id);
+
+    if (esp_timer_get_time() >= req->deadline_us) {
+        count(&stats.timed_out);
+        publish_error(req->id, esp_err_to_name(ESP_ERR_TIMEOUT));
+        return;
+    }
+
+    taskENTER_CRITICAL(&rpc_mux);
+    const rpc_entry_t *entry = find_handler_locked(req->method);
+    taskEXIT_CRITICAL(&rpc_mux);
+    if (!entry) {
+        count(&stats.failed);
+        publish_error(req->id, "unknown method");
+        return;
+    }
+
+    esp_err_t err = entry->handler(req->params, &reply, entry->ctx);
+    if (err == ESP_OK) {
+        err = reply.err;
+    }
+
+    if (err == ESP_OK) {
+        // An empty reply still needs its final chunk.
+        if (!reply.stream) {
+            reply.stream = mqtt_manager_stream_begin(reply.topic, 1, false);
+        }
+        err = reply.stream ? mqtt_manager_stream_end(reply.stream) : ESP_ERR_NO_MEM;
+    } else if (reply.stream) {
+        mqtt_manager_stream_fail(reply.stream, esp_err_to_name(err));
+    } else {
+        publish_error(req->id, esp_err_to_name(err));
+    }
+
+    count(err == ESP_OK ? &stats.completed : err == ESP_ERR_TIMEOUT ? &stats.timed_out : &stats.failed);
+}
+
+static void rpc_worker_task(void *arg) {
+    rpc_request_t req;
+    for (;;) {
+        if (xQueueReceive(rpc_queue, &req, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        taskENTER_CRITICAL(&rpc_mux);
+        if (++stats.in_flight > stats.in_flight_max) {
+            stats.in_flight_max = stats.in_flight;
+        }
+        taskEXIT_CRITICAL(&rpc_mux);
+
+        run_request(&req);
+        free(req.params);
+
+        taskENTER_CRITICAL(&rpc_mux);
+        stats.in_flight--;
+        taskEXIT_CRITICAL(&rpc_mux);
+    }
+}
+
+esp_err_t mqtt_rpc_reply_write(mqtt_rpc_reply_t *reply, const void *data, size_t len) {
+    if (!reply) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (reply->err == ESP_OK && esp_timer_get_time() >= reply->deadline_us) {
+        reply->err = ESP_ERR_TIMEOUT;
+    }
+    if (reply->err != ESP_OK) {
+        return reply->err;
+    }
+    if (!reply->stream) {
+        reply->stream = mqtt_manager_stream_begin(reply->topic, 1, reply->compress);
+        if (!reply->stream) {
+            reply->err = ESP_ERR_NO_MEM;
+            return reply->err;
+        }
+    }
+    reply->err = mqtt_manager_stream_write(reply->stream, data, len);
+    return reply->err;
+}
+
+esp_err_t mqtt_rpc_reply_printf(mqtt_rpc_reply_t *reply, const char *fmt, ...) {
+    char buf[RPC_PRINTF_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return ESP_FAIL;
+    }
+    if (n >= (int)sizeof(buf)) {
+        // Cut short it would be broken JSON: send nothing and let the handler fail.
+        ESP_LOGE(TAG, "Reply part of %d bytes over the %d byte printf limit", n, RPC_PRINTF_MAX);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return mqtt_rpc_reply_write(reply, buf, (size_t)n);
+}
+
+uint32_t mqtt_rpc_reply_remaining_ms(const mqtt_rpc_reply_t *reply) {
+    int64_t left = reply->deadline_us - esp_timer_get_time();
+    return left > 0 ? (uint32_t)(left / 1000) : 0;
+}
+
+esp_err_t mqtt_rpc_register(const char *method, mqtt_rpc_handler_t handler, void *ctx) {
+    if (!method || !handler || strlen(method) > RPC_METHOD_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Lookup and append under one hold, so a method cannot be registered twice.
+    esp_err_t err = ESP_OK;
+    taskENTER_CRITICAL(&rpc_mux);
+    if (find_handler_locked(method)) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (handler_count == CONFIG_MQTT_RPC_MAX_HANDLERS) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        handlers[handler_count].method = method;
+        handlers[handler_count].handler = handler;
+        handlers[handler_count].ctx = ctx;
+        handler_count++;
+    }
+    taskEXIT_CRITICAL(&rpc_mux);
+    return err;
+}
+
+void mqtt_rpc_get_stats(mqtt_rpc_stats_t *out) {
+    if (!out) {
+        return;
+    }
+    taskENTER_CRITICAL(&rpc_mux);
+    *out = stats;
+    taskEXIT_CRITICAL(&rpc_mux);
+}
+
+// --- Built-in commands ---
+
+static esp_err_t rpc_ping(const char *params, mqtt_rpc_reply_t *reply, void *ctx) {
+    return params ? mqtt_rpc_reply_write(reply, params, strlen(params))
+                  : mqtt_rpc_reply_write(reply, "\"pong\"", 6);
+}
+
+static esp_err_t rpc_methods(const char *params, mqtt_rpc_reply_t *reply, void *ctx) {
+    taskENTER_CRITICAL(&rpc_mux);
+    int n = handler_count;
+    taskEXIT_CRITICAL(&rpc_mux);
+
+    esp_err_t err = mqtt_rpc_reply_write(reply, "[", 1);
+    for (int i = 0; i < n && err == ESP_OK; i++) {
+        err = mqtt_rpc_reply_printf(reply, "%s\"%s\"", i ? "," : "", handlers[i].method);
+    }
+    return err == ESP_OK ? mqtt_rpc_reply_write(reply, "]", 1) : err;
+}
+
+static esp_err_t rpc_mqtt_stats(const char *params, mqtt_rpc_reply_t *reply, void *ctx) {
+    mqtt_manager_stats_t m;
+    mqtt_rpc_stats_t r;
+    mqtt_manager_get_stats(&m);
+    mqtt_rpc_get_stats(&r);
+
+    // In parts that fit RPC_PRINTF_MAX with every number at its widest.
+    esp_err_t err = mqtt_rpc_reply_printf(reply,
+        "{\"enqueued\":%" PRIu32 ",\"acked\":%" PRIu32 ",\"failed\":%" PRIu32 ",\"p50_ms\":%" PRIu32
+        ",\"p99_ms\":%" PRIu32 ",\"max_ms\":%" PRIu32 ",",
+        m.enqueued, m.acked, m.enqueue_failed, m.latency_p50_ms, m.latency_p99_ms, m.latency_max_ms);
+    if (err == ESP_OK) {
+#if CONFIG_IDF_TARGET_LINUX
+        // The heap watermark is not tracked on the host.
+        err = mqtt_rpc_reply_printf(reply,
+            "\"connects\":%" PRIu32 ",\"disconnects\":%" PRIu32 ",\"reconnect_max_ms\":%" PRIu32
+            ",\"outbox\":%d,",
+            m.connects, m.disconnects, m.reconnect_max_ms, m.outbox_bytes);
+#else
+        err = mqtt_rpc_reply_printf(reply,
+            "\"connects\":%" PRIu32 ",\"disconnects\":%" PRIu32 ",\"reconnect_max_ms\":%" PRIu32
+            ",\"heap_min_free\":%" PRIu32 ",\"outbox\":%d,",
+            m.connects, m.disconnects, m.reconnect_max_ms, m.heap_min_free, m.outbox_bytes);
+#endif
+    }
+    if (err == ESP_OK) {
+        err = mqtt_rpc_reply_printf(reply,
+            "\"compress_in\":%" PRIu64 ",\"compress_out\":%" PRIu64 ",\"compress_us\":%" PRIu64 ",",
+            m.compress_in_bytes, m.compress_out_bytes, m.compress_us);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    return mqtt_rpc_reply_printf(reply,
+        "\"rpc\":{\"received\":%" PRIu32 ",\"completed\":%" PRIu32 ",\"failed\":%" PRIu32
+        ",\"timed_out\":%" PRIu32 ",\"rejected\":%" PRIu32 ",\"in_flight_max\":%" PRIu32 "}}",
+        r.received, r.completed, r.failed, r.timed_out, r.rejected, r.in_flight_max);
+}
+
+esp_err_t mqtt_rpc_init(void) {
+    if (rpc_queue) {
+        return ESP_OK;
+    }
+
+    rpc_queue = xQueueCreate(CONFIG_MQTT_RPC_QUEUE_LEN, sizeof(rpc_request_t));
+    if (!rpc_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    mqtt_rpc_register("ping", rpc_ping, NULL);
+    mqtt_rpc_register("methods", rpc_methods, NULL);
+    mqtt_rpc_register("mqtt.stats", rpc_mqtt_stats, NULL);
+
+    for (int i = 0; i < CONFIG_MQTT_RPC_WORKERS; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "mqtt_rpc_%d", i);
+        if (xTaskCreate(rpc_worker_task, name, CONFIG_MQTT_RPC_WORKER_STACK, NULL, 4, NULL) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to start %s", name);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    snprintf(req_topic, sizeof(req_topic), "%s/%s/rpc/req", CONFIG_MQTT_RPC_TOPIC_PREFIX, mqtt_manager_device_id());
+    esp_err_t err = mqtt_manager_subscribe(req_topic, 1, on_request, NULL);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Listening on %s with %d workers", req_topic, CONFIG_MQTT_RPC_WORKERS);
+    }
+    return err;
+}
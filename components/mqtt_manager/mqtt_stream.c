@@ -0,0 +1,231 @@
+/**
+ * File: mqtt_stream.c
+ * Description: Chunked, optionally compressed, flow-controlled MQTT streams.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.7.2
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "mqtt_manager.h"
+#include "mqtt_manager_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+#include <stdlib.h>
+#if CONFIG_MQTT_MANAGER_COMPRESS
+#include "hs_encoder.h"
+#endif
+
+#define STREAM_CHUNK_SIZE   CONFIG_MQTT_MANAGER_STREAM_CHUNK
+#define STREAM_DRAIN_POLL   pdMS_TO_TICKS(20)
+#define STREAM_DRAIN_MAX_US (10LL * 1000 * 1000)
+
+struct mqtt_stream {
+    char *topic;
+    int qos;
+    uint8_t flags;
+    uint16_t seq;
+    esp_err_t err;
+    size_t len;                 // bytes used in buf, header included
+    uint8_t buf[STREAM_CHUNK_SIZE];
+#if CONFIG_MQTT_MANAGER_COMPRESS
+    hs_encoder_t *enc;
+    size_t raw_bytes;
+    size_t packed_bytes;
+    int64_t publish_us;         // time spent publishing from inside the encoder sink
+    int64_t cpu_us;             // encoder time, publishing excluded
+#endif
+};
+
+static const char *TAG = "MQTT_STREAM";
+
+static esp_err_t wait_outbox_drain(void) {
+    int64_t start = esp_timer_get_time();
+    while (mqtt_manager_outbox_size() > CONFIG_MQTT_MANAGER_STREAM_OUTBOX_MAX) {
+        if (esp_timer_get_time() - start > STREAM_DRAIN_MAX_US) {
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(STREAM_DRAIN_POLL);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t publish_chunk(struct mqtt_stream *s, bool final) {
+    if (s->err != ESP_OK) {
+        return s->err;
+    }
+
+    s->err = wait_outbox_drain();
+    if (s->err != ESP_OK) {
+        ESP_LOGW(TAG, "%s: outbox did not drain, aborting at chunk %u", s->topic, s->seq);
+        return s->err;
+    }
+
+    s->buf[0] = MQTT_STREAM_MAGIC;
+    s->buf[1] = s->flags | (final ? MQTT_STREAM_FLAG_FINAL : 0);
+    s->buf[2] = s->seq >> 8;
+    s->buf[3] = s->seq & 0xff;
+
+    const char *ctype = (s->flags & MQTT_STREAM_FLAG_COMPRESSED) ? MQTT_STREAM_CONTENT_TYPE_HS
+                                                                 : MQTT_STREAM_CONTENT_TYPE;
+    if (mqtt_manager_publish_typed(s->topic, (const char *)s->buf, s->len, s->qos, ctype) < 0) {
+        s->err = ESP_FAIL;
+        return s->err;
+    }
+
+    s->seq++;
+    s->len = MQTT_STREAM_HEADER_LEN;
+    return ESP_OK;
+}
+
+static esp_err_t append(struct mqtt_stream *s, const uint8_t *data, size_t len) {
+    while (len && s->err == ESP_OK) {
+        size_t n = sizeof(s->buf) - s->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(s->buf + s->len, data, n);
+        s->len += n;
+        data += n;
+        len -= n;
+        if (s->len == sizeof(s->buf)) {
+            publish_chunk(s, false);
+        }
+    }
+    return s->err;
+}
+
+#if CONFIG_MQTT_MANAGER_COMPRESS
+static int encoder_sink(void *ctx, const uint8_t *data, size_t len) {
+    struct mqtt_stream *s = ctx;
+    int64_t t0 = esp_timer_get_time();
+    s->packed_bytes += len;
+    append(s, data, len);
+    s->publish_us += esp_timer_get_time() - t0;
+    return s->err != ESP_OK;
+}
+
+// Run the encoder on data, or finish it when data is NULL, charging only its own time.
+static void encode(struct mqtt_stream *s, const void *data, size_t len) {
+    int64_t t0 = esp_timer_get_time();
+    int64_t publish0 = s->publish_us;
+    if (data) {
+        s->raw_bytes += len;
+        hs_encoder_write(s->enc, data, len);
+    } else {
+        hs_encoder_finish(s->enc);
+    }
+    s->cpu_us += (esp_timer_get_time() - t0) - (s->publish_us - publish0);
+}
+#endif
+
+mqtt_stream_handle_t mqtt_manager_stream_begin(const char *topic, int qos, bool compress) {
+    if (!topic) {
+        return NULL;
+    }
+
+    struct mqtt_stream *s = calloc(1, sizeof(*s));
+    if (!s) {
+        return NULL;
+    }
+    s->topic = strdup(topic);
+    if (!s->topic) {
+        free(s);
+        return NULL;
+    }
+    s->qos = qos;
+    s->len = MQTT_STREAM_HEADER_LEN;
+
+#if CONFIG_MQTT_MANAGER_COMPRESS
+    if (compress) {
+        s->enc = malloc(sizeof(hs_encoder_t));
+        if (!s->enc) {
+            free(s->topic);
+            free(s);
+            return NULL;
+        }
+        hs_encoder_init(s->enc, encoder_sink, s);
+        s->flags |= MQTT_STREAM_FLAG_COMPRESSED;
+    }
+#else
+    (void)compress;
+#endif
+    return s;
+}
+
+esp_err_t mqtt_manager_stream_write(mqtt_stream_handle_t s, const void *data, size_t len) {
+    if (!s || (!data && len)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (len == 0) {
+        return s->err;
+    }
+#if CONFIG_MQTT_MANAGER_COMPRESS
+    if (s->enc) {
+        if (s->err == ESP_OK) {
+            encode(s, data, len);
+        }
+        return s->err;
+    }
+#endif
+    return append(s, data, len);
+}
+
+// Finish the encoder and release it; any buffered output lands in s->buf.
+static void close_encoder(struct mqtt_stream *s) {
+#if CONFIG_MQTT_MANAGER_COMPRESS
+    if (s->enc) {
+        if (s->err == ESP_OK) {
+            encode(s, NULL, 0);
+        }
+        free(s->enc);
+        s->enc = NULL;
+    }
+#endif
+}
+
+static esp_err_t release(struct mqtt_stream *s) {
+#if CONFIG_MQTT_MANAGER_COMPRESS
+    if (s->flags & MQTT_STREAM_FLAG_COMPRESSED) {
+        mqtt_manager_note_compression(s->raw_bytes, s->packed_bytes, s->cpu_us);
+    }
+#endif
+
+    esp_err_t err = s->err;
+    free(s->topic);
+    free(s);
+    return err;
+}
+
+esp_err_t mqtt_manager_stream_end(mqtt_stream_handle_t s) {
+    if (!s) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    close_encoder(s);
+    publish_chunk(s, true);
+    return release(s);
+}
+
+esp_err_t mqtt_manager_stream_fail(mqtt_stream_handle_t s, const char *reason) {
+    if (!s) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    close_encoder(s);
+    if (s->len > MQTT_STREAM_HEADER_LEN) {
+        publish_chunk(s, false);
+    }
+
+    // The error chunk is plain text even when the payload was compressed.
+    uint8_t flags = s->flags;
+    s->flags = MQTT_STREAM_FLAG_ERROR;
+    append(s, (const uint8_t *)reason, reason ? strlen(reason) : 0);
+    publish_chunk(s, true);
+    s->flags = flags;
+
+    return release(s);
+}
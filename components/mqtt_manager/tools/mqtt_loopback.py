@@ -0,0 +1,279 @@
+#!/usr/bin/env python3
+#
+#  mqtt_loopback.py
+#
+#  Created on: 2026-10-19
+#  Edited on: 2026-10-19
+#      Author: Andwardo
+#      Version: v8.7.8
+#
+#  Broker stand-in for host/mqtt_bench: just enough MQTT 3.1.1 for mqtt_manager
+#  on loopback, so the bench measures the client and not a broker install.
+#  Python standard library only.
+#
+#  CONNECT, SUBSCRIBE, UNSUBSCRIBE and PINGREQ are answered at once. PUBLISH is
+#  acknowledged after --ack-delay-ms (QoS 1 PUBACK, QoS 2 PUBREC/PUBCOMP), which
+#  stands in for the round trip to a real broker, and copied at QoS 0 to every
+#  client subscribed to a matching filter (+ and # wildcards), the sender
+#  included, so RPC requests and streams can be looped back as well.
+#
+#  With --tls-cert/--tls-key it speaks MQTT over TLS, for mqtts:// runs with
+#  test certificates; --tls-ca then also requires a client certificate signed
+#  by that CA, as the production broker does.
+#
+#  usage: mqtt_loopback.py [--port P] [--ack-delay-ms MS] [--report S]
+#                          [--tls-cert PEM --tls-key PEM [--tls-ca PEM]]
+#
+
+import argparse
+import socket
+import ssl
+import struct
+import threading
+import time
+
+CONNECT, CONNACK, PUBLISH, PUBACK, PUBREC, PUBREL, PUBCOMP = 1, 2, 3, 4, 5, 6, 7
+SUBSCRIBE, SUBACK, UNSUBSCRIBE, UNSUBACK, PINGREQ, PINGRESP, DISCONNECT = 8, 9, 10, 11, 12, 13, 14
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.connects = self.publishes = self.bytes = self.delivered = 0
+
+    def add(self, **kw):
+        with self.lock:
+            for k, v in kw.items():
+                setattr(self, k, getattr(self, k) + v)
+
+    def snapshot(self):
+        with self.lock:
+            return self.connects, self.publishes, self.bytes, self.delivered
+
+
+def _varlen(n):
+    out = bytearray()
+    while True:
+        b = n & 0x7F
+        n >>= 7
+        out.append(b | 0x80 if n else b)
+        if not n:
+            return bytes(out)
+
+
+def _packet(ptype, flags, body):
+    return bytes([ptype << 4 | flags]) + _varlen(len(body)) + body
+
+
+def _string(body, pos):
+    n = struct.unpack_from(">H", body, pos)[0]
+    return body[pos + 2:pos + 2 + n], pos + 2 + n
+
+
+def topic_matches(filt, topic):
+    f, t = filt.split("/"), topic.split("/")
+    for i, part in enumerate(f):
+        if part == "#":
+            return True
+        if i >= len(t) or (part != "+" and part != t[i]):
+            return False
+    return len(f) == len(t)
+
+
+class Broker:
+    def __init__(self, ack_delay):
+        self.ack_delay = ack_delay
+        self.stats = Stats()
+        self.lock = threading.Lock()
+        self.clients = {}           # Client -> set of filters
+
+    def route(self, topic, payload):
+        packet = _packet(PUBLISH, 0, struct.pack(">H", len(topic)) + topic + payload)
+        name = topic.decode("utf-8", "replace")
+        with self.lock:
+            targets = [c for c, filters in self.clients.items() if any(topic_matches(f, name) for f in filters)]
+        for c in targets:
+            c.send(packet)
+        self.stats.add(delivered=len(targets))
+
+
+class Client(threading.Thread):
+    def __init__(self, broker, sock, addr):
+        super().__init__(daemon=True)
+        self.broker, self.sock, self.addr = broker, sock, addr
+        self.send_lock = threading.Lock()
+        self.acks = []              # (due, packet), in order
+        self.acks_cv = threading.Condition()
+        self.open = True
+
+    def send(self, data):
+        with self.send_lock:
+            try:
+                self.sock.sendall(data)
+            except OSError:
+                self.open = False
+
+    def _read(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError
+            data += chunk
+        return data
+
+    def _read_packet(self):
+        first = self._read(1)[0]
+        length = shift = 0
+        while True:
+            b = self._read(1)[0]
+            length |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                break
+        return first >> 4, first & 0x0F, self._read(length) if length else b""
+
+    # Acks go out from a thread of their own so a delay does not stall reading.
+    def _ack_loop(self):
+        while self.open:
+            with self.acks_cv:
+                while self.open and not self.acks:
+                    self.acks_cv.wait(0.5)
+                if not self.acks:
+                    continue
+                due, packet = self.acks[0]
+                wait = due - time.monotonic()
+                if wait > 0:
+                    self.acks_cv.wait(wait)
+                    continue
+                self.acks.pop(0)
+            self.send(packet)
+
+    def _ack(self, packet):
+        with self.acks_cv:
+            self.acks.append((time.monotonic() + self.broker.ack_delay, packet))
+            self.acks_cv.notify()
+
+    def _publish(self, flags, body):
+        qos = flags >> 1 & 3
+        topic, pos = _string(body, 0)
+        if qos:
+            msg_id = body[pos:pos + 2]
+            pos += 2
+            self._ack(_packet(PUBACK if qos == 1 else PUBREC, 0, msg_id))
+        payload = body[pos:]
+        self.broker.stats.add(publishes=1, bytes=len(payload))
+        self.broker.route(topic, payload)
+
+    def _subscribe(self, body):
+        msg_id, pos, granted, filters = body[:2], 2, bytearray(), []
+        while pos < len(body):
+            filt, pos = _string(body, pos)
+            pos += 1                # requested QoS; everything is delivered at 0
+            filters.append(filt.decode("utf-8", "replace"))
+            granted.append(0)
+        with self.broker.lock:
+            self.broker.clients[self].update(filters)
+        self.send(_packet(SUBACK, 0, msg_id + bytes(granted)))
+
+    def _unsubscribe(self, body):
+        msg_id, pos = body[:2], 2
+        with self.broker.lock:
+            while pos < len(body):
+                filt, pos = _string(body, pos)
+                self.broker.clients[self].discard(filt.decode("utf-8", "replace"))
+        self.send(_packet(UNSUBACK, 0, msg_id))
+
+    def run(self):
+        if isinstance(self.sock, ssl.SSLSocket):
+            try:
+                self.sock.do_handshake()
+            except (ssl.SSLError, OSError) as e:
+                print("mqtt_loopback: TLS handshake with %s:%d failed: %s" % (self.addr + (e,)), flush=True)
+                self.sock.close()
+                return
+        threading.Thread(target=self._ack_loop, daemon=True).start()
+        with self.broker.lock:
+            self.broker.clients[self] = set()
+        try:
+            while self.open:
+                ptype, flags, body = self._read_packet()
+                if ptype == CONNECT:
+                    # Clean session only: nothing is kept across connections.
+                    self.broker.stats.add(connects=1)
+                    self.send(_packet(CONNACK, 0, b"\x00\x00"))
+                elif ptype == PUBLISH:
+                    self._publish(flags, body)
+                elif ptype == PUBREL:
+                    self._ack(_packet(PUBCOMP, 0, body[:2]))
+                elif ptype == SUBSCRIBE:
+                    self._subscribe(body)
+                elif ptype == UNSUBSCRIBE:
+                    self._unsubscribe(body)
+                elif ptype == PINGREQ:
+                    self.send(_packet(PINGRESP, 0, b""))
+                elif ptype == DISCONNECT:
+                    break
+        except (ConnectionError, OSError, struct.error):
+            pass
+        self.open = False
+        with self.broker.lock:
+            self.broker.clients.pop(self, None)
+        self.sock.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Minimal MQTT 3.1.1 broker for mqtt_manager on loopback")
+    ap.add_argument("--port", type=int, default=1883)
+    ap.add_argument("--ack-delay-ms", type=float, default=0, help="delay before each PUBACK/PUBREC/PUBCOMP")
+    ap.add_argument("--report", type=int, default=5, metavar="S", help="seconds between counter lines, 0 for none")
+    ap.add_argument("--tls-cert", metavar="PEM", help="server certificate; enables TLS")
+    ap.add_argument("--tls-key", metavar="PEM", help="server private key")
+    ap.add_argument("--tls-ca", metavar="PEM", help="CA for client certificates, which are then required")
+    args = ap.parse_args()
+    if bool(args.tls_cert) != bool(args.tls_key) or (args.tls_ca and not args.tls_cert):
+        ap.error("--tls-cert and --tls-key go together, and --tls-ca needs both")
+
+    tls = None
+    if args.tls_cert:
+        tls = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        tls.load_cert_chain(args.tls_cert, args.tls_key)
+        if args.tls_ca:
+            tls.load_verify_locations(args.tls_ca)
+            tls.verify_mode = ssl.CERT_REQUIRED
+
+    broker = Broker(args.ack_delay_ms / 1000.0)
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    srv.bind(("127.0.0.1", args.port))
+    srv.listen(8)
+    print("mqtt_loopback: listening on 127.0.0.1:%d%s, ack delay %.1f ms"
+          % (args.port, " (TLS, client certs required)" if args.tls_ca else " (TLS)" if tls else "", args.ack_delay_ms),
+          flush=True)
+
+    def report():
+        prev = broker.stats.snapshot()
+        while True:
+            time.sleep(args.report)
+            now = broker.stats.snapshot()
+            print("mqtt_loopback: %d connects, %d msg/s, %d KB/s, %d delivered"
+                  % (now[0] - prev[0], (now[1] - prev[1]) / args.report,
+                     (now[2] - prev[2]) / 1024 / args.report, now[3] - prev[3]), flush=True)
+            prev = now
+
+    if args.report > 0:
+        threading.Thread(target=report, daemon=True).start()
+    try:
+        while True:
+            sock, addr = srv.accept()
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            if tls:
+                # Handshake on the client's own thread so a stalled one does not block accept().
+                sock = tls.wrap_socket(sock, server_side=True, do_handshake_on_connect=False)
+            Client(broker, sock, addr).start()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
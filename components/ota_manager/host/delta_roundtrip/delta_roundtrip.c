@@ -0,0 +1,185 @@
+/**
+ * File: delta_roundtrip.c
+ * Description: Applies a patch from tools/ota_delta.py to its base with ota_patch.c,
+ *              the same code the firmware runs, and checks the result byte for byte:
+ *              fed in random slices, resumed part way as after a restart, and with
+ *              corrupted patches that must fail cleanly or be left to the hash check.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.10.1
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "ota_patch.h"
+
+#define WINDOW_BITS_MAX 15
+#define SECTOR_SIZE     4096
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "delta_roundtrip: %s (line %d)\n", #cond, __LINE__); exit(1); } } while (0)
+
+typedef struct {
+    const uint8_t *base;
+    size_t base_len;
+    uint8_t *out;
+    size_t out_cap;
+    uint32_t next;          // next output offset expected
+    uint32_t reads;
+    uint64_t read_bytes;
+} sink_t;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} blob_t;
+
+static blob_t load(const char *path) {
+    blob_t b = { 0 };
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    b.len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    b.data = malloc(b.len ? b.len : 1);
+    CHECK(b.data && fread(b.data, 1, b.len, f) == b.len);
+    fclose(f);
+    return b;
+}
+
+static int read_base(void *ctx, uint32_t offset, void *buf, size_t len) {
+    sink_t *s = ctx;
+    CHECK(offset + len <= s->base_len);
+    memcpy(buf, s->base + offset, len);
+    s->reads++;
+    s->read_bytes += len;
+    return 0;
+}
+
+static int write_out(void *ctx, uint32_t offset, const void *data, size_t len) {
+    sink_t *s = ctx;
+    // What the firmware's ota_manager_write() requires: in order, no gaps, within the image.
+    CHECK(offset == s->next);
+    if (offset + len > s->out_cap) {
+        return 1;
+    }
+    memcpy(s->out + offset, data, len);
+    s->next += (uint32_t)len;
+    return 0;
+}
+
+// Feeds the patch in slices of 1..max_slice bytes; returns the result code.
+static ota_patch_err_t apply(const blob_t *base, const blob_t *patch, uint8_t *out, size_t out_cap,
+                             uint32_t out_from, size_t max_slice, sink_t *s, ota_patch_t *p) {
+    static uint8_t window[1 << WINDOW_BITS_MAX];
+
+    memset(s, 0, sizeof(*s));
+    s->base = base->data;
+    s->base_len = base->len;
+    s->out = out;
+    s->out_cap = out_cap;
+    s->next = out_from;
+    ota_patch_init(p, window, WINDOW_BITS_MAX, out_from, read_base, write_out, s);
+
+    ota_patch_err_t err = OTA_PATCH_OK;
+    for (size_t pos = 0; pos < patch->len && err == OTA_PATCH_OK;) {
+        size_t n = 1 + (size_t)rand() % max_slice;
+        if (n > patch->len - pos) {
+            n = patch->len - pos;
+        }
+        err = ota_patch_feed(p, patch->data + pos, n);
+        pos += n;
+    }
+    return err;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s old.bin new.patch new.bin [rounds]\n", argv[0]);
+        return 2;
+    }
+    blob_t base = load(argv[1]);
+    blob_t patch = load(argv[2]);
+    blob_t target = load(argv[3]);
+    int rounds = argc > 4 ? atoi(argv[4]) : 20;
+    uint8_t *out = malloc(target.len + 1);
+    sink_t s;
+    ota_patch_t p;
+    CHECK(out);
+    srand(1);
+
+    // In one go, timed.
+    double t = now_s();
+    CHECK(apply(&base, &patch, out, target.len, 0, patch.len, &s, &p) == OTA_PATCH_OK);
+    t = now_s() - t;
+    CHECK(ota_patch_done(&p) && p.target_size == target.len && p.base_size == base.len);
+    CHECK(s.next == target.len && memcmp(out, target.data, target.len) == 0);
+    printf("%s: %zu bytes rebuilds %zu (%.1f%%, %.1fx smaller), window %u/%u bits\n",
+           argv[2], patch.len, target.len, 100.0 * patch.len / target.len,
+           (double)target.len / patch.len, p.window_bits, p.lookahead_bits);
+    printf("applied in %.1f ms (%.1f MB/s), %u base reads, %zu + %u bytes of RAM\n",
+           t * 1000, target.len / t / 1e6, s.reads, sizeof(ota_patch_t), 1u << p.window_bits);
+
+    // Random slices, as the transports deliver them.
+    for (int r = 0; r < rounds; r++) {
+        memset(out, 0, target.len);
+        CHECK(apply(&base, &patch, out, target.len, 0, 1 + (size_t)rand() % 4096, &s, &p) == OTA_PATCH_OK);
+        CHECK(ota_patch_done(&p) && memcmp(out, target.data, target.len) == 0);
+    }
+
+    // Resumed after a restart: the output below a sector boundary is in flash already.
+    for (int r = 0; r < rounds; r++) {
+        uint32_t from = (uint32_t)(((size_t)rand() % (target.len + 1)) & ~(size_t)(SECTOR_SIZE - 1));
+        memcpy(out, target.data, from);
+        memset(out + from, 0, target.len - from);
+        CHECK(apply(&base, &patch, out, target.len, from, 1 + (size_t)rand() % 4096, &s, &p) == OTA_PATCH_OK);
+        CHECK(ota_patch_done(&p) && memcmp(out, target.data, target.len) == 0);
+    }
+
+    // Truncated: never done, never past the image.
+    for (int r = 0; r < rounds; r++) {
+        blob_t cut = { patch.data, (size_t)rand() % patch.len };
+        ota_patch_err_t err = apply(&base, &cut, out, target.len, 0, 4096, &s, &p);
+        CHECK(err != OTA_PATCH_OK || !ota_patch_done(&p));
+    }
+
+    // Corrupted: an error, or an image for the SHA-256 check to reject. The stream is not
+    // canonical (padding bits, backrefs to equal bytes), so some flips change nothing at all.
+    // Nothing may read or write out of bounds: CHECK in the callbacks, ASan for the rest.
+    uint8_t *bad = malloc(patch.len);
+    CHECK(bad);
+    int rejected = 0, harmless = 0;
+    for (int r = 0; r < rounds * 10; r++) {
+        memcpy(bad, patch.data, patch.len);
+        size_t at = OTA_PATCH_HEADER_LEN + (size_t)rand() % (patch.len - OTA_PATCH_HEADER_LEN);
+        bad[at] ^= (uint8_t)(1 + rand() % 255);
+        blob_t corrupt = { bad, patch.len };
+        ota_patch_err_t err = apply(&base, &corrupt, out, target.len, 0, 4096, &s, &p);
+        if (err != OTA_PATCH_OK || !ota_patch_done(&p)) {
+            rejected++;
+        } else if (memcmp(out, target.data, target.len) == 0) {
+            harmless++;
+        }
+    }
+    free(bad);
+
+    printf("ok: %d sliced, %d resumed, %d truncated, %d corrupted (%d rejected, %d unchanged)\n",
+           rounds, rounds, rounds, rounds * 10, rejected, harmless);
+    free(out);
+    free(base.data);
+    free(patch.data);
+    free(target.data);
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * File: components/ota_manager/include/ota_manager.h
+ * Description: A/B firmware updates streamed into the inactive ota_N slot over
+ *              HTTPS or MQTT, with resume, verification and rollback.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.10.2
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ *
+ * An update is described by a manifest: image size, SHA-256 and an ECDSA P-256
+ * signature of that SHA-256 (tools/ota_sign.py makes one). Data is written to
+ * the slot as it arrives, nothing is buffered beyond one transport read. The
+ * progress is checkpointed in NVS, so the same manifest sent again, before or
+ * after a restart, continues at the offset already in flash.
+ *
+ * Once the last byte is in, the SHA-256 and the signature are checked, the
+ * image is verified by the bootloader code and the slot is made the boot slot.
+ * The new image then starts in the pending-verify state (app rollback is
+ * enabled in the bootloader): it is confirmed when the health check passed to
+ * ota_manager_init() succeeds, otherwise the device rolls back and restarts.
+ *
+ * Instead of the image, a delta patch can be sent (tools/ota_delta.py makes
+ * one): the new image is rebuilt from the running one as the patch arrives,
+ * in a few KB of RAM, and then checked exactly like a full download. The
+ * manifest names the running image by the SHA-256 of its first base_size
+ * bytes; a patch for any other image is refused before anything is written.
+ *
+ * RPC commands (see mqtt_rpc.h), all replying with JSON:
+ *   ota.start   {"url":"https://...","size":N,"sha256":"<hex>","sig":"<base64>","restart":true}
+ *               Downloads over HTTPS with Range requests, resuming after errors
+ *               and following redirects.
+ *   ota.begin   {"size":N,"sha256":"<hex>","sig":"<base64>","restart":true}
+ *               Waits for chunks on <prefix>/<device_id>/ota/data, each a 4 byte
+ *               big-endian image offset followed by up to "chunk" bytes. Every
+ *               chunk is answered on <prefix>/<device_id>/ota/ack with
+ *               {"offset":N} (the next byte wanted), so the sender can keep a
+ *               few chunks in flight and go back to N after a loss.
+ *               Either command takes "patch":{"size":N,"base_size":N,"base_sha256":"<hex>"}
+ *               as well: the url or the chunks then carry the patch, and all
+ *               offsets are patch offsets.
+ *   ota.status  The ota_manager_stats_t counters.
+ *   ota.abort   Stops the download; the next ota.start/ota.begin resumes it.
+ * The reply to ota.start and ota.begin carries the offset the download resumes from.
+ */
+#ifndef OTA_MANAGER_H
+#define OTA_MANAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_MANAGER_SHA256_LEN 32
+/** Largest DER encoded ECDSA P-256 signature. */
+#define OTA_MANAGER_SIG_MAX    72
+
+typedef enum {
+    OTA_STATE_IDLE,
+    OTA_STATE_DOWNLOADING,
+    OTA_STATE_VERIFYING,
+    OTA_STATE_READY,            // boot slot switched; the new image runs after a restart
+    OTA_STATE_FAILED,
+    OTA_STATE_PENDING_VERIFY,   // running a new image whose health check has not passed yet
+} ota_manager_state_t;
+
+typedef struct {
+    uint32_t size;
+    uint8_t sha256[OTA_MANAGER_SHA256_LEN];
+    uint8_t sig[OTA_MANAGER_SIG_MAX];
+    size_t sig_len;             // 0: unsigned, refused with CONFIG_OTA_MANAGER_REQUIRE_SIGNATURE
+    uint32_t patch_size;        // delta update: patch bytes sent instead of the image; 0 for a full image
+    uint32_t base_size;         // bytes of the running image the patch was made from
+    uint8_t base_sha256[OTA_MANAGER_SHA256_LEN];
+} ota_manifest_t;
+
+/**
+ * @brief Decides whether a freshly updated image is fit to keep.
+ * @return ESP_OK to confirm the image; anything else rolls back to the previous one.
+ *         Must return within timeout_ms (CONFIG_OTA_MANAGER_HEALTH_TIMEOUT_S).
+ */
+typedef esp_err_t (*ota_manager_health_cb_t)(uint32_t timeout_ms);
+
+typedef struct {
+    ota_manager_state_t state;
+    esp_err_t last_err;         // why the last download failed or was stopped
+    uint32_t image_size;
+    uint32_t written;           // image bytes in flash
+    uint32_t resumed_at;        // offset the current download resumed from, 0 for a fresh one
+    uint32_t resumes;           // downloads that continued a partial image
+    uint32_t retries;           // HTTPS reconnects within a download
+    uint32_t dropped;           // MQTT chunks lost to a full queue (the sender resends them)
+    uint32_t patch_size;        // delta update: patch bytes, 0 for a full image
+    uint32_t patch_applied;     // patch bytes applied so far
+    uint32_t download_ms;       // first byte of this attempt to the last
+    uint32_t bytes_per_s;       // throughput of this attempt
+    uint32_t verify_ms;         // hash, signature, image check and boot slot switch
+    uint32_t swap_ms;           // last update: download start to the new image confirmed, across the restart
+    uint32_t health_ms;         // boot to the running image confirmed, 0 if it needed no check
+    bool rolled_back;           // this boot follows the rejection of a newer image; cleared by the next download
+} ota_manager_stats_t;
+
+/**
+ * @brief Register the RPC commands and, when the running image is still pending
+ *        verification, run health on a task of its own: ESP_OK confirms the
+ *        image, anything else marks it invalid and restarts into the previous slot.
+ * @param health NULL confirms a pending image straight away.
+ * @note Needs NVS and nvs_sync_create(); the commands work once mqtt_rpc_init() has run.
+ *       Call it before any other ota_manager function: it creates their locks.
+ */
+esp_err_t ota_manager_init(ota_manager_health_cb_t health);
+
+/**
+ * @brief Start writing the image described by manifest into the inactive slot,
+ *        or continue it: a download of the same image left off in this boot or
+ *        checkpointed before a restart resumes where it stopped. This and
+ *        ota_manager_write() take image bytes: the patch fields of the
+ *        manifest are only used by the HTTPS and MQTT transports.
+ * @param[out] offset First image byte still needed.
+ * @return ESP_ERR_INVALID_STATE while another image is being written or the
+ *         running one is still pending verification, ESP_ERR_INVALID_SIZE if the
+ *         image does not fit the slot, ESP_ERR_OTA_VALIDATE_FAILED for a missing
+ *         signature that is required.
+ */
+esp_err_t ota_manager_begin(const ota_manifest_t *manifest, uint32_t *offset);
+
+/**
+ * @brief Write image bytes at offset. Bytes below the current offset (resent
+ *        data) are skipped, so transports can replay without bookkeeping.
+ * @return ESP_ERR_INVALID_ARG if offset is past the current one (data was lost
+ *         in between; the download stays usable), ESP_ERR_INVALID_SIZE for data
+ *         past the image end, ESP_ERR_OTA_VALIDATE_FAILED if the image is for
+ *         another project, or a flash error. Anything but ESP_ERR_INVALID_ARG
+ *         fails the download.
+ */
+esp_err_t ota_manager_write(uint32_t offset, const void *data, size_t len);
+
+/**
+ * @brief Verify the complete image and make its slot the boot slot.
+ * @return ESP_ERR_INVALID_CRC on a hash mismatch, ESP_ERR_OTA_VALIDATE_FAILED
+ *         for a bad signature or image. Either way the partial download is
+ *         forgotten, so the next attempt starts from the beginning.
+ */
+esp_err_t ota_manager_finish(void);
+
+/**
+ * @brief Stop the current download; its progress is kept for a later resume.
+ */
+void ota_manager_abort(esp_err_t reason);
+
+/**
+ * @brief Download url into the inactive slot on a task of its own, reconnecting
+ *        with a Range request after errors (CONFIG_OTA_MANAGER_HTTP_RETRIES).
+ *        With manifest->patch_size set, url is a patch for the running image.
+ * @param restart Restart into the new image once it is verified.
+ * @param[out] offset As for ota_manager_begin(); a patch offset for a patch.
+ * @return As ota_manager_begin(), or ESP_ERR_INVALID_VERSION for a patch made
+ *         from another image than the running one.
+ */
+esp_err_t ota_manager_start_https(const char *url, const ota_manifest_t *manifest, bool restart,
+                                  uint32_t *offset);
+
+void ota_manager_get_stats(ota_manager_stats_t *stats);
+
+const char *ota_manager_state_name(ota_manager_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // OTA_MANAGER_H
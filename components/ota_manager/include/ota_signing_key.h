@@ -0,0 +1,36 @@
+/*
+ * File: components/ota_manager/include/ota_signing_key.h
+ * Description: Public half of the key ota_manager checks image signatures
+ *              with: the PEM text as bytes, not terminated. Written by
+ *              tools/ota_sign.py keygen; only ota_manager.c includes it.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.10.2
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+#ifndef OTA_SIGNING_KEY_H
+#define OTA_SIGNING_KEY_H
+
+static const unsigned char ota_signing_key_pem[] = {
+  0x2d, 0x2d, 0x2d, 0x2d, 0x2d, 0x42, 0x45, 0x47, 0x49, 0x4e, 0x20, 0x50,
+  0x55, 0x42, 0x4c, 0x49, 0x43, 0x20, 0x4b, 0x45, 0x59, 0x2d, 0x2d, 0x2d,
+  0x2d, 0x2d, 0x0a, 0x4d, 0x46, 0x6b, 0x77, 0x45, 0x77, 0x59, 0x48, 0x4b,
+  0x6f, 0x5a, 0x49, 0x7a, 0x6a, 0x30, 0x43, 0x41, 0x51, 0x59, 0x49, 0x4b,
+  0x6f, 0x5a, 0x49, 0x7a, 0x6a, 0x30, 0x44, 0x41, 0x51, 0x63, 0x44, 0x51,
+  0x67, 0x41, 0x45, 0x76, 0x54, 0x33, 0x4a, 0x6c, 0x4e, 0x70, 0x5a, 0x55,
+  0x78, 0x6c, 0x74, 0x5a, 0x30, 0x5a, 0x69, 0x6d, 0x56, 0x2f, 0x4d, 0x4f,
+  0x66, 0x2b, 0x44, 0x78, 0x42, 0x68, 0x6f, 0x0a, 0x49, 0x48, 0x6a, 0x62,
+  0x73, 0x61, 0x66, 0x73, 0x2b, 0x39, 0x7a, 0x35, 0x78, 0x34, 0x69, 0x6f,
+  0x39, 0x56, 0x72, 0x53, 0x2f, 0x6c, 0x73, 0x34, 0x36, 0x47, 0x4c, 0x59,
+  0x31, 0x54, 0x53, 0x6a, 0x67, 0x62, 0x50, 0x43, 0x41, 0x53, 0x73, 0x78,
+  0x68, 0x4d, 0x4f, 0x68, 0x64, 0x73, 0x64, 0x34, 0x6a, 0x5a, 0x4c, 0x33,
+  0x32, 0x52, 0x56, 0x58, 0x57, 0x77, 0x3d, 0x3d, 0x0a, 0x2d, 0x2d, 0x2d,
+  0x2d, 0x2d, 0x45, 0x4e, 0x44, 0x20, 0x50, 0x55, 0x42, 0x4c, 0x49, 0x43,
+  0x20, 0x4b, 0x45, 0x59, 0x2d, 0x2d, 0x2d, 0x2d, 0x2d, 0x0a
+};
+static const unsigned int ota_signing_key_pem_len = 178;
+
+#endif // OTA_SIGNING_KEY_H
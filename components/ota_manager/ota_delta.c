@@ -0,0 +1,229 @@
+/*
+ * File: components/ota_manager/ota_delta.c
+ * Description: The byte stream the transports deliver: the image itself, or a
+ *              delta patch that is applied against the running image on its way
+ *              into the inactive slot.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.10.2
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "ota_manager.h"
+#include "ota_manager_priv.h"
+#include "ota_patch.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+
+static const char *TAG = "OTA_DELTA";
+
+#define WINDOW_BITS CONFIG_OTA_MANAGER_DELTA_WINDOW_BITS
+#define BASE_READ   4096
+
+static SemaphoreHandle_t delta_lock = NULL;
+static StaticSemaphore_t delta_lock_buf;
+
+// Everything below is only touched with delta_lock held.
+static bool delta;                  // the stream is a patch
+static ota_manifest_t current;
+static uint32_t patch_pos;          // patch bytes applied
+static ota_patch_t *patch = NULL;   // applier and its window, while applying
+static const esp_partition_t *base_part = NULL;
+
+static int read_base(void *ctx, uint32_t offset, void *buf, size_t len) {
+    return esp_partition_read(base_part, offset, buf, len);
+}
+
+static int write_image(void *ctx, uint32_t offset, const void *data, size_t len) {
+    return ota_manager_write(offset, data, len);
+}
+
+static void drop_patch(void) {
+    free(patch);
+    patch = NULL;
+}
+
+// The patch only makes sense against the image it was made from.
+static esp_err_t check_base(const ota_manifest_t *m) {
+    base_part = esp_ota_get_running_partition();
+    if (!base_part || m->base_size == 0 || m->base_size > base_part->size) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+    uint8_t *buf = malloc(BASE_READ);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    esp_err_t err = ESP_OK;
+    for (uint32_t pos = 0; pos < m->base_size && err == ESP_OK; pos += BASE_READ) {
+        uint32_t n = m->base_size - pos < BASE_READ ? m->base_size - pos : BASE_READ;
+        err = esp_partition_read(base_part, pos, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&sha, buf, n);
+        }
+    }
+    uint8_t digest[OTA_MANAGER_SHA256_LEN];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    free(buf);
+    if (err == ESP_OK && memcmp(digest, m->base_sha256, sizeof(digest)) != 0) {
+        ESP_LOGE(TAG, "Patch is for another image than the one in %s", base_part->label);
+        err = ESP_ERR_INVALID_VERSION;
+    }
+    return err;
+}
+
+static esp_err_t begin_patch(const ota_manifest_t *m, uint32_t *offset) {
+    if (delta && patch && m->patch_size == current.patch_size && m->size == current.size &&
+        memcmp(m->sha256, current.sha256, OTA_MANAGER_SHA256_LEN) == 0) {
+        ota_manager_stats_t st;
+        ota_manager_get_stats(&st);
+        if (st.state == OTA_STATE_DOWNLOADING) {
+            // A reconnect: the applier is where the last byte left it.
+            *offset = patch_pos;
+            return ESP_OK;
+        }
+    }
+
+    uint32_t image_offset;
+    esp_err_t err = check_base(m);
+    if (err == ESP_OK) {
+        err = ota_manager_begin(m, &image_offset);
+    }
+    if (err == ESP_OK && !patch && !(patch = malloc(sizeof(*patch) + (1u << WINDOW_BITS)))) {
+        ota_manager_abort(ESP_ERR_NO_MEM);
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // After a restart the patch is replayed from its start; what is in flash already is skipped.
+    ota_patch_init(patch, (uint8_t *)(patch + 1), WINDOW_BITS, image_offset, read_base, write_image, NULL);
+    delta = true;
+    current = *m;
+    patch_pos = 0;
+    ota_manager_note_patch(m->patch_size, 0);
+    ESP_LOGI(TAG, "Applying a %" PRIu32 " byte patch to %s, image from offset %" PRIu32,
+             m->patch_size, base_part->label, image_offset);
+    *offset = 0;
+    return ESP_OK;
+}
+
+void ota_stream_init(void) {
+    delta_lock = xSemaphoreCreateMutexStatic(&delta_lock_buf);
+}
+
+esp_err_t ota_stream_begin(const ota_manifest_t *m, uint32_t *offset) {
+    if (!m || !offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(delta_lock, portMAX_DELAY);
+    ota_manager_stats_t st;
+    ota_manager_get_stats(&st);
+    esp_err_t err;
+    if (st.state == OTA_STATE_DOWNLOADING && delta != (m->patch_size != 0)) {
+        // Patch bytes and image bytes share the transports' offsets: one kind at a time.
+        err = ESP_ERR_INVALID_STATE;
+    } else if (m->patch_size) {
+        err = begin_patch(m, offset);
+    } else {
+        err = ota_manager_begin(m, offset);
+        if (err == ESP_OK) {
+            delta = false;
+            drop_patch();
+            ota_manager_note_patch(0, 0);
+        }
+    }
+    xSemaphoreGive(delta_lock);
+    return err;
+}
+
+static esp_err_t patch_err(ota_patch_err_t err) {
+    switch (err) {
+    case OTA_PATCH_ERR_IO:
+        return patch->io_err;
+    case OTA_PATCH_ERR_WINDOW:
+        return ESP_ERR_NOT_SUPPORTED;
+    default:
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+}
+
+static esp_err_t apply_locked(uint32_t offset, const uint8_t *data, size_t len) {
+    if (offset > patch_pos) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset + len <= patch_pos) {
+        return ESP_OK;
+    }
+    if (!patch) {
+        // Finished or failed already.
+        return ESP_ERR_INVALID_STATE;
+    }
+    data += patch_pos - offset;
+    len -= patch_pos - offset;
+
+    esp_err_t err = ESP_OK;
+    ota_patch_err_t perr = OTA_PATCH_OK;
+    if (len > current.patch_size - patch_pos) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        perr = ota_patch_feed(patch, data, len);
+        patch_pos += len;
+    }
+    if (perr != OTA_PATCH_OK) {
+        err = patch_err(perr);
+    } else if (err == ESP_OK && patch->header_len == OTA_PATCH_HEADER_LEN &&
+               (patch->target_size != current.size || patch->base_size != current.base_size)) {
+        ESP_LOGE(TAG, "Patch header does not match the manifest");
+        err = ESP_ERR_INVALID_VERSION;
+    }
+    if (err == ESP_OK && patch_pos == current.patch_size && !ota_patch_done(patch)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    ota_manager_note_patch(current.patch_size, patch_pos);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Patch failed at %" PRIu32 " of %" PRIu32 " bytes: %s",
+                 patch_pos, current.patch_size, esp_err_to_name(err));
+        // Does nothing when ota_manager_write() failed the download already.
+        ota_manager_abort(err);
+        drop_patch();
+    } else if (patch_pos == current.patch_size) {
+        drop_patch();
+    }
+    return err;
+}
+
+esp_err_t ota_stream_write(uint32_t offset, const void *data, size_t len) {
+    xSemaphoreTake(delta_lock, portMAX_DELAY);
+    esp_err_t err = delta ? apply_locked(offset, data, len) : ota_manager_write(offset, data, len);
+    xSemaphoreGive(delta_lock);
+    return err;
+}
+
+uint32_t ota_stream_position(void) {
+    xSemaphoreTake(delta_lock, portMAX_DELAY);
+    uint32_t pos = patch_pos;
+    bool is_delta = delta;
+    xSemaphoreGive(delta_lock);
+    if (!is_delta) {
+        ota_manager_stats_t st;
+        ota_manager_get_stats(&st);
+        pos = st.written;
+    }
+    return pos;
+}
@@ -0,0 +1,190 @@
+/*
+ * File: components/ota_manager/ota_http.c
+ * Description: HTTPS transport for ota_manager: streams the image (or a patch
+ *              for it) into the slot as it is read and reconnects with a Range
+ *              request after errors.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.10.2
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "ota_manager.h"
+#include "ota_manager_priv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+
+static const char *TAG = "OTA_HTTP";
+
+#define BACKOFF_FIRST_MS 1000
+#define BACKOFF_MAX_MS   30000
+#define MAX_REDIRECTS    5
+
+typedef struct {
+    char *url;
+    ota_manifest_t manifest;
+    bool restart;
+} http_job_t;
+
+static portMUX_TYPE busy_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool busy = false;          // a download task is running
+
+static bool claim(void) {
+    taskENTER_CRITICAL(&busy_mux);
+    bool ok = !busy;
+    busy = true;
+    taskEXIT_CRITICAL(&busy_mux);
+    return ok;
+}
+
+// One request from the current offset to the end. Returns ESP_OK once the whole
+// image or patch is in; *fatal is set for errors a retry cannot fix.
+static esp_err_t fetch(const http_job_t *job, char *buf, bool *fatal) {
+    const uint32_t size = ota_stream_size(&job->manifest);
+    uint32_t pos = ota_stream_position();
+    if (pos == size) {
+        return ESP_OK;
+    }
+
+    esp_http_client_config_t cfg = {
+        .url = job->url,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .timeout_ms = CONFIG_OTA_MANAGER_HTTP_TIMEOUT_MS,
+        .buffer_size = CONFIG_OTA_MANAGER_HTTP_BUF,
+        .keep_alive_enable = true,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (pos) {
+        char range[32];
+        snprintf(range, sizeof(range), "bytes=%" PRIu32 "-", pos);
+        esp_http_client_set_header(client, "Range", range);
+    }
+
+    // open() and fetch_headers() do not follow redirects themselves; release URLs often do.
+    esp_err_t err = ESP_OK;
+    int status = 0;
+    for (int redirects = 0; err == ESP_OK; redirects++) {
+        err = esp_http_client_open(client, 0);
+        if (err == ESP_OK && esp_http_client_fetch_headers(client) < 0) {
+            err = ESP_FAIL;
+        }
+        status = err == ESP_OK ? esp_http_client_get_status_code(client) : 0;
+        if (status < 300 || status >= 400 || status == 304) {
+            break;
+        }
+        // The Range header stays on the client, so a resume asks the new location for the rest.
+        esp_http_client_flush_response(client, NULL);
+        if (redirects == MAX_REDIRECTS || esp_http_client_set_redirection(client) != ESP_OK) {
+            ESP_LOGE(TAG, "HTTP %d: %s", status, redirects == MAX_REDIRECTS ? "too many redirects" : "no Location");
+            err = ESP_ERR_INVALID_RESPONSE;
+            *fatal = true;
+        }
+    }
+    if (err == ESP_OK) {
+        if (status == 200) {
+            // Range not honoured: the file comes from the start, what is already in is skipped.
+            pos = 0;
+        } else if (status != 206) {
+            ESP_LOGE(TAG, "HTTP %d", status);
+            err = ESP_ERR_INVALID_RESPONSE;
+            *fatal = status >= 400 && status < 500;
+        }
+    }
+
+    while (err == ESP_OK && pos < size) {
+        int n = esp_http_client_read(client, buf, CONFIG_OTA_MANAGER_HTTP_BUF);
+        if (n <= 0) {
+            // A short body ends up here too; the next request asks for the rest.
+            err = n == 0 ? ESP_ERR_INVALID_SIZE : ESP_FAIL;
+            break;
+        }
+        err = ota_stream_write(pos, buf, n);
+        *fatal = err != ESP_OK;
+        pos += n;
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+static void http_task(void *arg) {
+    http_job_t *job = arg;
+    char *buf = malloc(CONFIG_OTA_MANAGER_HTTP_BUF);
+    uint32_t backoff_ms = BACKOFF_FIRST_MS;
+    bool fatal = false;
+    esp_err_t err = buf ? ESP_FAIL : ESP_ERR_NO_MEM;
+
+    for (int attempt = 0; buf && attempt <= CONFIG_OTA_MANAGER_HTTP_RETRIES; attempt++) {
+        if (attempt) {
+            ESP_LOGW(TAG, "Download interrupted (%s); retrying in %" PRIu32 " ms",
+                     esp_err_to_name(err), backoff_ms);
+            ota_manager_note_retry();
+            vTaskDelay(pdMS_TO_TICKS(backoff_ms));
+            backoff_ms = backoff_ms * 2 < BACKOFF_MAX_MS ? backoff_ms * 2 : BACKOFF_MAX_MS;
+        }
+        err = fetch(job, buf, &fatal);
+        if (err == ESP_OK || fatal) {
+            break;
+        }
+    }
+
+    if (err == ESP_OK) {
+        err = ota_manager_finish();
+    } else {
+        // Keeps the progress unless the write itself failed the download already.
+        ota_manager_abort(err);
+    }
+    if (err == ESP_OK && job->restart) {
+        ota_manager_restart_soon();
+    }
+
+    free(buf);
+    free(job->url);
+    free(job);
+    busy = false;
+    vTaskDelete(NULL);
+}
+
+esp_err_t ota_manager_start_https(const char *url, const ota_manifest_t *manifest, bool restart,
+                                  uint32_t *offset) {
+    if (!url || !manifest || !offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!claim()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    http_job_t *job = calloc(1, sizeof(*job));
+    esp_err_t err = job && (job->url = strdup(url)) ? ESP_OK : ESP_ERR_NO_MEM;
+    if (err == ESP_OK) {
+        job->manifest = *manifest;
+        job->restart = restart;
+        err = ota_stream_begin(manifest, offset);
+    }
+    if (err == ESP_OK &&
+        xTaskCreate(http_task, "ota_http", CONFIG_OTA_MANAGER_HTTP_STACK, job, 5, NULL) != pdPASS) {
+        ota_manager_abort(ESP_ERR_NO_MEM);
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err != ESP_OK) {
+        if (job) {
+            free(job->url);
+        }
+        free(job);
+        busy = false;
+    }
+    return err;
+}
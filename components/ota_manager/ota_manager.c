@@ -0,0 +1,680 @@
+/*
+ * File: components/ota_manager/ota_manager.c
+ * Description: Writes update images into the inactive ota_N slot as they arrive,
+ *              checkpoints the progress, verifies the result and confirms or
+ *              rolls back the new image after the restart.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.10.3
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "ota_manager.h"
+#include "ota_manager_priv.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_app_desc.h"
+#include "esp_app_format.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/base64.h"
+#include "cJSON.h"
+#include "mqtt_rpc.h"
+#include "nvs_sync.h"
+#include "settings.h"
+
+#include "ota_signing_key.h"    // static const ota_signing_key_pem[] and ota_signing_key_pem_len; included here only
+
+static const char *TAG = "OTA_MANAGER";
+
+#define SECTOR_SIZE   4096
+// Erasing a whole 64 KB block at a time is several times faster than sector by sector.
+#define ERASE_BLOCK   (64 * 1024)
+// The app description sits behind the image and first segment headers.
+#define APP_DESC_END  (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t))
+#define RESTART_DELAY_US (1000 * 1000)
+
+// Progress of the image being written, so a restart can pick it up again.
+enum {
+    OTA_SET_SHA,
+    OTA_SET_SIZE,
+    OTA_SET_SLOT,
+    OTA_SET_WRITTEN,
+    OTA_SET_SWAP_MS,
+    OTA_SET_COUNT
+};
+
+static const settings_def_t ota_setting_defs[OTA_SET_COUNT] = {
+    [OTA_SET_SHA]     = SETTINGS_BLOB("sha", OTA_MANAGER_SHA256_LEN, NULL),
+    [OTA_SET_SIZE]    = SETTINGS_INT("size", 0),
+    [OTA_SET_SLOT]    = SETTINGS_INT("slot", -1),       // partition subtype being written
+    [OTA_SET_WRITTEN] = SETTINGS_INT("written", 0),     // bytes known to be in flash
+    [OTA_SET_SWAP_MS] = SETTINGS_INT("swap_ms", 0),     // download start to the restart into it; 0 once confirmed or rejected
+};
+
+static const settings_schema_t ota_settings = {
+    .ns = "ota",
+    .version = 1,
+    .defs = ota_setting_defs,
+    .count = OTA_SET_COUNT,
+};
+
+static SemaphoreHandle_t ota_lock = NULL;
+static StaticSemaphore_t ota_lock_buf;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static ota_manager_stats_t stats;
+
+// Everything below is only touched with ota_lock held.
+static const esp_partition_t *slot = NULL;
+static ota_manifest_t manifest;
+static mbedtls_sha256_context sha;
+static uint32_t written;
+static uint32_t erased;             // slot bytes erased ahead of the writes
+static uint32_t checkpoint;         // written as last stored
+static int64_t started_us;
+
+static ota_manager_health_cb_t health_cb = NULL;
+static esp_timer_handle_t restart_timer = NULL;
+
+const char *ota_manager_state_name(ota_manager_state_t state) {
+    static const char *const names[] = {
+        [OTA_STATE_IDLE] = "idle",
+        [OTA_STATE_DOWNLOADING] = "downloading",
+        [OTA_STATE_VERIFYING] = "verifying",
+        [OTA_STATE_READY] = "ready",
+        [OTA_STATE_FAILED] = "failed",
+        [OTA_STATE_PENDING_VERIFY] = "pending_verify",
+    };
+    return (unsigned)state < sizeof(names) / sizeof(names[0]) ? names[state] : "?";
+}
+
+static void set_state(ota_manager_state_t state, esp_err_t err) {
+    taskENTER_CRITICAL(&stats_mux);
+    stats.state = state;
+    stats.last_err = err;
+    taskEXIT_CRITICAL(&stats_mux);
+}
+
+static uint32_t ms_since(int64_t t_us) {
+    return (uint32_t)((esp_timer_get_time() - t_us) / 1000);
+}
+
+// The partial image is worthless: the next attempt starts from the beginning.
+static void forget_progress(void) {
+    settings_set_int(&ota_settings, OTA_SET_SIZE, 0);
+    settings_set_int(&ota_settings, OTA_SET_WRITTEN, 0);
+}
+
+static esp_err_t fail(esp_err_t err) {
+    ESP_LOGE(TAG, "Update failed at %" PRIu32 " of %" PRIu32 " bytes: %s",
+             written, manifest.size, esp_err_to_name(err));
+    if (err == ESP_ERR_INVALID_CRC || err == ESP_ERR_OTA_VALIDATE_FAILED) {
+        forget_progress();
+    } else {
+        settings_set_int(&ota_settings, OTA_SET_WRITTEN, (int32_t)written);
+    }
+    mbedtls_sha256_free(&sha);
+    set_state(OTA_STATE_FAILED, err);
+    return err;
+}
+
+// An image for another product would only be caught by the health check, after a restart.
+static esp_err_t check_app_desc(void) {
+    esp_app_desc_t desc;
+    esp_err_t err = esp_ota_get_partition_description(slot, &desc);
+    if (err != ESP_OK) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    const esp_app_desc_t *running = esp_app_get_description();
+    if (strncmp(desc.project_name, running->project_name, sizeof(desc.project_name)) != 0) {
+        ESP_LOGE(TAG, "Image is for %.32s, not %.32s", desc.project_name, running->project_name);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    ESP_LOGI(TAG, "Receiving %.32s %.32s", desc.project_name, desc.version);
+    return ESP_OK;
+}
+
+// Hash what an earlier boot already wrote, so the download continues from there.
+static esp_err_t rehash(uint32_t len) {
+    uint8_t *buf = malloc(SECTOR_SIZE);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = ESP_OK;
+    for (uint32_t pos = 0; pos < len && err == ESP_OK; pos += SECTOR_SIZE) {
+        uint32_t n = len - pos < SECTOR_SIZE ? len - pos : SECTOR_SIZE;
+        err = esp_partition_read(slot, pos, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&sha, buf, n);
+        }
+    }
+    free(buf);
+    return err;
+}
+
+static uint32_t resume_offset(void) {
+    uint8_t stored_sha[OTA_MANAGER_SHA256_LEN];
+
+    if (settings_get_int(&ota_settings, OTA_SET_SIZE) != (int32_t)manifest.size ||
+        settings_get_int(&ota_settings, OTA_SET_SLOT) != slot->subtype ||
+        settings_get_blob(&ota_settings, OTA_SET_SHA, stored_sha, sizeof(stored_sha)) != ESP_OK ||
+        memcmp(stored_sha, manifest.sha256, sizeof(stored_sha)) != 0) {
+        return 0;
+    }
+    // The sector holding the checkpoint may have been half rewritten since; it is erased again.
+    uint32_t offset = (uint32_t)settings_get_int(&ota_settings, OTA_SET_WRITTEN) & ~(SECTOR_SIZE - 1);
+    return offset < manifest.size ? offset : manifest.size & ~(SECTOR_SIZE - 1);
+}
+
+static esp_err_t begin_locked(const ota_manifest_t *m, uint32_t *offset) {
+    // Pending: the slot to write is the one to roll back to. Ready: it is the one about to boot.
+    if (stats.state == OTA_STATE_PENDING_VERIFY || stats.state == OTA_STATE_READY ||
+        stats.state == OTA_STATE_VERIFYING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (stats.state == OTA_STATE_DOWNLOADING) {
+        if (m->size != manifest.size || memcmp(m->sha256, manifest.sha256, OTA_MANAGER_SHA256_LEN) != 0) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        // Another transport or a reconnect: carry on from what this boot wrote.
+        *offset = written;
+        return ESP_OK;
+    }
+#if CONFIG_OTA_MANAGER_REQUIRE_SIGNATURE
+    if (m->sig_len == 0) {
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+#endif
+    slot = esp_ota_get_next_update_partition(NULL);
+    if (!slot) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (m->size < APP_DESC_END || m->size > slot->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    manifest = *m;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    written = resume_offset();
+    if (written && (rehash(written) != ESP_OK || (written >= APP_DESC_END && check_app_desc() != ESP_OK))) {
+        mbedtls_sha256_starts(&sha, 0);
+        written = 0;
+    }
+    if (!written) {
+        settings_set_blob(&ota_settings, OTA_SET_SHA, manifest.sha256, OTA_MANAGER_SHA256_LEN);
+        settings_set_int(&ota_settings, OTA_SET_SIZE, (int32_t)manifest.size);
+        settings_set_int(&ota_settings, OTA_SET_SLOT, slot->subtype);
+        settings_set_int(&ota_settings, OTA_SET_WRITTEN, 0);
+    }
+    erased = written;
+    checkpoint = written;
+    started_us = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&stats_mux);
+    stats.state = OTA_STATE_DOWNLOADING;
+    stats.last_err = ESP_OK;
+    stats.image_size = manifest.size;
+    stats.written = written;
+    stats.resumed_at = written;
+    stats.resumes += written ? 1 : 0;
+    stats.rolled_back = false;
+    stats.retries = 0;
+    stats.dropped = 0;
+    stats.patch_size = 0;
+    stats.patch_applied = 0;
+    stats.download_ms = 0;
+    stats.bytes_per_s = 0;
+    stats.verify_ms = 0;
+    taskEXIT_CRITICAL(&stats_mux);
+
+    ESP_LOGI(TAG, "Writing %" PRIu32 " bytes to %s from offset %" PRIu32,
+             manifest.size, slot->label, written);
+    *offset = written;
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_begin(const ota_manifest_t *m, uint32_t *offset) {
+    if (!m || !offset) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(ota_lock, portMAX_DELAY);
+    esp_err_t err = begin_locked(m, offset);
+    xSemaphoreGive(ota_lock);
+    return err;
+}
+
+// Erase up to end, a block at a time once aligned; never past the image.
+static esp_err_t erase_ahead(uint32_t end) {
+    uint32_t limit = (manifest.size + SECTOR_SIZE - 1) & ~(SECTOR_SIZE - 1);
+    while (erased < end) {
+        uint32_t n = ERASE_BLOCK - erased % ERASE_BLOCK;
+        if (n > limit - erased) {
+            n = limit - erased;
+        }
+        esp_err_t err = esp_partition_erase_range(slot, erased, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        erased += n;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t write_locked(uint32_t offset, const uint8_t *data, size_t len) {
+    if (offset > written) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset + len <= written) {
+        return ESP_OK;
+    }
+    data += written - offset;
+    len -= written - offset;
+    if (len > manifest.size - written) {
+        return fail(ESP_ERR_INVALID_SIZE);
+    }
+
+    esp_err_t err = erase_ahead(written + len);
+    if (err == ESP_OK) {
+        err = esp_partition_write(slot, written, data, len);
+    }
+    if (err != ESP_OK) {
+        return fail(err);
+    }
+    mbedtls_sha256_update(&sha, data, len);
+    uint32_t before = written;
+    written += len;
+
+    taskENTER_CRITICAL(&stats_mux);
+    stats.written = written;
+    taskEXIT_CRITICAL(&stats_mux);
+
+    if (before < APP_DESC_END && written >= APP_DESC_END && (err = check_app_desc()) != ESP_OK) {
+        return fail(err);
+    }
+    if (written - checkpoint >= CONFIG_OTA_MANAGER_CHECKPOINT_KB * 1024) {
+        settings_set_int(&ota_settings, OTA_SET_WRITTEN, (int32_t)written);
+        checkpoint = written;
+    }
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_write(uint32_t offset, const void *data, size_t len) {
+    xSemaphoreTake(ota_lock, portMAX_DELAY);
+    esp_err_t err = stats.state == OTA_STATE_DOWNLOADING ? write_locked(offset, data, len)
+                                                         : ESP_ERR_INVALID_STATE;
+    xSemaphoreGive(ota_lock);
+    return err;
+}
+
+static esp_err_t verify_signature(const uint8_t *digest) {
+    if (manifest.sig_len == 0) {
+        ESP_LOGW(TAG, "Image is not signed");
+        return ESP_OK;
+    }
+    // mbedtls wants a terminated string; the xxd array is not.
+    char *pem = malloc(ota_signing_key_pem_len + 1);
+    if (!pem) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(pem, ota_signing_key_pem, ota_signing_key_pem_len);
+    pem[ota_signing_key_pem_len] = '\0';
+
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+    int ret = mbedtls_pk_parse_public_key(&pk, (const unsigned char *)pem, ota_signing_key_pem_len + 1);
+    if (ret == 0) {
+        ret = mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, OTA_MANAGER_SHA256_LEN,
+                                manifest.sig, manifest.sig_len);
+    }
+    mbedtls_pk_free(&pk);
+    free(pem);
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Signature check failed: -0x%04x", -ret);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t finish_locked(void) {
+    if (stats.state != OTA_STATE_DOWNLOADING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (written != manifest.size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t download_ms = ms_since(started_us);
+    int64_t verify_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&stats_mux);
+    stats.state = OTA_STATE_VERIFYING;
+    stats.download_ms = download_ms;
+    stats.bytes_per_s = download_ms ? (uint32_t)((uint64_t)(written - stats.resumed_at) * 1000 / download_ms) : 0;
+    taskEXIT_CRITICAL(&stats_mux);
+
+    uint8_t digest[OTA_MANAGER_SHA256_LEN];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    if (memcmp(digest, manifest.sha256, sizeof(digest)) != 0) {
+        return fail(ESP_ERR_INVALID_CRC);
+    }
+    esp_err_t err = verify_signature(digest);
+    if (err == ESP_OK) {
+        // Runs the same image checks as the bootloader before switching.
+        err = esp_ota_set_boot_partition(slot);
+    }
+    if (err != ESP_OK) {
+        return fail(err == ESP_ERR_NO_MEM ? err : ESP_ERR_OTA_VALIDATE_FAILED);
+    }
+
+    uint32_t verify_ms = ms_since(verify_us);
+    taskENTER_CRITICAL(&stats_mux);
+    stats.state = OTA_STATE_READY;
+    stats.verify_ms = verify_ms;
+    taskEXIT_CRITICAL(&stats_mux);
+
+    settings_set_int(&ota_settings, OTA_SET_WRITTEN, (int32_t)written);
+    settings_set_int(&ota_settings, OTA_SET_SWAP_MS, (int32_t)ms_since(started_us));
+    settings_flush();
+    ESP_LOGI(TAG, "%s ready: %" PRIu32 " bytes in %" PRIu32 " ms (%" PRIu32 " B/s), verified in %" PRIu32 " ms",
+             slot->label, written, download_ms, stats.bytes_per_s, verify_ms);
+    return ESP_OK;
+}
+
+esp_err_t ota_manager_finish(void) {
+    xSemaphoreTake(ota_lock, portMAX_DELAY);
+    esp_err_t err = finish_locked();
+    xSemaphoreGive(ota_lock);
+    return err;
+}
+
+void ota_manager_abort(esp_err_t reason) {
+    xSemaphoreTake(ota_lock, portMAX_DELAY);
+    if (stats.state == OTA_STATE_DOWNLOADING) {
+        ESP_LOGW(TAG, "Stopped at %" PRIu32 " of %" PRIu32 " bytes: %s",
+                 written, manifest.size, esp_err_to_name(reason));
+        settings_set_int(&ota_settings, OTA_SET_WRITTEN, (int32_t)written);
+        mbedtls_sha256_free(&sha);
+        set_state(OTA_STATE_FAILED, reason);
+    }
+    xSemaphoreGive(ota_lock);
+}
+
+void ota_manager_get_stats(ota_manager_stats_t *out) {
+    taskENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    taskEXIT_CRITICAL(&stats_mux);
+}
+
+void ota_manager_note_retry(void) {
+    taskENTER_CRITICAL(&stats_mux);
+    stats.retries++;
+    taskEXIT_CRITICAL(&stats_mux);
+}
+
+void ota_manager_note_dropped(void) {
+    taskENTER_CRITICAL(&stats_mux);
+    stats.dropped++;
+    taskEXIT_CRITICAL(&stats_mux);
+}
+
+void ota_manager_note_patch(uint32_t size, uint32_t applied) {
+    taskENTER_CRITICAL(&stats_mux);
+    stats.patch_size = size;
+    stats.patch_applied = applied;
+    taskEXIT_CRITICAL(&stats_mux);
+}
+
+static void restart_cb(void *arg) {
+    esp_restart();
+}
+
+void ota_manager_restart_soon(void) {
+    const esp_timer_create_args_t args = { .callback = restart_cb, .name = "ota_restart" };
+    if (restart_timer || esp_timer_create(&args, &restart_timer) == ESP_OK) {
+        esp_timer_start_once(restart_timer, RESTART_DELAY_US);
+    }
+}
+
+// --- Post-update health check ---
+
+static void health_task(void *arg) {
+    esp_err_t err = health_cb ? health_cb(CONFIG_OTA_MANAGER_HEALTH_TIMEOUT_S * 1000) : ESP_OK;
+    if (err == ESP_OK) {
+        err = esp_ota_mark_app_valid_cancel_rollback();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "New image failed its health check (%s); rolling back", esp_err_to_name(err));
+        esp_ota_mark_app_invalid_rollback_and_reboot();
+        // Only returns when there is no image to go back to: keep this one.
+        ESP_LOGE(TAG, "No previous image to roll back to");
+        set_state(OTA_STATE_IDLE, err);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    uint32_t health_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint32_t swap_ms = (uint32_t)settings_get_int(&ota_settings, OTA_SET_SWAP_MS) + health_ms;
+    taskENTER_CRITICAL(&stats_mux);
+    stats.state = OTA_STATE_IDLE;
+    stats.health_ms = health_ms;
+    stats.swap_ms = swap_ms;
+    taskEXIT_CRITICAL(&stats_mux);
+    settings_set_int(&ota_settings, OTA_SET_SWAP_MS, 0);
+    forget_progress();
+
+    ESP_LOGI(TAG, "%s confirmed %" PRIu32 " ms after boot; update took %" PRIu32 " ms end to end",
+             esp_ota_get_running_partition()->label, health_ms, swap_ms);
+    vTaskDelete(NULL);
+}
+
+// --- RPC commands ---
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static esp_err_t parse_sha256(const cJSON *hash, uint8_t *out) {
+    if (!cJSON_IsString(hash) || strlen(hash->valuestring) != 2 * OTA_MANAGER_SHA256_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < OTA_MANAGER_SHA256_LEN; i++) {
+        int hi = hex_nibble(hash->valuestring[2 * i]), lo = hex_nibble(hash->valuestring[2 * i + 1]);
+        if (hi < 0 || lo < 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return ESP_OK;
+}
+
+static bool parse_size(const cJSON *size, uint32_t *out) {
+    if (!cJSON_IsNumber(size) || size->valuedouble <= 0 || size->valuedouble > UINT32_MAX) {
+        return false;
+    }
+    *out = (uint32_t)size->valuedouble;
+    return true;
+}
+
+// {"size":N,"sha256":"<64 hex>","sig":"<base64 DER>","patch":{...}}; sig and patch may be missing.
+static esp_err_t parse_manifest(const cJSON *root, ota_manifest_t *m) {
+    const cJSON *sig = cJSON_GetObjectItemCaseSensitive(root, "sig");
+    const cJSON *patch = cJSON_GetObjectItemCaseSensitive(root, "patch");
+
+    memset(m, 0, sizeof(*m));
+    if (!parse_size(cJSON_GetObjectItemCaseSensitive(root, "size"), &m->size) ||
+        parse_sha256(cJSON_GetObjectItemCaseSensitive(root, "sha256"), m->sha256) != ESP_OK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cJSON_IsString(sig) &&
+        mbedtls_base64_decode(m->sig, sizeof(m->sig), &m->sig_len,
+                              (const unsigned char *)sig->valuestring, strlen(sig->valuestring)) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (patch && (!parse_size(cJSON_GetObjectItemCaseSensitive(patch, "size"), &m->patch_size) ||
+                  !parse_size(cJSON_GetObjectItemCaseSensitive(patch, "base_size"), &m->base_size) ||
+                  parse_sha256(cJSON_GetObjectItemCaseSensitive(patch, "base_sha256"), m->base_sha256) != ESP_OK)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+// Shared by "ota.start" and "ota.begin": the manifest plus "restart", true unless given as false.
+static esp_err_t parse_request(const char *params, cJSON **root, ota_manifest_t *m, bool *restart) {
+    *root = cJSON_Parse(params ? params : "");
+    *restart = !cJSON_IsFalse(cJSON_GetObjectItemCaseSensitive(*root, "restart"));
+    return parse_manifest(*root, m);
+}
+
+// RPC "ota.start": download over HTTPS.
+static esp_err_t rpc_ota_start(const char *params, mqtt_rpc_reply_t *reply, void *ctx) {
+    cJSON *root;
+    ota_manifest_t m;
+    bool restart;
+    uint32_t offset = 0;
+
+    esp_err_t err = parse_request(params, &root, &m, &restart);
+    if (err == ESP_OK) {
+        const cJSON *url = cJSON_GetObjectItemCaseSensitive(root, "url");
+        err = cJSON_IsString(url) ? ota_manager_start_https(url->valuestring, &m, restart, &offset)
+                                  : ESP_ERR_INVALID_ARG;
+    }
+    cJSON_Delete(root);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return mqtt_rpc_reply_printf(reply, "{\"offset\":%" PRIu32 "}", offset);
+}
+
+// RPC "ota.begin": receive the image as MQTT chunks.
+static esp_err_t rpc_ota_begin(const char *params, mqtt_rpc_reply_t *reply, void *ctx) {
+    cJSON *root;
+    ota_manifest_t m;
+    bool restart;
+    uint32_t offset = 0;
+
+    esp_err_t err = parse_request(params, &root, &m, &restart);
+    cJSON_Delete(root);
+    if (err == ESP_OK) {
+        err = ota_mqtt_begin(&m, restart, &offset);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    return mqtt_rpc_reply_printf(reply, "{\"offset\":%" PRIu32 ",\"chunk\":%d,\"topic\":\"%s\"}",
+                                 offset, OTA_MQTT_CHUNK_MAX, ota_mqtt_data_topic());
+}
+
+static esp_err_t rpc_ota_status(const char *params, mqtt_rpc_reply_t *reply, void *ctx) {
+    ota_manager_stats_t st;
+    ota_manager_get_stats(&st);
+    const esp_partition_t *running = esp_ota_get_running_partition();
+
+    // In parts that fit the 256 byte limit of mqtt_rpc_reply_printf() at their widest.
+    esp_err_t err = mqtt_rpc_reply_printf(reply,
+        "{\"state\":\"%s\",\"err\":\"%s\",\"running\":\"%.16s\",\"version\":\"%.32s\",",
+        ota_manager_state_name(st.state), esp_err_to_name(st.last_err), running ? running->label : "?",
+        esp_app_get_description()->version);
+    if (err == ESP_OK) {
+        err = mqtt_rpc_reply_printf(reply,
+            "\"size\":%" PRIu32 ",\"written\":%" PRIu32 ",\"resumed_at\":%" PRIu32 ",\"resumes\":%" PRIu32
+            ",\"retries\":%" PRIu32 ",\"dropped\":%" PRIu32 ",\"patch_size\":%" PRIu32 ",\"patch_applied\":%" PRIu32 ",",
+            st.image_size, st.written, st.resumed_at, st.resumes,
+            st.retries, st.dropped, st.patch_size, st.patch_applied);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    return mqtt_rpc_reply_printf(reply,
+        "\"download_ms\":%" PRIu32 ",\"bytes_per_s\":%" PRIu32 ",\"verify_ms\":%" PRIu32
+        ",\"swap_ms\":%" PRIu32 ",\"health_ms\":%" PRIu32 ",\"rolled_back\":%s}",
+        st.download_ms, st.bytes_per_s, st.verify_ms, st.swap_ms, st.health_ms,
+        st.rolled_back ? "true" : "false");
+}
+
+static esp_err_t rpc_ota_abort(const char *params, mqtt_rpc_reply_t *reply, void *ctx) {
+    ota_manager_abort(ESP_ERR_INVALID_STATE);
+    return mqtt_rpc_reply_write(reply, "true", 4);
+}
+
+esp_err_t ota_manager_init(ota_manager_health_cb_t health) {
+    static const struct {
+        const char *method;
+        mqtt_rpc_handler_t handler;
+    } commands[] = {
+        { "ota.start", rpc_ota_start },
+        { "ota.begin", rpc_ota_begin },
+        { "ota.status", rpc_ota_status },
+        { "ota.abort", rpc_ota_abort },
+    };
+
+    // Created here, before the commands that use them exist; init runs once, on one task.
+    if (ota_lock == NULL) {
+        ota_lock = xSemaphoreCreateMutexStatic(&ota_lock_buf);
+        ota_stream_init();
+    }
+    esp_err_t err = nvs_sync_create();
+    if (err == ESP_OK) {
+        err = settings_register(&ota_settings);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "No settings: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // The registry has its own lock, so this may run before or alongside mqtt_rpc_init().
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+        err = mqtt_rpc_register(commands[i].method, commands[i].handler, NULL);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Cannot register %s: %s", commands[i].method, esp_err_to_name(err));
+        }
+    }
+
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *invalid = esp_ota_get_last_invalid_partition();
+    esp_ota_img_states_t state;
+    bool pending = esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY;
+
+    // The slot stays marked invalid until it is written again, so that alone does not mean this
+    // boot is the rollback: swap_ms does, set when an image is switched to and cleared once confirmed.
+    if (invalid && !pending && settings_get_int(&ota_settings, OTA_SET_SWAP_MS) != 0 &&
+        settings_get_int(&ota_settings, OTA_SET_SLOT) == invalid->subtype) {
+        stats.rolled_back = true;
+        // The rejected image is complete in the slot: resuming it would only switch to it again.
+        forget_progress();
+        settings_set_int(&ota_settings, OTA_SET_SWAP_MS, 0);
+        ESP_LOGW(TAG, "Running %s; the image in %s was rejected", running->label, invalid->label);
+    }
+
+    if (pending) {
+        stats.state = OTA_STATE_PENDING_VERIFY;
+        health_cb = health;
+        if (xTaskCreate(health_task, "ota_health", 3072, NULL, 5, NULL) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+        ESP_LOGI(TAG, "New image in %s; confirming within %d s", running->label,
+                 CONFIG_OTA_MANAGER_HEALTH_TIMEOUT_S);
+    }
+    return ESP_OK;
+}
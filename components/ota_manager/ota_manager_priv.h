@@ -0,0 +1,54 @@
+/**
+ * File: ota_manager_priv.h
+ * Description: Internal hooks shared between ota_manager source files.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.10.2
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#ifndef OTA_MANAGER_PRIV_H_INCLUDED
+#define OTA_MANAGER_PRIV_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ota_manager.h"
+
+/** Image payload per MQTT chunk; the 4 byte offset and the topic share the esp-mqtt buffer. */
+#define OTA_MQTT_HEADER_LEN 4
+#define OTA_MQTT_CHUNK_MAX  (CONFIG_MQTT_BUFFER_SIZE - OTA_MQTT_HEADER_LEN - 96)
+
+/**
+ * The transports deliver a stream: the image itself, or for a manifest with a
+ * patch_size the patch, which ota_delta.c applies against the running image.
+ * Offsets are stream offsets; the calls behave as ota_manager_begin() and
+ * ota_manager_write() do for the image.
+ */
+/** Creates the stream lock; ota_manager_init() calls it once, before any transport runs. */
+void ota_stream_init(void);
+esp_err_t ota_stream_begin(const ota_manifest_t *manifest, uint32_t *offset);
+esp_err_t ota_stream_write(uint32_t offset, const void *data, size_t len);
+
+/** Next stream byte wanted. */
+uint32_t ota_stream_position(void);
+
+static inline uint32_t ota_stream_size(const ota_manifest_t *manifest) {
+    return manifest->patch_size ? manifest->patch_size : manifest->size;
+}
+
+/** ota_stream_begin() for the MQTT chunk transport: subscribes on first use. */
+esp_err_t ota_mqtt_begin(const ota_manifest_t *manifest, bool restart, uint32_t *offset);
+
+/** Topic the chunks are expected on. */
+const char *ota_mqtt_data_topic(void);
+
+/** Restart into the new image a moment from now, so pending replies still go out. */
+void ota_manager_restart_soon(void);
+
+/** Counters kept by the transports, reported in ota_manager_stats_t. */
+void ota_manager_note_retry(void);
+void ota_manager_note_dropped(void);
+void ota_manager_note_patch(uint32_t size, uint32_t applied);
+
+#endif /* OTA_MANAGER_PRIV_H_INCLUDED */
@@ -0,0 +1,120 @@
+/*
+ * File: components/ota_manager/ota_mqtt.c
+ * Description: MQTT transport for ota_manager: image (or patch) chunks arrive on
+ *              <prefix>/<device_id>/ota/data and are acknowledged with the next
+ *              offset wanted on <prefix>/<device_id>/ota/ack.
+ *
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ *
+ * Version: v8.10.1
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "ota_manager.h"
+#include "ota_manager_priv.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "mqtt_manager.h"
+
+static const char *TAG = "OTA_MQTT";
+
+#define OTA_TOPIC_MAX 64
+
+typedef struct {
+    uint32_t offset;
+    uint16_t len;
+    uint8_t data[OTA_MQTT_CHUNK_MAX];
+} ota_chunk_t;
+
+static QueueHandle_t chunks = NULL;
+static volatile bool restart_after = false;
+static char data_topic[OTA_TOPIC_MAX];
+static char ack_topic[OTA_TOPIC_MAX];
+// Staging copy for the queue; MQTT callbacks all run on the one MQTT task.
+static ota_chunk_t incoming;
+
+const char *ota_mqtt_data_topic(void) {
+    return data_topic;
+}
+
+// Runs on the MQTT task, which must not block: flash writes happen on chunk_task.
+static void on_chunk(const char *topic, const char *data, int len, void *ctx) {
+    if (len <= OTA_MQTT_HEADER_LEN || len - OTA_MQTT_HEADER_LEN > OTA_MQTT_CHUNK_MAX) {
+        ESP_LOGW(TAG, "Ignoring a %d byte chunk", len);
+        return;
+    }
+    const uint8_t *p = (const uint8_t *)data;
+    incoming.offset = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    incoming.len = (uint16_t)(len - OTA_MQTT_HEADER_LEN);
+    memcpy(incoming.data, p + OTA_MQTT_HEADER_LEN, incoming.len);
+    if (xQueueSend(chunks, &incoming, 0) != pdTRUE) {
+        // The ack for the next chunk that does get in shows the sender where to go back to.
+        ota_manager_note_dropped();
+    }
+}
+
+static void ack(uint32_t offset, esp_err_t err, ota_manager_state_t state) {
+    char msg[96];
+    int n = snprintf(msg, sizeof(msg), "{\"offset\":%" PRIu32 ",\"state\":\"%s\",\"err\":\"%s\"}",
+                     offset, ota_manager_state_name(state), esp_err_to_name(err));
+    mqtt_manager_publish(ack_topic, msg, n, 0);
+}
+
+static void chunk_task(void *arg) {
+    static ota_chunk_t chunk;
+    ota_manager_stats_t st;
+
+    for (;;) {
+        xQueueReceive(chunks, &chunk, portMAX_DELAY);
+        esp_err_t err = ota_stream_write(chunk.offset, chunk.data, chunk.len);
+        ota_manager_get_stats(&st);
+        if (err == ESP_ERR_INVALID_ARG) {
+            // A gap: not an error, the ack asks for the missing offset.
+            err = ESP_OK;
+        }
+        if (err == ESP_OK && st.state == OTA_STATE_DOWNLOADING && st.written == st.image_size) {
+            err = ota_manager_finish();
+            ota_manager_get_stats(&st);
+            if (err == ESP_OK && restart_after) {
+                ota_manager_restart_soon();
+            }
+        }
+        ack(ota_stream_position(), err, st.state);
+    }
+}
+
+esp_err_t ota_mqtt_begin(const ota_manifest_t *manifest, bool restart, uint32_t *offset) {
+    static bool subscribed = false;
+
+    if (!chunks) {
+        chunks = xQueueCreate(CONFIG_OTA_MANAGER_MQTT_QUEUE, sizeof(ota_chunk_t));
+        if (!chunks) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(chunk_task, "ota_mqtt", 3072, NULL, 5, NULL) != pdPASS) {
+            vQueueDelete(chunks);
+            chunks = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!subscribed) {
+        const char *id = mqtt_manager_device_id();
+        snprintf(data_topic, sizeof(data_topic), "%s/%s/ota/data", CONFIG_MQTT_RPC_TOPIC_PREFIX, id);
+        snprintf(ack_topic, sizeof(ack_topic), "%s/%s/ota/ack", CONFIG_MQTT_RPC_TOPIC_PREFIX, id);
+        esp_err_t err = mqtt_manager_subscribe(data_topic, 1, on_chunk, NULL);
+        if (err != ESP_OK) {
+            return err;
+        }
+        subscribed = true;
+        ESP_LOGI(TAG, "Chunks on %s, acks on %s", data_topic, ack_topic);
+    }
+    restart_after = restart;
+    return ota_stream_begin(manifest, offset);
+}
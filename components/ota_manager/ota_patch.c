@@ -0,0 +1,235 @@
+/**
+ * File: ota_patch.c
+ * Description: Streaming applier for delta update patches: rebuilds the new image
+ *              from the running one and a compressed diff, in fixed RAM.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.10.1
+ * Author: R. Andrew Ballard (c) 2025
+ */
+
+#include "ota_patch.h"
+#include <string.h>
+
+// heatshrink limits, as in the reference decoder.
+#define WINDOW_BITS_MIN    4
+#define WINDOW_BITS_MAX    15
+#define LOOKAHEAD_BITS_MIN 3
+
+enum { HS_TAG, HS_LITERAL, HS_INDEX, HS_COUNT };
+enum { REC_DIFF_LEN, REC_EXTRA_LEN, REC_SEEK, REC_DIFF, REC_EXTRA };
+
+static uint32_t rd32(const uint8_t *b) {
+    return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+static ota_patch_err_t set_err(ota_patch_t *p, ota_patch_err_t err) {
+    if (p->err == OTA_PATCH_OK) {
+        p->err = err;
+    }
+    return p->err;
+}
+
+void ota_patch_init(ota_patch_t *p, uint8_t *window, uint8_t window_bits_max, uint32_t out_from,
+                    ota_patch_read_t read, ota_patch_write_t write, void *ctx) {
+    memset(p, 0, sizeof(*p));
+    p->window = window;
+    p->window_bits_max = window_bits_max;
+    p->out_from = out_from;
+    p->read = read;
+    p->write = write;
+    p->ctx = ctx;
+}
+
+bool ota_patch_done(const ota_patch_t *p) {
+    return p->err == OTA_PATCH_OK && p->header_len == OTA_PATCH_HEADER_LEN &&
+           p->out_pos == p->target_size && p->phase == REC_DIFF_LEN && p->shift == 0;
+}
+
+static ota_patch_err_t parse_header(ota_patch_t *p) {
+    const uint8_t *h = p->header;
+    if (memcmp(h, OTA_PATCH_MAGIC, 4) != 0 || h[6] != 0 || h[7] != 0) {
+        return set_err(p, OTA_PATCH_ERR_FORMAT);
+    }
+    p->window_bits = h[4];
+    p->lookahead_bits = h[5];
+    p->target_size = rd32(h + 8);
+    p->base_size = rd32(h + 12);
+    if (p->window_bits < WINDOW_BITS_MIN || p->window_bits > WINDOW_BITS_MAX ||
+        p->lookahead_bits < LOOKAHEAD_BITS_MIN || p->lookahead_bits >= p->window_bits) {
+        return set_err(p, OTA_PATCH_ERR_FORMAT);
+    }
+    if (p->window_bits > p->window_bits_max) {
+        return set_err(p, OTA_PATCH_ERR_WINDOW);
+    }
+    // A backref to before the first byte reads zeros, as with the reference decoder.
+    memset(p->window, 0, 1u << p->window_bits);
+    return OTA_PATCH_OK;
+}
+
+static ota_patch_err_t flush(ota_patch_t *p) {
+    if (p->out_len) {
+        int err = p->write(p->ctx, p->out_pos - p->out_len, p->out, p->out_len);
+        p->out_len = 0;
+        if (err) {
+            p->io_err = err;
+            return set_err(p, OTA_PATCH_ERR_IO);
+        }
+    }
+    return OTA_PATCH_OK;
+}
+
+static ota_patch_err_t put(ota_patch_t *p, uint8_t c) {
+    if (p->out_pos >= p->out_from) {
+        p->out[p->out_len++] = c;
+    }
+    p->out_pos++;
+    return p->out_len == sizeof(p->out) ? flush(p) : OTA_PATCH_OK;
+}
+
+// Base bytes for the next stretch of a diff run; nothing is read for output that is skipped.
+static ota_patch_err_t fill_base(ota_patch_t *p) {
+    uint32_t n = p->diff_left < sizeof(p->base) ? p->diff_left : sizeof(p->base);
+    uint32_t at = p->base_pos;
+    p->base_len = (uint16_t)n;
+    p->base_idx = 0;
+    p->base_pos += n;
+    if (p->out_pos + n <= p->out_from) {
+        return OTA_PATCH_OK;
+    }
+    int err = p->read(p->ctx, at, p->base, n);
+    if (err) {
+        p->io_err = err;
+        return set_err(p, OTA_PATCH_ERR_IO);
+    }
+    return OTA_PATCH_OK;
+}
+
+// A record header is complete: check it against the base and the target before using it.
+static ota_patch_err_t start_record(ota_patch_t *p, int64_t seek) {
+    uint64_t out_end = (uint64_t)p->out_pos + p->diff_left + p->extra_left;
+    int64_t base_next = (int64_t)p->base_pos + p->diff_left + seek;
+    if (out_end > p->target_size || (uint64_t)p->base_pos + p->diff_left > p->base_size ||
+        base_next < 0 || base_next > (int64_t)p->base_size) {
+        return set_err(p, OTA_PATCH_ERR_RANGE);
+    }
+    p->phase = p->diff_left ? REC_DIFF : p->extra_left ? REC_EXTRA : REC_DIFF_LEN;
+    p->base_idx = p->base_len = 0;
+    // The seek applies once the diff run has been read.
+    p->base_next = (uint32_t)base_next;
+    if (!p->diff_left) {
+        p->base_pos = p->base_next;
+    }
+    return OTA_PATCH_OK;
+}
+
+// One decompressed byte of the record stream.
+static ota_patch_err_t record_byte(ota_patch_t *p, uint8_t c) {
+    switch (p->phase) {
+    case REC_DIFF:
+        if (p->base_idx == p->base_len && fill_base(p) != OTA_PATCH_OK) {
+            return p->err;
+        }
+        c = (uint8_t)(c + p->base[p->base_idx++]);
+        if (--p->diff_left == 0) {
+            p->base_pos = p->base_next;
+            p->phase = p->extra_left ? REC_EXTRA : REC_DIFF_LEN;
+        }
+        return put(p, c);
+    case REC_EXTRA:
+        if (--p->extra_left == 0) {
+            p->phase = REC_DIFF_LEN;
+        }
+        return put(p, c);
+    default:
+        break;
+    }
+
+    // LEB128, at most 32 bits.
+    if (p->shift > 28 || (p->shift == 28 && (c & 0x70))) {
+        return set_err(p, OTA_PATCH_ERR_FORMAT);
+    }
+    if (p->phase == REC_DIFF_LEN && p->shift == 0 && p->out_pos == p->target_size) {
+        // Anything past the last record.
+        return set_err(p, OTA_PATCH_ERR_RANGE);
+    }
+    p->varint |= (uint32_t)(c & 0x7f) << p->shift;
+    if (c & 0x80) {
+        p->shift += 7;
+        return OTA_PATCH_OK;
+    }
+    uint32_t v = p->varint;
+    p->varint = 0;
+    p->shift = 0;
+    switch (p->phase) {
+    case REC_DIFF_LEN:
+        p->diff_left = v;
+        p->phase = REC_EXTRA_LEN;
+        return OTA_PATCH_OK;
+    case REC_EXTRA_LEN:
+        p->extra_left = v;
+        p->phase = REC_SEEK;
+        return OTA_PATCH_OK;
+    default:
+        return start_record(p, (v & 1) ? -(int64_t)(v >> 1) - 1 : (int64_t)(v >> 1));
+    }
+}
+
+static ota_patch_err_t emit(ota_patch_t *p, uint8_t c) {
+    p->window[p->head] = c;
+    p->head = (uint16_t)((p->head + 1) & ((1u << p->window_bits) - 1));
+    return record_byte(p, c);
+}
+
+ota_patch_err_t ota_patch_feed(ota_patch_t *p, const void *data, size_t len) {
+    const uint8_t *in = data;
+    const uint8_t *end = in + len;
+
+    while (p->err == OTA_PATCH_OK && p->header_len < OTA_PATCH_HEADER_LEN && in < end) {
+        p->header[p->header_len++] = *in++;
+        if (p->header_len == OTA_PATCH_HEADER_LEN) {
+            parse_header(p);
+        }
+    }
+
+    const uint32_t mask = (1u << p->window_bits) - 1;
+    while (p->err == OTA_PATCH_OK && in < end) {
+        p->bits = p->bits << 8 | *in++;
+        p->nbits += 8;
+        for (;;) {
+            uint8_t need = p->hs_state == HS_TAG ? 1 : p->hs_state == HS_LITERAL ? 8
+                         : p->hs_state == HS_INDEX ? p->window_bits : p->lookahead_bits;
+            if (p->nbits < need || p->err != OTA_PATCH_OK) {
+                break;
+            }
+            p->nbits -= need;
+            uint32_t v = (p->bits >> p->nbits) & ((1u << need) - 1);
+
+            switch (p->hs_state) {
+            case HS_TAG:
+                p->hs_state = v ? HS_LITERAL : HS_INDEX;
+                break;
+            case HS_LITERAL:
+                emit(p, (uint8_t)v);
+                p->hs_state = HS_TAG;
+                break;
+            case HS_INDEX:
+                p->hs_index = (uint16_t)v;
+                p->hs_state = HS_COUNT;
+                break;
+            default:
+                // Copy count + 1 bytes from index + 1 back; the source may overlap what is being written.
+                for (uint32_t i = 0; i <= v && p->err == OTA_PATCH_OK; i++) {
+                    emit(p, p->window[(p->head - p->hs_index - 1) & mask]);
+                }
+                p->hs_state = HS_TAG;
+                break;
+            }
+        }
+    }
+
+    if (p->err == OTA_PATCH_OK) {
+        flush(p);
+    }
+    return p->err;
+}
@@ -0,0 +1,122 @@
+/**
+ * File: ota_patch.h
+ * Description: Streaming applier for delta update patches: rebuilds the new image
+ *              from the running one and a compressed diff, in fixed RAM.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.10.1
+ * Author: R. Andrew Ballard (c) 2025
+ *
+ * Patch layout (tools/ota_delta.py writes it):
+ *
+ *   "OTD1"  window_bits  lookahead_bits  0  0  target_size(u32 LE)  base_size(u32 LE)
+ *
+ * followed by a heatshrink stream with those parameters. Decompressed, it is a
+ * list of bsdiff style records:
+ *
+ *   diff_len, extra_len (LEB128), seek (zigzag LEB128)
+ *   diff_len bytes added, byte by byte, to the base starting at the base cursor
+ *   extra_len bytes copied as they are
+ *   the base cursor moves by diff_len + seek
+ *
+ * Code that moved keeps its bytes, so diff runs are mostly zeros with a few
+ * changed addresses in between, which is what the compression feeds on.
+ *
+ * Nothing here depends on ESP-IDF: the base is read and the output written
+ * through callbacks, so host/delta_roundtrip builds this file unchanged.
+ */
+
+#ifndef OTA_PATCH_H_INCLUDED
+#define OTA_PATCH_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OTA_PATCH_MAGIC      "OTD1"
+#define OTA_PATCH_HEADER_LEN 16
+#define OTA_PATCH_BUF        256
+
+typedef enum {
+    OTA_PATCH_OK = 0,
+    OTA_PATCH_ERR_FORMAT = -1,     // bad header or record
+    OTA_PATCH_ERR_WINDOW = -2,     // compression window larger than the caller allows
+    OTA_PATCH_ERR_RANGE = -3,      // a record reads outside the base or writes past the target
+    OTA_PATCH_ERR_IO = -4,         // a callback failed; its code is in io_err
+} ota_patch_err_t;
+
+/** Read len base bytes at offset. @return 0 on success. */
+typedef int (*ota_patch_read_t)(void *ctx, uint32_t offset, void *buf, size_t len);
+/** Take len output bytes at offset; offsets only ever grow. @return 0 on success. */
+typedef int (*ota_patch_write_t)(void *ctx, uint32_t offset, const void *data, size_t len);
+
+typedef struct {
+    ota_patch_read_t read;
+    ota_patch_write_t write;
+    void *ctx;
+    uint8_t *window;                // 1 << window_bits bytes, from the caller
+    uint8_t window_bits_max;
+
+    uint8_t header[OTA_PATCH_HEADER_LEN];
+    uint8_t header_len;
+    uint8_t window_bits;
+    uint8_t lookahead_bits;
+    uint32_t target_size;
+    uint32_t base_size;
+
+    // heatshrink decoder
+    uint32_t bits;                  // pending input bits, the last nbits of them valid
+    uint8_t nbits;
+    uint8_t hs_state;
+    uint16_t hs_index;
+    uint16_t head;                  // next window slot
+
+    // record parser
+    uint8_t phase;
+    uint8_t shift;
+    uint32_t varint;
+    uint32_t diff_left;
+    uint32_t extra_left;
+    uint32_t base_pos;              // next base byte to read
+    uint32_t base_next;             // base cursor once the current diff run is done
+    uint32_t out_pos;               // output bytes produced, written or skipped
+    uint32_t out_from;              // output below this is already in place: not read or written
+
+    uint8_t base[OTA_PATCH_BUF];
+    uint16_t base_len;
+    uint16_t base_idx;
+    uint8_t out[OTA_PATCH_BUF];
+    uint16_t out_len;
+
+    int io_err;
+    ota_patch_err_t err;            // sticky
+} ota_patch_t;
+
+/**
+ * @brief Prepare p for a patch.
+ * @param window Decompression window of 1 << window_bits_max bytes.
+ * @param out_from Output bytes below this are skipped: a resumed update replays
+ *        the patch from its start without re-reading or re-writing them.
+ */
+void ota_patch_init(ota_patch_t *p, uint8_t *window, uint8_t window_bits_max, uint32_t out_from,
+                    ota_patch_read_t read, ota_patch_write_t write, void *ctx);
+
+/**
+ * @brief Apply the next len patch bytes. The output they complete is handed to
+ *        the write callback before returning.
+ * @return OTA_PATCH_OK or the first error, which sticks.
+ */
+ota_patch_err_t ota_patch_feed(ota_patch_t *p, const void *data, size_t len);
+
+/** @brief True once the whole target has been produced. */
+bool ota_patch_done(const ota_patch_t *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OTA_PATCH_H_INCLUDED */
@@ -0,0 +1,379 @@
+#!/usr/bin/env python3
+#
+#  ota_delta.py
+#
+#  Created on: 2026-10-19
+#  Edited on: 2026-10-19
+#      Author: Andwardo
+#      Version: v8.10.1
+#
+#  Delta patches for ota_manager, in the format ota_patch.h describes. Python
+#  standard library only.
+#
+#    ota_delta.py diff old.bin new.bin -o new.patch [--window 11] [--lookahead 10]
+#        Makes a patch that turns old.bin (the image the devices run) into
+#        new.bin. Prints its size and the "patch" object for the manifest;
+#        ota_sign.py manifest new.bin --base old.bin --patch new.patch adds it.
+#
+#    ota_delta.py apply old.bin new.patch -o out.bin
+#        Applies a patch the way the firmware does, to check one by hand.
+#
+#  The window decides the decoder's RAM on the device (1 << window bytes), and
+#  must not exceed CONFIG_OTA_MANAGER_DELTA_WINDOW_BITS.
+#
+
+import argparse
+import hashlib
+import json
+import struct
+import sys
+import time
+
+MAGIC = b"OTD1"
+HEADER = struct.Struct("<4sBBxxII")
+
+# Base index: a KEY byte string at every STEP-th base offset. A match of at
+# least KEY + STEP - 1 bytes is always found at one of its alignments.
+KEY = 8
+STEP = 4
+CANDIDATES = 8
+# A match elsewhere must beat the current alignment by this much to start a new record.
+SWITCH_MARGIN = 8
+
+
+# --- Record stream ---
+
+def _varint(out, v):
+    while v >= 0x80:
+        out.append(v & 0x7F | 0x80)
+        v >>= 7
+    out.append(v)
+
+
+def _match_len(a, i, b, j):
+    n = min(len(a) - i, len(b) - j)
+    k = 0
+    while k + 64 <= n and a[i + k:i + k + 64] == b[j + k:j + k + 64]:
+        k += 64
+    while k < n and a[i + k] == b[j + k]:
+        k += 1
+    return k
+
+
+class _Index:
+    def __init__(self, old):
+        self.old = old
+        self.keys = {}
+        for p in range(0, len(old) - KEY + 1, STEP):
+            lst = self.keys.setdefault(old[p:p + KEY], [])
+            if len(lst) < CANDIDATES:
+                lst.append(p)
+
+    # Longest exact match for new[scan:], the current alignment first so that it wins ties.
+    def search(self, new, scan, offset):
+        old = self.old
+        best_len, best_pos = 0, 0
+        p = scan + offset
+        if 0 <= p < len(old):
+            best_len, best_pos = _match_len(old, p, new, scan), p
+        for p in self.keys.get(new[scan:scan + KEY], ()):
+            n = _match_len(old, p, new, scan)
+            if n > best_len:
+                best_len, best_pos = n, p
+        return best_len, best_pos
+
+
+def records(old, new):
+    """bsdiff's greedy pass, with a sampled hash index in place of a suffix array.
+
+    Yields (diff, extra, seek): diff is new minus old byte by byte over a run
+    where the two mostly agree, extra is new bytes with no counterpart.
+    """
+    index = _Index(old)
+    o, n = len(old), len(new)
+    scan = length = pos = 0
+    lastscan = lastpos = lastoffset = 0
+
+    while scan < n:
+        oldscore = 0
+        scan += length
+        scsc = scan
+        while scan < n:
+            length, pos = index.search(new, scan, lastoffset)
+            while scsc < scan + length:
+                if scsc + lastoffset < o and old[scsc + lastoffset] == new[scsc]:
+                    oldscore += 1
+                scsc += 1
+            if (length == oldscore and length) or length > oldscore + SWITCH_MARGIN:
+                break
+            if scan + lastoffset < o and old[scan + lastoffset] == new[scan]:
+                oldscore -= 1
+            scan += 1
+
+        if length == oldscore and scan != n:
+            continue
+
+        # Grow the previous run forwards and this one backwards while at least half agrees.
+        s = best = lenf = 0
+        i = 0
+        while lastscan + i < scan and lastpos + i < o:
+            if old[lastpos + i] == new[lastscan + i]:
+                s += 1
+            i += 1
+            if s * 2 - i > best * 2 - lenf:
+                best, lenf = s, i
+
+        lenb = 0
+        if scan < n:
+            s = best = 0
+            i = 1
+            while scan >= lastscan + i and pos >= i:
+                if old[pos - i] == new[scan - i]:
+                    s += 1
+                if s * 2 - i > best * 2 - lenb:
+                    best, lenb = s, i
+                i += 1
+
+        if lastscan + lenf > scan - lenb:
+            overlap = lastscan + lenf - (scan - lenb)
+            s = best = lens = 0
+            for i in range(overlap):
+                if new[lastscan + lenf - overlap + i] == old[lastpos + lenf - overlap + i]:
+                    s += 1
+                if new[scan - lenb + i] == old[pos - lenb + i]:
+                    s -= 1
+                if s > best:
+                    best, lens = s, i + 1
+            lenf += lens - overlap
+            lenb -= lens
+
+        a, b = new[lastscan:lastscan + lenf], old[lastpos:lastpos + lenf]
+        diff = bytes((x - y) & 0xFF for x, y in zip(a, b))
+        extra = new[lastscan + lenf:scan - lenb]
+        seek = (pos - lenb) - (lastpos + lenf) if scan < n else 0
+        if diff or extra or seek:
+            yield diff, extra, seek
+
+        lastscan, lastpos, lastoffset = scan - lenb, pos - lenb, pos - scan
+
+
+def encode_records(recs):
+    out = bytearray()
+    for diff, extra, seek in recs:
+        _varint(out, len(diff))
+        _varint(out, len(extra))
+        _varint(out, seek << 1 if seek >= 0 else (-seek - 1) << 1 | 1)
+        out += diff
+        out += extra
+    return bytes(out)
+
+
+# --- heatshrink ---
+
+class _Bits:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def put(self, value, count):
+        self.acc = self.acc << count | value
+        self.n += count
+        while self.n >= 8:
+            self.n -= 8
+            self.out.append(self.acc >> self.n & 0xFF)
+        self.acc &= (1 << self.n) - 1
+
+    def finish(self):
+        if self.n:
+            self.put(0, 8 - self.n)
+        return bytes(self.out)
+
+
+def hs_compress(data, window_bits, lookahead_bits, chain=32):
+    """Greedy LZSS in heatshrink's bitstream: 1 + byte, or 0 + (distance - 1) + (length - 1)."""
+    window = 1 << window_bits
+    longest = 1 << lookahead_bits
+    # A backref must be cheaper than the literals it replaces.
+    shortest = (1 + window_bits + lookahead_bits) // 9 + 1
+    bits = _Bits()
+    head = {}
+    prev = [0] * len(data)
+    n = len(data)
+    pos = 0
+
+    def insert(p):
+        key = data[p:p + 3]
+        prev[p] = head.get(key, -1)
+        head[key] = p
+
+    while pos < n:
+        best_len, best_dist = 0, 0
+        limit = min(longest, n - pos)
+        if limit >= shortest:
+            cand = head.get(data[pos:pos + 3], -1)
+            tries = chain
+            while cand >= 0 and pos - cand <= window and tries:
+                if data[cand + best_len:cand + best_len + 1] == data[pos + best_len:pos + best_len + 1]:
+                    # Longest common prefix by halving; slices compare in C.
+                    lo, hi = 0, limit
+                    while lo < hi:
+                        mid = (lo + hi + 1) // 2
+                        if data[cand:cand + mid] == data[pos:pos + mid]:
+                            lo = mid
+                        else:
+                            hi = mid - 1
+                    if lo > best_len:
+                        best_len, best_dist = lo, pos - cand
+                        if lo == limit:
+                            break
+                cand = prev[cand]
+                tries -= 1
+        if best_len >= shortest:
+            bits.put(best_dist - 1, 1 + window_bits)
+            bits.put(best_len - 1, lookahead_bits)
+        else:
+            best_len = 1
+            bits.put(0x100 | data[pos], 9)
+        for p in range(pos, pos + best_len):
+            insert(p)
+        pos += best_len
+    return bits.finish()
+
+
+def hs_decompress(data, window_bits, lookahead_bits):
+    out = bytearray()
+    acc = nbits = 0
+    it = iter(data)
+
+    def take(count):
+        nonlocal acc, nbits
+        while nbits < count:
+            b = next(it, None)
+            if b is None:
+                return None
+            acc = acc << 8 | b
+            nbits += 8
+        nbits -= count
+        v = acc >> nbits & ((1 << count) - 1)
+        acc &= (1 << nbits) - 1
+        return v
+
+    while True:
+        tag = take(1)
+        if tag is None:
+            break
+        if tag:
+            v = take(8)
+            if v is None:
+                break
+            out.append(v)
+            continue
+        index = take(window_bits)
+        count = take(lookahead_bits) if index is not None else None
+        if count is None:
+            break
+        for _ in range(count + 1):
+            src = len(out) - index - 1
+            out.append(out[src] if src >= 0 else 0)
+    return bytes(out)
+
+
+# --- Patches ---
+
+def make_patch(old, new, window_bits=11, lookahead_bits=10):
+    stream = encode_records(records(old, new))
+    body = hs_compress(stream, window_bits, lookahead_bits)
+    return HEADER.pack(MAGIC, window_bits, lookahead_bits, len(new), len(old)) + body
+
+
+def apply_patch(old, patch):
+    magic, window_bits, lookahead_bits, target_size, base_size = HEADER.unpack_from(patch)
+    if magic != MAGIC:
+        raise ValueError("not a patch")
+    if base_size != len(old):
+        raise ValueError("patch is for a %d byte base, not %d" % (base_size, len(old)))
+    stream = hs_decompress(patch[HEADER.size:], window_bits, lookahead_bits)
+    out = bytearray()
+    pos = i = 0
+
+    def varint():
+        nonlocal i
+        v = shift = 0
+        while True:
+            b = stream[i]
+            i += 1
+            v |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return v
+
+    while len(out) < target_size:
+        dlen, elen, z = varint(), varint(), varint()
+        seek = -(z >> 1) - 1 if z & 1 else z >> 1
+        out += bytes((d + b) & 0xFF for d, b in zip(stream[i:i + dlen], old[pos:pos + dlen]))
+        i += dlen
+        out += stream[i:i + elen]
+        i += elen
+        pos += dlen + seek
+    if len(out) != target_size:
+        raise ValueError("patch overruns the target")
+    return bytes(out)
+
+
+def patch_info(old, patch):
+    return {"size": len(patch), "base_size": len(old), "base_sha256": hashlib.sha256(old).hexdigest()}
+
+
+def diff_cmd(args):
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.new, "rb") as f:
+        new = f.read()
+    t = time.time()
+    patch = make_patch(old, new, args.window, args.lookahead)
+    with open(args.output, "wb") as f:
+        f.write(patch)
+    print("%s: %d bytes for a %d byte image (%.1f%%, %.1fx smaller) in %.1f s"
+          % (args.output, len(patch), len(new), 100.0 * len(patch) / len(new),
+             len(new) / len(patch), time.time() - t), file=sys.stderr)
+    print(json.dumps({"patch": patch_info(old, patch)}))
+
+
+def apply_cmd(args):
+    with open(args.old, "rb") as f:
+        old = f.read()
+    with open(args.patch, "rb") as f:
+        patch = f.read()
+    out = apply_patch(old, patch)
+    with open(args.output, "wb") as f:
+        f.write(out)
+    print("%s: %d bytes, sha256 %s" % (args.output, len(out), hashlib.sha256(out).hexdigest()))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Delta patches for ota_manager updates")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    d = sub.add_parser("diff", help="make a patch from the running image to a new one")
+    d.add_argument("old")
+    d.add_argument("new")
+    d.add_argument("-o", "--output", required=True)
+    d.add_argument("--window", type=int, default=11, choices=range(4, 16), metavar="4..15")
+    d.add_argument("--lookahead", type=int, default=10, choices=range(3, 15), metavar="3..14")
+    d.set_defaults(fn=diff_cmd)
+
+    a = sub.add_parser("apply", help="apply a patch")
+    a.add_argument("old")
+    a.add_argument("patch")
+    a.add_argument("-o", "--output", required=True)
+    a.set_defaults(fn=apply_cmd)
+
+    args = ap.parse_args()
+    if args.cmd == "diff" and args.lookahead >= args.window:
+        ap.error("--lookahead must be smaller than --window")
+    args.fn(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+#
+#  ota_sign.py
+#
+#  Created on: 2026-10-19
+#  Edited on: 2026-10-19
+#      Author: Andwardo
+#      Version: v8.10.2
+#
+#  Signing side of ota_manager. Needs the openssl command line tool only.
+#
+#    ota_sign.py keygen KEY.pem [--header include/ota_signing_key.h]
+#        Creates an ECDSA P-256 signing key and writes its public half as the
+#        header the firmware embeds (xxd -i style, static const). Keep KEY.pem
+#        off the build hosts.
+#
+#    ota_sign.py manifest build/app.bin --key KEY.pem [--url https://...] [--no-restart]
+#                         [--base old.bin --patch app.patch]
+#        Prints the manifest for the image: size, SHA-256 and the signature of
+#        that SHA-256, ready to be used as the params of the ota.start RPC (with
+#        --url) or ota.begin (without). With --base and --patch (made by
+#        ota_delta.py from old.bin, the image the devices run) the url or the
+#        chunks carry the patch instead of the image.
+#
+
+import argparse
+import base64
+import datetime
+import hashlib
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+from ota_delta import patch_info
+
+VERSION = "v8.10.2"
+
+
+def openssl(*args, data=None):
+    return subprocess.run(("openssl",) + args, input=data, stdout=subprocess.PIPE, check=True).stdout
+
+
+KEY_HEADER = """/*
+ * File: components/ota_manager/include/ota_signing_key.h
+ * Description: Public half of the key ota_manager checks image signatures
+ *              with: the PEM text as bytes, not terminated. Written by
+ *              tools/ota_sign.py keygen; only ota_manager.c includes it.
+ *
+ * Created on: {date}
+ * Edited on:  {date}
+ *
+ * Version: {version}
+ *
+ * Author: R. Andrew Ballard (c) 2025
+ */
+#ifndef OTA_SIGNING_KEY_H
+#define OTA_SIGNING_KEY_H
+
+"""
+
+
+# xxd -i output, made static const so the key stays in flash and private to its includer.
+def xxd_header(name, data):
+    lines = [KEY_HEADER.format(date=datetime.date.today().isoformat(), version=VERSION)
+             + "static const unsigned char %s[] = {" % name]
+    for i in range(0, len(data), 12):
+        chunk = ", ".join("0x%02x" % b for b in data[i:i + 12])
+        lines.append("  " + chunk + ("," if i + 12 < len(data) else ""))
+    lines.append("};")
+    lines.append("static const unsigned int %s_len = %d;" % (name, len(data)))
+    lines.append("")
+    lines.append("#endif // OTA_SIGNING_KEY_H")
+    return "\n".join(lines) + "\n"
+
+
+def keygen(args):
+    if os.path.exists(args.key):
+        sys.exit("%s exists; not overwriting a signing key" % args.key)
+    openssl("ecparam", "-name", "prime256v1", "-genkey", "-noout", "-out", args.key)
+    os.chmod(args.key, 0o600)
+    pub = openssl("ec", "-in", args.key, "-pubout")
+    with open(args.header, "w") as f:
+        f.write(xxd_header("ota_signing_key_pem", pub))
+    print("private key %s, public key in %s" % (args.key, args.header))
+
+
+def manifest(args):
+    with open(args.image, "rb") as f:
+        image = f.read()
+    digest = hashlib.sha256(image).digest()
+    # The firmware verifies the signature over the SHA-256 itself: sign the
+    # digest as the message's hash, not the image a second time.
+    with tempfile.NamedTemporaryFile() as tmp:
+        tmp.write(digest)
+        tmp.flush()
+        sig = openssl("pkeyutl", "-sign", "-inkey", args.key, "-in", tmp.name)
+    out = {"size": len(image), "sha256": digest.hex(), "sig": base64.b64encode(sig).decode()}
+    if args.patch:
+        with open(args.base, "rb") as f:
+            base = f.read()
+        with open(args.patch, "rb") as f:
+            out["patch"] = patch_info(base, f.read())
+    if args.url:
+        out["url"] = args.url
+    if args.no_restart:
+        out["restart"] = False
+    print(json.dumps(out))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Keys and manifests for ota_manager updates")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    k = sub.add_parser("keygen", help="create a signing key and the firmware's key header")
+    k.add_argument("key")
+    k.add_argument("--header", default=os.path.join(os.path.dirname(__file__), "..", "include",
+                                                    "ota_signing_key.h"))
+    k.set_defaults(fn=keygen)
+
+    m = sub.add_parser("manifest", help="print the manifest of a signed image")
+    m.add_argument("image")
+    m.add_argument("--key", required=True)
+    m.add_argument("--url")
+    m.add_argument("--no-restart", action="store_true")
+    m.add_argument("--base", help="image the patch applies to")
+    m.add_argument("--patch", help="delta patch from ota_delta.py, sent instead of the image")
+    m.set_defaults(fn=manifest)
+
+    args = ap.parse_args()
+    if args.cmd == "manifest" and bool(args.base) != bool(args.patch):
+        ap.error("--base and --patch go together")
+    args.fn(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -23,6 +23,7 @@ function docReady(fn) {
 var selectedSSID = "";
 var refreshAPInterval = null;
 var checkStatusInterval = null;
+var events = null;
 
 function stopCheckStatusInterval() {
   if (checkStatusInterval != null) {
@@ -38,14 +39,44 @@ function stopRefreshAPInterval() {
   }
 }
 
+function pushActive() {
+  return events != null && events.readyState !== EventSource.CLOSED;
+}
+
+//polling is only the fallback for when the device cannot give us an event stream
 function startCheckStatusInterval() {
+  if (pushActive() || checkStatusInterval != null) return;
   checkStatusInterval = setInterval(checkStatus, 950);
 }
 
 function startRefreshAPInterval() {
+  if (pushActive() || refreshAPInterval != null) return;
   refreshAPInterval = setInterval(refreshAP, 3800);
 }
 
+//the device pushes status and scan changes as they happen
+function startEvents() {
+  if (!window.EventSource) return false;
+  events = new EventSource("events");
+  events.addEventListener("status", (e) => handleStatus(JSON.parse(e.data)));
+  events.addEventListener("ap", (e) => handleAP(JSON.parse(e.data)));
+  events.onopen = () => {
+    stopCheckStatusInterval();
+    stopRefreshAPInterval();
+  };
+  events.onerror = () => {
+    //CLOSED means the device refused the stream (e.g. too many clients); a
+    //dropped stream is retried by the browser on its own
+    if (events.readyState === EventSource.CLOSED) {
+      events = null;
+      refreshAP();
+      startCheckStatusInterval();
+      startRefreshAPInterval();
+    }
+  };
+  return true;
+}
+
 docReady(async function () {
   gel("wifi-status").addEventListener(
     "click",
@@ -182,9 +213,11 @@ docReady(async function () {
   });
 
   //first time the page loads: attempt get the connection status and start the wifi scan
-  await refreshAP();
-  startCheckStatusInterval();
-  startRefreshAPInterval();
+  if (!startEvents()) {
+    await refreshAP();
+    startCheckStatusInterval();
+    startRefreshAPInterval();
+  }
 });
 
 async function performConnect(conntype) {
@@ -211,6 +244,7 @@ async function performConnect(conntype) {
 
   gel("ok-connect").disabled = true;
   gel("ssid-wait").textContent = selectedSSID;
+  gel("join-progress").textContent = "";
   connect_div.style.display = "none";
   connect_manual_div.style.display = "none";
   connect_wait_div.style.display = "block";
@@ -219,10 +253,8 @@ async function performConnect(conntype) {
     method: "POST",
     headers: {
       "Content-Type": "application/json",
-      "X-Custom-ssid": selectedSSID,
-      "X-Custom-pwd": pwd,
     },
-    body: { timestamp: Date.now() },
+    body: JSON.stringify({ ssid: selectedSSID, pwd: pwd }),
   });
 
   //now we can re-set the intervals regardless of result
@@ -245,21 +277,24 @@ function rssiToIcon(rssi) {
 async function refreshAP(url = "ap.json") {
   try {
     var res = await fetch(url);
-    var access_points = await res.json();
-    if (access_points.length > 0) {
-      //sort by signal strength
-      access_points.sort((a, b) => {
-        var x = a["rssi"];
-        var y = b["rssi"];
-        return x < y ? 1 : x > y ? -1 : 0;
-      });
-      refreshAPHTML(access_points);
-    }
+    handleAP(await res.json());
   } catch (e) {
     console.info("Access points returned empty from /ap.json!");
   }
 }
 
+function handleAP(access_points) {
+  if (access_points.length > 0) {
+    //sort by signal strength
+    access_points.sort((a, b) => {
+      var x = a["rssi"];
+      var y = b["rssi"];
+      return x < y ? 1 : x > y ? -1 : 0;
+    });
+    refreshAPHTML(access_points);
+  }
+}
+
 function refreshAPHTML(data) {
   var h = "";
   data.forEach(function (e, idx, array) {
@@ -275,78 +310,86 @@ function refreshAPHTML(data) {
 async function checkStatus(url = "status.json") {
   try {
     var response = await fetch(url);
-    var data = await response.json();
-    if (data && data.hasOwnProperty("ssid") && data["ssid"] != "") {
-      if (data["ssid"] === selectedSSID) {
-        // Attempting connection
-        switch (data["urc"]) {
-          case 0:
-            console.info("Got connection!");
-            document.querySelector(
-              "#connected-to div div div span"
-            ).textContent = data["ssid"];
-            document.querySelector("#connect-details h1").textContent =
-              data["ssid"];
-            gel("ip").textContent = data["ip"];
-            gel("netmask").textContent = data["netmask"];
-            gel("gw").textContent = data["gw"];
-            gel("wifi-status").style.display = "block";
-
-            //unlock the wait screen if needed
-            gel("ok-connect").disabled = false;
-
-            //update wait screen
-            gel("loading").style.display = "none";
-            gel("connect-success").style.display = "block";
-            gel("connect-fail").style.display = "none";
-            break;
-          case 1:
-            console.info("Connection attempt failed!");
-            document.querySelector(
-              "#connected-to div div div span"
-            ).textContent = data["ssid"];
-            document.querySelector("#connect-details h1").textContent =
-              data["ssid"];
-            gel("ip").textContent = "0.0.0.0";
-            gel("netmask").textContent = "0.0.0.0";
-            gel("gw").textContent = "0.0.0.0";
-
-            //don't show any connection
-            gel("wifi-status").display = "none";
-
-            //unlock the wait screen
-            gel("ok-connect").disabled = false;
-
-            //update wait screen
-            gel("loading").display = "none";
-            gel("connect-fail").style.display = "block";
-            gel("connect-success").style.display = "none";
-            break;
-        }
-      } else if (data.hasOwnProperty("urc") && data["urc"] === 0) {
-        console.info("Connection established");
-        //ESP32 is already connected to a wifi without having the user do anything
-        if (
-          gel("wifi-status").style.display == "" ||
-          gel("wifi-status").style.display == "none"
-        ) {
-          document.querySelector("#connected-to div div div span").textContent =
-            data["ssid"];
+    handleStatus(await response.json());
+  } catch (e) {
+    console.info("Was not able to fetch /status.json");
+  }
+}
+
+function handleStatus(data) {
+  if (data && data.hasOwnProperty("ssid") && data["ssid"] != "") {
+    if (data["ssid"] === selectedSSID) {
+      // Attempting connection
+      switch (data["urc"]) {
+        case 0:
+          console.info("Got connection!");
+          document.querySelector(
+            "#connected-to div div div span"
+          ).textContent = data["ssid"];
           document.querySelector("#connect-details h1").textContent =
             data["ssid"];
           gel("ip").textContent = data["ip"];
           gel("netmask").textContent = data["netmask"];
           gel("gw").textContent = data["gw"];
           gel("wifi-status").style.display = "block";
-        }
+
+          //unlock the wait screen if needed
+          gel("ok-connect").disabled = false;
+
+          //update wait screen
+          gel("loading").style.display = "none";
+          gel("ip-wait").textContent = data["ip"];
+          gel("connect-success").style.display = "block";
+          gel("connect-fail").style.display = "none";
+          break;
+        case 4:
+          //still joining; the portal stays up until the device has an IP
+          gel("join-progress").textContent = `Attempt ${data["attempt"]}...`;
+          break;
+        case 1:
+          console.info("Connection attempt failed!");
+          document.querySelector(
+            "#connected-to div div div span"
+          ).textContent = data["ssid"];
+          document.querySelector("#connect-details h1").textContent =
+            data["ssid"];
+          gel("ip").textContent = "0.0.0.0";
+          gel("netmask").textContent = "0.0.0.0";
+          gel("gw").textContent = "0.0.0.0";
+
+          //don't show any connection
+          gel("wifi-status").display = "none";
+
+          //unlock the wait screen
+          gel("ok-connect").disabled = false;
+
+          //update wait screen
+          gel("loading").display = "none";
+          gel("connect-fail").style.display = "block";
+          gel("connect-success").style.display = "none";
+          break;
       }
-    } else if (data.hasOwnProperty("urc") && data["urc"] === 2) {
-      console.log("Manual disconnect requested...");
-      if (gel("wifi-status").style.display == "block") {
-        gel("wifi-status").style.display = "none";
+    } else if (data.hasOwnProperty("urc") && data["urc"] === 0) {
+      console.info("Connection established");
+      //ESP32 is already connected to a wifi without having the user do anything
+      if (
+        gel("wifi-status").style.display == "" ||
+        gel("wifi-status").style.display == "none"
+      ) {
+        document.querySelector("#connected-to div div div span").textContent =
+          data["ssid"];
+        document.querySelector("#connect-details h1").textContent =
+          data["ssid"];
+        gel("ip").textContent = data["ip"];
+        gel("netmask").textContent = data["netmask"];
+        gel("gw").textContent = data["gw"];
+        gel("wifi-status").style.display = "block";
       }
     }
-  } catch (e) {
-    console.info("Was not able to fetch /status.json");
+  } else if (data.hasOwnProperty("urc") && data["urc"] === 2) {
+    console.log("Manual disconnect requested...");
+    if (gel("wifi-status").style.display == "block") {
+      gel("wifi-status").style.display = "none";
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,63 @@
+/**
+ * File: dns_bench_main.c
+ * Description: Runs the captive DNS responder on 127.0.0.1:5300 under the ESP-IDF
+ *              Linux target and prints its own counters while tools/dns_load.py
+ *              drives it. DNS_BENCH_SECONDS in the environment bounds the run
+ *              (default: until interrupted).
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.2.63
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "dns_server.h"
+
+#define REPORT_PERIOD_S 5
+
+// Server-side view: handling cost per query, split by cache hit and miss.
+static void report(const dns_server_stats_t *st, const dns_server_stats_t *prev, int period_s)
+{
+    uint32_t queries = st->queries - prev->queries;
+    uint32_t hits = st->cache_hits - prev->cache_hits;
+    uint64_t busy = st->busy_us - prev->busy_us;
+    uint64_t hit_us = st->hit_us - prev->hit_us;
+
+    printf("dns_bench: %6" PRIu32 " q/s  hit %5.1f%%  avg %5.1f us (hit %5.1f, miss %5.1f)  max %" PRIu32 " us",
+           queries / period_s, queries ? 100.0 * hits / queries : 0.0,
+           queries ? (double)busy / queries : 0.0,
+           hits ? (double)hit_us / hits : 0.0,
+           queries > hits ? (double)(busy - hit_us) / (queries - hits) : 0.0, st->max_us);
+    for (int i = 0; i < DNS_RESULTS; i++) {
+        printf("  %s=%" PRIu32, dns_server_result_name(i), st->results[i] - prev->results[i]);
+    }
+    printf("  send_errors=%" PRIu32 "\n", st->send_errors - prev->send_errors);
+    fflush(stdout);
+}
+
+void app_main(void)
+{
+    const char *env = getenv("DNS_BENCH_SECONDS");
+    int seconds = env ? atoi(env) : 0;
+    dns_server_stats_t start = { 0 }, prev = { 0 }, now;
+
+    if (dns_server_start() != ESP_OK) {
+        exit(1);
+    }
+    for (int t = 0; seconds <= 0 || t < seconds; t += REPORT_PERIOD_S) {
+        vTaskDelay(pdMS_TO_TICKS(REPORT_PERIOD_S * 1000));
+        dns_server_get_stats(&now);
+        report(&now, &prev, REPORT_PERIOD_S);
+        prev = now;
+    }
+
+    dns_server_stop();
+    dns_server_get_stats(&now);
+    printf("dns_bench: total over %d s\n", seconds);
+    report(&now, &start, seconds);
+    exit(0);
+}
@@ -0,0 +1,197 @@
+/**
+ * File: json_bench_main.c
+ * Description: Times src/json.c's writer against cJSON (build the tree, print into a
+ *              preallocated buffer, free it: what app_logic does today) on the /ap.json,
+ *              /status.json and MQTT status payloads, after checking both give the same
+ *              bytes. JSON_BENCH_ITERATIONS in the environment sets the loop count.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.2.64
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cJSON.h"
+#include "json.h"
+
+#define OUT_SIZE 2048
+
+// A scan like the one wifi_scan.c renders: DEFAULT_SCAN_MAX_AP entries, a few SSIDs
+// that need escaping, the rest plain ASCII or UTF-8.
+static const struct {
+    const char *ssid;
+    int chan, rssi, auth;
+} aps[] = {
+    { "PianoStudio-5G", 36, -41, 3 },
+    { "Ballard Home", 6, -48, 3 },
+    { "NETGEAR42", 11, -55, 3 },
+    { "xfinitywifi", 1, -61, 0 },
+    { "Café \"Allegro\"", 6, -63, 4 },
+    { "DIRECT-7F-HP OfficeJet", 6, -66, 3 },
+    { "back\\slash", 11, -67, 3 },
+    { "Guest", 1, -70, 0 },
+    { "TP-Link_8C2E", 3, -72, 3 },
+    { "Musikschule Dürrenberg", 9, -74, 7 },
+    { "tab\there", 11, -77, 3 },
+    { "ATT9qz8x", 1, -80, 3 },
+    { "FBI Surveillance Van", 6, -83, 3 },
+    { "Linksys00417", 11, -86, 3 },
+    { "\x01odd\x1f", 4, -90, 0 },
+};
+#define AP_COUNT (sizeof(aps) / sizeof(aps[0]))
+
+static const char *ST_SSID = "Ballard Home";
+static const char *ST_IP = "192.168.1.57", *ST_NETMASK = "255.255.255.0", *ST_GW = "192.168.1.1";
+
+static unsigned allocs;
+
+static void *count_malloc(size_t size)
+{
+    allocs++;
+    return malloc(size);
+}
+
+static size_t writer_ap(char *out, size_t size)
+{
+    json_writer_t w;
+    json_writer_init(&w, out, size, NULL, NULL);
+    json_arr_begin(&w);
+    for (size_t i = 0; i < AP_COUNT; i++) {
+        json_obj_begin(&w);
+        json_kv_str(&w, "ssid", aps[i].ssid);
+        json_kv_int(&w, "chan", aps[i].chan);
+        json_kv_int(&w, "rssi", aps[i].rssi);
+        json_kv_int(&w, "auth", aps[i].auth);
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    return json_writer_finish(&w) ? w.len : 0;
+}
+
+static cJSON *cjson_ap(void)
+{
+    cJSON *root = cJSON_CreateArray();
+    for (size_t i = 0; i < AP_COUNT; i++) {
+        cJSON *ap = cJSON_CreateObject();
+        cJSON_AddStringToObject(ap, "ssid", aps[i].ssid);
+        cJSON_AddNumberToObject(ap, "chan", aps[i].chan);
+        cJSON_AddNumberToObject(ap, "rssi", aps[i].rssi);
+        cJSON_AddNumberToObject(ap, "auth", aps[i].auth);
+        cJSON_AddItemToArray(root, ap);
+    }
+    return root;
+}
+
+static size_t writer_status(char *out, size_t size)
+{
+    json_writer_t w;
+    json_writer_init(&w, out, size, NULL, NULL);
+    json_obj_begin(&w);
+    json_kv_str(&w, "ssid", ST_SSID);
+    json_kv_str(&w, "ip", ST_IP);
+    json_kv_str(&w, "netmask", ST_NETMASK);
+    json_kv_str(&w, "gw", ST_GW);
+    json_kv_int(&w, "urc", 0);
+    json_kv_uint(&w, "attempt", 1);
+    json_kv_bool(&w, "portal", false);
+    json_obj_end(&w);
+    return json_writer_finish(&w) ? w.len : 0;
+}
+
+static cJSON *cjson_status(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "ssid", ST_SSID);
+    cJSON_AddStringToObject(root, "ip", ST_IP);
+    cJSON_AddStringToObject(root, "netmask", ST_NETMASK);
+    cJSON_AddStringToObject(root, "gw", ST_GW);
+    cJSON_AddNumberToObject(root, "urc", 0);
+    cJSON_AddNumberToObject(root, "attempt", 1);
+    cJSON_AddBoolToObject(root, "portal", false);
+    return root;
+}
+
+// app_logic's status publish, every SAMPLE_PERIOD_MS.
+static size_t writer_telemetry(char *out, size_t size)
+{
+    json_writer_t w;
+    json_writer_init(&w, out, size, NULL, NULL);
+    json_obj_begin(&w);
+    json_kv_bool(&w, "power", true);
+    json_kv_bool(&w, "water", true);
+    json_kv_bool(&w, "pads", false);
+    json_obj_end(&w);
+    return json_writer_finish(&w) ? w.len : 0;
+}
+
+static cJSON *cjson_telemetry(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "power", true);
+    cJSON_AddBoolToObject(root, "water", true);
+    cJSON_AddBoolToObject(root, "pads", false);
+    return root;
+}
+
+static const struct {
+    const char *name;
+    size_t (*writer)(char *out, size_t size);
+    cJSON *(*tree)(void);
+} payloads[] = {
+    { "ap.json", writer_ap, cjson_ap },
+    { "status.json", writer_status, cjson_status },
+    { "telemetry", writer_telemetry, cjson_telemetry },
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void app_main(void)
+{
+    const char *env = getenv("JSON_BENCH_ITERATIONS");
+    long iterations = env && atol(env) > 0 ? atol(env) : 100000;
+    static char a[OUT_SIZE], b[OUT_SIZE];
+    cJSON_Hooks hooks = { count_malloc, free };
+    int failed = 0;
+
+    cJSON_InitHooks(&hooks);
+    printf("json_bench: %ld iterations\n", iterations);
+    for (size_t p = 0; p < sizeof(payloads) / sizeof(payloads[0]); p++) {
+        size_t len = payloads[p].writer(a, sizeof(a));
+        cJSON *root = payloads[p].tree();
+        bool printed = cJSON_PrintPreallocated(root, b, sizeof(b), false);
+        cJSON_Delete(root);
+        if (!len || !printed || strcmp(a, b) != 0) {
+            printf("json_bench: %s differs\n  writer: %s\n  cJSON:  %s\n", payloads[p].name, a, b);
+            failed = 1;
+            continue;
+        }
+
+        double t0 = now_ns();
+        for (long i = 0; i < iterations; i++) {
+            payloads[p].writer(a, sizeof(a));
+        }
+        double t1 = now_ns();
+        allocs = 0;
+        for (long i = 0; i < iterations; i++) {
+            root = payloads[p].tree();
+            cJSON_PrintPreallocated(root, b, sizeof(b), false);
+            cJSON_Delete(root);
+        }
+        double t2 = now_ns();
+
+        double writer_ns = (t1 - t0) / iterations, cjson_ns = (t2 - t1) / iterations;
+        printf("json_bench: %-12s %5zu B  writer %8.1f ns  cJSON %8.1f ns (%u mallocs)  x%.1f\n",
+               payloads[p].name, len, writer_ns, cjson_ns, allocs / (unsigned)iterations,
+               cjson_ns / writer_ns);
+    }
+    fflush(stdout);
+    exit(failed);
+}
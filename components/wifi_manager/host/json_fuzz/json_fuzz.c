@@ -0,0 +1,131 @@
+/**
+ * File: json_fuzz.c
+ * Description: Fuzz target for json_parse(), json_tok_str() and json_bind(). Any input
+ *              must be accepted or rejected without touching memory outside the input
+ *              and the token array, and accepted documents must give a consistent token
+ *              tree. Built with -DJSON_FUZZ_REPLAY it runs the files named on the command
+ *              line instead, to replay a corpus or a crash without libFuzzer.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.2.69
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "json.h"
+
+#define FUZZ_TOKENS 64
+
+// Same shape as the portal's connect.json, plus the other field types.
+typedef struct {
+    char ssid[33];
+    char pwd[65];
+    uint8_t channel;
+    int32_t offset;
+    bool hidden;
+    double gain;
+} fuzz_config_t;
+
+static const json_field_t fuzz_fields[] = {
+    JSON_BIND_STR("ssid", fuzz_config_t, ssid, true, 1),
+    JSON_BIND_STR("pwd", fuzz_config_t, pwd, false, 0),
+    JSON_BIND_INT("channel", fuzz_config_t, channel, false, 1, 13),
+    JSON_BIND_INT("offset", fuzz_config_t, offset, false, INT32_MIN, INT32_MAX),
+    JSON_BIND_BOOL("hidden", fuzz_config_t, hidden, false),
+    JSON_BIND_DOUBLE("gain", fuzz_config_t, gain, false),
+};
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "json_fuzz: %s\n", #cond); abort(); } } while (0)
+
+// Walks the value at toks[i] through size and next only; returns the index after it.
+// depth counts the containers around toks[i]; scalars add no level, as in json_parse().
+static int walk(const json_tok_t *toks, int n, int i, size_t len, int depth)
+{
+    CHECK(i < n);
+    const json_tok_t *t = &toks[i];
+
+    if (t->type == JSON_OBJECT || t->type == JSON_ARRAY) {
+        depth++;
+    }
+    CHECK(depth <= JSON_PARSE_MAX_DEPTH);
+    CHECK(t->start <= t->end && t->end <= len);
+    CHECK(t->next > i && t->next <= n);
+    int j = i + 1;
+    for (unsigned m = 0; m < t->size; m++) {
+        if (t->type == JSON_OBJECT) {
+            CHECK(toks[j].type == JSON_STRING && toks[j].next == j + 1);
+            j++;
+        }
+        j = walk(toks, n, j, len, depth);
+    }
+    CHECK(t->type == JSON_OBJECT || t->type == JSON_ARRAY || t->size == 0);
+    CHECK(j == t->next);
+    return j;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    json_tok_t toks[FUZZ_TOKENS];
+    const char *js = (const char *)data;
+    int n = json_parse(js, size, toks, FUZZ_TOKENS);
+
+    if (n < 0) {
+        CHECK(n >= JSON_ERR_DEPTH);
+        return 0;
+    }
+    CHECK(n > 0 && walk(toks, n, 0, size, 0) == n);
+
+    for (int i = 0; i < n; i++) {
+        char out[96];
+        int64_t iv;
+        double dv;
+        bool bv;
+        if (toks[i].type == JSON_STRING) {
+            int len = json_tok_str(js, &toks[i], out, sizeof(out));
+            CHECK(strlen(out) < sizeof(out) && (len < 0 || strlen(out) == (size_t)len));
+        }
+        json_tok_int(js, &toks[i], &iv);
+        json_tok_double(js, &toks[i], &dv);
+        json_tok_bool(js, &toks[i], &bv);
+    }
+
+    if (toks[0].type == JSON_OBJECT) {
+        fuzz_config_t cfg = { 0 };
+        const char *bad = NULL;
+        int err = json_bind(js, toks, 0, fuzz_fields, sizeof(fuzz_fields) / sizeof(fuzz_fields[0]), &cfg, &bad);
+        CHECK(err == JSON_OK ? bad == NULL : bad != NULL);
+        CHECK(memchr(cfg.ssid, '\0', sizeof(cfg.ssid)) && memchr(cfg.pwd, '\0', sizeof(cfg.pwd)));
+        if (err == JSON_OK) {
+            CHECK(strlen(cfg.ssid) >= 1 && cfg.channel <= 13);
+        }
+        json_obj_get(js, toks, 0, "ssid");
+    }
+    return 0;
+}
+
+#ifdef JSON_FUZZ_REPLAY
+int main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        FILE *f = fopen(argv[i], "rb");
+        if (f == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        static uint8_t buf[1 << 16];
+        size_t len = fread(buf, 1, sizeof(buf), f);
+        fclose(f);
+        // A copy of exactly len bytes, so ASan sees any read past the end.
+        uint8_t *data = malloc(len ? len : 1);
+        memcpy(data, buf, len);
+        LLVMFuzzerTestOneInput(data, len);
+        free(data);
+    }
+    printf("json_fuzz: %d inputs\n", argc - 1);
+    return 0;
+}
+#endif
@@ -0,0 +1,376 @@
+/**
+ * File: fake_idf.c
+ * Description: Just enough of NVS, esp_timer, FreeRTOS tasks and nvs_sync for
+ *              settings.c on the host. NVS is a table in RAM, time only moves in
+ *              fake_advance(), tasks are threads and the NVS lock is a mutex.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.2.69
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <string.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/task.h"
+#include "nvs_sync.h"
+#include "fake_idf.h"
+
+#define MAX_ENTRIES    64
+#define MAX_NAMESPACES 8
+#define MAX_VALUE      256
+
+typedef enum { T_I32 = 1, T_U8, T_STR, T_BLOB } nvs_type_t;
+
+typedef struct {
+    nvs_handle_t ns;            // 0: free
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    uint8_t data[MAX_VALUE];
+    size_t len;
+} entry_t;
+
+struct fake_timer {
+    esp_timer_cb_t cb;
+    void *arg;
+    bool armed;
+    int64_t due;
+};
+
+struct fake_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    uint32_t pending;
+    bool waiting;
+};
+
+// Guards everything below except the NVS table, which nvs_sync_lock() covers as on the device.
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+static int64_t now_us = 1000000;
+static struct fake_timer timers[4];
+static size_t timer_count;
+static struct fake_task tasks[4];
+static size_t task_count;
+static uint32_t commits;
+static uint32_t fail_commits;
+
+static pthread_mutex_t nvs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char namespaces[MAX_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static entry_t entries[MAX_ENTRIES];
+
+const char *esp_err_to_name(esp_err_t err) {
+    switch (err) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_ERR_NVS_NOT_FOUND:
+        return "ESP_ERR_NVS_NOT_FOUND";
+    default:
+        return "ESP_FAIL";
+    }
+}
+
+/* NVS */
+
+bool nvs_sync_lock(TickType_t ticks) {
+    return pthread_mutex_lock(&nvs_mutex) == 0;
+}
+
+void nvs_sync_unlock() {
+    pthread_mutex_unlock(&nvs_mutex);
+}
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out) {
+    for (size_t i = 0; i < MAX_NAMESPACES; i++) {
+        if (namespaces[i][0] == '\0') {
+            strncpy(namespaces[i], ns, NVS_KEY_NAME_MAX_SIZE - 1);
+        }
+        if (strcmp(namespaces[i], ns) == 0) {
+            *out = (nvs_handle_t)i + 1;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void nvs_close(nvs_handle_t h) {
+}
+
+static entry_t *find(nvs_handle_t h, const char *key, bool create) {
+    entry_t *free_slot = NULL;
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        if (entries[i].ns == h && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+        if (entries[i].ns == 0 && !free_slot) {
+            free_slot = &entries[i];
+        }
+    }
+    if (create && free_slot) {
+        free_slot->ns = h;
+        strncpy(free_slot->key, key, NVS_KEY_NAME_MAX_SIZE - 1);
+        return free_slot;
+    }
+    return NULL;
+}
+
+static esp_err_t get(nvs_handle_t h, const char *key, nvs_type_t type, void *out, size_t *len) {
+    entry_t *e = find(h, key, false);
+    if (!e || e->type != type) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out && *len < e->len) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    if (out) {
+        memcpy(out, e->data, e->len);
+    }
+    *len = e->len;
+    return ESP_OK;
+}
+
+static esp_err_t set(nvs_handle_t h, const char *key, nvs_type_t type, const void *data, size_t len) {
+    entry_t *e = find(h, key, true);
+    if (!e || len > MAX_VALUE) {
+        return ESP_ERR_NO_MEM;
+    }
+    e->type = type;
+    memcpy(e->data, data, len);
+    e->len = len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t h, const char *key, int32_t *out) {
+    size_t len = sizeof(*out);
+    return get(h, key, T_I32, out, &len);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t h, const char *key, int32_t v) {
+    return set(h, key, T_I32, &v, sizeof(v));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t h, const char *key, uint8_t *out) {
+    size_t len = sizeof(*out);
+    return get(h, key, T_U8, out, &len);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t h, const char *key, uint8_t v) {
+    return set(h, key, T_U8, &v, sizeof(v));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len) {
+    return get(h, key, T_STR, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *v) {
+    return set(h, key, T_STR, v, strlen(v) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len) {
+    return get(h, key, T_BLOB, out, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *v, size_t len) {
+    return set(h, key, T_BLOB, v, len);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t h, const char *key) {
+    entry_t *e = find(h, key, false);
+    if (!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    e->ns = 0;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t h) {
+    for (size_t i = 0; i < MAX_ENTRIES; i++) {
+        if (entries[i].ns == h) {
+            entries[i].ns = 0;
+        }
+    }
+    return ESP_OK;
+}
+
+// Sets reach the table at once; a commit only counts, or fails when told to.
+esp_err_t nvs_commit(nvs_handle_t h) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = ESP_OK;
+    if (fail_commits) {
+        fail_commits--;
+        err = ESP_FAIL;
+    } else {
+        commits++;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+uint32_t fake_nvs_commits(void) {
+    pthread_mutex_lock(&lock);
+    uint32_t n = commits;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void fake_nvs_fail_commits(uint32_t n) {
+    pthread_mutex_lock(&lock);
+    fail_commits = n;
+    pthread_mutex_unlock(&lock);
+}
+
+/* esp_timer */
+
+int64_t esp_timer_get_time(void) {
+    pthread_mutex_lock(&lock);
+    int64_t t = now_us;
+    pthread_mutex_unlock(&lock);
+    return t;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    pthread_mutex_lock(&lock);
+    if (timer_count == sizeof(timers) / sizeof(timers[0])) {
+        pthread_mutex_unlock(&lock);
+        return ESP_ERR_NO_MEM;
+    }
+    struct fake_timer *t = &timers[timer_count++];
+    t->cb = args->callback;
+    t->arg = args->arg;
+    *out = t;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = timer->armed ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        timer->armed = true;
+        timer->due = now_us + (int64_t)timeout_us;
+    }
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&lock);
+    esp_err_t err = timer->armed ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->armed = false;
+    pthread_mutex_unlock(&lock);
+    return err;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    pthread_mutex_lock(&lock);
+    bool armed = timer->armed;
+    pthread_mutex_unlock(&lock);
+    return armed;
+}
+
+bool fake_timer_armed(void) {
+    pthread_mutex_lock(&lock);
+    bool armed = false;
+    for (size_t i = 0; i < timer_count; i++) {
+        armed |= timers[i].armed;
+    }
+    pthread_mutex_unlock(&lock);
+    return armed;
+}
+
+void fake_advance(int64_t us, bool settle) {
+    pthread_mutex_lock(&lock);
+    int64_t end = now_us + us;
+    for (;;) {
+        struct fake_timer *next = NULL;
+        for (size_t i = 0; i < timer_count; i++) {
+            if (timers[i].armed && timers[i].due <= end && (!next || timers[i].due < next->due)) {
+                next = &timers[i];
+            }
+        }
+        if (!next) {
+            break;
+        }
+        if (next->due > now_us) {
+            now_us = next->due;
+        }
+        next->armed = false;
+        pthread_mutex_unlock(&lock);
+        // As on the esp_timer task: a callback that blocks stops the clock here.
+        next->cb(next->arg);
+        if (settle) {
+            fake_settle();
+        }
+        pthread_mutex_lock(&lock);
+    }
+    now_us = end;
+    pthread_mutex_unlock(&lock);
+}
+
+/* Tasks */
+
+static __thread struct fake_task *current;
+
+static void *task_main(void *arg) {
+    current = arg;
+    current->fn(current->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *out) {
+    pthread_mutex_lock(&lock);
+    if (task_count == sizeof(tasks) / sizeof(tasks[0])) {
+        pthread_mutex_unlock(&lock);
+        return pdFALSE;
+    }
+    struct fake_task *t = &tasks[task_count++];
+    t->fn = fn;
+    t->arg = arg;
+    pthread_mutex_unlock(&lock);
+    if (pthread_create(&t->thread, NULL, task_main, t) != 0) {
+        return pdFALSE;
+    }
+    pthread_detach(t->thread);
+    if (out) {
+        *out = t;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&lock);
+    task->pending++;
+    pthread_cond_broadcast(&changed);
+    pthread_mutex_unlock(&lock);
+    return pdPASS;
+}
+
+// Only portMAX_DELAY is needed here.
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait) {
+    pthread_mutex_lock(&lock);
+    struct fake_task *t = current;
+    t->waiting = true;
+    pthread_cond_broadcast(&changed);
+    while (t->pending == 0) {
+        pthread_cond_wait(&changed, &lock);
+    }
+    uint32_t n = t->pending;
+    t->pending = clear ? 0 : n - 1;
+    t->waiting = false;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+void fake_settle(void) {
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < task_count; i++) {
+        while (!tasks[i].waiting || tasks[i].pending) {
+            pthread_cond_wait(&changed, &lock);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
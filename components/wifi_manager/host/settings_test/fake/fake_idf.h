@@ -0,0 +1,15 @@
+/* Controls for the host stand-ins in fake_idf.c. */
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Moves the simulated clock on by us, running every timer that comes due on the
+ * calling thread. With settle, each expiry also waits for the tasks it woke. */
+void fake_advance(int64_t us, bool settle);
+/* Waits until every task is blocked in ulTaskNotifyTake() with nothing pending. */
+void fake_settle(void);
+bool fake_timer_armed(void);
+
+uint32_t fake_nvs_commits(void);
+/* The next n commits fail with ESP_FAIL. */
+void fake_nvs_fail_commits(uint32_t n);
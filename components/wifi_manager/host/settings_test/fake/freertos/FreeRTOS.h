@@ -0,0 +1,16 @@
+/* Host stand-in for FreeRTOS.h: critical sections are a pthread mutex. */
+#pragma once
+#include <stdint.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef pthread_mutex_t portMUX_TYPE;
+
+#define portMAX_DELAY                 ((TickType_t)0xffffffffu)
+#define portMUX_INITIALIZER_UNLOCKED  PTHREAD_MUTEX_INITIALIZER
+#define pdMS_TO_TICKS(ms)             ((TickType_t)(ms))
+#define pdTRUE                        1
+#define pdFALSE                       0
+#define pdPASS                        1
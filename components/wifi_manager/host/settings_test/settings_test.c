@@ -0,0 +1,220 @@
+/**
+ * File: settings_test.c
+ * Description: Runs settings.c against the in-memory NVS and simulated clock of
+ *              fake_idf.c: defaults and typed access, a burst written with one
+ *              commit, the maximum flush delay, a flush that waits for the NVS
+ *              lock without holding up the timer, failed commits, migration and
+ *              reset of older namespaces.
+ * Created on: 2026-10-19
+ * Edited on:  2026-10-19
+ * Version: v8.2.69
+ * Author: R. Andrew Ballard (c) 2025
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "settings.h"
+#include "nvs_sync.h"
+#include "fake_idf.h"
+
+#define MS 1000
+#define S  1000000
+
+#define CHECK(cond) do { if (!(cond)) { fprintf(stderr, "settings_test: %s (line %d)\n", #cond, __LINE__); exit(1); } } while (0)
+
+enum { T_PROFILE, T_POWER, T_NAME, T_KEY, T_COUNT };
+
+static const uint8_t key_default[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+static const settings_def_t test_defs[T_COUNT] = {
+    SETTINGS_INT("profile", -1),
+    SETTINGS_BOOL("power", true),
+    SETTINGS_STR("name", 12, "piano"),
+    SETTINGS_BLOB("key", sizeof(key_default), key_default),
+};
+static const settings_schema_t test_schema = { "test", 1, test_defs, T_COUNT, NULL, NULL };
+
+static int32_t stored_int(const char *ns, const char *key) {
+    nvs_handle_t nvs;
+    int32_t v = -12345;
+    CHECK(nvs_sync_lock(0));
+    CHECK(nvs_open(ns, NVS_READWRITE, &nvs) == ESP_OK);
+    nvs_get_i32(nvs, key, &v);
+    nvs_sync_unlock();
+    return v;
+}
+
+static settings_stats_t stats(void) {
+    settings_stats_t st;
+    settings_get_stats(&st);
+    return st;
+}
+
+static void test_access(void) {
+    char name[12];
+    uint8_t key[8];
+
+    CHECK(settings_register(&test_schema) == ESP_OK);
+    CHECK(settings_register(&test_schema) == ESP_OK);
+    CHECK(settings_get_int(&test_schema, T_PROFILE) == -1);
+    CHECK(settings_get_bool(&test_schema, T_POWER));
+    CHECK(settings_get_str(&test_schema, T_NAME, name, sizeof(name)) == ESP_OK && strcmp(name, "piano") == 0);
+    CHECK(settings_get_str(&test_schema, T_NAME, name, 3) == ESP_OK && strcmp(name, "pi") == 0);
+    CHECK(settings_get_blob(&test_schema, T_KEY, key, sizeof(key)) == ESP_OK && memcmp(key, key_default, 8) == 0);
+    CHECK(settings_get_blob(&test_schema, T_KEY, key, 4) == ESP_ERR_INVALID_SIZE);
+
+    // Another type, another index, or a schema never registered.
+    CHECK(settings_get_int(&test_schema, T_POWER) == 0);
+    CHECK(settings_get_int(&test_schema, T_COUNT) == 0);
+    CHECK(settings_set_int(&test_schema, T_NAME, 1) == ESP_ERR_INVALID_ARG);
+    CHECK(settings_set_str(&test_schema, T_NAME, "a name too long") == ESP_ERR_INVALID_SIZE);
+    CHECK(settings_set_blob(&test_schema, T_KEY, key, 7) == ESP_ERR_INVALID_SIZE);
+    static const settings_schema_t unknown = { "unknown", 1, test_defs, T_COUNT, NULL, NULL };
+    CHECK(settings_set_int(&unknown, T_PROFILE, 1) == ESP_ERR_INVALID_ARG);
+    CHECK(!fake_timer_armed());
+}
+
+static void test_burst(void) {
+    uint32_t commits = fake_nvs_commits();
+
+    for (int i = 0; i < 20; i++) {
+        CHECK(settings_set_int(&test_schema, T_PROFILE, i) == ESP_OK);
+        fake_advance(100 * MS, true);
+    }
+    CHECK(settings_set_str(&test_schema, T_NAME, "grand") == ESP_OK);
+    CHECK(fake_nvs_commits() == commits);
+    fake_advance(DEFAULT_SETTINGS_FLUSH_MS * MS, true);
+    CHECK(fake_nvs_commits() == commits + 1);
+    CHECK(stored_int("test", "profile") == 19);
+    CHECK(!fake_timer_armed());
+
+    // The value already held: nothing to write.
+    uint32_t unchanged = stats().unchanged;
+    CHECK(settings_set_int(&test_schema, T_PROFILE, 19) == ESP_OK);
+    CHECK(settings_set_str(&test_schema, T_NAME, "grand") == ESP_OK);
+    CHECK(stats().unchanged == unchanged + 2 && !fake_timer_armed());
+    printf("burst: 21 sets, 1 commit\n");
+}
+
+// A change every second never leaves the delay quiet; the maximum delay still flushes.
+static void test_continuous(void) {
+    uint32_t commits = fake_nvs_commits();
+
+    for (int i = 0; i < 25; i++) {
+        CHECK(settings_set_int(&test_schema, T_PROFILE, 100 + i) == ESP_OK);
+        fake_advance(1 * S, true);
+    }
+    uint32_t during = fake_nvs_commits() - commits;
+    CHECK(during == 25 * 1000 / DEFAULT_SETTINGS_FLUSH_MAX_MS);
+    fake_advance(DEFAULT_SETTINGS_FLUSH_MS * MS, true);
+    CHECK(stored_int("test", "profile") == 124);
+    printf("continuous: 25 sets over 25 s, %u commits while changing\n", (unsigned)during);
+}
+
+// The flush waits for the NVS lock on its own task; the timer callback must not.
+static void test_lock_held(void) {
+    uint32_t commits = fake_nvs_commits();
+
+    CHECK(settings_set_int(&test_schema, T_PROFILE, 7) == ESP_OK);
+    CHECK(nvs_sync_lock(0));
+    alarm(5);
+    fake_advance(DEFAULT_SETTINGS_FLUSH_MS * MS, false);
+    alarm(0);
+    CHECK(fake_nvs_commits() == commits);
+    nvs_sync_unlock();
+    fake_settle();
+    CHECK(fake_nvs_commits() == commits + 1);
+    CHECK(stored_int("test", "profile") == 7);
+}
+
+static void test_commit_failure(void) {
+    uint32_t errors = stats().errors;
+    uint32_t commits = fake_nvs_commits();
+
+    CHECK(settings_set_int(&test_schema, T_PROFILE, 8) == ESP_OK);
+    fake_nvs_fail_commits(1);
+    fake_advance(DEFAULT_SETTINGS_FLUSH_MS * MS, true);
+    CHECK(stats().errors == errors + 1 && fake_nvs_commits() == commits);
+    // Still dirty, so a new delay was started.
+    CHECK(fake_timer_armed());
+    fake_advance(DEFAULT_SETTINGS_FLUSH_MS * MS, true);
+    CHECK(fake_nvs_commits() == commits + 1 && !fake_timer_armed());
+    CHECK(stored_int("test", "profile") == 8);
+}
+
+static void test_explicit_flush(void) {
+    uint32_t commits = fake_nvs_commits();
+
+    CHECK(settings_set_bool(&test_schema, T_POWER, false) == ESP_OK);
+    CHECK(settings_flush() == ESP_OK);
+    CHECK(fake_nvs_commits() == commits + 1);
+    // The timer still fires, with nothing left to write.
+    fake_advance(DEFAULT_SETTINGS_FLUSH_MAX_MS * MS, true);
+    CHECK(fake_nvs_commits() == commits + 1);
+}
+
+static void put_old(const char *ns, uint8_t version, int32_t profile) {
+    nvs_handle_t nvs;
+    CHECK(nvs_sync_lock(0));
+    CHECK(nvs_open(ns, NVS_READWRITE, &nvs) == ESP_OK);
+    CHECK(nvs_set_u8(nvs, "_ver", version) == ESP_OK);
+    CHECK(nvs_set_i32(nvs, "profile", profile) == ESP_OK);
+    CHECK(nvs_set_str(nvs, "name", "upright") == ESP_OK);
+    nvs_sync_unlock();
+}
+
+static uint8_t migrated_from;
+
+// Version 1 kept the profile in tenths.
+static esp_err_t migrate(nvs_handle_t nvs, uint8_t from_version, void *ctx) {
+    int32_t v;
+    migrated_from = from_version;
+    if (nvs_get_i32(nvs, "profile", &v) == ESP_OK) {
+        return nvs_set_i32(nvs, "profile", v / 10);
+    }
+    return ESP_OK;
+}
+
+static void test_versions(void) {
+    static const settings_schema_t migrated = { "migrated", 2, test_defs, T_COUNT, migrate, NULL };
+    static const settings_schema_t reset = { "reset", 2, test_defs, T_COUNT, NULL, NULL };
+    static const settings_schema_t newer = { "newer", 1, test_defs, T_COUNT, NULL, NULL };
+    settings_stats_t before = stats();
+    char name[12];
+
+    put_old("migrated", 1, 30);
+    CHECK(settings_register(&migrated) == ESP_OK);
+    CHECK(migrated_from == 1 && settings_get_int(&migrated, T_PROFILE) == 3);
+    CHECK(settings_get_str(&migrated, T_NAME, name, sizeof(name)) == ESP_OK && strcmp(name, "upright") == 0);
+
+    put_old("reset", 1, 30);
+    CHECK(settings_register(&reset) == ESP_OK);
+    CHECK(settings_get_int(&reset, T_PROFILE) == -1 && stored_int("reset", "profile") == -12345);
+
+    // Written by a later firmware: read as far as the keys match.
+    put_old("newer", 5, 4);
+    CHECK(settings_register(&newer) == ESP_OK);
+    CHECK(settings_get_int(&newer, T_PROFILE) == 4);
+
+    settings_stats_t after = stats();
+    CHECK(after.migrations == before.migrations + 1 && after.resets == before.resets + 1);
+    CHECK(settings_register(&(settings_schema_t){ "full", 1, test_defs, T_COUNT, NULL, NULL }) == ESP_ERR_INVALID_ARG);
+}
+
+int main(void) {
+    test_access();
+    test_burst();
+    test_continuous();
+    test_lock_held();
+    test_commit_failure();
+    test_explicit_flush();
+    test_versions();
+
+    settings_stats_t st = stats();
+    printf("ok: %u sets, %u unchanged, %u flushes, %u commits, %u keys, %u errors, %u migrated, %u reset\n",
+           (unsigned)st.sets, (unsigned)st.unchanged, (unsigned)st.flushes, (unsigned)st.commits,
+           (unsigned)st.keys_written, (unsigned)st.errors, (unsigned)st.migrations, (unsigned)st.resets);
+    return 0;
+}
@@ -1,153 +1,402 @@
 /*
-Copyright (c) 2019 Tony Pottier
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-SOFTWARE.
-
-@file dns_server.c
-@brief Defines an extremely basic DNS server for captive portal functionality.
-*/
-
-#include <lwip/sockets.h>
+ *  dns_server.c
+ *
+ *  Created on: 2019 (Tony Pottier, MIT licence in dns_server.h)
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.63
+ *
+ *  Also builds for the ESP-IDF Linux target (host/dns_bench), where the same
+ *  code runs on host sockets for load testing.
+ */
+
 #include <string.h>
-#include <stdint.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/task.h>
-#include <freertos/event_groups.h>
-#include <esp_system.h>
-#include <esp_wifi.h>
-#include <esp_event.h>
-#include <esp_log.h>
-#include <esp_err.h>
-#include <nvs_flash.h>
-#include <lwip/err.h>
-#include <lwip/sys.h>
-#include <lwip/netdb.h>
-#include <lwip/dns.h>
-
-#include "wifi_manager.h"
+#include <errno.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
 #include "dns_server.h"
 
-// ✅ Define missing symbols (fallback/defaults)
-#define WIFI_MANAGER_TASK_PRIORITY 4
-#define DEFAULT_AP_IP "192.168.4.1"
+#if CONFIG_IDF_TARGET_LINUX
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+static int64_t now_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#else
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#define now_us esp_timer_get_time
+#endif
+
+/* The host build moves it off the privileged port. */
+#ifndef DNS_SERVER_PORT
+#define DNS_SERVER_PORT          53
+#endif
+#define DNS_SERVER_TASK_STACK    3072
+#define DNS_SERVER_TASK_PRIORITY 4
+/* Nothing a client learns from the portal should outlive it. */
+#define DNS_SERVER_TTL_S         0
+#define DNS_CLASS_ANY            255
+
+/*
+ * Prebuilt responses. A portal session asks for the same few names over and
+ * over (connectivity checks, captive.apple.com, ...), and the answer does not
+ * depend on who asks, so one cache serves every client. Responses longer than
+ * an entry are simply not cached.
+ */
+#define DNS_CACHE_ENTRIES        8
+#define DNS_CACHE_ENTRY_SIZE     128
+
+typedef struct {
+	uint32_t hash;             /* FNV-1a of QNAME, QTYPE and QCLASS as received */
+	uint16_t qtype;
+	uint16_t qend;             /* question end, i.e. the bytes compared on lookup */
+	uint16_t len;              /* 0 = free */
+	uint8_t result;            /* dns_result_t */
+	uint32_t last_used;
+	uint8_t resp[DNS_CACHE_ENTRY_SIZE];
+} dns_cache_entry_t;
 
-// ✅ Forward declaration if not provided in wifi_manager.h
-esp_netif_t* wifi_manager_get_esp_netif_sta(void);
+typedef struct {
+	uint32_t hash;
+	uint16_t qtype;
+	uint16_t qend;             /* 0 = query not cacheable */
+} dns_cache_key_t;
 
 static const char TAG[] = "dns_server";
-static TaskHandle_t task_dns_server = NULL;
-int socket_fd;
 
-void dns_server_start() {
-    if(task_dns_server == NULL){
-        xTaskCreate(&dns_server, "dns_server", 3072, NULL, WIFI_MANAGER_TASK_PRIORITY - 1, &task_dns_server);
-    }
+static TaskHandle_t dns_task = NULL;
+static SemaphoreHandle_t dns_done = NULL;
+static volatile bool dns_running = false;
+static int dns_fd = -1;
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static dns_server_stats_t stats;
+
+/* One query at a time, so the buffers need not be on the task's stack. */
+static uint8_t query_buf[DNS_QUERY_MAX_SIZE];
+static uint8_t resp_buf[DNS_RESPONSE_MAX_SIZE];
+
+/* Owned by the DNS task. */
+static dns_cache_entry_t cache[DNS_CACHE_ENTRIES];
+static uint32_t cache_clock;
+
+/*
+ * Offset just past QTYPE/QCLASS of the first question, or 0 if it is malformed.
+ * Every label is bounds-checked against the datagram; compression pointers have
+ * no business in a query's question and are rejected with the other label types.
+ */
+static size_t question_end(const uint8_t *q, size_t len) {
+	size_t i = DNS_HEADER_SIZE;
+	size_t name_len = 1;
+
+	while (i < len && q[i] != 0) {
+		if (q[i] > 63) {
+			return 0;
+		}
+		name_len += q[i] + 1;
+		if (name_len > 255) {
+			return 0;
+		}
+		i += q[i] + 1;
+	}
+	if (i >= len) {
+		return 0;
+	}
+	i += 1 + 4;
+	return i <= len ? i : 0;
+}
+
+size_t dns_server_respond(const uint8_t *query, size_t len, uint32_t addr,
+		uint8_t resp[DNS_RESPONSE_MAX_SIZE], dns_result_t *result) {
+	size_t out = DNS_HEADER_SIZE;
+	size_t qend = 0;
+	uint8_t rcode = DNS_RCODE_NO_ERROR;
+	uint8_t qdcount = 0;
+	uint8_t ancount = 0;
+
+	/* Too short to carry an ID, or a response: replying could start a loop. */
+	if (len < DNS_HEADER_SIZE || (query[2] & 0x80)) {
+		*result = DNS_RESULT_DROPPED;
+		return 0;
+	}
+	if (len > DNS_QUERY_MAX_SIZE) {
+		len = DNS_QUERY_MAX_SIZE;
+	}
+
+	uint8_t opcode = (query[2] >> 3) & 0x0f;
+	if (opcode != 0) {
+		rcode = DNS_RCODE_NOT_IMPLEMENTED;
+		*result = DNS_RESULT_NOTIMP;
+	} else if (query[4] != 0 || query[5] != 1 || (qend = question_end(query, len)) == 0) {
+		rcode = DNS_RCODE_FORM_ERROR;
+		*result = DNS_RESULT_FORMERR;
+	} else {
+		uint16_t qtype = (query[qend - 4] << 8) | query[qend - 3];
+		uint16_t qclass = (query[qend - 2] << 8) | query[qend - 1];
+
+		/* The question is echoed as is; anything after it (EDNS OPT and the like) is not. */
+		memcpy(resp + DNS_HEADER_SIZE, query + DNS_HEADER_SIZE, qend - DNS_HEADER_SIZE);
+		out = qend;
+		qdcount = 1;
+		if (qclass != DNS_CLASS_IN && qclass != DNS_CLASS_ANY) {
+			rcode = DNS_RCODE_NXDOMAIN;
+			*result = DNS_RESULT_NXDOMAIN;
+		} else if (qtype == DNS_TYPE_A || qtype == DNS_TYPE_ANY) {
+			static const uint8_t rr[] = {
+				0xc0, 0x0c,                       /* name: the question's, at offset 12 */
+				0x00, DNS_TYPE_A, 0x00, DNS_CLASS_IN,
+				(DNS_SERVER_TTL_S >> 24) & 0xff, (DNS_SERVER_TTL_S >> 16) & 0xff,
+				(DNS_SERVER_TTL_S >> 8) & 0xff, DNS_SERVER_TTL_S & 0xff,
+				0x00, 0x04
+			};
+			memcpy(resp + out, rr, sizeof(rr));
+			memcpy(resp + out + sizeof(rr), &addr, 4);
+			out += DNS_ANSWER_SIZE;
+			ancount = 1;
+			*result = DNS_RESULT_ANSWERED;
+		} else {
+			/*
+			 * NOERROR with no answer rather than NXDOMAIN: a negative answer to
+			 * the AAAA query makes some stub resolvers discard the A answer too.
+			 */
+			*result = DNS_RESULT_NODATA;
+		}
+	}
+
+	resp[0] = query[0];
+	resp[1] = query[1];
+	resp[2] = 0x80 | (opcode << 3) | 0x04 | (query[2] & 0x01);   /* QR, opcode, AA, RD copied */
+	resp[3] = rcode;                                                /* RA = 0 */
+	resp[4] = 0;
+	resp[5] = qdcount;
+	resp[6] = 0;
+	resp[7] = ancount;
+	memset(resp + 8, 0, 4);                                         /* NSCOUNT, ARCOUNT */
+	return out;
+}
+
+/* Only a plain QUERY with one well-formed question has a key; everything else takes the slow path. */
+static void cache_key(const uint8_t *query, size_t len, dns_cache_key_t *key) {
+	uint32_t h = 2166136261u;
+
+	key->qend = 0;
+	if (len < DNS_HEADER_SIZE || (query[2] & 0xf8) != 0 || query[4] != 0 || query[5] != 1) {
+		return;
+	}
+	size_t qend = question_end(query, len);
+	if (qend == 0 || qend + DNS_ANSWER_SIZE > DNS_CACHE_ENTRY_SIZE) {
+		return;
+	}
+	for (size_t i = DNS_HEADER_SIZE; i < qend; i++) {
+		h = (h ^ query[i]) * 16777619u;
+	}
+	key->hash = h;
+	key->qtype = (query[qend - 4] << 8) | query[qend - 3];
+	key->qend = qend;
+}
+
+/*
+ * A hit is patched in place for this query (ID and RD are all that differ) and
+ * sent from the entry. The question bytes are compared in full, so a hash
+ * collision costs a miss, never a wrong answer, and the echoed name keeps the
+ * client's letter case.
+ */
+static dns_cache_entry_t *cache_lookup(const uint8_t *query, const dns_cache_key_t *key) {
+	if (key->qend == 0) {
+		return NULL;
+	}
+	for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+		dns_cache_entry_t *e = &cache[i];
+		if (e->len && e->hash == key->hash && e->qtype == key->qtype && e->qend == key->qend &&
+				memcmp(e->resp + DNS_HEADER_SIZE, query + DNS_HEADER_SIZE, key->qend - DNS_HEADER_SIZE) == 0) {
+			e->resp[0] = query[0];
+			e->resp[1] = query[1];
+			e->resp[2] = (e->resp[2] & ~0x01) | (query[2] & 0x01);
+			e->last_used = ++cache_clock;
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/* Least recently used entry makes room. */
+static void cache_store(const dns_cache_key_t *key, const uint8_t *resp, size_t len, dns_result_t result) {
+	dns_cache_entry_t *victim = &cache[0];
+
+	if (key->qend == 0 || len > DNS_CACHE_ENTRY_SIZE) {
+		return;
+	}
+	for (int i = 1; i < DNS_CACHE_ENTRIES && victim->len; i++) {
+		if (cache[i].len == 0 || cache[i].last_used < victim->last_used) {
+			victim = &cache[i];
+		}
+	}
+	victim->hash = key->hash;
+	victim->qtype = key->qtype;
+	victim->qend = key->qend;
+	victim->len = len;
+	victim->result = result;
+	victim->last_used = ++cache_clock;
+	memcpy(victim->resp, resp, len);
+}
+
+/* Blocks in recvfrom; no logging on the query path. */
+static void dns_server_task(void *arg) {
+	struct sockaddr_in client;
+	uint32_t addr = inet_addr(DEFAULT_AP_IP);
+
+	while (dns_running) {
+		socklen_t client_len = sizeof(client);
+		int len = recvfrom(dns_fd, query_buf, sizeof(query_buf), 0, (struct sockaddr *)&client, &client_len);
+		if (!dns_running) {
+			break;
+		}
+		if (len < 0 && errno == EINTR) {
+			/* The Linux FreeRTOS port's tick signal. */
+			continue;
+		}
+		if (len < 0) {
+			/* Not expected on a bound UDP socket; do not spin if it keeps failing. */
+			vTaskDelay(pdMS_TO_TICKS(10));
+			continue;
+		}
+
+		int64_t t0 = now_us();
+		dns_result_t result;
+		dns_cache_key_t key;
+		const uint8_t *out = resp_buf;
+		size_t n;
+
+		cache_key(query_buf, len, &key);
+		dns_cache_entry_t *hit = cache_lookup(query_buf, &key);
+		if (hit) {
+			out = hit->resp;
+			n = hit->len;
+			result = hit->result;
+		} else {
+			n = dns_server_respond(query_buf, len, addr, resp_buf, &result);
+			if (n) {
+				cache_store(&key, resp_buf, n, result);
+			}
+		}
+		bool send_error = n && sendto(dns_fd, out, n, 0, (struct sockaddr *)&client, client_len) != (int)n;
+		uint32_t us = (uint32_t)(now_us() - t0);
+
+		taskENTER_CRITICAL(&stats_mux);
+		stats.queries++;
+		stats.results[result]++;
+		stats.send_errors += send_error;
+		stats.busy_us += us;
+		if (hit) {
+			stats.cache_hits++;
+			stats.hit_us += us;
+		}
+		if (us > stats.max_us) {
+			stats.max_us = us;
+		}
+		taskEXIT_CRITICAL(&stats_mux);
+	}
+
+	close(dns_fd);
+	dns_fd = -1;
+	xSemaphoreGive(dns_done);
+	vTaskDelete(NULL);
+}
+
+esp_err_t dns_server_start(void) {
+	struct sockaddr_in sa = {
+		.sin_family = AF_INET,
+		.sin_port = htons(DNS_SERVER_PORT),
+		.sin_addr.s_addr = inet_addr(DEFAULT_AP_IP),
+	};
+
+	if (dns_task) {
+		return ESP_OK;
+	}
+	if (dns_done == NULL && (dns_done = xSemaphoreCreateBinary()) == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+
+	/* Bound to the AP address only: queries arriving on the station side are not ours. */
+	dns_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (dns_fd < 0) {
+		ESP_LOGE(TAG, "socket: errno %d", errno);
+		return ESP_FAIL;
+	}
+	if (bind(dns_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+		ESP_LOGE(TAG, "bind %s:%d: errno %d", DEFAULT_AP_IP, DNS_SERVER_PORT, errno);
+		close(dns_fd);
+		dns_fd = -1;
+		return ESP_FAIL;
+	}
+
+	memset(cache, 0, sizeof(cache));
+	cache_clock = 0;
+	dns_running = true;
+	if (xTaskCreate(dns_server_task, "dns_server", DNS_SERVER_TASK_STACK, NULL,
+			DNS_SERVER_TASK_PRIORITY, &dns_task) != pdPASS) {
+		dns_running = false;
+		dns_task = NULL;
+		close(dns_fd);
+		dns_fd = -1;
+		return ESP_ERR_NO_MEM;
+	}
+	ESP_LOGI(TAG, "Listening on %s:%d/udp", DEFAULT_AP_IP, DNS_SERVER_PORT);
+	return ESP_OK;
+}
+
+/*
+ * lwIP cannot shut down a UDP socket under a blocked reader, so the task is
+ * woken with an empty datagram to its own address (netif loopback) and closes
+ * the socket itself.
+ */
+void dns_server_stop(void) {
+	struct sockaddr_in sa = {
+		.sin_family = AF_INET,
+		.sin_port = htons(DNS_SERVER_PORT),
+		.sin_addr.s_addr = inet_addr(DEFAULT_AP_IP),
+	};
+
+	if (dns_task == NULL) {
+		return;
+	}
+	dns_running = false;
+
+	/* All sockets can be taken (see DEFAULT_HTTP_MAX_SOCKETS); the server's own then does the send. */
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	sendto(fd >= 0 ? fd : dns_fd, NULL, 0, 0, (struct sockaddr *)&sa, sizeof(sa));
+	if (fd >= 0) {
+		close(fd);
+	}
+	if (xSemaphoreTake(dns_done, pdMS_TO_TICKS(1000)) != pdTRUE) {
+		/* Leave the handle set: a later start must not bind over a live task. */
+		ESP_LOGE(TAG, "Task did not stop");
+		return;
+	}
+	dns_task = NULL;
+	ESP_LOGI(TAG, "Stopped");
 }
 
-void dns_server_stop(){
-    if(task_dns_server){
-        vTaskDelete(task_dns_server);
-        close(socket_fd);
-        task_dns_server = NULL;
-    }
+void dns_server_get_stats(dns_server_stats_t *out) {
+	taskENTER_CRITICAL(&stats_mux);
+	*out = stats;
+	taskEXIT_CRITICAL(&stats_mux);
 }
 
-void dns_server(void *pvParameters) {
-
-    struct sockaddr_in ra;
-    ip4_addr_t ip_resolved;
-    inet_pton(AF_INET, DEFAULT_AP_IP, &ip_resolved);
-
-    socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (socket_fd < 0){
-        ESP_LOGE(TAG, "Failed to create socket");
-        exit(0);
-    }
-
-    esp_netif_ip_info_t ip;
-    esp_netif_t* netif_sta = wifi_manager_get_esp_netif_sta();
-    ESP_ERROR_CHECK(esp_netif_get_ip_info(netif_sta, &ip));
-    ra.sin_family = AF_INET;
-    ra.sin_addr.s_addr = ip.ip.addr;
-    ra.sin_port = htons(53);
-    if (bind(socket_fd, (struct sockaddr *)&ra, sizeof(struct sockaddr_in)) == -1) {
-        ESP_LOGE(TAG, "Failed to bind to 53/udp");
-        close(socket_fd);
-        exit(1);
-    }
-
-    struct sockaddr_in client;
-    socklen_t client_len = sizeof(client);
-    int length;
-    uint8_t data[DNS_QUERY_MAX_SIZE];
-    uint8_t response[DNS_ANSWER_MAX_SIZE];
-    char ip_address[INET_ADDRSTRLEN];
-    char *domain;
-    int err;
-
-    ESP_LOGI(TAG, "DNS Server listening on 53/udp");
-
-    for(;;) {
-        memset(data, 0x00, sizeof(data));
-        length = recvfrom(socket_fd, data, sizeof(data), 0, (struct sockaddr *)&client, &client_len);
-
-        if (length > 0 && ((length + sizeof(dns_answer_t) - 1) < DNS_ANSWER_MAX_SIZE)) {
-            data[length] = '\0';
-
-            memcpy(response, data, sizeof(dns_header_t));
-            dns_header_t *dns_header = (dns_header_t*)response;
-            dns_header->QR = 1;
-            dns_header->OPCode = DNS_OPCODE_QUERY;
-            dns_header->AA = 1;
-            dns_header->RCode = DNS_REPLY_CODE_NO_ERROR;
-            dns_header->TC = 0;
-            dns_header->RD = 0;
-            dns_header->ANCount = dns_header->QDCount;
-            dns_header->NSCount = 0x0000;
-            dns_header->ARCount = 0x0000;
-
-            memcpy(response + sizeof(dns_header_t), data + sizeof(dns_header_t), length - sizeof(dns_header_t));
-
-            inet_ntop(AF_INET, &(client.sin_addr), ip_address, INET_ADDRSTRLEN);
-            domain = (char*) &data[sizeof(dns_header_t) + 1];
-            for(char* c = domain; *c != '\0'; c++){
-                if(*c < ' ' || *c > 'z') *c = '.';
-            }
-            ESP_LOGI(TAG, "Replying to DNS request for %s from %s", domain, ip_address);
-
-            dns_answer_t *dns_answer = (dns_answer_t*)&response[length];
-            dns_answer->NAME = __builtin_bswap16(0xC00C);
-            dns_answer->TYPE = __builtin_bswap16(DNS_ANSWER_TYPE_A);
-            dns_answer->CLASS = __builtin_bswap16(DNS_ANSWER_CLASS_IN);
-            dns_answer->TTL = 0x00000000;
-            dns_answer->RDLENGTH = __builtin_bswap16(0x0004);
-            dns_answer->RDATA = ip_resolved.addr;
-
-            err = sendto(socket_fd, response, length + sizeof(dns_answer_t), 0, (struct sockaddr *)&client, client_len);
-            if (err < 0) {
-                ESP_LOGE(TAG, "UDP sendto failed: %d", err);
-            }
-        }
-
-        taskYIELD();
-    }
-
-    close(socket_fd);
-    vTaskDelete(NULL);
+const char *dns_server_result_name(dns_result_t result) {
+	static const char *const names[DNS_RESULTS] = {
+		"answered", "nodata", "nxdomain", "notimp", "formerr", "dropped"
+	};
+	return result < DNS_RESULTS ? names[result] : "?";
 }
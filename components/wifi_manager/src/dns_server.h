@@ -1,137 +1,116 @@
 /*
-Copyright (c) 2019 Tony Pottier
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-SOFTWARE.
-
-@file dns_server.h
-@author Tony Pottier
-@brief Defines an extremly basic DNS server for captive portal functionality.
-
-Contains the freeRTOS task for the DNS server that processes the requests.
+ *  dns_server.h
+ *
+ *  Created on: 2019 (Tony Pottier, see licence below)
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.62
+ *
+ *  Captive-portal DNS responder: every A query for any name is answered with
+ *  the SoftAP address, so whatever a phone looks up leads to the portal.
+ *
+ *  Copyright (c) 2019 Tony Pottier
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a copy
+ *  of this software and associated documentation files (the "Software"), to deal
+ *  in the Software without restriction, including without limitation the rights
+ *  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ *  copies of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in all
+ *  copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ *  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ *  SOFTWARE.
+ */
 
-@see https://idyl.io
-@see https://github.com/tonyp7/wifi_manager
-@see http://www.zytrax.com/books/dns/ch15
-*/
+#ifndef DNS_SERVER_H_
+#define DNS_SERVER_H_
 
-#ifndef MAIN_DNS_SERVER_H_
-#define MAIN_DNS_SERVER_H_
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-
-/** 12 byte header, 64 byte domain name, 4 byte qtype/qclass. This NOT compliant with the RFC, but it's good enough for a captive portal
- * if a DNS query is too big it just wont be processed. */
-#define	DNS_QUERY_MAX_SIZE 80
-
-/** Query + 2 byte ptr, 2 byte type, 2 byte class, 4 byte TTL, 2 byte len, 4 byte data */
-#define	DNS_ANSWER_MAX_SIZE (DNS_QUERY_MAX_SIZE+16)
-
+/* Classic UDP limit. Anything longer is truncated by recvfrom; the question comes first, so it still parses. */
+#define DNS_QUERY_MAX_SIZE    512
+#define DNS_HEADER_SIZE       12
+/* Answer appended to the echoed question: name pointer, type, class, TTL, rdlength, IPv4 address. */
+#define DNS_ANSWER_SIZE       16
+#define DNS_RESPONSE_MAX_SIZE (DNS_QUERY_MAX_SIZE + DNS_ANSWER_SIZE)
+
+typedef enum {
+	DNS_RCODE_NO_ERROR = 0,
+	DNS_RCODE_FORM_ERROR = 1,
+	DNS_RCODE_SERVER_FAILURE = 2,
+	DNS_RCODE_NXDOMAIN = 3,
+	DNS_RCODE_NOT_IMPLEMENTED = 4,
+	DNS_RCODE_REFUSED = 5
+} dns_rcode_t;
+
+typedef enum {
+	DNS_TYPE_A = 1,
+	DNS_TYPE_AAAA = 28,
+	DNS_TYPE_ANY = 255
+} dns_type_t;
+
+#define DNS_CLASS_IN 1
+
+/* How one query was handled; also the index into dns_server_stats_t.results. */
+typedef enum {
+	DNS_RESULT_ANSWERED = 0,   /* A (or ANY) record with the AP address */
+	DNS_RESULT_NODATA,         /* other types: NOERROR, no answer */
+	DNS_RESULT_NXDOMAIN,       /* other classes */
+	DNS_RESULT_NOTIMP,         /* opcode other than QUERY */
+	DNS_RESULT_FORMERR,        /* bad question section */
+	DNS_RESULT_DROPPED,        /* shorter than a header, or a response: no reply at all */
+	DNS_RESULTS
+} dns_result_t;
+
+typedef struct {
+	uint32_t queries;
+	uint32_t results[DNS_RESULTS];
+	uint32_t send_errors;
+	uint32_t cache_hits;       /* answered from a prebuilt response */
+	uint64_t busy_us;          /* parse, build and sendto, summed over all queries */
+	uint64_t hit_us;           /* the part of busy_us spent on cache hits */
+	uint32_t max_us;
+} dns_server_stats_t;
 
 /**
- * @brief RCODE values used in a DNS header message
+ * @brief Build the reply to one query. Pure function of its inputs, no I/O.
+ * @param addr IPv4 address for A answers, network order.
+ * @param result Set to how the query was handled.
+ * @return Reply length, 0 when nothing must be sent.
  */
-typedef enum dns_reply_code_t {
-	DNS_REPLY_CODE_NO_ERROR = 0,
-	DNS_REPLY_CODE_FORM_ERROR = 1,
-	DNS_REPLY_CODE_SERVER_FAILURE = 2,
-	DNS_REPLY_CODE_NON_EXISTANT_DOMAIN = 3,
-	DNS_REPLY_CODE_NOT_IMPLEMENTED = 4,
-	DNS_REPLY_CODE_REFUSED = 5,
-	DNS_REPLY_CODE_YXDOMAIN = 6,
-	DNS_REPLY_CODE_YXRRSET = 7,
-	DNS_REPLY_CODE_NXRRSET = 8
-}dns_reply_code_t;
-
-
+size_t dns_server_respond(const uint8_t *query, size_t len, uint32_t addr,
+		uint8_t resp[DNS_RESPONSE_MAX_SIZE], dns_result_t *result);
 
 /**
- * @brief OPCODE values used in a DNS header message
+ * @brief Start answering on DEFAULT_AP_IP, port 53. Does nothing if already running.
  */
-typedef enum dns_opcode_code_t {
-	DNS_OPCODE_QUERY = 0,
-	DNS_OPCODE_IQUERY = 1,
-	DNS_OPCODE_STATUS = 2
-}dns_opcode_code_t;
-
-
+esp_err_t dns_server_start(void);
 
 /**
- * @brief Represents a 12 byte DNS header.
- * __packed__ is needed to prevent potential unwanted memory alignments
+ * @brief Stop the responder and wait for its task to release the socket.
  */
-typedef struct __attribute__((__packed__)) dns_header_t{
-  uint16_t ID;         // identification number
-  uint8_t RD : 1;      // recursion desired
-  uint8_t TC : 1;      // truncated message
-  uint8_t AA : 1;      // authoritive answer
-  uint8_t OPCode : 4;  // message_type
-  uint8_t QR : 1;      // query/response flag
-  uint8_t RCode : 4;   // response code
-  uint8_t Z : 3;       // its z! reserved
-  uint8_t RA : 1;      // recursion available
-  uint16_t QDCount;    // number of question entries
-  uint16_t ANCount;    // number of answer entries
-  uint16_t NSCount;    // number of authority entries
-  uint16_t ARCount;    // number of resource entries
-}dns_header_t;
-
-
-
-typedef enum dns_answer_type_t {
-	DNS_ANSWER_TYPE_A = 1,
-	DNS_ANSWER_TYPE_NS = 2,
-	DNS_ANSWER_TYPE_CNAME = 5,
-	DNS_ANSWER_TYPE_SOA = 6,
-	DNS_ANSWER_TYPE_WKS = 11,
-	DNS_ANSWER_TYPE_PTR = 12,
-	DNS_ANSWER_TYPE_MX = 15,
-	DNS_ANSWER_TYPE_SRV = 33,
-	DNS_ANSWER_TYPE_AAAA = 28
-}dns_answer_type_t;
-
-typedef enum dns_answer_class_t {
-	DNS_ANSWER_CLASS_IN = 1
-}dns_answer_class_t;
-
-
-
-typedef struct __attribute__((__packed__)) dns_answer_t{
-	uint16_t NAME;	/* for the sake of simplicity only 16 bit pointers are supported */
-	uint16_t TYPE; /* Unsigned 16 bit value. The resource record types - determines the content of the RDATA field. */
-	uint16_t CLASS; /* Class of response. */
-	uint32_t TTL; /* The time in seconds that the record may be cached. A value of 0 indicates the record should not be cached. */
-	uint16_t RDLENGTH; /* Unsigned 16-bit value that defines the length in bytes of the RDATA record. */
-	uint32_t RDATA; /* For the sake of simplicity only ipv4 is supported, and as such it's a unsigned 32 bit */
-}dns_answer_t;
-
-void dns_server(void *pvParameters);
-void dns_server_start();
-void dns_server_stop();
+void dns_server_stop(void);
 
+void dns_server_get_stats(dns_server_stats_t *out);
 
+const char *dns_server_result_name(dns_result_t result);
 
 #ifdef __cplusplus
 }
 #endif
 
-
-#endif /* MAIN_DNS_SERVER_H_ */
+#endif /* DNS_SERVER_H_ */
@@ -2,74 +2,1122 @@
  *  http_app.c
  *
  *  Created on: 2025-06-12
- *  Edited on: 2025-07-07
+ *  Edited on: 2026-10-19
  *      Author: Andwardo
- *      Version: v8.2.38
+ *      Version: v8.2.72
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "esp_http_server.h"
+#include "esp_event.h"
+#include "esp_wifi.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "lwip/sockets.h"
+#include "mbedtls/base64.h"
 #include "http_app.h"
+#include "wifi_scan.h"
+#include "dns_server.h"
+#include "settings.h"
+#include "nvs_sync.h"
+#include "wifi_manager.h"
+#include "json.h"
+#include "portal_assets.h"
 
-extern const uint8_t index_html_start[] asm("_binary_index_html_start");
-extern const uint8_t index_html_end[]   asm("_binary_index_html_end");
-extern const uint8_t code_js_start[]    asm("_binary_code_js_start");
-extern const uint8_t code_js_end[]      asm("_binary_code_js_end");
-extern const uint8_t style_css_start[]  asm("_binary_style_css_start");
-extern const uint8_t style_css_end[]    asm("_binary_style_css_end");
+/* Minified and gzipped at build time (tools/portal_assets.py). */
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+extern const uint8_t code_js_gz_start[]    asm("_binary_code_js_gz_start");
+extern const uint8_t code_js_gz_end[]      asm("_binary_code_js_gz_end");
+extern const uint8_t style_css_gz_start[]  asm("_binary_style_css_gz_start");
+extern const uint8_t style_css_gz_end[]    asm("_binary_style_css_gz_end");
+extern const uint8_t dash_html_gz_start[]  asm("_binary_dash_html_gz_start");
+extern const uint8_t dash_html_gz_end[]    asm("_binary_dash_html_gz_end");
+
+typedef struct {
+    const uint8_t *start;
+    const uint8_t *end;
+    const char *type;
+    const char *etag;
+    const char *cache_control;
+} http_asset_t;
+
+/*
+ * index.html links the others as "<file>?v=<etag>", so they never change under
+ * their URL and can be cached for good; only index.html is revalidated.
+ */
+static const http_asset_t asset_index = {
+    index_html_gz_start, index_html_gz_end, "text/html", PORTAL_ETAG_INDEX_HTML, "no-cache"
+};
+static const http_asset_t asset_js = {
+    code_js_gz_start, code_js_gz_end, "application/javascript", PORTAL_ETAG_CODE_JS, "public, max-age=31536000, immutable"
+};
+static const http_asset_t asset_css = {
+    style_css_gz_start, style_css_gz_end, "text/css", PORTAL_ETAG_STYLE_CSS, "public, max-age=31536000, immutable"
+};
+static const http_asset_t asset_dash = {
+    dash_html_gz_start, dash_html_gz_end, "text/html", PORTAL_ETAG_DASH_HTML, "no-cache"
+};
+
+#define ROUTE_PORTAL 0x01    /* 404 unless the portal is up */
+#define ROUTE_AUTH   0x02    /* basic auth with the dashboard credentials */
+
+typedef struct {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req, const void *ctx);
+    const void *ctx;
+    uint8_t flags;
+} http_route_t;
 
 static const char *TAG = "http_app";
 
-static esp_err_t index_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/html");
-    return httpd_resp_send(req, (const char *)index_html_start, index_html_end - index_html_start);
+/* Written by the httpd task only; the mux is for readers on other tasks. */
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static http_app_route_stats_t stats[HTTP_APP_ROUTES];
+static http_app_server_stats_t server_stats;
+
+/*
+ * Socket budget: esp_http_server keeps 3 sockets of its own, and MQTT, the
+ * portal DNS server and the OTA download need one each.
+ */
+#define HTTP_INTERNAL_SOCKETS 3
+#define OTHER_SOCKETS         3
+#if DEFAULT_HTTP_MAX_SOCKETS + HTTP_INTERNAL_SOCKETS + OTHER_SOCKETS > CONFIG_LWIP_MAX_SOCKETS
+#error "DEFAULT_HTTP_MAX_SOCKETS does not fit in CONFIG_LWIP_MAX_SOCKETS"
+#endif
+
+/* Per open connection, found by socket; only touched on the httpd task. */
+typedef struct {
+    int fd;                /* -1 = free */
+    int64_t open_us;
+    uint32_t requests;
+    uint64_t busy_us;
+} http_conn_t;
+static http_conn_t conns[DEFAULT_HTTP_MAX_SOCKETS];
+
+static volatile bool portal_mode = false;
+static const wifi_manager_dashboard_t *volatile dashboard = NULL;
+
+/* "Basic " + base64("user:password"), built once at start-up. */
+#define AUTH_HDR_SIZE 128
+static char auth_expected[AUTH_HDR_SIZE];
+
+/* /ap.json as last copied out of wifi_scan; handlers and SSE pushes all run on the httpd task. */
+static char scan_json[WIFI_SCAN_JSON_SIZE];
+
+/*
+ * Server-sent events. Each /events client is an async request owned by the
+ * httpd task: pushes are queued there with httpd_queue_work(), so sockets are
+ * only ever written from one task and a slow client cannot stall the caller.
+ */
+#define SSE_MAX_CLIENTS   2
+#define SSE_PING_PERIOD_S 15
+
+static httpd_req_t *sse_clients[SSE_MAX_CLIENTS];
+static httpd_handle_t sse_server = NULL;
+static esp_timer_handle_t sse_ping_timer = NULL;
+static portMUX_TYPE sse_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t sse_pending = 0;
+static char sse_last_etag[WIFI_SCAN_ETAG_LEN + 1];
+
+#define SSE_PING (1u << 31)
+
+/*
+ * Captive portal. OS connectivity probes and any other unknown GET are answered
+ * with the same prebuilt 302, written straight to the socket, so the phone pops
+ * the portal on its first probe instead of after a timeout.
+ */
+#define PORTAL_URL "http://" DEFAULT_AP_IP "/"
+static const char portal_redirect[] =
+    "HTTP/1.1 302 Found\r\n"
+    "Location: " PORTAL_URL "\r\n"
+    "Cache-Control: no-store\r\n"
+    "Content-Length: 0\r\n"
+    "\r\n";
+
+typedef struct {
+    const char *uri;
+    const char *os;
+} portal_probe_t;
+
+static const portal_probe_t portal_probes[] = {
+    { "/generate_204",              "android" },
+    { "/gen_204",                   "android" },
+    { "/hotspot-detect.html",       "apple" },
+    { "/library/test/success.html", "apple" },
+    { "/ncsi.txt",                  "windows" },
+    { "/connecttest.txt",           "windows" },
+    { "/redirect",                  "windows" },
+    { "/canonical.html",            "firefox" },
+    { "/success.txt",               "firefox" },
+};
+#define PORTAL_PROBES (sizeof(portal_probes) / sizeof(portal_probes[0]))
+
+/* Association to first probe and to the portal page, per SoftAP client; written on the event loop and httpd tasks. */
+#define PORTAL_CLIENTS DEFAULT_AP_MAX_CONNECTIONS
+static portMUX_TYPE portal_mux = portMUX_INITIALIZER_UNLOCKED;
+static http_app_portal_client_t portal_clients[PORTAL_CLIENTS];
+static esp_event_handler_instance_t portal_sta_handler = NULL;
+static esp_event_handler_instance_t portal_ip_handler = NULL;
+
+/* Outcome of the request being served, for the counters; httpd has a single worker task. */
+static enum { OUTCOME_OK, OUTCOME_NOT_MODIFIED, OUTCOME_CLIENT_ERROR } outcome;
+
+static esp_err_t send_not_modified(httpd_req_t *req) {
+    outcome = OUTCOME_NOT_MODIFIED;
+    httpd_resp_set_status(req, "304 Not Modified");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+static esp_err_t send_bad_request(httpd_req_t *req, const char *msg) {
+    outcome = OUTCOME_CLIENT_ERROR;
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+}
+
+static esp_err_t send_not_found(httpd_req_t *req) {
+    outcome = OUTCOME_CLIENT_ERROR;
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+}
+
+static bool auth_init(void) {
+    static const char creds[] = DEFAULT_DASHBOARD_USER ":" DEFAULT_DASHBOARD_PASSWORD;
+    size_t olen = 0;
+
+    strcpy(auth_expected, "Basic ");
+    return mbedtls_base64_encode((unsigned char *)auth_expected + 6, sizeof(auth_expected) - 6, &olen,
+                                 (const unsigned char *)creds, sizeof(creds) - 1) == 0;
+}
+
+/* Compares the whole header whatever it holds, so the timing says nothing about the password. */
+static bool auth_ok(httpd_req_t *req) {
+    char got[AUTH_HDR_SIZE] = { 0 };
+    uint8_t diff = 0;
+
+    if (auth_expected[0] == '\0' ||
+            httpd_req_get_hdr_value_str(req, "Authorization", got, sizeof(got)) != ESP_OK) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof(got); i++) {
+        diff |= (uint8_t)(got[i] ^ auth_expected[i]);
+    }
+    return diff == 0;
+}
+
+static esp_err_t send_unauthorized(httpd_req_t *req) {
+    outcome = OUTCOME_CLIENT_ERROR;
+    httpd_resp_set_status(req, "401 Unauthorized");
+    httpd_resp_set_hdr(req, "WWW-Authenticate", "Basic realm=\"PianoGuard\", charset=\"UTF-8\"");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+/* Every browser that can run the portal accepts gzip, so there is no identity fallback. */
+static esp_err_t asset_handler(httpd_req_t *req, const void *ctx) {
+    const http_asset_t *asset = ctx;
+    char if_none_match[24];
+
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+            strcmp(if_none_match, asset->etag) == 0) {
+        return send_not_modified(req);
+    }
+
+    httpd_resp_set_type(req, asset->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset->start, asset->end - asset->start);
+}
+
+/* Served from the pre-rendered scan cache; browsers polling every few seconds mostly get a 304. */
+static esp_err_t ap_json_handler(httpd_req_t *req, const void *ctx) {
+    char if_none_match[WIFI_SCAN_ETAG_LEN + 1];
+    char etag[WIFI_SCAN_ETAG_LEN + 1];
+
+    bool has_inm = httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    /* Sent from a copy: a stalled client must not hold the scan lock for the send timeout. */
+    size_t len = wifi_scan_copy(scan_json, etag);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    if (has_inm && strcmp(if_none_match, etag) == 0) {
+        return send_not_modified(req);
+    }
+    return httpd_resp_send(req, scan_json, len);
+}
+
+#define STATUS_JSON_SIZE 384
+
+static void json_kv_ip(json_writer_t *w, const char *key, const esp_ip4_addr_t *ip) {
+    char s[16];
+    snprintf(s, sizeof(s), IPSTR, IP2STR(ip));
+    json_kv_str(w, key, s);
+}
+
+/* STATUS_JSON_SIZE holds a fully escaped SSID, so this always fits. */
+static int render_status(char *buf, size_t size) {
+    wifi_manager_sta_status_t st;
+    json_writer_t w;
+
+    wifi_manager_get_sta_status(&st);
+    json_writer_init(&w, buf, size, NULL, NULL);
+    json_obj_begin(&w);
+    json_kv_str(&w, "ssid", st.ssid);
+    json_kv_ip(&w, "ip", &st.ip_info.ip);
+    json_kv_ip(&w, "netmask", &st.ip_info.netmask);
+    json_kv_ip(&w, "gw", &st.ip_info.gw);
+    json_kv_int(&w, "urc", st.urc);
+    json_kv_uint(&w, "attempt", st.attempt);
+    json_kv_bool(&w, "portal", st.portal_up);
+    json_obj_end(&w);
+    json_writer_finish(&w);
+    return (int)w.len;
+}
+
+/* Polled by the portal while a join is in progress (when /events is not available); "urc" drives the wait screen. */
+static esp_err_t status_json_handler(httpd_req_t *req, const void *ctx) {
+    char buf[STATUS_JSON_SIZE];
+    int len = render_status(buf, sizeof(buf));
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, buf, len);
+}
+
+/*
+ * Credentials as {"ssid":"...","pwd":"..."}, parsed in place into a fixed token
+ * array. A body-less POST with X-Custom-ssid / X-Custom-pwd headers, the old form,
+ * still works; headers cannot carry every SSID byte, the JSON escapes can.
+ */
+#define CONNECT_BODY_MAX 256
+#define CONNECT_TOKENS   16
+
+typedef struct {
+    char ssid[33];
+    char pwd[65];
+} connect_req_t;
+
+static const json_field_t connect_fields[] = {
+    JSON_BIND_STR("ssid", connect_req_t, ssid, true, 1),
+    JSON_BIND_STR("pwd", connect_req_t, pwd, false, 0),
+};
+
+/* Each returns NULL, or what to answer with in a 400. */
+static const char *connect_from_headers(httpd_req_t *req, connect_req_t *cr) {
+    if (httpd_req_get_hdr_value_str(req, "X-Custom-ssid", cr->ssid, sizeof(cr->ssid)) != ESP_OK || cr->ssid[0] == '\0') {
+        return "Missing or invalid X-Custom-ssid";
+    }
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "X-Custom-pwd", cr->pwd, sizeof(cr->pwd));
+    if (err == ESP_ERR_NOT_FOUND) {
+        cr->pwd[0] = '\0';
+    } else if (err != ESP_OK) {
+        return "Invalid X-Custom-pwd";
+    }
+    return NULL;
+}
+
+static const char *connect_from_body(const char *body, size_t len, connect_req_t *cr) {
+    json_tok_t toks[CONNECT_TOKENS];
+    const char *bad = NULL;
+
+    if (json_parse(body, len, toks, CONNECT_TOKENS) < 0) {
+        return "Invalid JSON";
+    }
+    if (json_bind(body, toks, 0, connect_fields, sizeof(connect_fields) / sizeof(connect_fields[0]), cr, &bad) != JSON_OK) {
+        return bad && strcmp(bad, "pwd") == 0 ? "Missing or invalid pwd" : "Missing or invalid ssid";
+    }
+    return NULL;
+}
+
+static esp_err_t connect_json_handler(httpd_req_t *req, const void *ctx) {
+    connect_req_t cr = { 0 };
+    char body[CONNECT_BODY_MAX];
+    size_t got = 0;
+    int timeouts = 0;
+    const char *msg;
+
+    if (req->content_len == 0) {
+        msg = connect_from_headers(req, &cr);
+    } else if (req->content_len > sizeof(body)) {
+        msg = "Body too large";
+    } else {
+        while (got < req->content_len) {
+            int r = httpd_req_recv(req, body + got, req->content_len - got);
+            if (r == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < 3) {
+                continue;
+            }
+            if (r <= 0) {
+                return ESP_FAIL;
+            }
+            got += r;
+        }
+        msg = connect_from_body(body, got, &cr);
+    }
+    if (msg) {
+        return send_bad_request(req, msg);
+    }
+
+    ESP_LOGI(TAG, "Portal requested connection to %s", cr.ssid);
+    wifi_manager_connect_sta(cr.ssid, cr.pwd);
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, "{}");
+}
+
+/* "Disconnect" in the portal: drop the link and forget the network. */
+static esp_err_t disconnect_json_handler(httpd_req_t *req, const void *ctx) {
+    ESP_LOGI(TAG, "Portal requested disconnect");
+    wifi_manager_disconnect_sta();
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, "{}");
+}
+
+/* New association: take the client's slot, or the oldest one. */
+static void portal_sta_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    const wifi_event_ap_staconnected_t *ev = data;
+    int slot = 0;
+
+    taskENTER_CRITICAL(&portal_mux);
+    for (int i = 0; i < PORTAL_CLIENTS; i++) {
+        if (memcmp(portal_clients[i].mac, ev->mac, 6) == 0) {
+            slot = i;
+            break;
+        }
+        if (portal_clients[i].assoc_us < portal_clients[slot].assoc_us) {
+            slot = i;
+        }
+    }
+    memset(&portal_clients[slot], 0, sizeof(portal_clients[slot]));
+    memcpy(portal_clients[slot].mac, ev->mac, 6);
+    portal_clients[slot].assoc_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&portal_mux);
+}
+
+static void portal_ip_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    const ip_event_ap_staipassigned_t *ev = data;
+
+    taskENTER_CRITICAL(&portal_mux);
+    for (int i = 0; i < PORTAL_CLIENTS; i++) {
+        if (memcmp(portal_clients[i].mac, ev->mac, 6) == 0) {
+            portal_clients[i].ip = ev->ip.addr;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&portal_mux);
+}
+
+static uint32_t peer_ip(httpd_req_t *req) {
+    struct sockaddr_in6 addr;
+    socklen_t len = sizeof(addr);
+
+    if (getpeername(httpd_req_to_sockfd(req), (struct sockaddr *)&addr, &len) != 0) {
+        return 0;
+    }
+    if (addr.sin6_family == AF_INET) {
+        return ((struct sockaddr_in *)&addr)->sin_addr.s_addr;
+    }
+    /* IPv4-mapped IPv6, as lwIP reports it on a dual-stack listener. */
+    return addr.sin6_addr.un.u32_addr[3];
+}
+
+/* Record the first probe and the first portal page for the requesting client. */
+static void portal_note(httpd_req_t *req, const char *probe_os, bool portal_shown) {
+    uint32_t ip = peer_ip(req);
+    int64_t now = esp_timer_get_time();
+    http_app_portal_client_t done = { 0 };
+
+    if (ip == 0) {
+        return;
+    }
+    taskENTER_CRITICAL(&portal_mux);
+    for (int i = 0; i < PORTAL_CLIENTS; i++) {
+        http_app_portal_client_t *c = &portal_clients[i];
+        if (c->ip != ip || c->assoc_us == 0) {
+            continue;
+        }
+        uint32_t ms = (uint32_t)((now - c->assoc_us) / 1000);
+        if (probe_os && c->first_probe_ms == 0) {
+            c->first_probe_ms = ms ? ms : 1;
+            c->probe_os = probe_os;
+        }
+        if (portal_shown && c->portal_ms == 0) {
+            c->portal_ms = ms ? ms : 1;
+            done = *c;
+        }
+        break;
+    }
+    taskEXIT_CRITICAL(&portal_mux);
+
+    if (done.portal_ms) {
+        ESP_LOGI(TAG, "Portal shown to " MACSTR " %" PRIu32 " ms after association (first probe: %s at %" PRIu32 " ms)",
+                 MAC2STR(done.mac), done.portal_ms, done.probe_os ? done.probe_os : "none", done.first_probe_ms);
+    }
+}
+
+size_t http_app_get_portal_clients(http_app_portal_client_t *out, size_t max) {
+    size_t n = 0;
+
+    taskENTER_CRITICAL(&portal_mux);
+    for (int i = 0; i < PORTAL_CLIENTS && n < max; i++) {
+        if (portal_clients[i].assoc_us) {
+            out[n++] = portal_clients[i];
+        }
+    }
+    taskEXIT_CRITICAL(&portal_mux);
+    return n;
+}
+
+static esp_err_t send_portal_redirect(httpd_req_t *req) {
+    int ret = httpd_send(req, portal_redirect, sizeof(portal_redirect) - 1);
+    return ret == (int)(sizeof(portal_redirect) - 1) ? ESP_OK : ESP_FAIL;
+}
+
+/* Known OS connectivity checks: anything but the expected answer means "captive". */
+static esp_err_t probe_handler(httpd_req_t *req, const void *ctx) {
+    const char *os = "other";
+
+    for (size_t i = 0; i < PORTAL_PROBES; i++) {
+        if (strcmp(req->uri, portal_probes[i].uri) == 0) {
+            os = portal_probes[i].os;
+            break;
+        }
+    }
+    portal_note(req, os, false);
+    return send_portal_redirect(req);
+}
+
+/* Catch-all, registered last: unknown paths and hosts end up on the portal too. */
+static esp_err_t redirect_handler(httpd_req_t *req, const void *ctx) {
+    return send_portal_redirect(req);
+}
+
+static esp_err_t index_handler(httpd_req_t *req, const void *ctx) {
+    if (!portal_mode) {
+        httpd_resp_set_status(req, "302 Found");
+        httpd_resp_set_hdr(req, "Location", "/dash");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    esp_err_t err = asset_handler(req, ctx);
+    if (err == ESP_OK) {
+        portal_note(req, NULL, true);
+    }
+    return err;
+}
+
+static esp_err_t dash_write(void *sink, const char *data, size_t len) {
+    /* A zero-length chunk would end the response. */
+    return len ? httpd_resp_send_chunk(sink, data, len) : ESP_OK;
+}
+
+/* ctx picks the callback: 0 = status, 1 = history. Streamed straight from the provider's buffers. */
+static esp_err_t dash_json_handler(httpd_req_t *req, const void *ctx) {
+    const wifi_manager_dashboard_t *dash = dashboard;
+    esp_err_t (*render)(wifi_manager_dash_write_t, void *, void *) = NULL;
+
+    if (dash) {
+        render = ctx ? dash->history : dash->status;
+    }
+    if (render == NULL) {
+        return send_not_found(req);
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t err = render(dash_write, req, dash->ctx);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, NULL, 0);
+    }
+    return err;
+}
+
+static esp_err_t stats_json_handler(httpd_req_t *req, const void *ctx);
+static esp_err_t events_handler(httpd_req_t *req, const void *ctx);
+
+/*
+ * Order matches http_app_route_t. The provisioning API only exists while the
+ * portal is up; on the station side the server carries the dashboard alone.
+ */
+static const http_route_t routes[HTTP_APP_ROUTES] = {
+    [HTTP_APP_ROUTE_INDEX]        = { "/",                   HTTP_GET,    index_handler,           &asset_index, 0 },
+    [HTTP_APP_ROUTE_CODE_JS]      = { "/code.js",            HTTP_GET,    asset_handler,           &asset_js,    0 },
+    [HTTP_APP_ROUTE_STYLE_CSS]    = { "/style.css",          HTTP_GET,    asset_handler,           &asset_css,   0 },
+    [HTTP_APP_ROUTE_AP_JSON]      = { "/ap.json",            HTTP_GET,    ap_json_handler,         NULL, ROUTE_PORTAL },
+    [HTTP_APP_ROUTE_STATUS]       = { "/status.json",        HTTP_GET,    status_json_handler,     NULL, ROUTE_PORTAL },
+    [HTTP_APP_ROUTE_CONNECT]      = { "/connect.json",       HTTP_POST,   connect_json_handler,    NULL, ROUTE_PORTAL },
+    [HTTP_APP_ROUTE_DISCONNECT]   = { "/connect.json",       HTTP_DELETE, disconnect_json_handler, NULL, ROUTE_PORTAL },
+    [HTTP_APP_ROUTE_STATS]        = { "/stats.json",         HTTP_GET,    stats_json_handler,      NULL, ROUTE_AUTH },
+    [HTTP_APP_ROUTE_EVENTS]       = { "/events",             HTTP_GET,    events_handler,          NULL, ROUTE_PORTAL },
+    [HTTP_APP_ROUTE_DASH]         = { "/dash",               HTTP_GET,    asset_handler,           &asset_dash,  ROUTE_AUTH },
+    [HTTP_APP_ROUTE_DASH_STATUS]  = { "/dash/status.json",   HTTP_GET,    dash_json_handler,       (void *)0,    ROUTE_AUTH },
+    [HTTP_APP_ROUTE_DASH_HISTORY] = { "/dash/history.json",  HTTP_GET,    dash_json_handler,       (void *)1,    ROUTE_AUTH },
+    /* One slot for all of portal_probes[]. */
+    [HTTP_APP_ROUTE_PROBE]        = { NULL,                  HTTP_GET,    probe_handler,           NULL, ROUTE_PORTAL },
+    [HTTP_APP_ROUTE_REDIRECT]     = { "/*",                  HTTP_GET,    redirect_handler,        NULL, ROUTE_PORTAL },
+};
+
+static http_conn_t *conn_find(int fd) {
+    for (int i = 0; i < DEFAULT_HTTP_MAX_SOCKETS; i++) {
+        if (conns[i].fd == fd) {
+            return &conns[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t conn_open(httpd_handle_t hd, int sockfd) {
+    http_conn_t *c = conn_find(-1);
+
+    if (c) {
+        *c = (http_conn_t){ .fd = sockfd, .open_us = esp_timer_get_time() };
+    }
+    taskENTER_CRITICAL(&stats_mux);
+    server_stats.opened++;
+    server_stats.open_now++;
+    if (server_stats.open_now > server_stats.open_max) {
+        server_stats.open_max = server_stats.open_now;
+    }
+    taskEXIT_CRITICAL(&stats_mux);
+    return ESP_OK;
+}
+
+/* A peer that went away leaves the socket readable (EOF or reset); nothing to read means we closed it. */
+static bool conn_idle(int fd) {
+    char b;
+    return recv(fd, &b, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/*
+ * With a close_fn set, closing the socket is up to us. A live, idle connection
+ * closed while every slot is taken is the LRU purge making room.
+ */
+static void conn_close(httpd_handle_t hd, int sockfd) {
+    http_conn_t *c = conn_find(sockfd);
+    bool purged = conn_idle(sockfd);
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&stats_mux);
+    if (purged && server_stats.open_now >= DEFAULT_HTTP_MAX_SOCKETS) {
+        server_stats.purged++;
+    }
+    server_stats.closed++;
+    if (server_stats.open_now) {
+        server_stats.open_now--;
+    }
+    if (c) {
+        server_stats.requests += c->requests;
+        if (c->requests > server_stats.requests_max) {
+            server_stats.requests_max = c->requests;
+        }
+        server_stats.lifetime_ms += (now - c->open_us) / 1000;
+        server_stats.busy_us += c->busy_us;
+    }
+    taskEXIT_CRITICAL(&stats_mux);
+
+    if (c) {
+        c->fd = -1;
+    }
+    close(sockfd);
+}
+
+/*
+ * Latency runs from handler entry to the last byte handed to the socket, so it
+ * covers rendering and the send but not header parsing or queueing in httpd.
+ */
+static esp_err_t route_dispatch(httpd_req_t *req) {
+    int idx = (int)(intptr_t)req->user_ctx;
+    int64_t t0 = esp_timer_get_time();
+
+    outcome = OUTCOME_OK;
+    esp_err_t err;
+    if ((routes[idx].flags & ROUTE_PORTAL) && !portal_mode) {
+        err = send_not_found(req);
+    } else if ((routes[idx].flags & ROUTE_AUTH) && !auth_ok(req)) {
+        err = send_unauthorized(req);
+    } else {
+        err = routes[idx].handler(req, routes[idx].ctx);
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+    /* Deepest point so far; the handlers are where the stack peaks. */
+    uint32_t stack_free = uxTaskGetStackHighWaterMark(NULL);
+
+    taskENTER_CRITICAL(&stats_mux);
+    http_app_route_stats_t *st = &stats[idx];
+    st->requests++;
+    st->total_us += us;
+    st->last_us = us;
+    if (us > st->max_us) {
+        st->max_us = us;
+    }
+    if (outcome == OUTCOME_NOT_MODIFIED) {
+        st->not_modified++;
+    } else if (outcome == OUTCOME_CLIENT_ERROR) {
+        st->client_errors++;
+    }
+    if (err != ESP_OK) {
+        st->send_errors++;
+    }
+    if (server_stats.stack_free_min == 0 || stack_free < server_stats.stack_free_min) {
+        server_stats.stack_free_min = stack_free;
+    }
+    taskEXIT_CRITICAL(&stats_mux);
+
+    http_conn_t *c = conn_find(httpd_req_to_sockfd(req));
+    if (c) {
+        c->requests++;
+        c->busy_us += us;
+    }
+    return err;
 }
 
-static esp_err_t js_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "application/javascript");
-    return httpd_resp_send(req, (const char *)code_js_start, code_js_end - code_js_start);
+void http_app_get_stats(http_app_route_stats_t out[HTTP_APP_ROUTES]) {
+    taskENTER_CRITICAL(&stats_mux);
+    memcpy(out, stats, sizeof(stats));
+    taskEXIT_CRITICAL(&stats_mux);
 }
 
-static esp_err_t css_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/css");
-    return httpd_resp_send(req, (const char *)style_css_start, style_css_end - style_css_start);
+void http_app_get_server_stats(http_app_server_stats_t *out) {
+    taskENTER_CRITICAL(&stats_mux);
+    *out = server_stats;
+    taskEXIT_CRITICAL(&stats_mux);
+}
+
+const char *http_app_route_name(http_app_route_t route) {
+    static const char *const names[HTTP_APP_ROUTES] = {
+        "index", "code.js", "style.css", "ap.json", "status.json", "connect", "disconnect", "stats.json",
+        "events", "dash", "dash.status", "dash.history", "probe", "redirect"
+    };
+    return route < HTTP_APP_ROUTES ? names[route] : "?";
+}
+
+static bool chunk_flush(void *ctx, const char *data, size_t len) {
+    return httpd_resp_send_chunk(ctx, data, len) == ESP_OK;
+}
+
+static uint64_t avg(uint64_t total, uint32_t n) {
+    return n ? total / n : 0;
+}
+
+#if DEFAULT_NVS_SYNC_STATS
+static void json_hist(json_writer_t *w, const char *key, const uint32_t *hist) {
+    json_key(w, key);
+    json_arr_begin(w);
+    for (int i = 0; i < NVS_SYNC_BUCKETS; i++) {
+        json_uint(w, hist[i]);
+    }
+    json_arr_end(w);
+}
+
+/* "nvs_sync": histogram bucket bounds, the longest hold, then one object per call site. */
+static void json_nvs_sync(json_writer_t *w) {
+    /* Too big for the server stack next to the rest, and RPC workers render this too. */
+    nvs_sync_stats_t *st = malloc(sizeof(*st));
+
+    if (!st) {
+        return;
+    }
+    nvs_sync_get_stats(st);
+    json_key(w, "nvs_sync");
+    json_obj_begin(w);
+    json_key(w, "bucket_us");
+    json_arr_begin(w);
+    for (int i = 0; i < NVS_SYNC_BUCKETS - 1; i++) {
+        json_uint(w, nvs_sync_bucket_limit_us(i));
+    }
+    json_arr_end(w);
+    json_kv_str(w, "hold_max_site", st->hold_max_site ? st->hold_max_site : "");
+    json_kv_uint(w, "hold_max_us", st->hold_max_us);
+    for (size_t i = 0; i < st->sites; i++) {
+        const nvs_sync_site_stats_t *s = &st->site[i];
+        json_key(w, s->site);
+        json_obj_begin(w);
+        json_kv_uint(w, "locks", s->locks);
+        json_kv_uint(w, "timeouts", s->timeouts);
+        json_kv_uint(w, "contended", s->contended);
+        json_kv_uint(w, "wait_avg_us", avg(s->wait_us, s->locks));
+        json_kv_uint(w, "wait_max_us", s->wait_max_us);
+        json_kv_uint(w, "hold_avg_us", avg(s->hold_us, s->locks));
+        json_kv_uint(w, "hold_max_us", s->hold_max_us);
+        json_hist(w, "wait", s->wait_hist);
+        json_hist(w, "hold", s->hold_hist);
+        json_key(w, "blocked_by");
+        json_obj_begin(w);
+        for (size_t j = 0; j < st->sites; j++) {
+            if (s->blocked_by[j]) {
+                json_kv_uint(w, st->site[j].site, s->blocked_by[j]);
+            }
+        }
+        json_obj_end(w);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+    free(st);
+}
+#endif
+
+void http_app_write_stats(json_writer_t *w) {
+    http_app_route_stats_t snap[HTTP_APP_ROUTES];
+    http_app_server_stats_t srv;
+    dns_server_stats_t dns;
+    settings_stats_t cfg;
+    http_app_portal_client_t clients[PORTAL_CLIENTS];
+    char mac[18];
+
+    http_app_get_stats(snap);
+    http_app_get_server_stats(&srv);
+    dns_server_get_stats(&dns);
+    settings_get_stats(&cfg);
+    size_t n = http_app_get_portal_clients(clients, PORTAL_CLIENTS);
+
+    json_obj_begin(w);
+    for (int i = 0; i < HTTP_APP_ROUTES; i++) {
+        json_key(w, http_app_route_name(i));
+        json_obj_begin(w);
+        json_kv_uint(w, "requests", snap[i].requests);
+        json_kv_uint(w, "not_modified", snap[i].not_modified);
+        json_kv_uint(w, "client_errors", snap[i].client_errors);
+        json_kv_uint(w, "send_errors", snap[i].send_errors);
+        json_kv_uint(w, "avg_us", avg(snap[i].total_us, snap[i].requests));
+        json_kv_uint(w, "last_us", snap[i].last_us);
+        json_kv_uint(w, "max_us", snap[i].max_us);
+        json_obj_end(w);
+    }
+
+    json_key(w, "server");
+    json_obj_begin(w);
+    json_kv_int(w, "max_sockets", DEFAULT_HTTP_MAX_SOCKETS);
+    json_kv_uint(w, "opened", srv.opened);
+    json_kv_uint(w, "open_now", srv.open_now);
+    json_kv_uint(w, "open_max", srv.open_max);
+    json_kv_uint(w, "purged", srv.purged);
+    json_kv_uint(w, "closed", srv.closed);
+    json_kv_uint(w, "requests_avg", avg(srv.requests, srv.closed));
+    json_kv_uint(w, "requests_max", srv.requests_max);
+    json_kv_uint(w, "lifetime_avg_ms", avg(srv.lifetime_ms, srv.closed));
+    json_kv_uint(w, "busy_avg_us", avg(srv.busy_us, srv.closed));
+    json_kv_int(w, "stack_size", DEFAULT_HTTP_STACK_SIZE);
+    json_kv_uint(w, "stack_free_min", srv.stack_free_min);
+    json_obj_end(w);
+
+    json_key(w, "dns");
+    json_obj_begin(w);
+    json_kv_uint(w, "queries", dns.queries);
+    json_kv_uint(w, "avg_us", avg(dns.busy_us, dns.queries));
+    json_kv_uint(w, "max_us", dns.max_us);
+    json_kv_uint(w, "send_errors", dns.send_errors);
+    for (int i = 0; i < DNS_RESULTS; i++) {
+        json_kv_uint(w, dns_server_result_name(i), dns.results[i]);
+    }
+    json_kv_uint(w, "cache_hits", dns.cache_hits);
+    json_kv_uint(w, "hit_avg_us", avg(dns.hit_us, dns.cache_hits));
+    json_kv_uint(w, "miss_avg_us", avg(dns.busy_us - dns.hit_us, dns.queries - dns.cache_hits));
+    json_obj_end(w);
+
+    json_key(w, "settings");
+    json_obj_begin(w);
+    json_kv_uint(w, "sets", cfg.sets);
+    json_kv_uint(w, "unchanged", cfg.unchanged);
+    json_kv_uint(w, "flushes", cfg.flushes);
+    json_kv_uint(w, "keys_written", cfg.keys_written);
+    json_kv_uint(w, "commits", cfg.commits);
+    json_kv_uint(w, "errors", cfg.errors);
+    json_kv_uint(w, "migrations", cfg.migrations);
+    json_kv_uint(w, "resets", cfg.resets);
+    json_kv_uint(w, "flush_us_last", cfg.flush_us_last);
+    json_kv_uint(w, "flush_us_max", cfg.flush_us_max);
+    json_obj_end(w);
+
+#if DEFAULT_NVS_SYNC_STATS
+    json_nvs_sync(w);
+#endif
+
+    json_key(w, "portal");
+    json_arr_begin(w);
+    for (size_t i = 0; i < n; i++) {
+        snprintf(mac, sizeof(mac), MACSTR, MAC2STR(clients[i].mac));
+        json_obj_begin(w);
+        json_kv_str(w, "mac", mac);
+        json_kv_str(w, "probe", clients[i].probe_os ? clients[i].probe_os : "");
+        json_kv_uint(w, "first_probe_ms", clients[i].first_probe_ms);
+        json_kv_uint(w, "portal_ms", clients[i].portal_ms);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+/* Streamed through a small stack buffer; each time it fills it goes out as one chunk. */
+static esp_err_t stats_json_handler(httpd_req_t *req, const void *ctx) {
+    char buf[256];
+    json_writer_t w;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    json_writer_init(&w, buf, sizeof(buf), chunk_flush, req);
+    http_app_write_stats(&w);
+    if (!json_writer_finish(&w)) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+/* SSE frame: "event: <name>\ndata: <json>\n\n". The JSON never contains a newline. */
+static esp_err_t sse_send(httpd_req_t *req, const char *event, const char *data, size_t len) {
+    char head[24];
+    int n = snprintf(head, sizeof(head), "event: %s\ndata: ", event);
+    esp_err_t err = httpd_resp_send_chunk(req, head, n);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, data, len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "\n\n", 2);
+    }
+    return err;
+}
+
+static void sse_drop(int i) {
+    httpd_req_async_handler_complete(sse_clients[i]);
+    sse_clients[i] = NULL;
+    ESP_LOGI(TAG, "Event client %d gone", i);
+}
+
+static int sse_client_count(void) {
+    int n = 0;
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        n += sse_clients[i] != NULL;
+    }
+    return n;
+}
+
+/* Send what changed to one client, or everything when it has just connected. */
+static esp_err_t sse_push_one(httpd_req_t *req, uint32_t what, const char *etag_seen) {
+    esp_err_t err = ESP_OK;
+
+    if (what & HTTP_APP_PUSH_STATUS) {
+        char buf[STATUS_JSON_SIZE];
+        int len = render_status(buf, sizeof(buf));
+        err = sse_send(req, "status", buf, len);
+    }
+    if (err == ESP_OK && (what & HTTP_APP_PUSH_SCAN)) {
+        char etag[WIFI_SCAN_ETAG_LEN + 1];
+        size_t len = wifi_scan_copy(scan_json, etag);
+        if (etag_seen == NULL || strcmp(etag, etag_seen) != 0) {
+            err = sse_send(req, "ap", scan_json, len);
+        }
+    }
+    if (err == ESP_OK && (what & SSE_PING)) {
+        err = httpd_resp_send_chunk(req, ":\n\n", 3);
+    }
+    return err;
+}
+
+/* Runs on the httpd task. */
+static void sse_push_work(void *arg) {
+    uint32_t what;
+
+    taskENTER_CRITICAL(&sse_mux);
+    what = sse_pending;
+    sse_pending = 0;
+    taskEXIT_CRITICAL(&sse_mux);
+
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        if (sse_clients[i] && sse_push_one(sse_clients[i], what, sse_last_etag) != ESP_OK) {
+            sse_drop(i);
+        }
+    }
+    if (what & HTTP_APP_PUSH_SCAN) {
+        wifi_scan_copy(NULL, sse_last_etag);
+    }
+    if (sse_client_count() == 0) {
+        esp_timer_stop(sse_ping_timer);
+    }
+}
+
+/* Several notifications before the httpd task gets round to it cost one push. */
+static void sse_queue(uint32_t what) {
+    bool queue;
+
+    taskENTER_CRITICAL(&sse_mux);
+    queue = (sse_pending == 0);
+    sse_pending |= what;
+    taskEXIT_CRITICAL(&sse_mux);
+
+    if (queue && httpd_queue_work(sse_server, sse_push_work, NULL) != ESP_OK) {
+        taskENTER_CRITICAL(&sse_mux);
+        sse_pending = 0;
+        taskEXIT_CRITICAL(&sse_mux);
+    }
+}
+
+/* Comment frames keep middleboxes quiet and are how a vanished client is noticed. */
+static void sse_ping_cb(void *arg) {
+    sse_queue(SSE_PING);
+}
+
+void http_app_push(httpd_handle_t server, uint32_t what) {
+    if (server && server == sse_server) {
+        sse_queue(what);
+    }
+}
+
+/*
+ * Takes the request over as an async handler and answers with the current
+ * status and scan table. A full house gets 503 and the portal falls back to polling.
+ */
+static esp_err_t events_handler(httpd_req_t *req, const void *ctx) {
+    httpd_req_t *async = NULL;
+    int slot = -1;
+
+    for (int i = 0; i < SSE_MAX_CLIENTS && slot < 0; i++) {
+        if (sse_clients[i] == NULL) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        outcome = OUTCOME_CLIENT_ERROR;
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    if (httpd_req_async_handler_begin(req, &async) != ESP_OK) {
+        return httpd_resp_send_500(req);
+    }
+
+    httpd_resp_set_type(async, "text/event-stream");
+    httpd_resp_set_hdr(async, "Cache-Control", "no-store");
+    esp_err_t err = httpd_resp_send_chunk(async, "retry: 2000\n\n", 13);
+    if (err == ESP_OK) {
+        err = sse_push_one(async, HTTP_APP_PUSH_STATUS | HTTP_APP_PUSH_SCAN, NULL);
+    }
+    if (err != ESP_OK) {
+        httpd_req_async_handler_complete(async);
+        return err;
+    }
+
+    sse_clients[slot] = async;
+    if (!esp_timer_is_active(sse_ping_timer)) {
+        esp_timer_start_periodic(sse_ping_timer, SSE_PING_PERIOD_S * 1000000ULL);
+    }
+    ESP_LOGI(TAG, "Event client %d connected", slot);
+    return ESP_OK;
+}
+
+/* Queued ahead of the shutdown message, so it runs on the httpd task before it exits. */
+static void sse_close_all_work(void *arg) {
+    for (int i = 0; i < SSE_MAX_CLIENTS; i++) {
+        if (sse_clients[i]) {
+            httpd_resp_send_chunk(sse_clients[i], NULL, 0);
+            sse_drop(i);
+        }
+    }
+}
+
+void http_app_set_portal(httpd_handle_t server, bool on) {
+    if (!server) {
+        return;
+    }
+    portal_mode = on;
+    /* The portal page is the only /events client; its streams have no business on the station side. */
+    if (!on && server == sse_server) {
+        esp_timer_stop(sse_ping_timer);
+        httpd_queue_work(server, sse_close_all_work, NULL);
+    }
+}
+
+void http_app_set_dashboard(const wifi_manager_dashboard_t *dash) {
+    dashboard = dash;
+}
+
+void stop_http_server(httpd_handle_t server) {
+    if (!server) {
+        return;
+    }
+    esp_timer_stop(sse_ping_timer);
+    httpd_queue_work(server, sse_close_all_work, NULL);
+    httpd_stop(server);
+    sse_server = NULL;
+    portal_mode = false;
+    esp_event_handler_instance_unregister(WIFI_EVENT, WIFI_EVENT_AP_STACONNECTED, portal_sta_handler);
+    esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_AP_STAIPASSIGNED, portal_ip_handler);
+    portal_sta_handler = NULL;
+    portal_ip_handler = NULL;
 }
 
 httpd_handle_t start_http_server(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     httpd_handle_t server = NULL;
 
-    if (httpd_start(&server, &config) == ESP_OK) {
-        httpd_uri_t index_uri = {
-            .uri      = "/",
-            .method   = HTTP_GET,
-            .handler  = index_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &index_uri);
-
-        httpd_uri_t js_uri = {
-            .uri      = "/code.js",
-            .method   = HTTP_GET,
-            .handler  = js_handler,
-            .user_ctx = NULL
+    /* Exact matches still behave as before; only the catch-all (registered last) is a pattern. */
+    config.uri_match_fn = httpd_uri_match_wildcard;
+    config.max_uri_handlers = HTTP_APP_ROUTES - 1 + PORTAL_PROBES;
+    config.server_port = DEFAULT_WEB_PORT;
+    /*
+     * Browsers open several keep-alive connections each and hold them. When
+     * all sockets are taken, the least recently used one is closed for the new
+     * connection instead of the new one waiting in the backlog.
+     */
+    config.max_open_sockets = DEFAULT_HTTP_MAX_SOCKETS;
+    config.lru_purge_enable = true;
+    config.stack_size = DEFAULT_HTTP_STACK_SIZE;
+    config.core_id = DEFAULT_HTTP_CORE;
+    config.open_fn = conn_open;
+    config.close_fn = conn_close;
+    for (int i = 0; i < DEFAULT_HTTP_MAX_SOCKETS; i++) {
+        conns[i].fd = -1;
+    }
+    if (sizeof(DEFAULT_DASHBOARD_PASSWORD) == 1) {
+        ESP_LOGW(TAG, "No dashboard password in this build (DEFAULT_DASHBOARD_PASSWORD), /dash is locked");
+        auth_expected[0] = '\0';
+    } else if (!auth_init()) {
+        ESP_LOGW(TAG, "Dashboard credentials too long, /dash is locked");
+        auth_expected[0] = '\0';
+    }
+    if (sse_ping_timer == NULL) {
+        const esp_timer_create_args_t args = {
+            .callback = sse_ping_cb,
+            .name = "http_sse_ping",
         };
-        httpd_register_uri_handler(server, &js_uri);
+        if (esp_timer_create(&args, &sse_ping_timer) != ESP_OK) {
+            return NULL;
+        }
+    }
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start HTTP server");
+        return NULL;
+    }
+    sse_server = server;
+    sse_last_etag[0] = '\0';
 
-        httpd_uri_t css_uri = {
-            .uri      = "/style.css",
-            .method   = HTTP_GET,
-            .handler  = css_handler,
-            .user_ctx = NULL
+    /* Handlers are tried in registration order, so the routes' order puts the wildcard last. */
+    for (int i = 0; i < HTTP_APP_ROUTES; i++) {
+        httpd_uri_t uri = {
+            .uri      = routes[i].uri,
+            .method   = routes[i].method,
+            .handler  = route_dispatch,
+            .user_ctx = (void *)(intptr_t)i
         };
-        httpd_register_uri_handler(server, &css_uri);
-
-        ESP_LOGI(TAG, "HTTP server started");
-    } else {
-        ESP_LOGE(TAG, "Failed to start HTTP server");
+        if (i == HTTP_APP_ROUTE_PROBE) {
+            for (size_t p = 0; p < PORTAL_PROBES; p++) {
+                uri.uri = portal_probes[p].uri;
+                httpd_register_uri_handler(server, &uri);
+            }
+        } else {
+            httpd_register_uri_handler(server, &uri);
+        }
     }
 
+    esp_event_handler_instance_register(WIFI_EVENT, WIFI_EVENT_AP_STACONNECTED, portal_sta_event, NULL, &portal_sta_handler);
+    esp_event_handler_instance_register(IP_EVENT, IP_EVENT_AP_STAIPASSIGNED, portal_ip_event, NULL, &portal_ip_handler);
+
+    ESP_LOGI(TAG, "HTTP server started");
     return server;
 }
@@ -2,17 +2,138 @@
  *  http_app.h
  *
  *  Created on: 2025-06-18
- *  Edited on: 2025-07-08
+ *  Edited on: 2026-10-19
  *      Author: Andwardo
- *      Version: v8.2.46
+ *      Version: v8.2.71
  */
 
 #ifndef HTTP_APP_H_
 #define HTTP_APP_H_
 
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 #include "esp_http_server.h"
+#include "wifi_manager.h"
+#include "json.h"
+
+typedef enum {
+	HTTP_APP_ROUTE_INDEX = 0,
+	HTTP_APP_ROUTE_CODE_JS,
+	HTTP_APP_ROUTE_STYLE_CSS,
+	HTTP_APP_ROUTE_AP_JSON,
+	HTTP_APP_ROUTE_STATUS,
+	HTTP_APP_ROUTE_CONNECT,
+	HTTP_APP_ROUTE_DISCONNECT,
+	HTTP_APP_ROUTE_STATS,
+	HTTP_APP_ROUTE_EVENTS,
+	HTTP_APP_ROUTE_DASH,          /* station-side dashboard, basic auth */
+	HTTP_APP_ROUTE_DASH_STATUS,
+	HTTP_APP_ROUTE_DASH_HISTORY,
+	HTTP_APP_ROUTE_PROBE,         /* OS captive-portal checks (/generate_204, /hotspot-detect.html, ...) */
+	HTTP_APP_ROUTE_REDIRECT,      /* catch-all 302 to the portal; must stay last */
+	HTTP_APP_ROUTES
+} http_app_route_t;
+
+/**
+ * @brief Per-endpoint counters, kept for the life of the firmware (they survive
+ *        the server being stopped and restarted with the portal).
+ */
+typedef struct {
+	uint32_t requests;
+	uint32_t not_modified;     /* answered 304 */
+	uint32_t client_errors;    /* answered 4xx, or 503 when /events is full */
+	uint32_t send_errors;      /* handler returned an error, e.g. the socket went away */
+	uint64_t total_us;         /* handler entry to last byte sent, summed */
+	uint32_t last_us;
+	uint32_t max_us;
+} http_app_route_stats_t;
+
+/**
+ * @brief Connection-level counters for sizing the server, also kept for the life
+ *        of the firmware.
+ */
+typedef struct {
+	uint32_t opened;           /* connections accepted */
+	uint32_t closed;
+	uint32_t open_now;
+	uint32_t open_max;         /* most connections open at once */
+	uint32_t purged;           /* idle connections closed by the LRU purge to admit a new one */
+	uint32_t requests;         /* on closed connections */
+	uint32_t requests_max;     /* most requests on one connection */
+	uint64_t lifetime_ms;      /* closed connections, summed */
+	uint64_t busy_us;          /* time in handlers on closed connections, summed */
+	uint32_t stack_free_min;   /* httpd task stack high-water mark, bytes (0 = not measured yet) */
+} http_app_server_stats_t;
+
+/**
+ * @brief Captive-portal timing for one SoftAP client, in ms after association
+ *        (0 = not seen yet).
+ */
+typedef struct {
+	uint8_t mac[6];
+	uint32_t ip;               /* network order, 0 until DHCP assigned one */
+	int64_t assoc_us;
+	const char *probe_os;      /* "android", "apple", "windows", "firefox" or "other" */
+	uint32_t first_probe_ms;
+	uint32_t portal_ms;        /* the portal page was served */
+} http_app_portal_client_t;
+
+/* What changed, for http_app_push(). */
+#define HTTP_APP_PUSH_STATUS 0x01    /* wifi_manager_sta_status_t */
+#define HTTP_APP_PUSH_SCAN   0x02    /* the /ap.json table */
 
 httpd_handle_t start_http_server(void);
 
-#endif /* HTTP_APP_H_ */
\ No newline at end of file
+/**
+ * @brief Portal mode serves the provisioning pages, /events and the captive
+ *        redirects. Outside it those answer 404, "/" leads to the dashboard and
+ *        any /events streams are closed.
+ */
+void http_app_set_portal(httpd_handle_t server, bool on);
+
+/**
+ * @brief Data source for /dash/status.json and /dash/history.json; NULL until set.
+ */
+void http_app_set_dashboard(const wifi_manager_dashboard_t *dash);
+
+/**
+ * @brief Close the /events streams and stop the server.
+ */
+void stop_http_server(httpd_handle_t server);
+
+/**
+ * @brief Push the current state to /events subscribers. Never blocks: the send
+ *        is queued to the httpd task and notifications arriving before it runs
+ *        are merged. A scan push is skipped when the table's ETag is unchanged.
+ */
+void http_app_push(httpd_handle_t server, uint32_t what);
+
+/**
+ * @brief Snapshot of the counters, indexed by http_app_route_t. Also served as /stats.json.
+ */
+void http_app_get_stats(http_app_route_stats_t out[HTTP_APP_ROUTES]);
+
+const char *http_app_route_name(http_app_route_t route);
+
+/**
+ * @brief Snapshot of the connection counters. Also the "server" object of /stats.json.
+ */
+void http_app_get_server_stats(http_app_server_stats_t *out);
+
+/**
+ * @brief Most recent SoftAP clients and how long the portal took to reach them.
+ *        Also part of /stats.json.
+ * @return Number of entries written.
+ */
+size_t http_app_get_portal_clients(http_app_portal_client_t *out, size_t max);
+
+/**
+ * @brief Write the /stats.json document, one object, into w; the caller finishes it.
+ *        Also behind the "http.stats" RPC, since /stats.json needs the dashboard
+ *        password and builds without one lock it.
+ */
+void http_app_write_stats(json_writer_t *w);
+
+#endif /* HTTP_APP_H_ */
@@ -1,6 +1,7 @@
 /*
 @file json.c
-@brief handles very basic JSON with a minimal footprint on the system
+@brief handles very basic JSON with a minimal footprint on the system: string escaping, a
+       streaming writer and an in-place parser, none of which need the heap
 
 This code is a lightly modified version of cJSON 1.4.7. cJSON is licensed under the MIT license:
 Copyright (c) 2009 Dave Gamble
@@ -29,115 +30,990 @@ OTHER DEALINGS IN THE SOFTWARE.
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
 #include "json.h"
 
+/*
+ * What follows the backslash for each byte that must be escaped, 0 for bytes
+ * copied as they are. Control characters without a short form use \u00XX.
+ */
+static const char escape_table[256] =
+{
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	['\"'] = '\"', ['\\'] = '\\',
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/*
+ * Nonzero if any of the four bytes is below 0x20, '"' or '\\'. Each test is
+ * exact as an "any byte" test, so a clear word can be copied without looking
+ * at its bytes.
+ */
+static inline uint32_t word_needs_escape(uint32_t x)
+{
+	uint32_t q = x ^ 0x22222222u;
+	uint32_t b = x ^ 0x5c5c5c5cu;
+
+	return (((x - 0x20202020u) & ~x) |
+			((q - 0x01010101u) & ~q) |
+			((b - 0x01010101u) & ~b)) & 0x80808080u;
+}
+
+/* Length of the leading run of s that needs no escaping: four bytes at a time, then the table. */
+static size_t plain_run(const unsigned char *s, size_t n)
+{
+	size_t i = 0;
+	uint32_t x;
+
+	for (; i + 4 <= n; i += 4)
+	{
+		memcpy(&x, s + i, 4);
+		if (word_needs_escape(x))
+		{
+			break;
+		}
+	}
+	while (i < n && escape_table[s[i]] == 0)
+	{
+		i++;
+	}
+	return i;
+}
+
+static void put(json_writer_t *w, const char *data, size_t len)
+{
+	while (len && !w->error)
+	{
+		size_t room = w->size - w->len;
+		if (room == 0)
+		{
+			if (w->flush == NULL || !w->flush(w->ctx, w->buf, w->len))
+			{
+				w->error = true;
+				return;
+			}
+			w->len = 0;
+			room = w->size;
+		}
+		size_t n = len < room ? len : room;
+		memcpy(w->buf + w->len, data, n);
+		w->len += n;
+		data += n;
+		len -= n;
+	}
+}
+
+static inline void put_char(json_writer_t *w, char c)
+{
+	if (w->len < w->size)
+	{
+		w->buf[w->len++] = c;
+	}
+	else
+	{
+		put(w, &c, 1);
+	}
+}
+
+static void put_escaped(json_writer_t *w, const unsigned char *s, size_t n)
+{
+	put_char(w, '\"');
+	while (n)
+	{
+		size_t run = plain_run(s, n);
+		put(w, (const char *)s, run);
+		s += run;
+		n -= run;
+		if (n == 0)
+		{
+			break;
+		}
+
+		char e = escape_table[*s];
+		if (e == 'u')
+		{
+			char u[6] = { '\\', 'u', '0', '0', hex_digits[*s >> 4], hex_digits[*s & 0x0f] };
+			put(w, u, sizeof(u));
+		}
+		else
+		{
+			char esc[2] = { '\\', e };
+			put(w, esc, sizeof(esc));
+		}
+		s++;
+		n--;
+	}
+	put_char(w, '\"');
+}
+
+/* Comma before every member but the first; nothing between a key and its value. */
+static void begin_value(json_writer_t *w)
+{
+	if (w->key_pending)
+	{
+		w->key_pending = false;
+		return;
+	}
+	if (w->depth)
+	{
+		uint32_t bit = 1u << (w->depth - 1);
+		if (w->nonempty & bit)
+		{
+			put_char(w, ',');
+		}
+		w->nonempty |= bit;
+	}
+}
+
+static void open_container(json_writer_t *w, char c)
+{
+	begin_value(w);
+	if (w->depth >= JSON_WRITER_MAX_DEPTH)
+	{
+		w->error = true;
+		return;
+	}
+	put_char(w, c);
+	w->nonempty &= ~(1u << w->depth);
+	w->depth++;
+}
+
+static void close_container(json_writer_t *w, char c)
+{
+	if (w->depth == 0 || w->key_pending)
+	{
+		w->error = true;
+		return;
+	}
+	w->depth--;
+	put_char(w, c);
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_flush_t flush, void *ctx)
+{
+	memset(w, 0, sizeof(*w));
+	w->buf = buf;
+	w->flush = flush;
+	w->ctx = ctx;
+	if (flush)
+	{
+		w->size = size;
+	}
+	else
+	{
+		w->size = size ? size - 1 : 0;
+	}
+	w->error = (buf == NULL || w->size == 0);
+}
+
+bool json_writer_finish(json_writer_t *w)
+{
+	if (w->depth || w->key_pending)
+	{
+		w->error = true;
+	}
+	if (w->error)
+	{
+		return false;
+	}
+	if (w->flush)
+	{
+		if (w->len && !w->flush(w->ctx, w->buf, w->len))
+		{
+			w->error = true;
+			return false;
+		}
+		w->len = 0;
+	}
+	else
+	{
+		w->buf[w->len] = '\0';
+	}
+	return true;
+}
+
+void json_obj_begin(json_writer_t *w)
+{
+	open_container(w, '{');
+}
+
+void json_obj_end(json_writer_t *w)
+{
+	close_container(w, '}');
+}
+
+void json_arr_begin(json_writer_t *w)
+{
+	open_container(w, '[');
+}
+
+void json_arr_end(json_writer_t *w)
+{
+	close_container(w, ']');
+}
+
+void json_key(json_writer_t *w, const char *key)
+{
+	if (w->depth == 0 || w->key_pending)
+	{
+		w->error = true;
+		return;
+	}
+	begin_value(w);
+	put_escaped(w, (const unsigned char *)key, strlen(key));
+	put_char(w, ':');
+	w->key_pending = true;
+}
+
+void json_str(json_writer_t *w, const char *s)
+{
+	if (s == NULL)
+	{
+		json_null(w);
+		return;
+	}
+	json_strn(w, s, strlen(s));
+}
+
+void json_strn(json_writer_t *w, const char *s, size_t len)
+{
+	begin_value(w);
+	put_escaped(w, (const unsigned char *)s, len);
+}
+
+/* Digits are produced backwards into the end of a 20-byte buffer, the most a uint64_t needs. */
+static void put_uint(json_writer_t *w, uint64_t v, bool negative)
+{
+	char digits[21];
+	char *p = digits + sizeof(digits);
+
+	do
+	{
+		*--p = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+	if (negative)
+	{
+		*--p = '-';
+	}
+	put(w, p, digits + sizeof(digits) - p);
+}
+
+void json_int(json_writer_t *w, int64_t v)
+{
+	begin_value(w);
+	/* Negated as unsigned, so INT64_MIN does not overflow. */
+	put_uint(w, v < 0 ? 0 - (uint64_t)v : (uint64_t)v, v < 0);
+}
+
+void json_uint(json_writer_t *w, uint64_t v)
+{
+	begin_value(w);
+	put_uint(w, v, false);
+}
+
+void json_double(json_writer_t *w, double v)
+{
+	char num[32];
+
+	if (!isfinite(v))
+	{
+		json_null(w);
+		return;
+	}
+	begin_value(w);
+	/* 17 significant digits round-trip a double, as cJSON does when 15 do not. */
+	int n = snprintf(num, sizeof(num), "%.15g", v);
+	if (strtod(num, NULL) != v)
+	{
+		n = snprintf(num, sizeof(num), "%.17g", v);
+	}
+	put(w, num, (size_t)n);
+}
+
+void json_bool(json_writer_t *w, bool v)
+{
+	begin_value(w);
+	if (v)
+	{
+		put(w, "true", 4);
+	}
+	else
+	{
+		put(w, "false", 5);
+	}
+}
+
+void json_null(json_writer_t *w)
+{
+	begin_value(w);
+	put(w, "null", 4);
+}
+
+void json_raw(json_writer_t *w, const char *json, size_t len)
+{
+	begin_value(w);
+	put(w, json, len);
+}
+
+void json_kv_str(json_writer_t *w, const char *key, const char *s)
+{
+	json_key(w, key);
+	json_str(w, s);
+}
+
+void json_kv_int(json_writer_t *w, const char *key, int64_t v)
+{
+	json_key(w, key);
+	json_int(w, v);
+}
+
+void json_kv_uint(json_writer_t *w, const char *key, uint64_t v)
+{
+	json_key(w, key);
+	json_uint(w, v);
+}
+
+void json_kv_bool(json_writer_t *w, const char *key, bool v)
+{
+	json_key(w, key);
+	json_bool(w, v);
+}
 
 bool json_print_string(const unsigned char *input, unsigned char *output_buffer)
 {
-	const unsigned char *input_pointer = NULL;
-	unsigned char *output = NULL;
-	unsigned char *output_pointer = NULL;
-	size_t output_length = 0;
-	/* numbers of additional characters needed for escaping */
-	size_t escape_characters = 0;
+	json_writer_t w;
 
 	if (output_buffer == NULL)
 	{
 		return false;
 	}
-
-	/* empty string */
+	/* The caller guarantees the room, so the bound is only nominal. */
+	json_writer_init(&w, (char *)output_buffer, SIZE_MAX, NULL, NULL);
 	if (input == NULL)
 	{
-		//output = ensure(output_buffer, sizeof("\"\""), hooks);
-		if (output == NULL)
+		json_strn(&w, "", 0);
+	}
+	else
+	{
+		json_str(&w, (const char *)input);
+	}
+	return json_writer_finish(&w);
+}
+
+/*
+ * Parser. One pass, a state per position in the grammar and a stack of open
+ * containers; every byte is looked at a bounded number of times.
+ */
+
+enum
+{
+	WANT_VALUE,
+	WANT_VALUE_OR_CLOSE,    /* just after '[' */
+	WANT_KEY,
+	WANT_KEY_OR_CLOSE,      /* just after '{' */
+	WANT_COLON,
+	WANT_NEXT,              /* ',' or the end of the container */
+	WANT_NOTHING            /* the top-level value is complete */
+};
+
+static inline bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	c |= 0x20;
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+/* From just after the opening quote; returns the offset of the closing quote, or a json_err_t. */
+static long scan_string(const char *js, size_t len, size_t pos)
+{
+	for (;;)
+	{
+		/* plain_run stops exactly at controls, quotes and backslashes. */
+		pos += plain_run((const unsigned char *)js + pos, len - pos);
+		if (pos >= len)
 		{
-			return false;
+			return JSON_ERR_PART;
 		}
-		strcpy((char*)output, "\"\"");
+		if (js[pos] == '\"')
+		{
+			return (long)pos;
+		}
+		if (js[pos] != '\\')
+		{
+			return JSON_ERR_INVAL;
+		}
+		if (++pos >= len)
+		{
+			return JSON_ERR_PART;
+		}
+		switch (js[pos])
+		{
+			case '\"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+				break;
+			case 'u':
+				for (int i = 0; i < 4; i++)
+				{
+					if (++pos >= len)
+					{
+						return JSON_ERR_PART;
+					}
+					if (hex_value(js[pos]) < 0)
+					{
+						return JSON_ERR_INVAL;
+					}
+				}
+				break;
+			default:
+				return JSON_ERR_INVAL;
+		}
+		pos++;
+	}
+}
 
-		return true;
+static long scan_digits(const char *js, size_t len, size_t pos)
+{
+	if (pos >= len)
+	{
+		return JSON_ERR_PART;
+	}
+	if (!is_digit(js[pos]))
+	{
+		return JSON_ERR_INVAL;
 	}
+	while (pos < len && is_digit(js[pos]))
+	{
+		pos++;
+	}
+	return (long)pos;
+}
 
-	/* set "flag" to 1 if something needs to be escaped */
-	for (input_pointer = input; *input_pointer; input_pointer++)
+/* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?; returns the offset just past it. */
+static long scan_number(const char *js, size_t len, size_t pos)
+{
+	long r;
+
+	if (js[pos] == '-')
+	{
+		pos++;
+	}
+	if (pos < len && js[pos] == '0')
+	{
+		pos++;
+	}
+	else
 	{
-		if (strchr("\"\\\b\f\n\r\t", *input_pointer))
+		if ((r = scan_digits(js, len, pos)) < 0)
 		{
-			/* one character escape sequence */
-			escape_characters++;
+			return r;
 		}
-		else if (*input_pointer < 32)
+		pos = (size_t)r;
+	}
+	if (pos < len && js[pos] == '.')
+	{
+		if ((r = scan_digits(js, len, pos + 1)) < 0)
 		{
-			/* UTF-16 escape sequence uXXXX */
-			escape_characters += 5;
+			return r;
 		}
+		pos = (size_t)r;
 	}
-	output_length = (size_t)(input_pointer - input) + escape_characters;
+	if (pos < len && (js[pos] == 'e' || js[pos] == 'E'))
+	{
+		pos++;
+		if (pos < len && (js[pos] == '+' || js[pos] == '-'))
+		{
+			pos++;
+		}
+		if ((r = scan_digits(js, len, pos)) < 0)
+		{
+			return r;
+		}
+		pos = (size_t)r;
+	}
+	return (long)pos;
+}
 
-	/* in the original cJSON it is possible to realloc here in case output buffer is too small.
-	 * This is overkill for an embedded system. */
-	output = output_buffer;
+static long scan_literal(const char *js, size_t len, size_t pos, const char *lit)
+{
+	size_t n = strlen(lit);
+	size_t avail = len - pos < n ? len - pos : n;
 
-	/* no characters have to be escaped */
-	if (escape_characters == 0)
+	if (memcmp(js + pos, lit, avail) != 0)
 	{
-		output[0] = '\"';
-		memcpy(output + 1, input, output_length);
-		output[output_length + 1] = '\"';
-		output[output_length + 2] = '\0';
+		return JSON_ERR_INVAL;
+	}
+	return avail < n ? JSON_ERR_PART : (long)(pos + n);
+}
 
-		return true;
+int json_parse(const char *js, size_t len, json_tok_t *toks, unsigned max_toks)
+{
+	uint16_t stack[JSON_PARSE_MAX_DEPTH];
+	unsigned depth = 0;
+	unsigned count = 0;
+	int want = WANT_VALUE;
+	size_t pos = 0;
+
+	if ((uint64_t)len > UINT32_MAX)
+	{
+		return JSON_ERR_NOMEM;
+	}
+	if (max_toks > UINT16_MAX)
+	{
+		max_toks = UINT16_MAX;
 	}
 
-	output[0] = '\"';
-	output_pointer = output + 1;
-	/* copy the string */
-	for (input_pointer = input; *input_pointer != '\0'; (void)input_pointer++, output_pointer++)
+	while (pos < len)
 	{
-		if ((*input_pointer > 31) && (*input_pointer != '\"') && (*input_pointer != '\\'))
+		char c = js[pos];
+		json_tok_t *top = depth ? &toks[stack[depth - 1]] : NULL;
+
+		if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
 		{
-			/* normal character, copy */
-			*output_pointer = *input_pointer;
+			pos++;
+			continue;
 		}
-		else
+
+		if ((want == WANT_NEXT || want == WANT_KEY_OR_CLOSE || want == WANT_VALUE_OR_CLOSE) &&
+				(c == '}' || c == ']'))
 		{
-			/* character needs to be escaped */
-			*output_pointer++ = '\\';
-			switch (*input_pointer)
+			if (c != (top->type == JSON_OBJECT ? '}' : ']'))
 			{
-			case '\\':
-				*output_pointer = '\\';
-				break;
-			case '\"':
-				*output_pointer = '\"';
+				return JSON_ERR_INVAL;
+			}
+			top->end = (uint32_t)(pos + 1);
+			top->next = (uint16_t)count;
+			depth--;
+			want = depth ? WANT_NEXT : WANT_NOTHING;
+			pos++;
+			continue;
+		}
+
+		switch (want)
+		{
+			case WANT_NEXT:
+				if (c != ',')
+				{
+					return JSON_ERR_INVAL;
+				}
+				want = top->type == JSON_OBJECT ? WANT_KEY : WANT_VALUE;
+				pos++;
+				continue;
+			case WANT_COLON:
+				if (c != ':')
+				{
+					return JSON_ERR_INVAL;
+				}
+				want = WANT_VALUE;
+				pos++;
+				continue;
+			case WANT_NOTHING:
+				return JSON_ERR_INVAL;
+			default:
 				break;
-			case '\b':
-				*output_pointer = 'b';
+		}
+
+		bool key = want == WANT_KEY || want == WANT_KEY_OR_CLOSE;
+		if (key && c != '\"')
+		{
+			return JSON_ERR_INVAL;
+		}
+		if (count >= max_toks)
+		{
+			return JSON_ERR_NOMEM;
+		}
+
+		json_tok_t *t = &toks[count];
+		long r;
+		t->start = (uint32_t)pos;
+		t->size = 0;
+		switch (c)
+		{
+			case '{':
+			case '[':
+				if (depth >= JSON_PARSE_MAX_DEPTH)
+				{
+					return JSON_ERR_DEPTH;
+				}
+				t->type = c == '{' ? JSON_OBJECT : JSON_ARRAY;
+				r = (long)pos + 1;
 				break;
-			case '\f':
-				*output_pointer = 'f';
+			case '\"':
+				t->type = JSON_STRING;
+				if ((r = scan_string(js, len, pos + 1)) < 0)
+				{
+					return (int)r;
+				}
+				t->start = (uint32_t)(pos + 1);
+				t->end = (uint32_t)r;
+				r++;
 				break;
-			case '\n':
-				*output_pointer = 'n';
+			case 't':
+				t->type = JSON_BOOL;
+				r = scan_literal(js, len, pos, "true");
 				break;
-			case '\r':
-				*output_pointer = 'r';
+			case 'f':
+				t->type = JSON_BOOL;
+				r = scan_literal(js, len, pos, "false");
 				break;
-			case '\t':
-				*output_pointer = 't';
+			case 'n':
+				t->type = JSON_NULL;
+				r = scan_literal(js, len, pos, "null");
 				break;
 			default:
-				/* escape and print as unicode codepoint */
-				sprintf((char*)output_pointer, "u%04x", *input_pointer);
-				output_pointer += 4;
+				if (c != '-' && !is_digit(c))
+				{
+					return JSON_ERR_INVAL;
+				}
+				t->type = JSON_NUMBER;
+				r = scan_number(js, len, pos);
 				break;
+		}
+		if (r < 0)
+		{
+			return (int)r;
+		}
+		pos = (size_t)r;
+		count++;
+
+		/* Objects count their keys, arrays their elements. */
+		if (top && (key || top->type == JSON_ARRAY))
+		{
+			top->size++;
+		}
+		if (key)
+		{
+			t->next = (uint16_t)count;
+			want = WANT_COLON;
+		}
+		else if (t->type == JSON_OBJECT || t->type == JSON_ARRAY)
+		{
+			stack[depth++] = (uint16_t)(count - 1);
+			want = t->type == JSON_OBJECT ? WANT_KEY_OR_CLOSE : WANT_VALUE_OR_CLOSE;
+		}
+		else
+		{
+			if (t->type != JSON_STRING)
+			{
+				t->end = (uint32_t)pos;
 			}
+			t->next = (uint16_t)count;
+			want = depth ? WANT_NEXT : WANT_NOTHING;
 		}
 	}
-	output[output_length + 1] = '\"';
-	output[output_length + 2] = '\0';
+	return want == WANT_NOTHING ? (int)count : JSON_ERR_PART;
+}
 
+bool json_tok_eq(const char *js, const json_tok_t *t, const char *s)
+{
+	size_t n = strlen(s);
+
+	return t->type == JSON_STRING && t->end - t->start == n && memcmp(js + t->start, s, n) == 0;
+}
+
+static uint32_t hex4(const char *p)
+{
+	return (uint32_t)(hex_value(p[0]) << 12 | hex_value(p[1]) << 8 | hex_value(p[2]) << 4 | hex_value(p[3]));
+}
+
+/* UTF-8 for one code point; returns the byte count. */
+static size_t utf8_encode(uint32_t cp, char *u)
+{
+	if (cp < 0x80)
+	{
+		u[0] = (char)cp;
+		return 1;
+	}
+	if (cp < 0x800)
+	{
+		u[0] = (char)(0xc0 | cp >> 6);
+		u[1] = (char)(0x80 | (cp & 0x3f));
+		return 2;
+	}
+	if (cp < 0x10000)
+	{
+		u[0] = (char)(0xe0 | cp >> 12);
+		u[1] = (char)(0x80 | (cp >> 6 & 0x3f));
+		u[2] = (char)(0x80 | (cp & 0x3f));
+		return 3;
+	}
+	u[0] = (char)(0xf0 | cp >> 18);
+	u[1] = (char)(0x80 | (cp >> 12 & 0x3f));
+	u[2] = (char)(0x80 | (cp >> 6 & 0x3f));
+	u[3] = (char)(0x80 | (cp & 0x3f));
+	return 4;
+}
+
+int json_tok_str(const char *js, const json_tok_t *t, char *out, size_t size)
+{
+	size_t n = 0;
+
+	if (t->type != JSON_STRING)
+	{
+		return JSON_ERR_TYPE;
+	}
+	if (size == 0)
+	{
+		return JSON_ERR_NOMEM;
+	}
+	out[0] = '\0';
+	for (uint32_t i = t->start; i < t->end; i++)
+	{
+		char u[4];
+		size_t k = 1;
+
+		/* Unescaped bytes are copied as they are: SSIDs need not be UTF-8. */
+		u[0] = js[i];
+		if (js[i] == '\\')
+		{
+			/* The parser checked every escape, so what is read here lies within the token. */
+			switch (js[++i])
+			{
+				case 'b': u[0] = '\b'; break;
+				case 'f': u[0] = '\f'; break;
+				case 'n': u[0] = '\n'; break;
+				case 'r': u[0] = '\r'; break;
+				case 't': u[0] = '\t'; break;
+				case 'u':
+				{
+					uint32_t cp = hex4(js + i + 1);
+					i += 4;
+					if (cp >= 0xdc00 && cp <= 0xdfff)
+					{
+						return JSON_ERR_INVAL;
+					}
+					if (cp >= 0xd800 && cp <= 0xdbff)
+					{
+						if (i + 6 >= t->end || js[i + 1] != '\\' || js[i + 2] != 'u')
+						{
+							return JSON_ERR_INVAL;
+						}
+						uint32_t lo = hex4(js + i + 3);
+						if (lo < 0xdc00 || lo > 0xdfff)
+						{
+							return JSON_ERR_INVAL;
+						}
+						cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+						i += 6;
+					}
+					if (cp == 0)
+					{
+						return JSON_ERR_INVAL;
+					}
+					k = utf8_encode(cp, u);
+					break;
+				}
+				default:
+					u[0] = js[i];
+					break;
+			}
+		}
+		if (n + k >= size)
+		{
+			return JSON_ERR_NOMEM;
+		}
+		memcpy(out + n, u, k);
+		n += k;
+		/* Kept terminated, so a failed decode still leaves a C string. */
+		out[n] = '\0';
+	}
+	return (int)n;
+}
+
+bool json_tok_int(const char *js, const json_tok_t *t, int64_t *v)
+{
+	uint32_t i = t->start;
+	bool negative = false;
+	uint64_t acc = 0;
+
+	if (t->type != JSON_NUMBER)
+	{
+		return false;
+	}
+	if (js[i] == '-')
+	{
+		negative = true;
+		i++;
+	}
+	/* One past INT64_MAX is allowed only as INT64_MIN. */
+	uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+	for (; i < t->end; i++)
+	{
+		if (!is_digit(js[i]))
+		{
+			return false;
+		}
+		unsigned d = (unsigned)(js[i] - '0');
+		if (acc > (limit - d) / 10)
+		{
+			return false;
+		}
+		acc = acc * 10 + d;
+	}
+	*v = negative ? (int64_t)(0 - acc) : (int64_t)acc;
 	return true;
 }
 
+bool json_tok_double(const char *js, const json_tok_t *t, double *v)
+{
+	char num[40];
+	size_t n = t->end - t->start;
+
+	/* strtod wants a NUL, and a longer number than this is not worth the trouble. */
+	if (t->type != JSON_NUMBER || n >= sizeof(num))
+	{
+		return false;
+	}
+	memcpy(num, js + t->start, n);
+	num[n] = '\0';
+	*v = strtod(num, NULL);
+	return isfinite(*v);
+}
+
+bool json_tok_bool(const char *js, const json_tok_t *t, bool *v)
+{
+	if (t->type != JSON_BOOL)
+	{
+		return false;
+	}
+	*v = js[t->start] == 't';
+	return true;
+}
+
+int json_obj_get(const char *js, const json_tok_t *toks, int obj, const char *key)
+{
+	if (toks[obj].type != JSON_OBJECT)
+	{
+		return -1;
+	}
+	int i = obj + 1;
+	for (unsigned m = 0; m < toks[obj].size; m++)
+	{
+		if (json_tok_eq(js, &toks[i], key))
+		{
+			return i + 1;
+		}
+		i = toks[i + 1].next;
+	}
+	return -1;
+}
+
+static int bind_field(const char *js, const json_tok_t *t, const json_field_t *f, void *out)
+{
+	char *dst = (char *)out + f->offset;
+
+	switch (f->type)
+	{
+		case JSON_FIELD_STR:
+		{
+			int n = json_tok_str(js, t, dst, f->size);
+			if (n == JSON_ERR_NOMEM)
+			{
+				return JSON_ERR_TYPE;
+			}
+			if (n < 0)
+			{
+				return n;
+			}
+			return n < f->min || n > f->max ? JSON_ERR_TYPE : JSON_OK;
+		}
+		case JSON_FIELD_INT:
+		{
+			int64_t v;
+			if (!json_tok_int(js, t, &v) || v < f->min || v > f->max)
+			{
+				return JSON_ERR_TYPE;
+			}
+			/* Through the unsigned type of the same width: defined for signed and unsigned members alike. */
+			switch (f->size)
+			{
+				case 1: { uint8_t u = (uint8_t)v; memcpy(dst, &u, 1); break; }
+				case 2: { uint16_t u = (uint16_t)v; memcpy(dst, &u, 2); break; }
+				case 4: { uint32_t u = (uint32_t)v; memcpy(dst, &u, 4); break; }
+				case 8: { uint64_t u = (uint64_t)v; memcpy(dst, &u, 8); break; }
+				default: return JSON_ERR_TYPE;
+			}
+			return JSON_OK;
+		}
+		case JSON_FIELD_BOOL:
+		{
+			bool v;
+			if (!json_tok_bool(js, t, &v))
+			{
+				return JSON_ERR_TYPE;
+			}
+			memcpy(dst, &v, sizeof(v));
+			return JSON_OK;
+		}
+		case JSON_FIELD_DOUBLE:
+		{
+			double v;
+			if (!json_tok_double(js, t, &v))
+			{
+				return JSON_ERR_TYPE;
+			}
+			memcpy(dst, &v, sizeof(v));
+			return JSON_OK;
+		}
+		default:
+			return JSON_ERR_TYPE;
+	}
+}
+
+int json_bind(const char *js, const json_tok_t *toks, int obj,
+		const json_field_t *fields, size_t nfields, void *out, const char **bad)
+{
+	uint32_t seen = 0;
+	int i = obj + 1;
+
+	if (toks[obj].type != JSON_OBJECT || nfields > 32)
+	{
+		return JSON_ERR_TYPE;
+	}
+	for (unsigned m = 0; m < toks[obj].size; m++, i = toks[i + 1].next)
+	{
+		for (size_t f = 0; f < nfields; f++)
+		{
+			if (!json_tok_eq(js, &toks[i], fields[f].key))
+			{
+				continue;
+			}
+			int err = seen & 1u << f ? JSON_ERR_DUP : bind_field(js, &toks[i + 1], &fields[f], out);
+			if (err != JSON_OK)
+			{
+				if (bad)
+				{
+					*bad = fields[f].key;
+				}
+				return err;
+			}
+			seen |= 1u << f;
+			break;
+		}
+	}
+	for (size_t f = 0; f < nfields; f++)
+	{
+		if (fields[f].required && !(seen & 1u << f))
+		{
+			if (bad)
+			{
+				*bad = fields[f].key;
+			}
+			return JSON_ERR_MISSING;
+		}
+	}
+	return JSON_OK;
+}
@@ -1,6 +1,7 @@
 /*
 @file json.h
-@brief handles very basic JSON with a minimal footprint on the system
+@brief handles very basic JSON with a minimal footprint on the system: string escaping, a
+       streaming writer and an in-place parser, none of which need the heap
 
 This code is a lightly modified version of cJSON 1.4.7. cJSON is licensed under the MIT license:
 Copyright (c) 2009 Dave Gamble
@@ -28,18 +29,193 @@ OTHER DEALINGS IN THE SOFTWARE.
 #ifndef JSON_H_INCLUDED
 #define JSON_H_INCLUDED
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
  * @brief Render the cstring provided to a JSON escaped version that can be printed.
- * @param input the input buffer to be escaped.
- * @param output_buffer the output buffer to write to. You must ensure it is big enough to contain the final string.
+ * @param input the input buffer to be escaped. NULL renders as "".
+ * @param output_buffer the output buffer to write to. You must ensure it is big enough to contain the final string
+ *        (6 bytes per input byte, plus quotes and NUL).
  * @see cJSON equivlaent static cJSON_bool print_string_ptr(const unsigned char * const input, printbuffer * const output_buffer)
  */
 bool json_print_string(const unsigned char *input, unsigned char *output_buffer);
 
+/**
+ * @brief Receives the writer's buffer each time it fills up, and the rest from json_writer_finish().
+ * @return false to abort; the writer then fails from there on.
+ */
+typedef bool (*json_flush_t)(void *ctx, const char *data, size_t len);
+
+#define JSON_WRITER_MAX_DEPTH 32
+
+/**
+ * @brief Streaming JSON writer. Output goes into the caller's buffer; with a flush
+ *        callback the buffer is emptied through it whenever it fills, so documents of
+ *        any size stream through a small buffer. Without one, the document must fit
+ *        and is NUL-terminated by json_writer_finish().
+ *
+ *        Commas and colons are placed by the writer. Errors (overflow, a failed flush,
+ *        nesting deeper than JSON_WRITER_MAX_DEPTH, unbalanced ends) are sticky: check
+ *        json_writer_finish() once at the end. Never allocates.
+ *
+ *        The struct may be copied to take a checkpoint and assigned back to roll a
+ *        fixed-buffer document back to it.
+ */
+typedef struct {
+	char *buf;
+	size_t size;         /* usable bytes; one less than the buffer in fixed mode, for the NUL */
+	size_t len;
+	json_flush_t flush;
+	void *ctx;
+	uint32_t nonempty;   /* bit d: the container at depth d already has a member */
+	uint8_t depth;
+	bool key_pending;    /* a key was written, its value comes next */
+	bool error;
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_flush_t flush, void *ctx);
+
+/**
+ * @brief Flush what is left (flush mode) or NUL-terminate (fixed mode).
+ * @return true if the whole document was written and its containers are closed.
+ */
+bool json_writer_finish(json_writer_t *w);
+
+void json_obj_begin(json_writer_t *w);
+void json_obj_end(json_writer_t *w);
+void json_arr_begin(json_writer_t *w);
+void json_arr_end(json_writer_t *w);
+
+/** @brief Member name inside an object; the next value call supplies its value. */
+void json_key(json_writer_t *w, const char *key);
+
+void json_str(json_writer_t *w, const char *s);                 /* NULL writes null */
+void json_strn(json_writer_t *w, const char *s, size_t len);    /* may contain NULs */
+void json_int(json_writer_t *w, int64_t v);
+void json_uint(json_writer_t *w, uint64_t v);
+void json_double(json_writer_t *w, double v);                   /* NaN and infinities write null */
+void json_bool(json_writer_t *w, bool v);
+void json_null(json_writer_t *w);
+/** @brief Already-rendered JSON, copied as is (a cached document, for instance). */
+void json_raw(json_writer_t *w, const char *json, size_t len);
+
+/* Key and value in one call. */
+void json_kv_str(json_writer_t *w, const char *key, const char *s);
+void json_kv_int(json_writer_t *w, const char *key, int64_t v);
+void json_kv_uint(json_writer_t *w, const char *key, uint64_t v);
+void json_kv_bool(json_writer_t *w, const char *key, bool v);
+
+typedef enum {
+	JSON_OK = 0,
+	JSON_ERR_NOMEM = -1,    /* more values than the token array holds, or a decoded string too long */
+	JSON_ERR_INVAL = -2,    /* not JSON */
+	JSON_ERR_PART = -3,     /* JSON, but cut short */
+	JSON_ERR_DEPTH = -4,    /* nested deeper than JSON_PARSE_MAX_DEPTH */
+	JSON_ERR_TYPE = -5,     /* bind: a value of the wrong type, or out of range */
+	JSON_ERR_MISSING = -6,  /* bind: a required field is absent */
+	JSON_ERR_DUP = -7       /* bind: the same key twice */
+} json_err_t;
+
+typedef enum {
+	JSON_OBJECT = 1,
+	JSON_ARRAY,
+	JSON_STRING,
+	JSON_NUMBER,
+	JSON_BOOL,
+	JSON_NULL
+} json_type_t;
+
+#define JSON_PARSE_MAX_DEPTH 16
+
+/**
+ * @brief One value, or object key, of a parsed document: byte offsets into the input,
+ *        which must stay in place while the tokens are used. Strings span their
+ *        contents without the quotes, escapes still in place.
+ *
+ *        Tokens are in document order. An object's members follow it as key, value,
+ *        key, value; "next" steps over a whole value, nested ones included.
+ */
+typedef struct {
+	uint8_t type;           /* json_type_t */
+	uint16_t size;          /* members of an object, elements of an array */
+	uint16_t next;          /* index of the first token after this value */
+	uint32_t start;
+	uint32_t end;
+} json_tok_t;
+
+/**
+ * @brief Tokenize a complete JSON document in place, jsmn style, into a fixed token array.
+ *        Strict (RFC 8259 grammar, one top-level value), one pass over the input with
+ *        nesting capped at JSON_PARSE_MAX_DEPTH, so any input is rejected or accepted in
+ *        time linear in its length. Never allocates; the input need not be NUL-terminated.
+ * @param max_toks At most 65535 are used.
+ * @return The number of tokens, or a negative json_err_t.
+ */
+int json_parse(const char *js, size_t len, json_tok_t *toks, unsigned max_toks);
+
+/** @brief True if the string token is exactly s. Escapes are not decoded, which is what keys need. */
+bool json_tok_eq(const char *js, const json_tok_t *t, const char *s);
+
+/**
+ * @brief Decode a string token, escapes and surrogate pairs included, to NUL-terminated UTF-8.
+ *        \u0000 is refused, since it would cut the C string short.
+ * @return The decoded length, or a negative json_err_t.
+ */
+int json_tok_str(const char *js, const json_tok_t *t, char *out, size_t size);
+
+/** @brief Integers only: a fraction or exponent, or more than 64 bits, fail. */
+bool json_tok_int(const char *js, const json_tok_t *t, int64_t *v);
+bool json_tok_double(const char *js, const json_tok_t *t, double *v);
+bool json_tok_bool(const char *js, const json_tok_t *t, bool *v);
+
+/** @return Index of the value under key in object toks[obj], or -1. */
+int json_obj_get(const char *js, const json_tok_t *toks, int obj, const char *key);
+
+typedef enum {
+	JSON_FIELD_STR,
+	JSON_FIELD_INT,
+	JSON_FIELD_BOOL,
+	JSON_FIELD_DOUBLE
+} json_field_type_t;
+
+/** @brief Where one object member lands in a struct; build them with the JSON_BIND_* macros. */
+typedef struct {
+	const char *key;
+	uint8_t type;           /* json_field_type_t */
+	bool required;
+	uint16_t offset;
+	uint16_t size;          /* STR: the char array, NUL included; INT: sizeof the member */
+	int64_t min;            /* INT: value range; STR: length range */
+	int64_t max;
+} json_field_t;
+
+#define JSON_BIND_STR(key, type, member, required, min_len) \
+	{ (key), JSON_FIELD_STR, (required), offsetof(type, member), sizeof(((type *)0)->member), \
+	  (min_len), sizeof(((type *)0)->member) - 1 }
+#define JSON_BIND_INT(key, type, member, required, lo, hi) \
+	{ (key), JSON_FIELD_INT, (required), offsetof(type, member), sizeof(((type *)0)->member), (lo), (hi) }
+#define JSON_BIND_BOOL(key, type, member, required) \
+	{ (key), JSON_FIELD_BOOL, (required), offsetof(type, member), sizeof(bool), 0, 0 }
+#define JSON_BIND_DOUBLE(key, type, member, required) \
+	{ (key), JSON_FIELD_DOUBLE, (required), offsetof(type, member), sizeof(double), 0, 0 }
+
+/**
+ * @brief Copy the members of object toks[obj] described by fields (at most 32) straight
+ *        into the struct at out. Unknown keys are skipped, fields absent from the document
+ *        are left alone. A repeated key, a wrong type, a value out of range or a missing
+ *        required field fails the bind; out may then be partly written.
+ * @param bad If not NULL, set to the key at fault on failure.
+ * @return JSON_OK or a negative json_err_t.
+ */
+int json_bind(const char *js, const json_tok_t *toks, int obj,
+		const json_field_t *fields, size_t nfields, void *out, const char **bad);
+
 #ifdef __cplusplus
 }
 #endif
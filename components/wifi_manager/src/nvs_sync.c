@@ -28,9 +28,11 @@ SOFTWARE.
 */
 
 #include <stdbool.h>
+#include <string.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 #include <esp_err.h>
+#include <esp_timer.h>
 #include "nvs_sync.h"
 
 
@@ -60,6 +62,108 @@ void nvs_sync_free(){
     }
 }
 
+#if DEFAULT_NVS_SYNC_STATS
+
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static nvs_sync_stats_t stats;
+/* Set by the holder only, read racily by waiters to see who they wait for. */
+static volatile int holder = -1;
+static int64_t held_since_us;
+
+static int bucket(uint32_t us){
+	int i = 0;
+	for(uint32_t limit = 16; i < NVS_SYNC_BUCKETS - 1 && us >= limit; limit <<= 2){
+		i++;
+	}
+	return i;
+}
+
+uint32_t nvs_sync_bucket_limit_us(int i){
+	return i < NVS_SYNC_BUCKETS - 1 ? 16u << (2 * i) : 0;
+}
+
+/* Index for a call site, added on first use; under stats_mux. */
+static int site_index(const char *site){
+	for(size_t i = 0; i < stats.sites; i++){
+		if(stats.site[i].site == site || strcmp(stats.site[i].site, site) == 0){
+			return i;
+		}
+	}
+	if(stats.sites == NVS_SYNC_SITES - 1){
+		stats.site[stats.sites++].site = "other";
+	}
+	else if(stats.sites < NVS_SYNC_SITES - 1){
+		stats.site[stats.sites].site = site;
+		return stats.sites++;
+	}
+	return NVS_SYNC_SITES - 1;
+}
+
+bool nvs_sync_lock_at(TickType_t xTicksToWait, const char *site){
+	if(nvs_sync_mutex == NULL){
+		return false;
+	}
+
+	int blocker = holder;
+	int64_t t0 = esp_timer_get_time();
+	bool locked = xSemaphoreTake( nvs_sync_mutex, xTicksToWait ) == pdTRUE;
+	int64_t now = esp_timer_get_time();
+	uint32_t wait = (uint32_t)(now - t0);
+
+	taskENTER_CRITICAL(&stats_mux);
+	int i = site_index(site);
+	nvs_sync_site_stats_t *s = &stats.site[i];
+	if(blocker >= 0){
+		s->contended++;
+		if(s->blocked_by[blocker] < UINT16_MAX){
+			s->blocked_by[blocker]++;
+		}
+	}
+	if(locked){
+		s->locks++;
+		s->wait_hist[bucket(wait)]++;
+		s->wait_us += wait;
+		if(wait > s->wait_max_us){
+			s->wait_max_us = wait;
+		}
+		holder = i;
+		held_since_us = now;
+	}
+	else{
+		s->timeouts++;
+	}
+	taskEXIT_CRITICAL(&stats_mux);
+	return locked;
+}
+
+static void record_hold(void){
+	uint32_t hold = (uint32_t)(esp_timer_get_time() - held_since_us);
+
+	taskENTER_CRITICAL(&stats_mux);
+	if(holder >= 0){
+		nvs_sync_site_stats_t *s = &stats.site[holder];
+		s->hold_hist[bucket(hold)]++;
+		s->hold_us += hold;
+		if(hold > s->hold_max_us){
+			s->hold_max_us = hold;
+		}
+		if(hold > stats.hold_max_us){
+			stats.hold_max_us = hold;
+			stats.hold_max_site = s->site;
+		}
+		holder = -1;
+	}
+	taskEXIT_CRITICAL(&stats_mux);
+}
+
+void nvs_sync_get_stats(nvs_sync_stats_t *out){
+	taskENTER_CRITICAL(&stats_mux);
+	*out = stats;
+	taskEXIT_CRITICAL(&stats_mux);
+}
+
+#else
+
 bool nvs_sync_lock(TickType_t xTicksToWait){
 	if(nvs_sync_mutex){
 		if( xSemaphoreTake( nvs_sync_mutex, xTicksToWait ) == pdTRUE ) {
@@ -74,6 +178,12 @@ bool nvs_sync_lock(TickType_t xTicksToWait){
 	}
 }
 
+#endif
+
 void nvs_sync_unlock(){
+#if DEFAULT_NVS_SYNC_STATS
+	/* Booked before the give, while this task still holds the lock. */
+	record_hold();
+#endif
 	xSemaphoreGive( nvs_sync_mutex );
 }
@@ -33,6 +33,8 @@ SOFTWARE.
 #define WIFI_MANAGER_NVS_SYNC_H_INCLUDED
 
 #include <stdbool.h> /* for type bool */
+#include <stddef.h> /* for size_t */
+#include <stdint.h> /* for uint32_t */
 #include <freertos/FreeRTOS.h> /* for TickType_t */
 #include <esp_err.h> /* for esp_err_t */
 
@@ -44,9 +46,16 @@ extern "C" {
 /**
  * @brief Attempts to get hold of the NVS semaphore for a set amount of ticks.
  * @note If you are uncertain about the number of ticks to wait use portMAX_DELAY.
+ * @note With DEFAULT_NVS_SYNC_STATS this is a macro passing the calling function
+ *       along as the call site; without it, the instrumentation is not compiled in.
  * @return true on a succesful lock, false otherwise
  */
+#if DEFAULT_NVS_SYNC_STATS
+bool nvs_sync_lock_at(TickType_t xTicksToWait, const char *site);
+#define nvs_sync_lock(xTicksToWait) nvs_sync_lock_at((xTicksToWait), __func__)
+#else
 bool nvs_sync_lock(TickType_t xTicksToWait);
+#endif
 
 
 /**
@@ -68,6 +77,41 @@ esp_err_t nvs_sync_create();
  */
 void nvs_sync_free();
 
+#if DEFAULT_NVS_SYNC_STATS
+
+/* Call sites told apart; later ones are counted together under "other". */
+#define NVS_SYNC_SITES 8
+/* Wait and hold histograms: < 16 us, < 64 us, ... < 65.5 ms, then the rest (x4 per bucket). */
+#define NVS_SYNC_BUCKETS 8
+
+typedef struct {
+	const char *site;                        /* the function that took the lock */
+	uint32_t locks;
+	uint32_t timeouts;                       /* gave up waiting */
+	uint32_t contended;                      /* found it held */
+	uint32_t wait_hist[NVS_SYNC_BUCKETS];
+	uint32_t hold_hist[NVS_SYNC_BUCKETS];
+	uint64_t wait_us;
+	uint64_t hold_us;
+	uint32_t wait_max_us;
+	uint32_t hold_max_us;
+	uint16_t blocked_by[NVS_SYNC_SITES];     /* contended waits, by the holder's site index */
+} nvs_sync_site_stats_t;
+
+typedef struct {
+	size_t sites;                            /* entries used in site[] */
+	nvs_sync_site_stats_t site[NVS_SYNC_SITES];
+	const char *hold_max_site;               /* the longest hold on record, and by whom */
+	uint32_t hold_max_us;
+} nvs_sync_stats_t;
+
+void nvs_sync_get_stats(nvs_sync_stats_t *out);
+
+/** @brief Upper bound of histogram bucket i, in microseconds; 0 for the last, open one. */
+uint32_t nvs_sync_bucket_limit_us(int i);
+
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,519 @@
+/*
+ *  settings.c
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.69
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "nvs_sync.h"
+#include "settings.h"
+
+/* Schema version, next to the settings in each namespace. */
+#define SETTINGS_VERSION_KEY "_ver"
+
+#define SETTINGS_TASK_STACK    3072
+#define SETTINGS_TASK_PRIORITY 2
+
+typedef struct {
+	const settings_schema_t *schema;
+	uint8_t *values;        /* each setting at offsets[id], size from its def */
+	uint16_t offsets[SETTINGS_MAX_PER_SCHEMA];
+	uint32_t dirty;         /* bit id: the mirror differs from flash */
+	bool version_dirty;     /* the namespace has no version key yet */
+} settings_group_t;
+
+static const char TAG[] = "settings";
+
+/* Guards the mirrors, dirty bits and stats; held only for a copy of one value. */
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+static settings_group_t groups[SETTINGS_MAX_SCHEMAS];
+static size_t group_count;
+static esp_timer_handle_t flush_timer;
+static TaskHandle_t flush_task;
+static int64_t dirty_since_us;
+static settings_stats_t stats;
+
+static size_t value_size(const settings_def_t *def) {
+	switch (def->type) {
+	case SETTINGS_TYPE_INT:
+		return sizeof(int32_t);
+	case SETTINGS_TYPE_BOOL:
+		return sizeof(bool);
+	default:
+		return def->size;
+	}
+}
+
+static settings_group_t *find(const settings_schema_t *schema) {
+	for (size_t i = 0; i < group_count; i++) {
+		if (groups[i].schema == schema) {
+			return &groups[i];
+		}
+	}
+	return NULL;
+}
+
+/* The group, if id names a setting of this type in a registered schema. */
+static settings_group_t *lookup(const settings_schema_t *schema, unsigned id, settings_type_t type) {
+	settings_group_t *g = find(schema);
+
+	if (g == NULL || id >= schema->count || schema->defs[id].type != type) {
+		return NULL;
+	}
+	return g;
+}
+
+static void set_default(settings_group_t *g, unsigned id) {
+	const settings_def_t *def = &g->schema->defs[id];
+	uint8_t *v = g->values + g->offsets[id];
+
+	switch (def->type) {
+	case SETTINGS_TYPE_INT:
+		memcpy(v, &def->def_int, sizeof(int32_t));
+		break;
+	case SETTINGS_TYPE_BOOL:
+		*(bool *)v = def->def_int != 0;
+		break;
+	case SETTINGS_TYPE_STR:
+		memset(v, 0, def->size);
+		if (def->def) {
+			strncpy((char *)v, def->def, def->size - 1);
+		}
+		break;
+	default:
+		if (def->def) {
+			memcpy(v, def->def, def->size);
+		} else {
+			memset(v, 0, def->size);
+		}
+		break;
+	}
+}
+
+/* Straight into the mirror; registration is the only writer at this point. A missing or mismatched key keeps its default. */
+static void load(settings_group_t *g, nvs_handle_t nvs, unsigned id) {
+	const settings_def_t *def = &g->schema->defs[id];
+	uint8_t *v = g->values + g->offsets[id];
+	uint8_t buf[SETTINGS_VALUE_MAX];
+	size_t len = def->size;
+	int32_t i32;
+	uint8_t u8;
+
+	switch (def->type) {
+	case SETTINGS_TYPE_INT:
+		if (nvs_get_i32(nvs, def->key, &i32) == ESP_OK) {
+			memcpy(v, &i32, sizeof(i32));
+		}
+		break;
+	case SETTINGS_TYPE_BOOL:
+		if (nvs_get_u8(nvs, def->key, &u8) == ESP_OK) {
+			*(bool *)v = u8 != 0;
+		}
+		break;
+	case SETTINGS_TYPE_STR:
+		if (nvs_get_str(nvs, def->key, (char *)buf, &len) == ESP_OK) {
+			memset(v, 0, def->size);
+			memcpy(v, buf, len);
+		}
+		break;
+	default:
+		if (nvs_get_blob(nvs, def->key, buf, &len) == ESP_OK && len == def->size) {
+			memcpy(v, buf, len);
+		}
+		break;
+	}
+}
+
+static esp_err_t store(nvs_handle_t nvs, const settings_def_t *def, const uint8_t *v) {
+	switch (def->type) {
+	case SETTINGS_TYPE_INT: {
+		int32_t i32;
+		memcpy(&i32, v, sizeof(i32));
+		return nvs_set_i32(nvs, def->key, i32);
+	}
+	case SETTINGS_TYPE_BOOL:
+		return nvs_set_u8(nvs, def->key, *(const bool *)v);
+	case SETTINGS_TYPE_STR:
+		return nvs_set_str(nvs, def->key, (const char *)v);
+	default:
+		return nvs_set_blob(nvs, def->key, v, def->size);
+	}
+}
+
+/*
+ * The timer only wakes the flush task: the flush waits for nvs_sync_lock() and
+ * for flash, and every other esp_timer callback would wait behind it.
+ */
+static void flush_timer_cb(void *arg) {
+	xTaskNotifyGive(flush_task);
+}
+
+static void flush_task_fn(void *arg) {
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		settings_flush();
+	}
+}
+
+static bool check_schema(const settings_schema_t *schema) {
+	if (schema->count == 0 || schema->count > SETTINGS_MAX_PER_SCHEMA || strlen(schema->ns) > NVS_KEY_NAME_MAX_SIZE - 1) {
+		return false;
+	}
+	for (size_t i = 0; i < schema->count; i++) {
+		const settings_def_t *def = &schema->defs[i];
+		if (strlen(def->key) > NVS_KEY_NAME_MAX_SIZE - 1 || strcmp(def->key, SETTINGS_VERSION_KEY) == 0 ||
+				def->type > SETTINGS_TYPE_BLOB || def->size == 0 || def->size > SETTINGS_VALUE_MAX) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Under nvs_sync_lock(). Returns true if the stored settings are worth reading. */
+static bool check_version(nvs_handle_t nvs, settings_group_t *g) {
+	const settings_schema_t *schema = g->schema;
+	uint8_t version;
+	esp_err_t err = nvs_get_u8(nvs, SETTINGS_VERSION_KEY, &version);
+
+	if (err == ESP_ERR_NVS_NOT_FOUND) {
+		/* New namespace, or one written before it had a schema: read what matches. */
+		g->version_dirty = true;
+		return true;
+	}
+	if (err != ESP_OK || version == schema->version) {
+		return err == ESP_OK;
+	}
+	if (version > schema->version) {
+		ESP_LOGW(TAG, "%s is version %u, newer than this firmware's %u", schema->ns, version, schema->version);
+		return true;
+	}
+
+	if (schema->migrate && schema->migrate(nvs, version, schema->ctx) == ESP_OK &&
+			nvs_set_u8(nvs, SETTINGS_VERSION_KEY, schema->version) == ESP_OK && nvs_commit(nvs) == ESP_OK) {
+		ESP_LOGI(TAG, "%s migrated from version %u to %u", schema->ns, version, schema->version);
+		stats.migrations++;
+		return true;
+	}
+	ESP_LOGW(TAG, "%s reset to defaults (version %u, now %u)", schema->ns, version, schema->version);
+	nvs_erase_all(nvs);
+	nvs_set_u8(nvs, SETTINGS_VERSION_KEY, schema->version);
+	nvs_commit(nvs);
+	stats.resets++;
+	return false;
+}
+
+esp_err_t settings_register(const settings_schema_t *schema) {
+	nvs_handle_t nvs;
+	size_t total = 0;
+	esp_err_t err;
+
+	if (find(schema)) {
+		return ESP_OK;
+	}
+	if (group_count >= SETTINGS_MAX_SCHEMAS || !check_schema(schema)) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (flush_task == NULL &&
+			xTaskCreate(flush_task_fn, "settings", SETTINGS_TASK_STACK, NULL, SETTINGS_TASK_PRIORITY, &flush_task) != pdPASS) {
+		return ESP_ERR_NO_MEM;
+	}
+	if (flush_timer == NULL) {
+		const esp_timer_create_args_t args = {
+			.callback = flush_timer_cb,
+			.name = "settings_flush",
+		};
+		err = esp_timer_create(&args, &flush_timer);
+		if (err != ESP_OK) {
+			return err;
+		}
+	}
+
+	settings_group_t g = { .schema = schema };
+	for (size_t i = 0; i < schema->count; i++) {
+		g.offsets[i] = total;
+		/* Keeps every int at a 4-byte boundary. */
+		total += (value_size(&schema->defs[i]) + 3) & ~3u;
+	}
+	g.values = calloc(1, total);
+	if (g.values == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	for (size_t i = 0; i < schema->count; i++) {
+		set_default(&g, i);
+	}
+
+	if (!nvs_sync_lock(portMAX_DELAY)) {
+		free(g.values);
+		return ESP_ERR_TIMEOUT;
+	}
+	err = nvs_open(schema->ns, NVS_READWRITE, &nvs);
+	if (err == ESP_OK) {
+		if (check_version(nvs, &g)) {
+			for (size_t i = 0; i < schema->count; i++) {
+				load(&g, nvs, i);
+			}
+		}
+		nvs_close(nvs);
+	}
+	nvs_sync_unlock();
+	if (err != ESP_OK) {
+		free(g.values);
+		return err;
+	}
+
+	taskENTER_CRITICAL(&mux);
+	groups[group_count++] = g;
+	taskEXIT_CRITICAL(&mux);
+	return ESP_OK;
+}
+
+static void read_value(const settings_group_t *g, unsigned id, void *out, size_t len) {
+	taskENTER_CRITICAL(&mux);
+	memcpy(out, g->values + g->offsets[id], len);
+	taskEXIT_CRITICAL(&mux);
+}
+
+int32_t settings_get_int(const settings_schema_t *schema, unsigned id) {
+	settings_group_t *g = lookup(schema, id, SETTINGS_TYPE_INT);
+	int32_t v = 0;
+
+	if (g) {
+		read_value(g, id, &v, sizeof(v));
+	}
+	return v;
+}
+
+bool settings_get_bool(const settings_schema_t *schema, unsigned id) {
+	settings_group_t *g = lookup(schema, id, SETTINGS_TYPE_BOOL);
+	bool v = false;
+
+	if (g) {
+		read_value(g, id, &v, sizeof(v));
+	}
+	return v;
+}
+
+esp_err_t settings_get_str(const settings_schema_t *schema, unsigned id, char *out, size_t size) {
+	settings_group_t *g = lookup(schema, id, SETTINGS_TYPE_STR);
+
+	if (g == NULL || size == 0) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	size_t n = schema->defs[id].size;
+	if (size < n) {
+		/* Only as much as the caller has room for; the mirror is always terminated. */
+		n = size;
+	}
+	read_value(g, id, out, n);
+	out[n - 1] = '\0';
+	return ESP_OK;
+}
+
+esp_err_t settings_get_blob(const settings_schema_t *schema, unsigned id, void *out, size_t size) {
+	settings_group_t *g = lookup(schema, id, SETTINGS_TYPE_BLOB);
+
+	if (g == NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	if (size != schema->defs[id].size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	read_value(g, id, out, size);
+	return ESP_OK;
+}
+
+/* Restarted by every change, so a burst is written once; but never pushed back past the maximum delay. */
+static void schedule_flush(void) {
+	int64_t now = esp_timer_get_time();
+	int64_t since;
+
+	taskENTER_CRITICAL(&mux);
+	if (dirty_since_us == 0) {
+		dirty_since_us = now;
+	}
+	since = dirty_since_us;
+	taskEXIT_CRITICAL(&mux);
+
+	int64_t delay = (int64_t)DEFAULT_SETTINGS_FLUSH_MS * 1000;
+	int64_t left = since + (int64_t)DEFAULT_SETTINGS_FLUSH_MAX_MS * 1000 - now;
+	if (left < delay) {
+		if (esp_timer_is_active(flush_timer)) {
+			return;
+		}
+		delay = left > 0 ? left : 0;
+	}
+	esp_timer_stop(flush_timer);
+	esp_timer_start_once(flush_timer, delay);
+}
+
+/* value is len bytes; for strings the rest of the setting is zero-filled, so equal strings compare equal. */
+static esp_err_t set_value(const settings_schema_t *schema, unsigned id, settings_type_t type, const void *value, size_t len) {
+	settings_group_t *g = lookup(schema, id, type);
+	uint8_t buf[SETTINGS_VALUE_MAX] = { 0 };
+	bool changed;
+
+	if (g == NULL) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	size_t size = value_size(&schema->defs[id]);
+	if (len > size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	memcpy(buf, value, len);
+
+	uint8_t *v = g->values + g->offsets[id];
+	taskENTER_CRITICAL(&mux);
+	changed = memcmp(v, buf, size) != 0;
+	if (changed) {
+		memcpy(v, buf, size);
+		g->dirty |= 1u << id;
+		stats.sets++;
+	} else {
+		stats.unchanged++;
+	}
+	taskEXIT_CRITICAL(&mux);
+
+	if (changed) {
+		schedule_flush();
+	}
+	return ESP_OK;
+}
+
+esp_err_t settings_set_int(const settings_schema_t *schema, unsigned id, int32_t v) {
+	return set_value(schema, id, SETTINGS_TYPE_INT, &v, sizeof(v));
+}
+
+esp_err_t settings_set_bool(const settings_schema_t *schema, unsigned id, bool v) {
+	return set_value(schema, id, SETTINGS_TYPE_BOOL, &v, sizeof(v));
+}
+
+esp_err_t settings_set_str(const settings_schema_t *schema, unsigned id, const char *s) {
+	size_t len = strlen(s) + 1;
+	const settings_def_t *def = id < schema->count ? &schema->defs[id] : NULL;
+
+	if (def && def->type == SETTINGS_TYPE_STR && len > def->size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return set_value(schema, id, SETTINGS_TYPE_STR, s, len);
+}
+
+esp_err_t settings_set_blob(const settings_schema_t *schema, unsigned id, const void *data, size_t len) {
+	const settings_def_t *def = id < schema->count ? &schema->defs[id] : NULL;
+
+	if (def && len != def->size) {
+		return ESP_ERR_INVALID_SIZE;
+	}
+	return set_value(schema, id, SETTINGS_TYPE_BLOB, data, len);
+}
+
+/* Under nvs_sync_lock(); one commit for everything dirty in the group. */
+static esp_err_t flush_group(settings_group_t *g) {
+	const settings_schema_t *schema = g->schema;
+	uint8_t buf[SETTINGS_VALUE_MAX];
+	uint32_t failed = 0;
+	uint32_t written = 0;
+	nvs_handle_t nvs;
+
+	esp_err_t err = nvs_open(schema->ns, NVS_READWRITE, &nvs);
+	if (err != ESP_OK) {
+		return err;
+	}
+	for (unsigned id = 0; id < schema->count; id++) {
+		const settings_def_t *def = &schema->defs[id];
+		bool dirty;
+
+		/* Taken clean before the write: a set that lands meanwhile dirties it again. */
+		taskENTER_CRITICAL(&mux);
+		dirty = g->dirty & 1u << id;
+		if (dirty) {
+			memcpy(buf, g->values + g->offsets[id], value_size(def));
+			g->dirty &= ~(1u << id);
+		}
+		taskEXIT_CRITICAL(&mux);
+		if (!dirty) {
+			continue;
+		}
+
+		if (store(nvs, def, buf) == ESP_OK) {
+			written++;
+		} else {
+			failed |= 1u << id;
+		}
+	}
+	if (g->version_dirty && nvs_set_u8(nvs, SETTINGS_VERSION_KEY, schema->version) == ESP_OK) {
+		g->version_dirty = false;
+	}
+	err = nvs_commit(nvs);
+	nvs_close(nvs);
+	if (err != ESP_OK) {
+		/* Nothing is known to be on flash; all of it is written again next time. */
+		failed = ~0u >> (32 - schema->count);
+	}
+
+	taskENTER_CRITICAL(&mux);
+	g->dirty |= failed;
+	stats.keys_written += written;
+	stats.commits++;
+	if (failed) {
+		stats.errors++;
+	}
+	taskEXIT_CRITICAL(&mux);
+	if (failed) {
+		ESP_LOGW(TAG, "%s: flush failed (%s)", schema->ns, esp_err_to_name(err));
+		return err == ESP_OK ? ESP_FAIL : err;
+	}
+	return ESP_OK;
+}
+
+esp_err_t settings_flush(void) {
+	esp_err_t result = ESP_OK;
+	bool dirty = false;
+
+	if (!nvs_sync_lock(portMAX_DELAY)) {
+		return ESP_ERR_TIMEOUT;
+	}
+	int64_t t0 = esp_timer_get_time();
+	for (size_t i = 0; i < group_count; i++) {
+		if (groups[i].dirty || groups[i].version_dirty) {
+			esp_err_t err = flush_group(&groups[i]);
+			if (err != ESP_OK) {
+				result = err;
+			}
+		}
+	}
+	uint32_t us = (uint32_t)(esp_timer_get_time() - t0);
+	nvs_sync_unlock();
+
+	taskENTER_CRITICAL(&mux);
+	for (size_t i = 0; i < group_count; i++) {
+		dirty |= groups[i].dirty != 0;
+	}
+	/* Anything left (a failed write, or a set during the flush) starts a new delay. */
+	dirty_since_us = 0;
+	stats.flushes++;
+	stats.flush_us_last = us;
+	if (us > stats.flush_us_max) {
+		stats.flush_us_max = us;
+	}
+	taskEXIT_CRITICAL(&mux);
+
+	if (dirty) {
+		schedule_flush();
+	}
+	return result;
+}
+
+void settings_get_stats(settings_stats_t *out) {
+	taskENTER_CRITICAL(&mux);
+	*out = stats;
+	taskEXIT_CRITICAL(&mux);
+}
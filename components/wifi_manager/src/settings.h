@@ -0,0 +1,124 @@
+/*
+ *  settings.h
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.69
+ *
+ *  Typed settings over NVS with a RAM mirror. Each owner describes its
+ *  settings in a static schema (one NVS namespace, with a version) and
+ *  registers it once; reads then come from RAM. Writes update the mirror and
+ *  mark the setting dirty, and a flush a little later writes every dirty
+ *  setting and commits once, under nvs_sync_lock(), so a burst of changes
+ *  costs one commit. A write of the value already held costs nothing.
+ */
+
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SETTINGS_MAX_SCHEMAS 4
+#define SETTINGS_MAX_PER_SCHEMA 32
+/* Largest string (NUL included) or blob. */
+#define SETTINGS_VALUE_MAX 128
+
+typedef enum {
+	SETTINGS_TYPE_INT,
+	SETTINGS_TYPE_BOOL,
+	SETTINGS_TYPE_STR,
+	SETTINGS_TYPE_BLOB
+} settings_type_t;
+
+typedef struct {
+	const char *key;        /* NVS key, 15 characters at most */
+	uint8_t type;           /* settings_type_t */
+	uint16_t size;          /* STR: NUL included; BLOB: bytes */
+	int32_t def_int;        /* INT and BOOL default */
+	const void *def;        /* STR and BLOB default; NULL for "" or zeros */
+} settings_def_t;
+
+#define SETTINGS_INT(key, def)        { (key), SETTINGS_TYPE_INT, sizeof(int32_t), (def), NULL }
+#define SETTINGS_BOOL(key, def)       { (key), SETTINGS_TYPE_BOOL, sizeof(bool), (def), NULL }
+#define SETTINGS_STR(key, size, def)  { (key), SETTINGS_TYPE_STR, (size), 0, (def) }
+#define SETTINGS_BLOB(key, size, def) { (key), SETTINGS_TYPE_BLOB, (size), 0, (def) }
+
+/**
+ * @brief Brings a namespace written by an older schema up to date. Called with
+ *        nvs_sync_lock() held and the namespace open for writing; it renames or
+ *        converts keys in place, the settings are read afterwards. Nothing is
+ *        committed if it fails: the namespace is then reset to the defaults.
+ */
+typedef esp_err_t (*settings_migrate_t)(nvs_handle_t nvs, uint8_t from_version, void *ctx);
+
+/**
+ * @brief A setting is named by its schema and its index in defs; owners keep an
+ *        enum in the same order. Raise version when the meaning or type of a key
+ *        changes; new keys need no bump, they start at their default.
+ */
+typedef struct {
+	const char *ns;         /* NVS namespace, 15 characters at most */
+	uint8_t version;
+	const settings_def_t *defs;
+	size_t count;
+	settings_migrate_t migrate;   /* NULL: older namespaces are reset */
+	void *ctx;
+} settings_schema_t;
+
+typedef struct {
+	uint32_t sets;          /* writes that changed a value */
+	uint32_t unchanged;     /* writes of the value already held: no flash work */
+	uint32_t flushes;
+	uint32_t keys_written;
+	uint32_t commits;
+	uint32_t errors;        /* failed NVS writes or commits; those settings stay dirty */
+	uint32_t migrations;
+	uint32_t resets;
+	uint32_t flush_us_last;
+	uint32_t flush_us_max;
+} settings_stats_t;
+
+/**
+ * @brief Load a schema into RAM, migrating or resetting an older namespace.
+ *        A namespace from a newer schema (after a rollback, say) is read as far
+ *        as its keys still match and left at its version. Needs nvs_sync_create().
+ * @return ESP_ERR_INVALID_ARG for a bad schema, ESP_ERR_NO_MEM, or an NVS error.
+ */
+esp_err_t settings_register(const settings_schema_t *schema);
+
+/** @brief 0 or false for an unregistered schema or a setting of another type. */
+int32_t settings_get_int(const settings_schema_t *schema, unsigned id);
+bool settings_get_bool(const settings_schema_t *schema, unsigned id);
+esp_err_t settings_get_str(const settings_schema_t *schema, unsigned id, char *out, size_t size);
+esp_err_t settings_get_blob(const settings_schema_t *schema, unsigned id, void *out, size_t size);
+
+esp_err_t settings_set_int(const settings_schema_t *schema, unsigned id, int32_t v);
+esp_err_t settings_set_bool(const settings_schema_t *schema, unsigned id, bool v);
+/** @return ESP_ERR_INVALID_SIZE if s does not fit the setting. */
+esp_err_t settings_set_str(const settings_schema_t *schema, unsigned id, const char *s);
+esp_err_t settings_set_blob(const settings_schema_t *schema, unsigned id, const void *data, size_t len);
+
+/**
+ * @brief Write what is dirty now instead of after the flush delay; call it
+ *        before a restart. Flushes run DEFAULT_SETTINGS_FLUSH_MS after the last
+ *        change, or DEFAULT_SETTINGS_FLUSH_MAX_MS after the first at the latest,
+ *        on a task of the store's own, so a held nvs_sync_lock() delays only them.
+ */
+esp_err_t settings_flush(void);
+
+void settings_get_stats(settings_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SETTINGS_H_ */
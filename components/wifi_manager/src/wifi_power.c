@@ -0,0 +1,185 @@
+/*
+ *  wifi_power.c
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.53
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "wifi_power.h"
+
+/* One beacon interval (100 TU). */
+#define WIFI_POWER_BEACON_US   102400
+/*
+ * Radio-on time booked per wakeup: beacon reception plus the settle time on
+ * either side. A planning figure, not a measurement; only the ratios between
+ * profiles are meant to be compared.
+ */
+#define WIFI_POWER_AWAKE_US    3000
+
+typedef struct {
+	uint64_t active_us;
+	uint64_t tx_bytes;
+	uint32_t tx_packets;
+	uint32_t tx_wakeups;
+} wifi_power_acct_t;
+
+static const char TAG[] = "wifi_power";
+
+static portMUX_TYPE acct_mux = portMUX_INITIALIZER_UNLOCKED;
+static wifi_power_acct_t acct[WIFI_MANAGER_PS_PROFILES];
+static wifi_manager_ps_profile_t selected = WIFI_MANAGER_PS_NONE;
+static volatile wifi_manager_ps_profile_t effective = WIFI_MANAGER_PS_NONE;
+static bool link_up = false;
+static int64_t segment_start_us = 0;
+static int64_t last_tx_us = 0;
+
+static netif_linkoutput_fn sta_linkoutput = NULL;
+
+static const wifi_ps_type_t ps_types[WIFI_MANAGER_PS_PROFILES] = {
+	[WIFI_MANAGER_PS_NONE] = WIFI_PS_NONE,
+	[WIFI_MANAGER_PS_MIN_MODEM] = WIFI_PS_MIN_MODEM,
+	[WIFI_MANAGER_PS_MAX_MODEM] = WIFI_PS_MAX_MODEM,
+};
+
+/* Min-modem wakes every DTIM (assumed 1); max-modem every listen interval. */
+static uint32_t wake_period_us(wifi_manager_ps_profile_t p) {
+	switch (p) {
+	case WIFI_MANAGER_PS_MIN_MODEM:
+		return WIFI_POWER_BEACON_US;
+	case WIFI_MANAGER_PS_MAX_MODEM:
+		return DEFAULT_LISTEN_INTERVAL * WIFI_POWER_BEACON_US;
+	default:
+		return 0;
+	}
+}
+
+/* Caller holds acct_mux. */
+static void close_segment(int64_t now) {
+	if (link_up) {
+		acct[effective].active_us += now - segment_start_us;
+	}
+	segment_start_us = now;
+}
+
+/* Runs on the lwIP thread for every frame the station sends. */
+static err_t counting_linkoutput(struct netif *netif, struct pbuf *p) {
+	int64_t now = esp_timer_get_time();
+
+	taskENTER_CRITICAL(&acct_mux);
+	wifi_power_acct_t *a = &acct[effective];
+	uint32_t period = wake_period_us(effective);
+	a->tx_bytes += p->tot_len;
+	a->tx_packets++;
+	/* Idle for a whole wake period: the modem was asleep and this frame woke it. */
+	if (period && now - last_tx_us > period) {
+		a->tx_wakeups++;
+	}
+	last_tx_us = now;
+	taskEXIT_CRITICAL(&acct_mux);
+
+	return sta_linkoutput(netif, p);
+}
+
+void wifi_power_init(esp_netif_t *sta) {
+	struct netif *n = esp_netif_get_netif_impl(sta);
+
+	if (n && n->linkoutput && sta_linkoutput == NULL) {
+		sta_linkoutput = n->linkoutput;
+		n->linkoutput = counting_linkoutput;
+	} else {
+		ESP_LOGW(TAG, "STA netif not ready, TX bytes will not be counted");
+	}
+
+	switch (DEFAULT_WIFI_POWER_SAVE) {
+	case WIFI_PS_MIN_MODEM:
+		selected = WIFI_MANAGER_PS_MIN_MODEM;
+		break;
+	case WIFI_PS_MAX_MODEM:
+		selected = WIFI_MANAGER_PS_MAX_MODEM;
+		break;
+	default:
+		selected = WIFI_MANAGER_PS_NONE;
+		break;
+	}
+	segment_start_us = esp_timer_get_time();
+}
+
+bool wifi_power_apply(wifi_manager_ps_profile_t profile, bool ap_running) {
+	bool changed = (profile != selected);
+	wifi_manager_ps_profile_t next = ap_running ? WIFI_MANAGER_PS_NONE : profile;
+	wifi_ps_type_t current;
+
+	selected = profile;
+	/* Ask the driver rather than trust our copy: it starts in min-modem on its own. */
+	if (esp_wifi_get_ps(&current) != ESP_OK || current != ps_types[next]) {
+		esp_err_t err = esp_wifi_set_ps(ps_types[next]);
+		if (err != ESP_OK) {
+			ESP_LOGW(TAG, "esp_wifi_set_ps(%d): %s", ps_types[next], esp_err_to_name(err));
+		}
+	}
+	if (next != effective || changed) {
+		taskENTER_CRITICAL(&acct_mux);
+		close_segment(esp_timer_get_time());
+		effective = next;
+		taskEXIT_CRITICAL(&acct_mux);
+		ESP_LOGI(TAG, "Power profile %d (effective %d)", selected, next);
+	}
+	return changed;
+}
+
+uint16_t wifi_power_listen_interval(void) {
+	/* 0 lets the driver use its default of 3. */
+	return selected == WIFI_MANAGER_PS_MAX_MODEM ? DEFAULT_LISTEN_INTERVAL : 0;
+}
+
+void wifi_power_link(bool up) {
+	taskENTER_CRITICAL(&acct_mux);
+	close_segment(esp_timer_get_time());
+	link_up = up;
+	taskEXIT_CRITICAL(&acct_mux);
+}
+
+wifi_manager_ps_profile_t wifi_power_get_profile(void) {
+	return selected;
+}
+
+void wifi_power_get_stats(wifi_manager_ps_profile_t profile, wifi_manager_power_stats_t *stats) {
+	wifi_power_acct_t a;
+
+	memset(stats, 0, sizeof(*stats));
+	if (profile >= WIFI_MANAGER_PS_PROFILES) {
+		return;
+	}
+
+	taskENTER_CRITICAL(&acct_mux);
+	close_segment(esp_timer_get_time());
+	a = acct[profile];
+	taskEXIT_CRITICAL(&acct_mux);
+
+	uint32_t period = wake_period_us(profile);
+	uint64_t beacon_wakeups = period ? a.active_us / period : 0;
+	uint64_t radio_on_us = a.active_us;
+	if (period) {
+		radio_on_us = (beacon_wakeups + a.tx_wakeups) * WIFI_POWER_AWAKE_US;
+		if (radio_on_us > a.active_us) {
+			radio_on_us = a.active_us;
+		}
+	}
+
+	stats->active_ms = (uint32_t)(a.active_us / 1000);
+	stats->radio_on_ms = (uint32_t)(radio_on_us / 1000);
+	stats->tx_bytes = a.tx_bytes;
+	stats->tx_packets = a.tx_packets;
+	stats->wakeups = (uint32_t)beacon_wakeups + a.tx_wakeups;
+	stats->tx_wakeups = a.tx_wakeups;
+}
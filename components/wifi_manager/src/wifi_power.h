@@ -0,0 +1,57 @@
+/*
+ *  wifi_power.h
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.53
+ *
+ *  Station power-save profiles and per-profile airtime accounting. TX bytes
+ *  are counted at the STA netif; beacon wakeups and radio-on time are derived
+ *  from the wake schedule of each profile. Manager task only, except the
+ *  getters.
+ */
+
+#ifndef WIFI_POWER_H_
+#define WIFI_POWER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_netif.h"
+#include "wifi_manager.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Hook TX accounting into the STA netif and select the build-time default
+ *        profile (DEFAULT_WIFI_POWER_SAVE). Call before esp_wifi_start().
+ */
+void wifi_power_init(esp_netif_t *sta);
+
+/**
+ * @brief Select a profile. The SoftAP cannot run with modem sleep, so while
+ *        it is up the radio stays on and time is booked to WIFI_MANAGER_PS_NONE.
+ * @return true if the selected profile changed.
+ */
+bool wifi_power_apply(wifi_manager_ps_profile_t profile, bool ap_running);
+
+/**
+ * @brief Listen interval (in beacons) for the next association.
+ */
+uint16_t wifi_power_listen_interval(void);
+
+/**
+ * @brief Time is only booked while the station is associated.
+ */
+void wifi_power_link(bool up);
+
+wifi_manager_ps_profile_t wifi_power_get_profile(void);
+void wifi_power_get_stats(wifi_manager_ps_profile_t profile, wifi_manager_power_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIFI_POWER_H_ */
@@ -0,0 +1,228 @@
+/*
+ *  wifi_scan.c
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.70
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "json.h"
+#include "wifi_scan.h"
+#include "wifi_manager.h"
+
+/* Raw records pulled from the driver per scan. */
+#define WIFI_SCAN_MAX_RECORDS 24
+/* Per-channel dwell; short enough that AP clients barely notice the radio leaving. */
+#define WIFI_SCAN_DWELL_MS    100
+
+static const char TAG[] = "wifi_scan";
+
+static SemaphoreHandle_t scan_mutex = NULL;
+static esp_timer_handle_t scan_timer = NULL;
+static bool scan_running = false;
+static int64_t scan_started_us = 0;
+static wifi_scan_stats_t stats;
+
+/* Deduplicated, strongest first; only touched by the manager task. */
+static wifi_ap_record_t records[WIFI_SCAN_MAX_RECORDS];
+static uint16_t records_kept = 0;
+static int64_t scan_done_us = 0;
+static char scratch[WIFI_SCAN_JSON_SIZE];
+
+/* Published copy, guarded by scan_mutex. */
+static char ap_json[WIFI_SCAN_JSON_SIZE] = "[]";
+static size_t ap_json_len = 2;
+static char ap_etag[WIFI_SCAN_ETAG_LEN + 1] = "\"00000000\"";
+
+/* Scans are started from the manager task, like every other driver call. */
+static void scan_timer_cb(void *arg) {
+	wifi_manager_scan();
+}
+
+esp_err_t wifi_scan_init(void) {
+	if (scan_mutex) {
+		return ESP_OK;
+	}
+	scan_mutex = xSemaphoreCreateMutex();
+	if (!scan_mutex) {
+		return ESP_ERR_NO_MEM;
+	}
+	const esp_timer_create_args_t args = {
+		.callback = scan_timer_cb,
+		.name = "wifi_scan",
+	};
+	return esp_timer_create(&args, &scan_timer);
+}
+
+void wifi_scan_schedule_start(void) {
+	if (!esp_timer_is_active(scan_timer)) {
+		esp_timer_start_periodic(scan_timer, (uint64_t)DEFAULT_SCAN_INTERVAL_MS * 1000);
+	}
+	wifi_scan_trigger();
+}
+
+void wifi_scan_schedule_stop(void) {
+	esp_timer_stop(scan_timer);
+}
+
+bool wifi_scan_trigger(void) {
+	if (scan_running) {
+		return true;
+	}
+
+	wifi_scan_config_t cfg = {
+		.show_hidden = false,
+		.scan_type = WIFI_SCAN_TYPE_ACTIVE,
+		.scan_time.active.min = 0,
+		.scan_time.active.max = WIFI_SCAN_DWELL_MS,
+	};
+	if (esp_wifi_scan_start(&cfg, false) == ESP_OK) {
+		scan_running = true;
+		scan_started_us = esp_timer_get_time();
+		stats.scans_started++;
+	} else {
+		stats.scans_skipped++;
+	}
+	return scan_running;
+}
+
+static int compare_rssi(const void *a, const void *b) {
+	return ((const wifi_ap_record_t *)b)->rssi - ((const wifi_ap_record_t *)a)->rssi;
+}
+
+/* Sorted strongest first, so the first occurrence of an SSID is the one to keep. */
+static uint16_t dedupe(wifi_ap_record_t *recs, uint16_t count) {
+	uint16_t kept = 0;
+	for (uint16_t i = 0; i < count; i++) {
+		if (recs[i].ssid[0] == '\0') {
+			continue;
+		}
+		bool dup = false;
+		for (uint16_t j = 0; j < kept; j++) {
+			if (strcmp((const char *)recs[j].ssid, (const char *)recs[i].ssid) == 0) {
+				dup = true;
+				break;
+			}
+		}
+		if (!dup) {
+			if (kept != i) {
+				recs[kept] = recs[i];
+			}
+			kept++;
+		}
+	}
+	return kept;
+}
+
+static size_t render(const wifi_ap_record_t *recs, uint16_t count, uint16_t *rendered) {
+	json_writer_t w;
+
+	json_writer_init(&w, scratch, sizeof(scratch), NULL, NULL);
+	json_arr_begin(&w);
+	*rendered = 0;
+	for (uint16_t i = 0; i < count && i < DEFAULT_SCAN_MAX_AP; i++) {
+		/* An entry that does not fit is taken back, leaving room for the closing bracket. */
+		json_writer_t before = w;
+		json_obj_begin(&w);
+		json_kv_str(&w, "ssid", (const char *)recs[i].ssid);
+		json_kv_int(&w, "chan", recs[i].primary);
+		json_kv_int(&w, "rssi", recs[i].rssi);
+		json_kv_int(&w, "auth", recs[i].authmode);
+		json_obj_end(&w);
+		if (w.error || w.len == w.size) {
+			w = before;
+			break;
+		}
+		(*rendered)++;
+	}
+	json_arr_end(&w);
+	json_writer_finish(&w);
+	return w.len;
+}
+
+static uint32_t fnv1a(const char *data, size_t len) {
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < len; i++) {
+		h = (h ^ (uint8_t)data[i]) * 16777619u;
+	}
+	return h;
+}
+
+void wifi_scan_on_done(const wifi_event_sta_scan_done_t *event) {
+	uint16_t count = WIFI_SCAN_MAX_RECORDS;
+
+	scan_running = false;
+	if (event->status != 0 || esp_wifi_scan_get_ap_records(&count, records) != ESP_OK) {
+		/* Frees the driver's copy on failure too. */
+		esp_wifi_clear_ap_list();
+		records_kept = 0;
+		return;
+	}
+
+	stats.scans_done++;
+	stats.last_scan_ms = (uint32_t)((esp_timer_get_time() - scan_started_us) / 1000);
+	stats.last_found = count;
+
+	qsort(records, count, sizeof(records[0]), compare_rssi);
+	count = dedupe(records, count);
+	records_kept = count;
+	scan_done_us = esp_timer_get_time();
+
+	uint16_t rendered;
+	size_t len = render(records, count, &rendered);
+	stats.last_kept = rendered;
+
+	char etag[WIFI_SCAN_ETAG_LEN + 1];
+	snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)fnv1a(scratch, len));
+
+	xSemaphoreTake(scan_mutex, portMAX_DELAY);
+	memcpy(ap_json, scratch, len + 1);
+	ap_json_len = len;
+	memcpy(ap_etag, etag, sizeof(etag));
+	xSemaphoreGive(scan_mutex);
+
+	ESP_LOGD(TAG, "Scan: %u found, %u published in %lu ms", stats.last_found, rendered, (unsigned long)stats.last_scan_ms);
+}
+
+size_t wifi_scan_copy(char *json, char *etag) {
+	xSemaphoreTake(scan_mutex, portMAX_DELAY);
+	size_t len = ap_json_len;
+	if (json) {
+		memcpy(json, ap_json, len + 1);
+	}
+	memcpy(etag, ap_etag, sizeof(ap_etag));
+	xSemaphoreGive(scan_mutex);
+	return len;
+}
+
+bool wifi_scan_lookup(const char *ssid, wifi_scan_hit_t *hit) {
+	for (uint16_t i = 0; i < records_kept; i++) {
+		if (strcmp((const char *)records[i].ssid, ssid) == 0) {
+			hit->rssi = records[i].rssi;
+			memcpy(hit->bssid, records[i].bssid, sizeof(hit->bssid));
+			hit->channel = records[i].primary;
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t wifi_scan_age_ms(void) {
+	if (scan_done_us == 0) {
+		return UINT32_MAX;
+	}
+	return (uint32_t)((esp_timer_get_time() - scan_done_us) / 1000);
+}
+
+void wifi_scan_get_stats(wifi_scan_stats_t *out) {
+	*out = stats;
+}
@@ -0,0 +1,96 @@
+/*
+ *  wifi_scan.h
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.70
+ *
+ *  Background scan scheduler and pre-rendered /ap.json cache. Scans run at a
+ *  fixed cadence while the portal is up; each completed scan is deduplicated
+ *  by SSID, sorted by RSSI, rendered to JSON once and published with an ETag.
+ */
+
+#ifndef WIFI_SCAN_H_
+#define WIFI_SCAN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_wifi_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Quoted FNV-1a hash of the rendered JSON, e.g. "\"1a2b3c4d\"". */
+#define WIFI_SCAN_ETAG_LEN 11
+/* Rendered /ap.json, NUL included. Worst case per entry is a fully escaped
+ * 32 byte SSID; typical entries are ~70 bytes. */
+#define WIFI_SCAN_JSON_SIZE 2048
+
+typedef struct {
+	uint32_t scans_started;
+	uint32_t scans_done;
+	uint32_t scans_skipped;   /* driver busy (e.g. STA connecting) */
+	uint32_t last_scan_ms;    /* start to SCAN_DONE of the last scan */
+	uint16_t last_found;      /* raw records before dedupe */
+	uint16_t last_kept;       /* entries in the published table */
+} wifi_scan_stats_t;
+
+/* Strongest BSSID seen for an SSID in the last scan. */
+typedef struct {
+	int8_t rssi;
+	uint8_t bssid[6];
+	uint8_t channel;
+} wifi_scan_hit_t;
+
+esp_err_t wifi_scan_init(void);
+
+/**
+ * @brief Start periodic scans; the first one runs immediately.
+ */
+void wifi_scan_schedule_start(void);
+void wifi_scan_schedule_stop(void);
+
+/**
+ * @brief Start one scan now (no-op if one is already running). Manager task only;
+ *        other tasks go through wifi_manager_scan().
+ * @return true if a scan is in progress afterwards, i.e. a SCAN_DONE will follow.
+ */
+bool wifi_scan_trigger(void);
+
+/**
+ * @brief Called by the manager task on WIFI_EVENT_SCAN_DONE.
+ */
+void wifi_scan_on_done(const wifi_event_sta_scan_done_t *event);
+
+/**
+ * @brief Copy the published JSON and its ETag, which always match. The lock is
+ *        held for the copy only, so sending it to a slow client never holds up
+ *        wifi_scan_on_done() on the manager task.
+ * @param json WIFI_SCAN_JSON_SIZE bytes, or NULL for the ETag alone.
+ * @param etag WIFI_SCAN_ETAG_LEN + 1 bytes; NUL-terminated quoted ETag.
+ * @return Length of the JSON ("[]" before the first scan).
+ */
+size_t wifi_scan_copy(char *json, char *etag);
+
+/**
+ * @brief Look an SSID up in the last scan. Manager task only.
+ * @return false if it was not seen (or no scan has completed yet).
+ */
+bool wifi_scan_lookup(const char *ssid, wifi_scan_hit_t *hit);
+
+/**
+ * @brief Milliseconds since the last completed scan, UINT32_MAX if there was none.
+ */
+uint32_t wifi_scan_age_ms(void);
+
+void wifi_scan_get_stats(wifi_scan_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIFI_SCAN_H_ */
@@ -0,0 +1,152 @@
+/*
+ *  wifi_store.c
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.73
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "mbedtls/pkcs5.h"
+#include "nvs_sync.h"
+#include "wifi_store.h"
+
+#define WIFI_STORE_NAMESPACE "wifi_manager"
+#define WIFI_STORE_KEY       "nets"
+/* Bump when wifi_store_sta_t changes layout; unknown versions are ignored. */
+#define WIFI_STORE_VERSION   1
+
+/* Only the first count entries of list are written. */
+typedef struct {
+	uint8_t version;
+	uint8_t count;
+	wifi_store_sta_t list[];
+} wifi_store_record_t;
+
+static const char TAG[] = "wifi_store";
+
+static void sanitize(wifi_store_sta_t *entry) {
+	entry->ssid[sizeof(entry->ssid) - 1] = '\0';
+	entry->password[sizeof(entry->password) - 1] = '\0';
+}
+
+esp_err_t wifi_store_load(wifi_store_sta_t list[WIFI_STORE_MAX_NETWORKS], size_t *count) {
+	wifi_store_record_t *record = NULL;
+	size_t len = 0;
+	nvs_handle_t handle;
+	esp_err_t err;
+
+	*count = 0;
+	if (!nvs_sync_lock(portMAX_DELAY)) {
+		return ESP_ERR_TIMEOUT;
+	}
+	err = nvs_open(WIFI_STORE_NAMESPACE, NVS_READONLY, &handle);
+	if (err == ESP_OK) {
+		/* The stored list may be longer than this build allows; read it whole, keep the head. */
+		err = nvs_get_blob(handle, WIFI_STORE_KEY, NULL, &len);
+		if (err == ESP_OK && len >= sizeof(*record)) {
+			record = malloc(len);
+			err = record ? nvs_get_blob(handle, WIFI_STORE_KEY, record, &len) : ESP_ERR_NO_MEM;
+		}
+		nvs_close(handle);
+	}
+	nvs_sync_unlock();
+
+	if (err != ESP_OK || record == NULL) {
+		free(record);
+		return err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+	}
+	if (record->version != WIFI_STORE_VERSION ||
+			len != offsetof(wifi_store_record_t, list) + record->count * sizeof(wifi_store_sta_t)) {
+		ESP_LOGW(TAG, "Ignoring stored list (len %u, version %u)", (unsigned)len, record->version);
+		free(record);
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	size_t n = record->count < WIFI_STORE_MAX_NETWORKS ? record->count : WIFI_STORE_MAX_NETWORKS;
+	for (size_t i = 0; i < n; i++) {
+		list[i] = record->list[i];
+		sanitize(&list[i]);
+	}
+	*count = n;
+	free(record);
+
+	return n ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t wifi_store_save(const wifi_store_sta_t *list, size_t count) {
+	size_t len = offsetof(wifi_store_record_t, list) + count * sizeof(wifi_store_sta_t);
+	wifi_store_record_t *record;
+	nvs_handle_t handle;
+	esp_err_t err;
+
+	if (count > WIFI_STORE_MAX_NETWORKS) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	record = malloc(len);
+	if (record == NULL) {
+		return ESP_ERR_NO_MEM;
+	}
+	record->version = WIFI_STORE_VERSION;
+	record->count = count;
+	memcpy(record->list, list, count * sizeof(wifi_store_sta_t));
+
+	if (!nvs_sync_lock(portMAX_DELAY)) {
+		free(record);
+		return ESP_ERR_TIMEOUT;
+	}
+	err = nvs_open(WIFI_STORE_NAMESPACE, NVS_READWRITE, &handle);
+	if (err == ESP_OK) {
+		err = nvs_set_blob(handle, WIFI_STORE_KEY, record, len);
+		if (err == ESP_OK) {
+			err = nvs_commit(handle);
+		}
+		nvs_close(handle);
+	}
+	nvs_sync_unlock();
+	free(record);
+
+	return err;
+}
+
+esp_err_t wifi_store_erase(void) {
+	nvs_handle_t handle;
+	esp_err_t err;
+
+	if (!nvs_sync_lock(portMAX_DELAY)) {
+		return ESP_ERR_TIMEOUT;
+	}
+	err = nvs_open(WIFI_STORE_NAMESPACE, NVS_READWRITE, &handle);
+	if (err == ESP_OK) {
+		err = nvs_erase_key(handle, WIFI_STORE_KEY);
+		if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
+			err = nvs_commit(handle);
+		}
+		nvs_close(handle);
+	}
+	nvs_sync_unlock();
+
+	return err;
+}
+
+esp_err_t wifi_store_derive_pmk(wifi_store_sta_t *entry) {
+	size_t pw_len = strlen(entry->password);
+
+	/* Open networks have no PMK; a 64 digit password already is one in hex. */
+	if (pw_len < 8 || pw_len > 63) {
+		entry->pmk_valid = false;
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	int ret = mbedtls_pkcs5_pbkdf2_hmac_ext(MBEDTLS_MD_SHA1,
+			(const unsigned char *)entry->password, pw_len,
+			(const unsigned char *)entry->ssid, strlen(entry->ssid),
+			4096, sizeof(entry->pmk), entry->pmk);
+	entry->pmk_valid = (ret == 0);
+	return ret == 0 ? ESP_OK : ESP_FAIL;
+}
@@ -0,0 +1,75 @@
+/*
+ *  wifi_store.h
+ *
+ *  Created on: 2026-10-19
+ *  Edited on: 2026-10-19
+ *      Author: Andwardo
+ *      Version: v8.2.73
+ *
+ *  NVS persistence for the known networks: credentials, the fast-reconnect
+ *  cache (BSSID, channel and PMK of the last successful join) and connection
+ *  history used to rank them. All access goes through nvs_sync_lock().
+ */
+
+#ifndef WIFI_STORE_H_
+#define WIFI_STORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WIFI_STORE_MAX_NETWORKS DEFAULT_MAX_NETWORKS
+
+/**
+ * @brief Per-network history. Updated in RAM on every attempt and written
+ *        back whenever the list is saved, so it survives reboots approximately.
+ */
+typedef struct {
+	uint16_t attempts;
+	uint16_t successes;
+	uint8_t consecutive_failures;
+	int8_t rssi_last;              /* seen in the last scan or at the last join */
+	uint32_t reconnect_ms_last;    /* link lost to IP again */
+	uint32_t reconnect_ms_avg;     /* EWMA, 1/4 weight for the newest sample */
+	uint32_t last_join_seq;        /* higher means joined more recently */
+} wifi_store_history_t;
+
+typedef struct {
+	char ssid[33];
+	char password[65];
+	uint8_t bssid[6];
+	uint8_t channel;
+	uint8_t authmode;      /* wifi_auth_mode_t seen at the last join */
+	uint8_t pmk[32];
+	bool pmk_valid;        /* pmk was derived from ssid/password above */
+	bool bssid_valid;      /* bssid/channel are usable for a directed connect */
+	wifi_store_history_t hist;
+} wifi_store_sta_t;
+
+/**
+ * @brief Load the known networks, highest priority first.
+ * @param count Number of entries written to list.
+ * @return ESP_OK, ESP_ERR_NOT_FOUND if nothing is stored or the record is from an unknown version.
+ */
+esp_err_t wifi_store_load(wifi_store_sta_t list[WIFI_STORE_MAX_NETWORKS], size_t *count);
+
+esp_err_t wifi_store_save(const wifi_store_sta_t *list, size_t count);
+
+esp_err_t wifi_store_erase(void);
+
+/**
+ * @brief Run PBKDF2-SHA1(password, ssid, 4096) into entry->pmk.
+ * @note Takes a few hundred milliseconds; never call from the event loop.
+ */
+esp_err_t wifi_store_derive_pmk(wifi_store_sta_t *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIFI_STORE_H_ */
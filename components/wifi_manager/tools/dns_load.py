@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+#
+#  dns_load.py
+#
+#  Created on: 2026-10-19
+#  Edited on: 2026-10-19
+#      Author: Andwardo
+#      Version: v8.2.63
+#
+#  Load generator for the captive DNS responder (src/dns_server.c), meant for
+#  the Linux-target build in host/dns_bench but usable against a device on the
+#  portal network as well (--host 192.168.4.1 --port 53).
+#
+#  Every client is one UDP socket, like one phone, sending a query and waiting
+#  for its answer before the next (closed loop). The mix follows what phones
+#  send when they join a captive network: connectivity checks in A and AAAA,
+#  the odd HTTPS record, random names, plus malformed and oversize packets the
+#  responder must reject. Each reply is checked against what the responder is
+#  supposed to send, so wrong answers are counted, not just lost ones.
+#
+#  usage: dns_load.py [--host H] [--port P] [--clients N] [--duration S]
+#                     [--answer IP] [--timeout MS]
+#
+
+import argparse
+import random
+import socket
+import struct
+import threading
+import time
+
+TYPE_A, TYPE_AAAA, TYPE_HTTPS, TYPE_ANY = 1, 28, 65, 255
+CLASS_IN, CLASS_CH = 1, 3
+NOERROR, FORMERR, NXDOMAIN, NOTIMP = 0, 1, 3, 4
+
+CHECK_NAMES = (
+    "connectivitycheck.gstatic.com", "www.google.com", "clients3.google.com",
+    "captive.apple.com", "www.apple.com", "www.msftconnecttest.com",
+    "dns.msftncsi.com", "detectportal.firefox.com",
+)
+
+
+def encode_name(name):
+    out = b""
+    for label in name.split("."):
+        out += bytes([len(label)]) + label.encode()
+    return out + b"\0"
+
+
+def header(qid, flags=0x0100, qdcount=1, arcount=0):
+    return struct.pack(">HHHHHH", qid, flags, qdcount, 0, 0, arcount)
+
+
+def case_mix(name):
+    # DNS 0x20: resolvers randomise the case and expect it echoed back.
+    return "".join(c.upper() if random.random() < 0.5 else c for c in name)
+
+
+# Each builder returns (packet, question or None, expected rcode or None, expected answers).
+# An expected rcode of None means "no reply at all".
+
+def q_check(qid):
+    name = random.choice(CHECK_NAMES)
+    question = encode_name(name) + struct.pack(">HH", TYPE_A, CLASS_IN)
+    return header(qid) + question, question, NOERROR, 1
+
+
+def q_check_case(qid):
+    name = case_mix(random.choice(CHECK_NAMES))
+    question = encode_name(name) + struct.pack(">HH", TYPE_A, CLASS_IN)
+    return header(qid) + question, question, NOERROR, 1
+
+
+def q_aaaa(qid):
+    question = encode_name(random.choice(CHECK_NAMES)) + struct.pack(">HH", TYPE_AAAA, CLASS_IN)
+    return header(qid) + question, question, NOERROR, 0
+
+
+def q_https(qid):
+    question = encode_name(random.choice(CHECK_NAMES)) + struct.pack(">HH", TYPE_HTTPS, CLASS_IN)
+    return header(qid) + question, question, NOERROR, 0
+
+
+def q_random(qid):
+    name = "%08x.example%d.net" % (random.getrandbits(32), random.randint(0, 99))
+    question = encode_name(name) + struct.pack(">HH", TYPE_A, CLASS_IN)
+    return header(qid) + question, question, NOERROR, 1
+
+
+def q_edns(qid):
+    # OPT record after the question: the reply echoes the question only.
+    question = encode_name(random.choice(CHECK_NAMES)) + struct.pack(">HH", TYPE_A, CLASS_IN)
+    opt = b"\0" + struct.pack(">HHIH", 41, 1232, 0, 0)
+    return header(qid, arcount=1) + question + opt, question, NOERROR, 1
+
+
+def q_oversize(qid):
+    # Longer than a classic DNS datagram; the question still comes first.
+    question = encode_name(random.choice(CHECK_NAMES)) + struct.pack(">HH", TYPE_A, CLASS_IN)
+    return header(qid) + question + bytes(1400), question, NOERROR, 1
+
+
+def q_chaos(qid):
+    question = encode_name("version.bind") + struct.pack(">HH", 16, CLASS_CH)
+    return header(qid) + question, question, NXDOMAIN, 0
+
+
+def q_pointer(qid):
+    # Compression pointer in the question.
+    return header(qid) + b"\xc0\x0c" + struct.pack(">HH", TYPE_A, CLASS_IN), None, FORMERR, 0
+
+
+def q_truncated(qid):
+    # A label running past the end of the packet.
+    return header(qid) + b"\x3fshort", None, FORMERR, 0
+
+
+def q_long_name(qid):
+    # Legal labels, but more than 255 bytes in total.
+    question = encode_name(".".join(["a" * 63] * 5)) + struct.pack(">HH", TYPE_A, CLASS_IN)
+    return header(qid) + question, None, FORMERR, 0
+
+
+def q_two_questions(qid):
+    question = encode_name("captive.apple.com") + struct.pack(">HH", TYPE_A, CLASS_IN)
+    return header(qid, qdcount=2) + question * 2, None, FORMERR, 0
+
+
+def q_status(qid):
+    return header(qid, flags=0x1000, qdcount=0), None, NOTIMP, 0
+
+
+def q_runt(qid):
+    return struct.pack(">H", qid) + b"\x01\x00\x00", None, None, 0
+
+
+def q_response(qid):
+    question = encode_name("captive.apple.com") + struct.pack(">HH", TYPE_A, CLASS_IN)
+    return header(qid, flags=0x8180) + question, None, None, 0
+
+
+# (weight, builder): mostly repeated connectivity checks, a tail of the rest.
+MIX = (
+    (40, q_check), (10, q_check_case), (25, q_aaaa), (5, q_https), (6, q_random),
+    (4, q_edns), (2, q_oversize), (1, q_chaos), (2, q_pointer), (2, q_truncated),
+    (1, q_long_name), (1, q_two_questions), (1, q_status), (0.5, q_runt), (0.5, q_response),
+)
+
+
+def check_reply(reply, qid, question, rcode, answers, addr):
+    """Return None if the reply is what the responder should send, else why not."""
+    if len(reply) < 12:
+        return "short reply"
+    rid, flags, qd, an, ns, ar = struct.unpack(">HHHHHH", reply[:12])
+    if rid != qid:
+        return "wrong id"
+    if not flags & 0x8000:
+        return "QR not set"
+    if flags & 0x000f != rcode:
+        return "rcode %d, expected %d" % (flags & 0x000f, rcode)
+    if an != answers or ns or ar:
+        return "counts an=%d ns=%d ar=%d" % (an, ns, ar)
+    if question is None:
+        return None if qd == 0 and len(reply) == 12 else "question echoed on an error"
+    if qd != 1 or reply[12:12 + len(question)] != question:
+        return "question not echoed"
+    rest = reply[12 + len(question):]
+    if answers == 0:
+        return None if not rest else "trailing bytes"
+    expected = b"\xc0\x0c" + struct.pack(">HHIH", TYPE_A, CLASS_IN, 0, 4) + socket.inet_aton(addr)
+    return None if rest == expected else "bad answer record"
+
+
+class Client(threading.Thread):
+    def __init__(self, args, deadline, weights, builders):
+        super().__init__(daemon=True)
+        self.args = args
+        self.deadline = deadline
+        self.weights = weights
+        self.builders = builders
+        self.latencies = []
+        self.sent = self.lost = self.unexpected = 0
+        self.wrong = {}
+
+    def run(self):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        target = (self.args.host, self.args.port)
+        timeout = self.args.timeout / 1000.0
+        qid = random.getrandbits(16)
+        while time.monotonic() < self.deadline:
+            qid = (qid + 1) & 0xffff
+            build = random.choices(self.builders, self.weights)[0]
+            packet, question, rcode, answers = build(qid)
+            # Nothing should come back for these; give it a short window to prove it.
+            sock.settimeout(timeout if rcode is not None else min(timeout, 0.02))
+            t0 = time.perf_counter()
+            sock.sendto(packet, target)
+            self.sent += 1
+            reply = None
+            try:
+                # Late replies to earlier, timed-out queries are skipped by ID.
+                while True:
+                    reply, _ = sock.recvfrom(2048)
+                    if len(reply) >= 2 and struct.unpack(">H", reply[:2])[0] == qid:
+                        break
+            except socket.timeout:
+                reply = None
+            dt = time.perf_counter() - t0
+            if rcode is None:
+                if reply is not None:
+                    self.unexpected += 1
+                continue
+            if reply is None:
+                self.lost += 1
+                continue
+            self.latencies.append(dt)
+            why = check_reply(reply, qid, question, rcode, answers, self.args.answer)
+            if why:
+                key = "%s: %s" % (build.__name__, why)
+                self.wrong[key] = self.wrong.get(key, 0) + 1
+        sock.close()
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    k = min(len(sorted_values) - 1, int(round(p / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[k]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument("--host", default="127.0.0.1")
+    ap.add_argument("--port", type=int, default=5300)
+    ap.add_argument("--clients", type=int, default=12, help="simulated phones")
+    ap.add_argument("--duration", type=float, default=10.0, help="seconds")
+    ap.add_argument("--answer", default=None, help="expected A address (default: --host)")
+    ap.add_argument("--timeout", type=float, default=500.0, help="ms before a query counts as dropped")
+    args = ap.parse_args()
+    args.answer = args.answer or args.host
+
+    weights = [w for w, _ in MIX]
+    builders = [b for _, b in MIX]
+    start = time.monotonic()
+    clients = [Client(args, start + args.duration, weights, builders) for _ in range(args.clients)]
+    for c in clients:
+        c.start()
+    for c in clients:
+        c.join()
+    elapsed = time.monotonic() - start
+
+    latencies = sorted(l for c in clients for l in c.latencies)
+    sent = sum(c.sent for c in clients)
+    lost = sum(c.lost for c in clients)
+    unexpected = sum(c.unexpected for c in clients)
+    wrong = {}
+    for c in clients:
+        for k, v in c.wrong.items():
+            wrong[k] = wrong.get(k, 0) + v
+
+    print("clients %d, %.1f s: sent %d, answered %d (%.0f q/s), dropped %d, "
+          "mis-answered %d, replies to unanswerable %d"
+          % (args.clients, elapsed, sent, len(latencies), len(latencies) / elapsed, lost,
+             sum(wrong.values()), unexpected))
+    print("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f"
+          % tuple(1000 * percentile(latencies, p) for p in (50, 90, 99, 99.9, 100)))
+    for k, v in sorted(wrong.items(), key=lambda kv: -kv[1]):
+        print("  %6d  %s" % (v, k))
+    # Non-zero exit when the responder got anything wrong, for use in scripts.
+    raise SystemExit(1 if wrong or unexpected else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+#
+#  portal_assets.py
+#
+#  Created on: 2026-10-19
+#  Edited on: 2026-10-19
+#      Author: Andwardo
+#      Version: v8.2.59
+#
+#  Build-time pipeline for the captive portal: minify index.html, style.css and
+#  code.js, gzip them (deterministically, so unchanged sources give unchanged
+#  blobs and ETags) and write portal_assets.h with the ETags and sizes.
+#
+#  index.html references the other two as "<file>?v=<etag>", so the browser can
+#  cache them for good and only index.html is ever revalidated.
+#
+#  dash.html is the station-side dashboard and is self-contained. Its inline
+#  script goes through the HTML minifier, which joins lines: it must use
+#  explicit semicolons and /* */ comments only.
+#
+#  usage: portal_assets.py <source dir> <output dir>
+#
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+ASSETS = ("style.css", "code.js", "index.html", "dash.html")
+
+
+def minify_js(src):
+    """Drop comments, indentation and blank lines. Line breaks are kept so
+    automatic semicolon insertion behaves exactly as in the source; strings and
+    template literals are copied verbatim. Regex literals are not recognised,
+    so a '//' inside one would be taken as a comment: the portal has none."""
+    out = []
+    i, n = 0, len(src)
+    while i < n:
+        c = src[i]
+        if c in "\"'`":
+            j = i + 1
+            while j < n and src[j] != c:
+                j += 2 if src[j] == "\\" else 1
+            out.append(src[i:j + 1])
+            i = j + 1
+        elif src.startswith("//", i):
+            i = src.find("\n", i)
+            i = n if i < 0 else i
+        elif src.startswith("/*", i):
+            j = src.find("*/", i + 2)
+            i = n if j < 0 else j + 2
+        else:
+            out.append(c)
+            i += 1
+    lines = (line.strip() for line in "".join(out).split("\n"))
+    return "\n".join(line for line in lines if line) + "\n"
+
+
+def minify_css(src):
+    src = re.sub(r"/\*.*?\*/", "", src, flags=re.S)
+    src = re.sub(r"\s+", " ", src)
+    src = re.sub(r"\s*([{};,>])\s*", r"\1", src)
+    # Only after a colon: "a :hover" and "a:hover" are different selectors.
+    src = re.sub(r":\s+", ":", src)
+    return src.replace(";}", "}").strip() + "\n"
+
+
+def minify_html(src):
+    # Whitespace between tags is collapsed, not removed: it can be significant inline.
+    src = re.sub(r"<!--.*?-->", "", src, flags=re.S)
+    src = re.sub(r"\s+", " ", src)
+    return src.strip() + "\n"
+
+
+def gzip_bytes(data):
+    # mtime=0 and no file name keep the output byte-identical between builds.
+    return gzip.compress(data, compresslevel=9, mtime=0)
+
+
+def etag(blob):
+    return hashlib.sha256(blob).hexdigest()[:16]
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: portal_assets.py <source dir> <output dir>")
+    src_dir, out_dir = sys.argv[1], sys.argv[2]
+    os.makedirs(out_dir, exist_ok=True)
+
+    minifiers = {".css": minify_css, ".js": minify_js, ".html": minify_html}
+    tags = {}
+    defines = []
+    for name in ASSETS:
+        with open(os.path.join(src_dir, name), encoding="utf-8") as f:
+            text = f.read()
+        raw_len = len(text.encode("utf-8"))
+        if name == "index.html":
+            for ref, tag in tags.items():
+                text = text.replace('"%s"' % ref, '"%s?v=%s"' % (ref, tag))
+        text = minifiers[os.path.splitext(name)[1]](text)
+        blob = gzip_bytes(text.encode("utf-8"))
+        tags[name] = etag(blob)
+
+        with open(os.path.join(out_dir, name + ".gz"), "wb") as f:
+            f.write(blob)
+
+        macro = re.sub(r"\W", "_", name).upper()
+        defines.append('#define PORTAL_ETAG_%s "\\"%s\\""' % (macro, tags[name]))
+        defines.append("#define PORTAL_RAW_LEN_%s %d" % (macro, raw_len))
+        defines.append("#define PORTAL_GZ_LEN_%s %d" % (macro, len(blob)))
+        print("portal_assets: %-10s %6d -> %5d bytes" % (name, raw_len, len(blob)))
+
+    header = "\n".join([
+        "/* Generated by tools/portal_assets.py; do not edit. */",
+        "#ifndef PORTAL_ASSETS_H_",
+        "#define PORTAL_ASSETS_H_",
+        "",
+    ] + defines + [
+        "",
+        "#endif /* PORTAL_ASSETS_H_ */",
+        "",
+    ])
+    path = os.path.join(out_dir, "portal_assets.h")
+    # Leave the header alone when nothing changed so http_app.c is not rebuilt.
+    try:
+        with open(path, encoding="utf-8") as f:
+            if f.read() == header:
+                return
+    except OSError:
+        pass
+    with open(path, "w", encoding="utf-8") as f:
+        f.write(header)
+
+
+if __name__ == "__main__":
+    main()
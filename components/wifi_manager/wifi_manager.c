@@ -2,34 +2,200 @@
  * File: wifi_manager.c
  * Description: Wi-Fi manager implementation for captive portal, NVS, and event handling.
  * Created on: 2025-06-18
- * Edited on:  2025-07-09
- * Version: v8.6.6
+ * Edited on:  2026-10-19
+ * Version: v8.8.8
  * Author: R. Andrew Ballard (c) 2025
- * Fix: Add NVS initialization required before esp_wifi_init() on ESP-IDF v5.2.5.
+ * Feat: Keep the power profile across reboots in the settings store.
  **/
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_mac.h"
-#include "nvs_flash.h"
+#include "esp_timer.h"
 #include "esp_netif.h"
+#include "mdns.h"
+#include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include "wifi_manager.h"
+#include "nvs_sync.h"
+#include "wifi_store.h"
+#include "wifi_scan.h"
+#include "wifi_power.h"
+#include "settings.h"
+#include "http_app.h"
+#include "dns_server.h"
+
+/* Failed joins before the SoftAP is brought up so the device can be re-provisioned. */
+#define WIFI_MANAGER_MAX_RETRIES_BEFORE_AP 5
+#define WIFI_MANAGER_RETRY_DELAY_MS        2000
+/* Failed joins on one network before the known networks are ranked again. */
+#define WIFI_MANAGER_RETRIES_PER_NETWORK   2
+/* Joins tried with new credentials before reporting failure. */
+#define WIFI_MANAGER_PROV_ATTEMPTS         3
+/* Portal lifetime after the station gets an IP, so the browser (polling ~1 s) can show it. */
+#define WIFI_MANAGER_HANDOFF_DELAY_MS      5000
+/* A scan younger than this is good enough to pick a network from. */
+#define WIFI_MANAGER_SCAN_MAX_AGE_MS       15000
+/* A roam target must beat the current link by this much, so we do not flap between APs. */
+#define WIFI_MANAGER_ROAM_HYSTERESIS_DB    8
+/* Quiet period after a roam scan found nothing better. */
+#define WIFI_MANAGER_ROAM_BACKOFF_MS       30000
+/* History is written with every cache save, and at least every this many joins. */
+#define WIFI_MANAGER_HIST_SAVE_EVERY       8
+
+#define WIFI_MANAGER_QUEUE_LEN             16
+#define WIFI_MANAGER_TASK_STACK            4096
+#define WIFI_MANAGER_TASK_PRIORITY         5
+/* How long an event callback or API call may block on a full queue. */
+#define WIFI_MANAGER_POST_TIMEOUT_MS       100
+
+typedef enum {
+	/* Orders from the public API and the portal. */
+	WM_ORDER_CONNECT_STA,
+	WM_ORDER_DISCONNECT_STA,
+	WM_ORDER_START_SCAN,
+	WM_ORDER_START_AP,
+	WM_ORDER_SET_PS,
+	/* esp_event callbacks. */
+	WM_EVENT_STA_START,
+	WM_EVENT_AP_START,
+	WM_EVENT_AP_STOP,
+	WM_EVENT_SCAN_DONE,
+	WM_EVENT_STA_CONNECTED,
+	WM_EVENT_STA_DISCONNECTED,
+	WM_EVENT_STA_GOT_IP,
+	WM_EVENT_RSSI_LOW,
+	/* Internal timers and workers. */
+	WM_TIMER_RETRY,
+	WM_TIMER_HANDOFF,
+	WM_TIMER_ROAM,
+	WM_CACHE_SAVED,
+} wifi_manager_msg_code_t;
+
+typedef struct {
+	wifi_manager_msg_code_t code;
+	union {
+		struct {
+			char ssid[33];
+			char password[65];
+		} creds;
+		struct {
+			char ssid[33];
+			uint8_t pmk[32];
+			bool pmk_valid;
+		} cache;
+		wifi_event_sta_connected_t connected;
+		wifi_event_sta_disconnected_t disconnected;
+		wifi_event_sta_scan_done_t scan_done;
+		esp_netif_ip_info_t ip_info;
+		int32_t rssi;
+		wifi_manager_ps_profile_t profile;
+	};
+} wifi_manager_msg_t;
+
+/* Handed to save_cache_task, which owns and frees it. */
+typedef struct {
+	size_t count;
+	int cur;
+	wifi_store_sta_t list[WIFI_STORE_MAX_NETWORKS];
+} wifi_manager_save_job_t;
+
+/* Runtime settings kept across reboots. */
+enum {
+	WM_SETTING_PS_PROFILE,     /* -1: the build default, DEFAULT_WIFI_POWER_SAVE */
+};
+
+static const settings_def_t wm_setting_defs[] = {
+	[WM_SETTING_PS_PROFILE] = SETTINGS_INT("ps_profile", -1),
+};
+
+static const settings_schema_t wm_settings = {
+	.ns = "wm_settings",
+	.version = 1,
+	.defs = wm_setting_defs,
+	.count = sizeof(wm_setting_defs) / sizeof(wm_setting_defs[0]),
+};
 
 static const char TAG[] = "wifi_manager";
 
+static const char *const state_names[] = {
+	[WIFI_MANAGER_STATE_IDLE] = "IDLE",
+	[WIFI_MANAGER_STATE_SELECTING] = "SELECTING",
+	[WIFI_MANAGER_STATE_CONNECTING] = "CONNECTING",
+	[WIFI_MANAGER_STATE_CONNECTED] = "CONNECTED",
+	[WIFI_MANAGER_STATE_ONLINE] = "ONLINE",
+	[WIFI_MANAGER_STATE_BACKOFF] = "BACKOFF",
+};
+
 static EventGroupHandle_t wifi_event_group;
+static QueueHandle_t wifi_queue = NULL;
+static esp_netif_t *netif_sta = NULL;
+static esp_netif_t *netif_ap = NULL;
+static esp_timer_handle_t retry_timer = NULL;
+static esp_timer_handle_t handoff_timer = NULL;
+static esp_timer_handle_t roam_timer = NULL;
+static httpd_handle_t http_server = NULL;
+static bool mdns_up = false;
 
 static char ap_ssid[32] = {0};
 
+/*
+ * Everything below is owned by the manager task; other tasks only see it
+ * through messages, the event group, sta_status and the stats copies.
+ */
+static volatile wifi_manager_state_t state = WIFI_MANAGER_STATE_IDLE;
+static int64_t state_entered_us = 0;
+
+/* Known networks, highest priority first. */
+static wifi_store_sta_t networks[WIFI_STORE_MAX_NETWORKS];
+static size_t net_count = 0;
+static uint32_t join_seq = 0;
+
+/*
+ * Working copy of the network we are joining or joined. cur is its index in
+ * networks, or -1 while new credentials are tried (provisioning); those only
+ * join the list once they get an IP.
+ */
+static wifi_store_sta_t sta_entry;
+static int cur = -1;
+static bool provisioning = false;
+static bool sta_fast_path = false;
+static bool sta_entry_dirty = false;   /* BSSID/channel taken from a scan, not yet saved */
+static bool ap_running = false;
+static bool select_pending = false;
+static bool roam_pending = false;
+static int8_t roam_rssi = 0;
+static int retries = 0;
+static int64_t connect_started_us = 0;
+static int64_t lost_at_us = 0;
+static wifi_manager_connect_stats_t connect_stats;
+static wifi_manager_ps_cb_t ps_cb = NULL;
+static void *ps_cb_ctx = NULL;
+
+static portMUX_TYPE status_mux = portMUX_INITIALIZER_UNLOCKED;
+static wifi_manager_sta_status_t sta_status;
+static wifi_manager_network_info_t net_info[WIFI_STORE_MAX_NETWORKS];
+static size_t net_info_count = 0;
+
 EventGroupHandle_t wifi_manager_get_event_group(void) {
 	return wifi_event_group;
 }
 
+esp_netif_t* wifi_manager_get_esp_netif_sta(void) {
+	return netif_sta;
+}
+
+esp_netif_t* wifi_manager_get_esp_netif_ap(void) {
+	return netif_ap;
+}
+
 void generate_ap_ssid_from_mac(void) {
 	uint8_t mac[6];
 	esp_read_mac(mac, ESP_MAC_WIFI_SOFTAP);
@@ -40,25 +206,188 @@ const char* get_ap_ssid(void) {
 	return ap_ssid;
 }
 
-void wifi_manager_start(void) {
-	wifi_event_group = xEventGroupCreate();
-	generate_ap_ssid_from_mac();
+void wifi_manager_get_connect_stats(wifi_manager_connect_stats_t *stats) {
+	*stats = connect_stats;
+}
 
-	ESP_LOGI(TAG, "Starting Wi-Fi manager, AP SSID: %s", ap_ssid);
+wifi_manager_state_t wifi_manager_get_state(void) {
+	return state;
+}
+
+void wifi_manager_get_sta_status(wifi_manager_sta_status_t *status) {
+	taskENTER_CRITICAL(&status_mux);
+	*status = sta_status;
+	taskEXIT_CRITICAL(&status_mux);
+}
+
+size_t wifi_manager_get_networks(wifi_manager_network_info_t *out, size_t max) {
+	taskENTER_CRITICAL(&status_mux);
+	size_t n = net_info_count < max ? net_info_count : max;
+	memcpy(out, net_info, n * sizeof(*out));
+	taskEXIT_CRITICAL(&status_mux);
+	return n;
+}
+
+static esp_err_t post(const wifi_manager_msg_t *msg, TickType_t wait) {
+	if (wifi_queue == NULL) {
+		return ESP_ERR_INVALID_STATE;
+	}
+	if (xQueueSend(wifi_queue, msg, wait) != pdTRUE) {
+		ESP_LOGE(TAG, "Queue full, dropped message %d", msg->code);
+		return ESP_ERR_TIMEOUT;
+	}
+	return ESP_OK;
+}
+
+static void transition(wifi_manager_state_t next) {
+	int64_t now = esp_timer_get_time();
 
-	esp_err_t ret = nvs_flash_init();
-	if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-		ESP_ERROR_CHECK(nvs_flash_erase());
-		ret = nvs_flash_init();
+	if (next == state) {
+		return;
 	}
-	ESP_ERROR_CHECK(ret);
+	connect_stats.transitions++;
+	ESP_LOGI(TAG, "%s -> %s after %" PRIu32 " ms", state_names[state], state_names[next],
+			(uint32_t)((now - state_entered_us) / 1000));
+	state = next;
+	state_entered_us = now;
+}
 
-	ESP_ERROR_CHECK(esp_netif_init());
-	ESP_ERROR_CHECK(esp_event_loop_create_default());
-	esp_netif_create_default_wifi_ap();
+static bool have_network(void) {
+	return provisioning || cur >= 0;
+}
 
-	wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-	ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+static void set_status(wifi_manager_urc_t urc, const esp_netif_ip_info_t *ip_info) {
+	taskENTER_CRITICAL(&status_mux);
+	strncpy(sta_status.ssid, have_network() ? sta_entry.ssid : "", sizeof(sta_status.ssid) - 1);
+	sta_status.urc = urc;
+	sta_status.portal_up = ap_running;
+	if (urc == WIFI_MANAGER_URC_CONNECTING) {
+		sta_status.attempt++;
+	}
+	if (ip_info) {
+		sta_status.ip_info = *ip_info;
+	} else {
+		memset(&sta_status.ip_info, 0, sizeof(sta_status.ip_info));
+	}
+	taskEXIT_CRITICAL(&status_mux);
+	http_app_push(http_server, HTTP_APP_PUSH_STATUS);
+}
+
+/* Copy the working entry back into the list and refresh the snapshot other tasks read. */
+static void sync_networks(void) {
+	if (cur >= 0) {
+		networks[cur] = sta_entry;
+	}
+
+	taskENTER_CRITICAL(&status_mux);
+	for (size_t i = 0; i < net_count; i++) {
+		const wifi_store_sta_t *n = &networks[i];
+		wifi_manager_network_info_t *info = &net_info[i];
+		memcpy(info->ssid, n->ssid, sizeof(info->ssid));
+		info->attempts = n->hist.attempts;
+		info->successes = n->hist.successes;
+		info->consecutive_failures = n->hist.consecutive_failures;
+		info->rssi_last = n->hist.rssi_last;
+		info->reconnect_ms_last = n->hist.reconnect_ms_last;
+		info->reconnect_ms_avg = n->hist.reconnect_ms_avg;
+		info->current = ((int)i == cur);
+	}
+	net_info_count = net_count;
+	taskEXIT_CRITICAL(&status_mux);
+}
+
+static int find_network(const char *ssid) {
+	for (size_t i = 0; i < net_count; i++) {
+		if (strcmp(networks[i].ssid, ssid) == 0) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+static void remove_network(int idx) {
+	memmove(&networks[idx], &networks[idx + 1], (net_count - idx - 1) * sizeof(networks[0]));
+	net_count--;
+	if (cur == idx) {
+		cur = -1;
+	} else if (cur > idx) {
+		cur--;
+	}
+}
+
+/* Move sta_entry to the top of the list, dropping the lowest-ranked entry if it is full. */
+static void promote_current(void) {
+	int idx = cur >= 0 ? cur : find_network(sta_entry.ssid);
+
+	if (idx >= 0) {
+		remove_network(idx);
+	} else if (net_count == WIFI_STORE_MAX_NETWORKS) {
+		ESP_LOGW(TAG, "Network list full, forgetting %s", networks[net_count - 1].ssid);
+		net_count--;
+	}
+	memmove(&networks[1], &networks[0], net_count * sizeof(networks[0]));
+	net_count++;
+	cur = 0;
+	networks[0] = sta_entry;
+}
+
+/*
+ * RSSI dominates; list position and history only break near-ties and push
+ * networks that keep failing behind ones that work.
+ */
+static int score(int idx, int8_t rssi) {
+	const wifi_store_history_t *h = &networks[idx].hist;
+	int s = rssi - 3 * idx;
+
+	if (h->attempts) {
+		s += 10 * h->successes / h->attempts;
+	}
+	s -= 6 * (h->consecutive_failures < 5 ? h->consecutive_failures : 5);
+	return s;
+}
+
+/* Best known network in the last scan; -1 if none of them were seen. */
+static int rank_networks(wifi_scan_hit_t *best_hit) {
+	int best = -1;
+	int best_score = 0;
+
+	for (size_t i = 0; i < net_count; i++) {
+		wifi_scan_hit_t hit;
+		if (!wifi_scan_lookup(networks[i].ssid, &hit)) {
+			continue;
+		}
+		networks[i].hist.rssi_last = hit.rssi;
+		int s = score(i, hit.rssi);
+		if (best < 0 || s > best_score) {
+			best = (int)i;
+			best_score = s;
+			*best_hit = hit;
+		}
+	}
+	return best;
+}
+
+/* Make networks[idx] the working entry, aimed at the BSSID from the scan if there is one. */
+static void use_network(int idx, const wifi_scan_hit_t *hit) {
+	if (cur >= 0) {
+		networks[cur] = sta_entry;
+	}
+	cur = idx;
+	sta_entry = networks[idx];
+	sta_entry_dirty = false;
+	if (hit && (!sta_entry.bssid_valid || sta_entry.channel != hit->channel ||
+			memcmp(sta_entry.bssid, hit->bssid, sizeof(hit->bssid)) != 0)) {
+		memcpy(sta_entry.bssid, hit->bssid, sizeof(sta_entry.bssid));
+		sta_entry.channel = hit->channel;
+		sta_entry.bssid_valid = true;
+		sta_entry_dirty = true;
+	}
+}
+
+static void start_softap(void) {
+	if (ap_running) {
+		return;
+	}
 
 	wifi_config_t ap_config = {
 		.ap = {
@@ -72,9 +401,719 @@ void wifi_manager_start(void) {
 	};
 	strncpy((char *)ap_config.ap.ssid, ap_ssid, sizeof(ap_config.ap.ssid) - 1);
 
-	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
+	/* The station interface stays up: it joins stored networks and runs the portal's scans. */
+	ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
 	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_AP, &ap_config));
-	ESP_ERROR_CHECK(esp_wifi_start());
+	ap_running = true;
+	wifi_power_apply(wifi_power_get_profile(), true);
 
 	ESP_LOGI(TAG, "SoftAP started with SSID: %s", ap_ssid);
-}
\ No newline at end of file
+}
+
+static void start_portal(void) {
+	if (http_server == NULL) {
+		http_server = start_http_server();
+	}
+	http_app_set_portal(http_server, true);
+	if (DEFAULT_CAPTIVE_PORTAL_ENABLE) {
+		dns_server_start();
+	}
+	wifi_scan_schedule_start();
+}
+
+/* The server itself stays up: it carries the dashboard on the station side. */
+static void stop_portal(void) {
+	wifi_scan_schedule_stop();
+	dns_server_stop();
+	http_app_set_portal(http_server, false);
+	esp_wifi_set_mode(WIFI_MODE_STA);
+	ap_running = false;
+	wifi_power_apply(wifi_power_get_profile(), false);
+	taskENTER_CRITICAL(&status_mux);
+	sta_status.portal_up = false;
+	taskEXIT_CRITICAL(&status_mux);
+
+	ESP_LOGI(TAG, "Provisioning done, portal stopped");
+}
+
+/* Dashboard on the station address, announced as <DEFAULT_HOSTNAME>-xxxx.local. */
+static void start_dashboard(void) {
+	if (http_server == NULL) {
+		http_server = start_http_server();
+	}
+	if (!mdns_up && mdns_init() == ESP_OK) {
+		char hostname[32];
+		uint8_t mac[6];
+
+		esp_read_mac(mac, ESP_MAC_WIFI_SOFTAP);
+		snprintf(hostname, sizeof(hostname), DEFAULT_HOSTNAME "-%02x%02x", mac[4], mac[5]);
+		mdns_hostname_set(hostname);
+		mdns_instance_name_set(ap_ssid);
+		mdns_service_add(NULL, "_http", "_tcp", DEFAULT_WEB_PORT, NULL, 0);
+		mdns_up = true;
+		ESP_LOGI(TAG, "Dashboard at http://%s.local/", hostname);
+	}
+}
+
+/*
+ * Directed connect when the cache is valid: the driver is told the exact BSSID
+ * and channel so it probes one channel instead of sweeping all of them, and a
+ * PMK in hex replaces the passphrase so the 4096-round PBKDF2 is skipped.
+ */
+static void sta_connect(void) {
+	wifi_config_t cfg = { 0 };
+
+	strncpy((char *)cfg.sta.ssid, sta_entry.ssid, sizeof(cfg.sta.ssid));
+	cfg.sta.threshold.authmode = DEFAULT_THRESHOLD_AUTHMODE;
+	cfg.sta.pmf_cfg.capable = true;
+	cfg.sta.listen_interval = wifi_power_listen_interval();
+#if CONFIG_ESP_WIFI_11KV_SUPPORT
+	/* Let the supplicant follow neighbor reports and BSS transition requests from the AP. */
+	cfg.sta.rm_enabled = 1;
+	cfg.sta.btm_enabled = 1;
+#endif
+
+	sta_fast_path = sta_entry.bssid_valid;
+	if (sta_fast_path) {
+		memcpy(cfg.sta.bssid, sta_entry.bssid, sizeof(cfg.sta.bssid));
+		cfg.sta.bssid_set = true;
+		cfg.sta.channel = sta_entry.channel;
+		cfg.sta.scan_method = WIFI_FAST_SCAN;
+	} else {
+		cfg.sta.scan_method = DEFAULT_SCAN_METHOD;
+		cfg.sta.sort_method = DEFAULT_SORT_METHOD;
+	}
+
+	/* SAE derives its keys from the passphrase itself, so only WPA/WPA2-PSK can use the PMK. */
+	if (sta_entry.pmk_valid && sta_entry.authmode != WIFI_AUTH_WPA3_PSK && sta_entry.authmode != WIFI_AUTH_WPA2_WPA3_PSK) {
+		/* 64 hex digits fill the field exactly; the driver does not expect a terminator here. */
+		static const char hex[] = "0123456789abcdef";
+		for (size_t i = 0; i < sizeof(sta_entry.pmk); i++) {
+			cfg.sta.password[i * 2] = hex[sta_entry.pmk[i] >> 4];
+			cfg.sta.password[i * 2 + 1] = hex[sta_entry.pmk[i] & 0x0f];
+		}
+	} else {
+		strncpy((char *)cfg.sta.password, sta_entry.password, sizeof(cfg.sta.password));
+	}
+
+	ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &cfg));
+	connect_started_us = esp_timer_get_time();
+	sta_entry.hist.attempts++;
+	sync_networks();
+	set_status(WIFI_MANAGER_URC_CONNECTING, NULL);
+	transition(WIFI_MANAGER_STATE_CONNECTING);
+	ESP_LOGI(TAG, "Connecting to %s (%s)", sta_entry.ssid, sta_fast_path ? "cached BSSID/channel" : "full scan");
+	esp_wifi_connect();
+}
+
+static void select_from_scan(void) {
+	wifi_scan_hit_t hit;
+	int best = rank_networks(&hit);
+
+	if (best >= 0) {
+		ESP_LOGI(TAG, "Selected %s (%d dBm) of %u known networks", networks[best].ssid, hit.rssi, (unsigned)net_count);
+		use_network(best, &hit);
+	} else {
+		/* None seen (hidden SSID, or the scan missed it): walk the list in priority order. */
+		use_network(cur >= 0 ? (cur + 1) % (int)net_count : 0, NULL);
+	}
+	sync_networks();
+	sta_connect();
+}
+
+/* Pick a known network and join it; scans first when there is a real choice to make. */
+static void begin_join(bool boot) {
+	if (net_count == 0) {
+		cur = -1;
+		transition(WIFI_MANAGER_STATE_IDLE);
+		return;
+	}
+
+	if (net_count == 1) {
+		use_network(0, NULL);
+		sta_connect();
+		return;
+	}
+
+	if (boot) {
+		/* The last network joined is the likeliest to still be there; keep the fast path for it. */
+		int last = -1;
+		for (size_t i = 0; i < net_count; i++) {
+			if (networks[i].bssid_valid && (last < 0 || networks[i].hist.last_join_seq > networks[last].hist.last_join_seq)) {
+				last = (int)i;
+			}
+		}
+		if (last >= 0) {
+			use_network(last, NULL);
+			sta_connect();
+			return;
+		}
+	}
+
+	if (wifi_scan_age_ms() < WIFI_MANAGER_SCAN_MAX_AGE_MS) {
+		select_from_scan();
+		return;
+	}
+
+	xEventGroupClearBits(wifi_event_group, WIFI_MANAGER_SCAN_DONE_BIT);
+	if (wifi_scan_trigger()) {
+		select_pending = true;
+		transition(WIFI_MANAGER_STATE_SELECTING);
+	} else {
+		select_from_scan();
+	}
+}
+
+static void roam_check(void) {
+	wifi_scan_hit_t hit;
+	int best = rank_networks(&hit);
+
+	sync_networks();
+	if (state != WIFI_MANAGER_STATE_ONLINE) {
+		return;
+	}
+	if (best >= 0 && hit.rssi >= roam_rssi + WIFI_MANAGER_ROAM_HYSTERESIS_DB &&
+			(best != cur || memcmp(hit.bssid, sta_entry.bssid, sizeof(hit.bssid)) != 0)) {
+		ESP_LOGI(TAG, "Roaming from %s (%d dBm) to %s (%d dBm, ch %u)", sta_entry.ssid, roam_rssi,
+				networks[best].ssid, hit.rssi, hit.channel);
+		connect_stats.roams++;
+		lost_at_us = esp_timer_get_time();
+		use_network(best, &hit);
+		esp_wifi_disconnect();
+		sta_connect();
+		return;
+	}
+
+	esp_timer_start_once(roam_timer, WIFI_MANAGER_ROAM_BACKOFF_MS * 1000);
+}
+
+static void retry_timer_cb(void *arg) {
+	wifi_manager_msg_t msg = { .code = WM_TIMER_RETRY };
+	post(&msg, 0);
+}
+
+static void handoff_timer_cb(void *arg) {
+	wifi_manager_msg_t msg = { .code = WM_TIMER_HANDOFF };
+	post(&msg, 0);
+}
+
+static void roam_timer_cb(void *arg) {
+	wifi_manager_msg_t msg = { .code = WM_TIMER_ROAM };
+	post(&msg, 0);
+}
+
+/* PBKDF2 and the NVS write are too slow for the manager task; do them on a throwaway task. */
+static void save_cache_task(void *arg) {
+	wifi_manager_save_job_t *job = arg;
+	wifi_store_sta_t *entry = &job->list[job->cur];
+	wifi_manager_msg_t msg = { .code = WM_CACHE_SAVED };
+
+	if (!entry->pmk_valid) {
+		wifi_store_derive_pmk(entry);
+	}
+	if (wifi_store_save(job->list, job->count) == ESP_OK) {
+		ESP_LOGI(TAG, "Saved %u networks, current %s (ch %u, pmk %s)", (unsigned)job->count,
+				entry->ssid, entry->channel, entry->pmk_valid ? "yes" : "no");
+		strncpy(msg.cache.ssid, entry->ssid, sizeof(msg.cache.ssid) - 1);
+		memcpy(msg.cache.pmk, entry->pmk, sizeof(msg.cache.pmk));
+		msg.cache.pmk_valid = entry->pmk_valid;
+		post(&msg, portMAX_DELAY);
+	} else {
+		ESP_LOGE(TAG, "Failed to save network list");
+	}
+	free(job);
+	vTaskDelete(NULL);
+}
+
+static void save_networks(void) {
+	wifi_manager_save_job_t *job = malloc(sizeof(*job));
+
+	if (job == NULL || cur < 0) {
+		free(job);
+		return;
+	}
+	job->count = net_count;
+	job->cur = cur;
+	memcpy(job->list, networks, net_count * sizeof(networks[0]));
+	if (xTaskCreate(save_cache_task, "wifi_cache", 3072, job, 2, NULL) != pdPASS) {
+		free(job);
+	}
+}
+
+static void on_sta_connected(const wifi_event_sta_connected_t *ev) {
+	bool changed = !sta_entry.bssid_valid || sta_entry.channel != ev->channel ||
+			memcmp(sta_entry.bssid, ev->bssid, sizeof(ev->bssid)) != 0;
+	if (changed) {
+		memcpy(sta_entry.bssid, ev->bssid, sizeof(ev->bssid));
+		sta_entry.channel = ev->channel;
+		sta_entry.bssid_valid = false; /* becomes valid once we get an IP */
+	}
+	sta_entry.authmode = ev->authmode;
+	xEventGroupSetBits(wifi_event_group, WIFI_MANAGER_STA_CONNECTED_BIT);
+	transition(WIFI_MANAGER_STATE_CONNECTED);
+}
+
+static void on_sta_disconnected(const wifi_event_sta_disconnected_t *ev) {
+	EventBits_t bits = xEventGroupClearBits(wifi_event_group, WIFI_MANAGER_STA_CONNECTED_BIT | WIFI_MANAGER_GOT_IP_BIT);
+
+	wifi_power_link(false);
+	/* Our own esp_wifi_disconnect() ahead of a new join is not a failed attempt. */
+	if (!have_network() || ev->reason == WIFI_REASON_ASSOC_LEAVE) {
+		return;
+	}
+
+	ESP_LOGW(TAG, "Disconnected from %s, reason %u", sta_entry.ssid, ev->reason);
+	esp_timer_stop(roam_timer);
+	roam_pending = false;
+	if (bits & WIFI_MANAGER_GOT_IP_BIT) {
+		lost_at_us = esp_timer_get_time();
+		set_status(WIFI_MANAGER_URC_LOST_CONNECTION, NULL);
+	} else if (sta_entry.hist.consecutive_failures < UINT8_MAX) {
+		sta_entry.hist.consecutive_failures++;
+	}
+	sync_networks();
+	retries++;
+	connect_stats.failures++;
+
+	if (provisioning && retries >= WIFI_MANAGER_PROV_ATTEMPTS) {
+		/* Report the failure, then go back to the known networks. */
+		ESP_LOGW(TAG, "Giving up on %s after %d attempts", sta_entry.ssid, retries);
+		set_status(WIFI_MANAGER_URC_FAILED_ATTEMPT, NULL);
+		provisioning = false;
+		retries = 0;
+		if (net_count) {
+			transition(WIFI_MANAGER_STATE_BACKOFF);
+			esp_timer_start_once(retry_timer, WIFI_MANAGER_RETRY_DELAY_MS * 1000);
+		} else {
+			transition(WIFI_MANAGER_STATE_IDLE);
+		}
+		return;
+	}
+	if (sta_fast_path) {
+		/* The AP may have moved channel or been replaced: fall back to a full scan at once. */
+		sta_entry.bssid_valid = false;
+		sta_connect();
+		return;
+	}
+	if (retries == WIFI_MANAGER_MAX_RETRIES_BEFORE_AP) {
+		start_softap();
+	}
+	transition(WIFI_MANAGER_STATE_BACKOFF);
+	esp_timer_start_once(retry_timer, WIFI_MANAGER_RETRY_DELAY_MS * 1000);
+}
+
+static void on_got_ip(const esp_netif_ip_info_t *ip_info) {
+	int64_t now = esp_timer_get_time();
+	bool list_changed = provisioning;
+	bool cache_stale = !sta_entry.bssid_valid || !sta_entry.pmk_valid || sta_entry_dirty;
+	wifi_ap_record_t ap;
+
+	connect_stats.connect_to_ip_ms = (uint32_t)((now - connect_started_us) / 1000);
+	if (connect_stats.boot_to_ip_ms == 0) {
+		connect_stats.boot_to_ip_ms = (uint32_t)(now / 1000);
+	}
+	connect_stats.fast_path = sta_fast_path;
+	connect_stats.connects++;
+	retries = 0;
+
+	ESP_LOGI(TAG, "Got IP after %" PRIu32 " ms (boot-to-IP %" PRIu32 " ms, %s)",
+			connect_stats.connect_to_ip_ms, connect_stats.boot_to_ip_ms,
+			sta_fast_path ? "fast path" : "full scan");
+
+	wifi_store_history_t *h = &sta_entry.hist;
+	h->successes++;
+	h->consecutive_failures = 0;
+	h->last_join_seq = ++join_seq;
+	if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+		h->rssi_last = ap.rssi;
+	}
+	if (lost_at_us) {
+		h->reconnect_ms_last = (uint32_t)((now - lost_at_us) / 1000);
+		h->reconnect_ms_avg = h->reconnect_ms_avg ? (h->reconnect_ms_avg * 3 + h->reconnect_ms_last) / 4 : h->reconnect_ms_last;
+		lost_at_us = 0;
+	}
+
+	sta_entry.bssid_valid = true;
+	sta_entry_dirty = false;
+	if (provisioning) {
+		promote_current();
+		provisioning = false;
+	}
+	sync_networks();
+
+	transition(WIFI_MANAGER_STATE_ONLINE);
+	wifi_power_link(true);
+	xEventGroupSetBits(wifi_event_group, WIFI_MANAGER_GOT_IP_BIT);
+	set_status(WIFI_MANAGER_URC_CONNECTION_OK, ip_info);
+	start_dashboard();
+	if (cache_stale || list_changed || h->successes % WIFI_MANAGER_HIST_SAVE_EVERY == 0) {
+		save_networks();
+	}
+	/* Also worth it with one known network: several APs often share an SSID. Fires once per crossing. */
+	esp_wifi_set_rssi_threshold(DEFAULT_ROAM_RSSI);
+	if (ap_running) {
+		/*
+		 * The AP has already followed the station onto its channel, so portal
+		 * clients may have reassociated; give them time to read the new IP.
+		 */
+		esp_timer_stop(handoff_timer);
+		esp_timer_start_once(handoff_timer, WIFI_MANAGER_HANDOFF_DELAY_MS * 1000);
+	}
+}
+
+static void on_rssi_low(int32_t rssi) {
+	if (state != WIFI_MANAGER_STATE_ONLINE || roam_pending) {
+		return;
+	}
+	ESP_LOGI(TAG, "RSSI %" PRId32 " dBm below %d, looking for a better AP", rssi, DEFAULT_ROAM_RSSI);
+	roam_rssi = (int8_t)rssi;
+	connect_stats.roam_scans++;
+	if (wifi_scan_trigger()) {
+		roam_pending = true;
+	} else {
+		esp_timer_start_once(roam_timer, WIFI_MANAGER_ROAM_BACKOFF_MS * 1000);
+	}
+}
+
+static void on_connect_order(const char *ssid, const char *password) {
+	int idx = find_network(ssid);
+
+	if (ap_running) {
+		esp_timer_stop(handoff_timer);
+	}
+	if (idx >= 0 && strcmp(password, networks[idx].password) == 0) {
+		/* Already known: just switch to it. */
+		provisioning = false;
+		use_network(idx, NULL);
+	} else {
+		if (cur >= 0) {
+			networks[cur] = sta_entry;
+		}
+		cur = -1;
+		provisioning = true;
+		memset(&sta_entry, 0, sizeof(sta_entry));
+		strncpy(sta_entry.ssid, ssid, sizeof(sta_entry.ssid) - 1);
+		strncpy(sta_entry.password, password, sizeof(sta_entry.password) - 1);
+	}
+	retries = 0;
+	esp_timer_stop(retry_timer);
+	taskENTER_CRITICAL(&status_mux);
+	sta_status.attempt = 0;
+	taskEXIT_CRITICAL(&status_mux);
+
+	wifi_mode_t mode;
+	esp_wifi_get_mode(&mode);
+	if (mode == WIFI_MODE_AP) {
+		/* STA_START will trigger the connect. */
+		esp_wifi_set_mode(WIFI_MODE_APSTA);
+	} else {
+		esp_wifi_disconnect();
+		sta_connect();
+	}
+}
+
+static void on_disconnect_order(void) {
+	esp_timer_stop(retry_timer);
+	esp_timer_stop(roam_timer);
+	provisioning = false;
+	retries = 0;
+	esp_wifi_disconnect();
+	xEventGroupClearBits(wifi_event_group, WIFI_MANAGER_STA_CONNECTED_BIT | WIFI_MANAGER_GOT_IP_BIT);
+	set_status(WIFI_MANAGER_URC_USER_DISCONNECT, NULL);
+
+	if (cur >= 0) {
+		ESP_LOGI(TAG, "Forgetting %s", networks[cur].ssid);
+		remove_network(cur);
+		esp_err_t err = net_count ? wifi_store_save(networks, net_count) : wifi_store_erase();
+		if (err != ESP_OK) {
+			ESP_LOGE(TAG, "Failed to update stored networks: %s", esp_err_to_name(err));
+		}
+	}
+	memset(&sta_entry, 0, sizeof(sta_entry));
+	sync_networks();
+
+	if (net_count) {
+		begin_join(false);
+	} else {
+		transition(WIFI_MANAGER_STATE_IDLE);
+		/* Nothing left to join, so make sure the device can be provisioned again. */
+		start_softap();
+	}
+}
+
+static void on_retry(void) {
+	if (state != WIFI_MANAGER_STATE_BACKOFF) {
+		return;
+	}
+	if (provisioning) {
+		sta_connect();
+	} else if (cur < 0 || (net_count > 1 && retries % WIFI_MANAGER_RETRIES_PER_NETWORK == 0)) {
+		/* This one keeps failing: rank the known networks again. */
+		begin_join(false);
+	} else {
+		sta_connect();
+	}
+}
+
+static void wifi_manager_task(void *arg) {
+	wifi_manager_msg_t msg;
+
+	for (;;) {
+		if (xQueueReceive(wifi_queue, &msg, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		switch (msg.code) {
+		case WM_ORDER_CONNECT_STA:
+			on_connect_order(msg.creds.ssid, msg.creds.password);
+			break;
+		case WM_ORDER_DISCONNECT_STA:
+			on_disconnect_order();
+			break;
+		case WM_ORDER_START_SCAN:
+			xEventGroupClearBits(wifi_event_group, WIFI_MANAGER_SCAN_DONE_BIT);
+			wifi_scan_trigger();
+			break;
+		case WM_ORDER_START_AP:
+			start_softap();
+			break;
+		case WM_ORDER_SET_PS:
+			settings_set_int(&wm_settings, WM_SETTING_PS_PROFILE, msg.profile);
+			if (wifi_power_apply(msg.profile, ap_running) && ps_cb) {
+				ps_cb(msg.profile, ps_cb_ctx);
+			}
+			break;
+		case WM_EVENT_STA_START:
+			if (provisioning) {
+				sta_connect();
+			} else {
+				begin_join(true);
+			}
+			break;
+		case WM_EVENT_AP_START:
+			xEventGroupSetBits(wifi_event_group, WIFI_MANAGER_AP_STARTED_BIT);
+			start_portal();
+			break;
+		case WM_EVENT_AP_STOP:
+			xEventGroupClearBits(wifi_event_group, WIFI_MANAGER_AP_STARTED_BIT);
+			break;
+		case WM_EVENT_SCAN_DONE:
+			wifi_scan_on_done(&msg.scan_done);
+			http_app_push(http_server, HTTP_APP_PUSH_SCAN);
+			xEventGroupSetBits(wifi_event_group, WIFI_MANAGER_SCAN_DONE_BIT);
+			if (select_pending) {
+				select_pending = false;
+				if (state == WIFI_MANAGER_STATE_SELECTING) {
+					select_from_scan();
+				}
+			}
+			if (roam_pending) {
+				roam_pending = false;
+				roam_check();
+			}
+			break;
+		case WM_EVENT_STA_CONNECTED:
+			on_sta_connected(&msg.connected);
+			break;
+		case WM_EVENT_STA_DISCONNECTED:
+			on_sta_disconnected(&msg.disconnected);
+			break;
+		case WM_EVENT_STA_GOT_IP:
+			on_got_ip(&msg.ip_info);
+			break;
+		case WM_EVENT_RSSI_LOW:
+			on_rssi_low(msg.rssi);
+			break;
+		case WM_TIMER_RETRY:
+			on_retry();
+			break;
+		case WM_TIMER_HANDOFF:
+			if (ap_running && state == WIFI_MANAGER_STATE_ONLINE) {
+				stop_portal();
+			}
+			break;
+		case WM_TIMER_ROAM:
+			if (state == WIFI_MANAGER_STATE_ONLINE) {
+				esp_wifi_set_rssi_threshold(DEFAULT_ROAM_RSSI);
+			}
+			break;
+		case WM_CACHE_SAVED: {
+			/* The network may have changed while PBKDF2 was running. */
+			int idx = find_network(msg.cache.ssid);
+			if (idx >= 0) {
+				memcpy(networks[idx].pmk, msg.cache.pmk, sizeof(networks[idx].pmk));
+				networks[idx].pmk_valid = msg.cache.pmk_valid;
+			}
+			if (strcmp(msg.cache.ssid, sta_entry.ssid) == 0) {
+				memcpy(sta_entry.pmk, msg.cache.pmk, sizeof(sta_entry.pmk));
+				sta_entry.pmk_valid = msg.cache.pmk_valid;
+			}
+			break;
+		}
+		}
+	}
+}
+
+/* Runs on the default event loop: copy what is needed and hand it to the manager task. */
+static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data) {
+	wifi_manager_msg_t msg;
+
+	if (base == WIFI_EVENT) {
+		switch (id) {
+		case WIFI_EVENT_STA_START:
+			msg.code = WM_EVENT_STA_START;
+			break;
+		case WIFI_EVENT_AP_START:
+			msg.code = WM_EVENT_AP_START;
+			break;
+		case WIFI_EVENT_AP_STOP:
+			msg.code = WM_EVENT_AP_STOP;
+			break;
+		case WIFI_EVENT_SCAN_DONE:
+			msg.code = WM_EVENT_SCAN_DONE;
+			msg.scan_done = *(wifi_event_sta_scan_done_t *)data;
+			break;
+		case WIFI_EVENT_STA_CONNECTED:
+			msg.code = WM_EVENT_STA_CONNECTED;
+			msg.connected = *(wifi_event_sta_connected_t *)data;
+			break;
+		case WIFI_EVENT_STA_DISCONNECTED:
+			msg.code = WM_EVENT_STA_DISCONNECTED;
+			msg.disconnected = *(wifi_event_sta_disconnected_t *)data;
+			break;
+		case WIFI_EVENT_STA_BSS_RSSI_LOW:
+			msg.code = WM_EVENT_RSSI_LOW;
+			msg.rssi = ((wifi_event_bss_rssi_low_t *)data)->rssi;
+			break;
+		default:
+			return;
+		}
+	} else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+		msg.code = WM_EVENT_STA_GOT_IP;
+		msg.ip_info = ((ip_event_got_ip_t *)data)->ip_info;
+	} else {
+		return;
+	}
+
+	post(&msg, pdMS_TO_TICKS(WIFI_MANAGER_POST_TIMEOUT_MS));
+}
+
+esp_err_t wifi_manager_connect_sta(const char* ssid, const char* password) {
+	wifi_manager_msg_t msg = { .code = WM_ORDER_CONNECT_STA };
+
+	if (ssid == NULL || ssid[0] == '\0') {
+		return ESP_ERR_INVALID_ARG;
+	}
+	strncpy(msg.creds.ssid, ssid, sizeof(msg.creds.ssid) - 1);
+	strncpy(msg.creds.password, password ? password : "", sizeof(msg.creds.password) - 1);
+	return post(&msg, pdMS_TO_TICKS(WIFI_MANAGER_POST_TIMEOUT_MS));
+}
+
+esp_err_t wifi_manager_disconnect_sta(void) {
+	wifi_manager_msg_t msg = { .code = WM_ORDER_DISCONNECT_STA };
+	return post(&msg, pdMS_TO_TICKS(WIFI_MANAGER_POST_TIMEOUT_MS));
+}
+
+esp_err_t wifi_manager_scan(void) {
+	wifi_manager_msg_t msg = { .code = WM_ORDER_START_SCAN };
+	/* Also called from the scan schedule's esp_timer callback, which must not block. */
+	return post(&msg, 0);
+}
+
+esp_err_t wifi_manager_start_ap(void) {
+	wifi_manager_msg_t msg = { .code = WM_ORDER_START_AP };
+	return post(&msg, pdMS_TO_TICKS(WIFI_MANAGER_POST_TIMEOUT_MS));
+}
+
+esp_err_t wifi_manager_set_power_profile(wifi_manager_ps_profile_t profile) {
+	wifi_manager_msg_t msg = { .code = WM_ORDER_SET_PS, .profile = profile };
+
+	if (profile >= WIFI_MANAGER_PS_PROFILES) {
+		return ESP_ERR_INVALID_ARG;
+	}
+	return post(&msg, pdMS_TO_TICKS(WIFI_MANAGER_POST_TIMEOUT_MS));
+}
+
+wifi_manager_ps_profile_t wifi_manager_get_power_profile(void) {
+	return wifi_power_get_profile();
+}
+
+void wifi_manager_get_power_stats(wifi_manager_ps_profile_t profile, wifi_manager_power_stats_t *stats) {
+	wifi_power_get_stats(profile, stats);
+}
+
+void wifi_manager_set_dashboard(const wifi_manager_dashboard_t *dash) {
+	http_app_set_dashboard(dash);
+}
+
+void wifi_manager_set_power_cb(wifi_manager_ps_cb_t cb, void *ctx) {
+	ps_cb_ctx = ctx;
+	ps_cb = cb;
+	if (cb) {
+		cb(wifi_power_get_profile(), ctx);
+	}
+}
+
+void wifi_manager_start(void) {
+	wifi_event_group = xEventGroupCreate();
+	wifi_queue = xQueueCreate(WIFI_MANAGER_QUEUE_LEN, sizeof(wifi_manager_msg_t));
+	generate_ap_ssid_from_mac();
+
+	ESP_LOGI(TAG, "Starting Wi-Fi manager, AP SSID: %s", ap_ssid);
+
+	/* NVS, esp_netif and the event loop are up already: the nvs and netif boot stages. */
+	ESP_ERROR_CHECK(nvs_sync_create());
+	if (settings_register(&wm_settings) != ESP_OK) {
+		ESP_LOGW(TAG, "Settings unavailable, using build defaults");
+	}
+
+	netif_ap = esp_netif_create_default_wifi_ap();
+	netif_sta = esp_netif_create_default_wifi_sta();
+	wifi_power_init(netif_sta);
+
+	wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+	ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+	/* Credentials live in our own NVS record; the driver copy would just cost flash writes. */
+	ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+
+	ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL, NULL));
+	ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL, NULL));
+
+	const esp_timer_create_args_t retry_args = {
+		.callback = retry_timer_cb,
+		.name = "wifi_retry",
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&retry_args, &retry_timer));
+	const esp_timer_create_args_t handoff_args = {
+		.callback = handoff_timer_cb,
+		.name = "wifi_handoff",
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&handoff_args, &handoff_timer));
+	const esp_timer_create_args_t roam_args = {
+		.callback = roam_timer_cb,
+		.name = "wifi_roam",
+	};
+	ESP_ERROR_CHECK(esp_timer_create(&roam_args, &roam_timer));
+	ESP_ERROR_CHECK(wifi_scan_init());
+
+	/* Set up before the task exists; events raised by esp_wifi_start() wait in the queue. */
+	state_entered_us = esp_timer_get_time();
+	if (wifi_store_load(networks, &net_count) == ESP_OK) {
+		for (size_t i = 0; i < net_count; i++) {
+			if (networks[i].hist.last_join_seq > join_seq) {
+				join_seq = networks[i].hist.last_join_seq;
+			}
+		}
+		sync_networks();
+		ESP_LOGI(TAG, "%u known networks, first %s", (unsigned)net_count, networks[0].ssid);
+		ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+	} else {
+		start_softap();
+	}
+
+	ESP_ERROR_CHECK(esp_wifi_start());
+	int32_t profile = settings_get_int(&wm_settings, WM_SETTING_PS_PROFILE);
+	wifi_power_apply(profile >= 0 && profile < WIFI_MANAGER_PS_PROFILES ? (wifi_manager_ps_profile_t)profile : wifi_power_get_profile(),
+			ap_running);
+	xTaskCreate(wifi_manager_task, "wifi_manager", WIFI_MANAGER_TASK_STACK, NULL, WIFI_MANAGER_TASK_PRIORITY, NULL);
+}
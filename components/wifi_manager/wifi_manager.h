@@ -2,25 +2,208 @@
  *  wifi_manager.h
  *
  *  Created on: 2025-06-23
- *  Edited on: 2025-07-09
+ *  Edited on: 2026-10-19
  *      Author: Andwardo
- *      Version: v8.2.47
+ *      Version: v8.2.73
  */
 
 #ifndef WIFI_MANAGER_H
 #define WIFI_MANAGER_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "esp_netif.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-#define WIFI_MANAGER_STA_CONNECTED_BIT BIT0
+/* Event group bits; set and cleared by the manager task only. */
+#define WIFI_MANAGER_STA_CONNECTED_BIT BIT0   /* associated with the AP */
+#define WIFI_MANAGER_AP_STARTED_BIT    BIT1   /* SoftAP is up */
+#define WIFI_MANAGER_GOT_IP_BIT        BIT2   /* station has an IP; the network is usable */
+#define WIFI_MANAGER_SCAN_DONE_BIT     BIT3   /* last requested scan finished; cleared when one starts */
 
+/**
+ * @brief Station side of the manager task's state machine.
+ */
+typedef enum {
+	WIFI_MANAGER_STATE_IDLE = 0,    /* no network configured */
+	WIFI_MANAGER_STATE_SELECTING,   /* scanning to rank the known networks */
+	WIFI_MANAGER_STATE_CONNECTING,  /* esp_wifi_connect() issued */
+	WIFI_MANAGER_STATE_CONNECTED,   /* associated, waiting for DHCP */
+	WIFI_MANAGER_STATE_ONLINE,      /* has an IP */
+	WIFI_MANAGER_STATE_BACKOFF,     /* waiting to retry after a failed join */
+} wifi_manager_state_t;
+
+/**
+ * @brief Update reason codes reported to the portal in status.json ("urc").
+ */
+typedef enum {
+	WIFI_MANAGER_URC_CONNECTION_OK = 0,
+	WIFI_MANAGER_URC_FAILED_ATTEMPT = 1,
+	WIFI_MANAGER_URC_USER_DISCONNECT = 2,
+	WIFI_MANAGER_URC_LOST_CONNECTION = 3,
+	WIFI_MANAGER_URC_CONNECTING = 4,
+} wifi_manager_urc_t;
+
+/**
+ * @brief Snapshot of the station side, as shown to the provisioning browser.
+ */
+typedef struct {
+	char ssid[33];
+	wifi_manager_urc_t urc;
+	uint8_t attempt;            /* join attempts for the current credentials */
+	bool portal_up;             /* AP and HTTP server still running */
+	esp_netif_ip_info_t ip_info;
+} wifi_manager_sta_status_t;
+
+/**
+ * @brief Join timing, for tracking boot-to-IP on cold and warm (cached) connects.
+ */
+typedef struct {
+	uint32_t boot_to_ip_ms;     /* esp_timer time of the first IP after boot */
+	uint32_t connect_to_ip_ms;  /* last esp_wifi_connect() to IP */
+	bool fast_path;             /* last join used the cached BSSID/channel/PMK */
+	uint32_t connects;
+	uint32_t failures;
+	uint32_t transitions;       /* state machine transitions since boot */
+	uint32_t roam_scans;        /* scans started because the link RSSI dropped */
+	uint32_t roams;             /* moves to a stronger BSSID or network */
+} wifi_manager_connect_stats_t;
+
+/**
+ * @brief Station power-save profiles, switchable at runtime.
+ */
+typedef enum {
+	WIFI_MANAGER_PS_NONE = 0,       /* radio always on; lowest latency */
+	WIFI_MANAGER_PS_MIN_MODEM,      /* wake every DTIM */
+	WIFI_MANAGER_PS_MAX_MODEM,      /* wake every DEFAULT_LISTEN_INTERVAL beacons */
+	WIFI_MANAGER_PS_PROFILES
+} wifi_manager_ps_profile_t;
+
+/**
+ * @brief Airtime accounting for one profile, booked only while associated.
+ *        TX is measured at the STA netif; wakeups and radio_on_ms are
+ *        estimated from the profile's wake schedule.
+ */
+typedef struct {
+	uint32_t active_ms;         /* time spent associated in this profile */
+	uint32_t radio_on_ms;       /* estimated; equals active_ms for WIFI_MANAGER_PS_NONE */
+	uint64_t tx_bytes;
+	uint32_t tx_packets;
+	uint32_t wakeups;           /* scheduled beacon wakeups plus tx_wakeups */
+	uint32_t tx_wakeups;        /* frames sent after a full wake period of silence */
+} wifi_manager_power_stats_t;
+
+/**
+ * @brief Called from the manager task after the selected profile changes,
+ *        e.g. to stretch the MQTT keepalive so it does not defeat the sleep.
+ */
+typedef void (*wifi_manager_ps_cb_t)(wifi_manager_ps_profile_t profile, void *ctx);
+
+/**
+ * @brief One entry of the known-network list, highest priority first.
+ */
+typedef struct {
+	char ssid[33];
+	uint16_t attempts;
+	uint16_t successes;
+	uint8_t consecutive_failures;
+	int8_t rssi_last;
+	uint32_t reconnect_ms_last; /* link lost to IP again */
+	uint32_t reconnect_ms_avg;
+	bool current;               /* the network being joined or joined */
+} wifi_manager_network_info_t;
+
+/**
+ * @brief Bring up Wi-Fi and start the manager task. Every call below, and every
+ *        esp_event callback, is turned into a message for that task; the calls
+ *        return once the message is queued, not when it has been handled.
+ * @note  nvs_flash_init(), esp_netif_init() and esp_event_loop_create_default()
+ *        must have run first; main.c does them in the nvs and netif boot stages.
+ */
 void wifi_manager_start(void);
-void wifi_manager_connect_sta(const char* ssid, const char* password);
+
+/**
+ * @brief Join a network. Once the station gets an IP it goes to the top of the
+ *        known-network list in NVS (the lowest-ranked entry is dropped when the
+ *        list is full), with its BSSID, channel and PMK. Call after wifi_manager_start().
+ *
+ * If the portal is up the join runs in APSTA alongside it; the AP and HTTP
+ * server are only torn down once the station has an IP and the browser has
+ * had time to read it. A join that keeps failing is reported as
+ * WIFI_MANAGER_URC_FAILED_ATTEMPT and the known networks are used again.
+ */
+esp_err_t wifi_manager_connect_sta(const char* ssid, const char* password);
+
+/**
+ * @brief Leave the current network and forget it. The next best known network
+ *        is joined, or the portal is brought up if none are left.
+ */
+esp_err_t wifi_manager_disconnect_sta(void);
+
+/**
+ * @brief Start one scan; wait on WIFI_MANAGER_SCAN_DONE_BIT for the result.
+ */
+esp_err_t wifi_manager_scan(void);
+esp_err_t wifi_manager_start_ap(void);
+wifi_manager_state_t wifi_manager_get_state(void);
+
+/**
+ * @return Number of entries written to out.
+ */
+size_t wifi_manager_get_networks(wifi_manager_network_info_t *out, size_t max);
+
+/**
+ * @brief Switch power profile. Modem sleep takes effect at once; the max-modem
+ *        listen interval is negotiated at association, so it applies from the
+ *        next (re)connect. While the SoftAP is up the radio stays on. The
+ *        choice is kept across reboots.
+ */
+esp_err_t wifi_manager_set_power_profile(wifi_manager_ps_profile_t profile);
+wifi_manager_ps_profile_t wifi_manager_get_power_profile(void);
+void wifi_manager_get_power_stats(wifi_manager_ps_profile_t profile, wifi_manager_power_stats_t *stats);
+
+/**
+ * @brief Register the profile-change callback (one slot). It is called right
+ *        away with the current profile, then from the manager task on changes.
+ */
+void wifi_manager_set_power_cb(wifi_manager_ps_cb_t cb, void *ctx);
+
+/**
+ * @brief Sink for dashboard output; each call becomes one HTTP chunk.
+ */
+typedef esp_err_t (*wifi_manager_dash_write_t)(void *sink, const char *data, size_t len);
+
+/**
+ * @brief Data behind the local dashboard (/dash). Both callbacks run on the
+ *        httpd task and write JSON piecewise through write(), so nothing has
+ *        to be rendered in one buffer. Either may be NULL.
+ */
+typedef struct {
+	esp_err_t (*status)(wifi_manager_dash_write_t write, void *sink, void *ctx);
+	esp_err_t (*history)(wifi_manager_dash_write_t write, void *sink, void *ctx);
+	void *ctx;
+} wifi_manager_dashboard_t;
+
+/**
+ * @brief Provide the dashboard data. The dashboard is served on the station
+ *        address once it has an IP, as http://<DEFAULT_HOSTNAME>-xxxx.local/,
+ *        behind HTTP basic auth (DEFAULT_DASHBOARD_USER / DEFAULT_DASHBOARD_PASSWORD).
+ *        A build without DEFAULT_DASHBOARD_PASSWORD keeps it locked.
+ * @param dash Kept by reference; must stay valid.
+ */
+void wifi_manager_set_dashboard(const wifi_manager_dashboard_t *dash);
+
 EventGroupHandle_t wifi_manager_get_event_group(void);
+esp_netif_t* wifi_manager_get_esp_netif_sta(void);
+esp_netif_t* wifi_manager_get_esp_netif_ap(void);
+void wifi_manager_get_connect_stats(wifi_manager_connect_stats_t *stats);
+void wifi_manager_get_sta_status(wifi_manager_sta_status_t *status);
 void generate_ap_ssid_from_mac(void);
 const char* get_ap_ssid(void);
 
@@ -2,25 +2,139 @@
  * File: main.c
  * Description: Main entry point for the PianoGuard DCM-1 application.
  * Created on: 2025-06-25
- * Edited on:  2025-07-09
- * Version: v8.6.2
+ * Edited on:  2026-10-19
+ * Version: v8.6.5
  * Author: R. Andrew Ballard (c) 2025
- * Fix: Add stdint.h for uint16_t errors and terminate app_main() properly.
+ * Feat: OTA stage; a freshly updated image must boot fully and reach the broker to be kept.
  **/
 
 #include <stdio.h>
 #include <stdint.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "nvs_flash.h"
+#include "esp_timer.h"
+#include "app_logic.h"
+#include "board_manager.h"
+#include "boot_manager.h"
+#include "mqtt_manager.h"
+#include "mqtt_rpc.h"
+#include "ota_manager.h"
 #include "wifi_manager.h"
 
-void app_main(void) {
-    ESP_LOGI("main", "PianoGuard DCM-1 starting up...");
+static const char *TAG = "main";
+
+// Stage indices; a stage may only depend on stages listed before it.
+enum {
+    STAGE_NVS,
+    STAGE_NETIF,
+    STAGE_BOARD,
+    STAGE_TLS,
+    STAGE_WIFI,
+    STAGE_IP,
+    STAGE_MQTT,
+    STAGE_APP,
+    STAGE_OTA,
+    STAGE_COUNT
+};
+
+static esp_err_t stage_nvs(void) {
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        ret = nvs_flash_init();
+    }
+    return ret;
+}
+
+static esp_err_t stage_netif(void) {
+    esp_err_t ret = esp_netif_init();
+    if (ret == ESP_OK) {
+        ret = esp_event_loop_create_default();
+    }
+    return ret;
+}
+
+// GPIO set-up and the first sensor read run while the radio is still associating.
+static esp_err_t stage_board(void) {
+    dcm_status_t status;
+    esp_err_t ret = board_manager_init();
+    if (ret == ESP_OK) {
+        ret = board_manager_get_status(&status);
+    }
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "Initial sensors: power=%d water_low=%d pads_worn=%d",
+                 status.power_ok, status.water_low, status.pads_worn);
+    }
+    return ret;
+}
 
+static esp_err_t stage_wifi(void) {
     wifi_manager_start();
+    return ESP_OK;
+}
 
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
+// Not work of its own: makes the station's IP an explicit dependency and puts it on the timeline.
+static esp_err_t stage_ip(void) {
+    xEventGroupWaitBits(wifi_manager_get_event_group(), WIFI_MANAGER_GOT_IP_BIT,
+                        pdFALSE, pdTRUE, portMAX_DELAY);
+    return ESP_OK;
+}
+
+// Started only once there is an IP: before that esp-mqtt's first connect fails
+// and the retry waits out the full reconnect timeout.
+static esp_err_t stage_mqtt(void) {
+    mqtt_manager_init();
+    return mqtt_rpc_init();
+}
+
+// After mqtt: the task waits on the broker session from its first sample, and
+// mqtt_manager_wait_connected() has nothing to wait on before mqtt_manager_init().
+// It waits for the station's IP anyway, so this costs it nothing.
+static esp_err_t stage_app(void) {
+    app_logic_init();
+    return ESP_OK;
+}
+
+// Health check for an image booting for the first time after an update: every
+// stage must have come up and the broker must be reachable, or ota_manager rolls
+// back to the previous image. Runs on its own task, so waiting on the boot is fine.
+static esp_err_t ota_health(uint32_t timeout_ms) {
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    esp_err_t err = boot_manager_wait(timeout_ms);
+    if (err == ESP_OK) {
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        err = mqtt_manager_wait_connected(left_ms > 0 ? (uint32_t)left_ms : 0);
     }
-}
\ No newline at end of file
+    return err;
+}
+
+// After wifi: that stage creates the NVS lock the settings store uses. Not after
+// ip or mqtt, which can block forever and would then keep a bad image from rolling back.
+static esp_err_t stage_ota(void) {
+    return ota_manager_init(ota_health);
+}
+
+static const boot_stage_t boot_stages[STAGE_COUNT] = {
+    [STAGE_NVS]   = { "nvs",   stage_nvs,   0, 0 },
+    [STAGE_NETIF] = { "netif", stage_netif, 0, 0 },
+    [STAGE_BOARD] = { "board", stage_board, 0, 0 },
+    [STAGE_TLS]   = { "tls",   mqtt_manager_prepare_tls, 0, 0 },
+    [STAGE_WIFI]  = { "wifi",  stage_wifi,  BOOT_DEP(STAGE_NVS) | BOOT_DEP(STAGE_NETIF), 6144 },
+    [STAGE_IP]    = { "ip",    stage_ip,    BOOT_DEP(STAGE_WIFI), 2048 },
+    [STAGE_MQTT]  = { "mqtt",  stage_mqtt,  BOOT_DEP(STAGE_IP) | BOOT_DEP(STAGE_TLS), 0 },
+    [STAGE_APP]   = { "app",   stage_app,   BOOT_DEP(STAGE_BOARD) | BOOT_DEP(STAGE_WIFI) | BOOT_DEP(STAGE_MQTT), 0 },
+    [STAGE_OTA]   = { "ota",   stage_ota,   BOOT_DEP(STAGE_WIFI), 0 },
+};
+
+void app_main(void) {
+    ESP_LOGI(TAG, "PianoGuard DCM-1 starting up...");
+
+    ESP_ERROR_CHECK(boot_manager_run(boot_stages, STAGE_COUNT));
+
+    // The stages own everything from here; the timeline is logged when the last one finishes.
+}